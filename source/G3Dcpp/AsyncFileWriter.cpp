@@ -0,0 +1,207 @@
+/**
+ @file AsyncFileWriter.cpp
+
+ @maintainer Morgan McGuire, matrix@graphics3d.com
+
+ @created 2026-10-17
+ @edited  2026-10-17
+ */
+
+#include "G3D/platform.h"
+#include "G3D/AsyncFileWriter.h"
+#include "G3D/Queue.h"
+#include "G3D/System.h"
+#include "G3D/fileutils.h"
+#include "G3D/stringutils.h"
+
+namespace G3D {
+
+AsyncWrite::AsyncWrite(const std::string& f, uint8* d, size_t n, bool a) :
+    _filename(f), data(d), length(n), append(a), done(0), _completed(false), _ok(false) {
+}
+
+
+AsyncWrite::~AsyncWrite() {
+    System::free(data);
+    data = NULL;
+}
+
+
+void AsyncWrite::wait() {
+    done.acquire();
+    // Let other waiters through
+    done.release();
+}
+
+
+namespace _internal {
+
+class AsyncFileWriterThread : public GThread {
+public:
+
+    GMutex                  lock;
+
+    /** Protected by lock.  A null element tells the thread to exit. */
+    Queue<AsyncWriteRef>    queue;
+
+    /** Most recently queued write; protected by lock. */
+    AsyncWriteRef           last;
+
+    /** Count of elements in queue */
+    GSemaphore              items;
+
+    /** Count of free queue slots */
+    GSemaphore              slots;
+
+    /** Total queue slots */
+    int                     numSlots;
+
+    AsyncFileWriterThread(int n) : GThread("AsyncFileWriter"), items(0), slots(n), numSlots(n) {}
+
+    void push(const AsyncWriteRef& w) {
+        slots.acquire();
+        lock.lock();
+        queue.pushBack(w);
+        if (w.notNull()) {
+            last = w;
+        }
+        lock.unlock();
+        items.release();
+    }
+
+    static void perform(AsyncWrite* w) {
+        if (! w->append) {
+            // Create the parent directory
+            std::string root, base, ext;
+            Array<std::string> path;
+            parseFilename(w->_filename, root, path, base, ext);
+            if (path.size() > 0) {
+                std::string dir = root + stringJoin(path, '/');
+                if (! fileExists(dir)) {
+                    createDirectory(dir);
+                }
+            }
+        }
+
+        FILE* file = fopen(w->_filename.c_str(), w->append ? "ab" : "wb");
+        if (file != NULL) {
+            w->_ok = (fwrite(w->data, 1, w->length, file) == w->length);
+            w->_ok = (fclose(file) == 0) && w->_ok;
+        }
+
+        System::free(w->data);
+        w->data = NULL;
+        w->_completed = true;
+        w->done.release();
+    }
+
+protected:
+
+    virtual void threadMain() {
+        while (true) {
+            items.acquire();
+
+            lock.lock();
+            AsyncWriteRef w = queue.popFront();
+            lock.unlock();
+
+            if (w.isNull()) {
+                return;
+            }
+
+            perform(w.pointer());
+            w = NULL;
+            slots.release();
+        }
+    }
+};
+
+} // _internal
+
+
+/** Created on the first write */
+static _internal::AsyncFileWriterThread* writer = NULL;
+static GMutex writerLock;
+static int writerMaxPending = 4;
+
+
+/** Finishes pending writes when the program exits */
+static class AsyncFileWriterShutdown {
+public:
+    ~AsyncFileWriterShutdown() {
+        GMutexLock l(&writerLock);
+        if (writer != NULL) {
+            writer->push(AsyncWriteRef());
+            writer->waitForCompletion();
+            delete writer;
+            writer = NULL;
+        }
+    }
+} asyncFileWriterShutdown;
+
+
+static _internal::AsyncFileWriterThread* writerThread() {
+    // Always lock, so that no thread can see the pointer before the writer
+    // is constructed.  This is cheap next to the file I/O that follows.
+    GMutexLock l(&writerLock);
+    if (writer == NULL) {
+        writer = new _internal::AsyncFileWriterThread(writerMaxPending);
+        bool started = writer->start();
+        alwaysAssertM(started, "Could not start the AsyncFileWriter thread."); (void)started;
+    }
+    return writer;
+}
+
+
+AsyncWriteRef AsyncFileWriter::write(const std::string& filename, uint8* data, size_t length, bool append) {
+    debugAssert((data != NULL) || (length == 0));
+    AsyncWriteRef w = new AsyncWrite(filename, data, length, append);
+    writerThread()->push(w);
+    return w;
+}
+
+
+void AsyncFileWriter::waitForAll() {
+    AsyncWriteRef w;
+    {
+        GMutexLock l(&writerLock);
+        if (writer == NULL) {
+            return;
+        }
+
+        writer->lock.lock();
+        w = writer->last;
+        writer->lock.unlock();
+    }
+
+    // Writes complete in order, so the last one finishes after all others
+    if (w.notNull()) {
+        w->wait();
+    }
+}
+
+
+void AsyncFileWriter::setMaxPending(int n) {
+    alwaysAssertM(n > 0, "Must allow at least one pending write.");
+    GMutexLock l(&writerLock);
+    writerMaxPending = n;
+    if (writer == NULL) {
+        return;
+    }
+
+    if (n > writer->numSlots) {
+        writer->slots.release(n - writer->numSlots);
+    } else {
+        for (int i = n; i < writer->numSlots; ++i) {
+            writer->slots.acquire();
+        }
+    }
+    writer->numSlots = n;
+}
+
+
+int AsyncFileWriter::maxPending() {
+    return writerMaxPending;
+}
+
+}
@@ -0,0 +1,268 @@
+/**
+ @file Benchmark.cpp
+
+ @maintainer Morgan McGuire, matrix@graphics3d.com
+
+ @created 2026-10-17
+ @edited  2026-10-17
+ */
+
+#include "G3D/platform.h"
+#include "G3D/Benchmark.h"
+#include "G3D/System.h"
+#include "G3D/TextOutput.h"
+#include "G3D/fileutils.h"
+#include "G3D/stringutils.h"
+#include "G3D/format.h"
+#include "G3D/g3dmath.h"
+#include "G3D/debug.h"
+#include <stdlib.h>
+
+namespace G3D {
+
+Benchmark::Benchmark(const Settings& settings) : m_settings(settings) {
+    // Every result is computed from at least one timed iteration
+    alwaysAssertM(settings.maxIterations >= 1, "Benchmark::Settings::maxIterations must be at least 1");
+}
+
+
+Benchmark::~Benchmark() {
+    for (int i = 0; i < m_entry.size(); ++i) {
+        delete m_entry[i].benchCase;
+    }
+}
+
+
+void Benchmark::add(const std::string& name, Case* benchCase, int elementsPerIteration) {
+    debugAssertM((name.find(',') == std::string::npos) && (name.find('"') == std::string::npos),
+                 "Benchmark names may not contain commas or quotes");
+    debugAssert(elementsPerIteration > 0);
+#   ifdef G3D_DEBUG
+        for (int i = 0; i < m_entry.size(); ++i) {
+            debugAssertM(m_entry[i].name != name, "Duplicate benchmark name " + name);
+        }
+#   endif
+
+    Entry& e = m_entry.next();
+    e.name      = name;
+    e.benchCase = benchCase;
+    e.elements  = elementsPerIteration;
+}
+
+
+void Benchmark::add(const std::string& name, void (*function)(), int elementsPerIteration) {
+    add(name, new FunctionCase(function), elementsPerIteration);
+}
+
+
+/** Value at fraction f of the sorted array, interpolating between neighbors */
+static double percentile(const Array<double>& sorted, double f) {
+    const double x = f * (sorted.size() - 1);
+    const int i = iFloor(x);
+    if (i + 1 >= sorted.size()) {
+        return sorted.last();
+    }
+    return lerp(sorted[i], sorted[i + 1], x - i);
+}
+
+
+void Benchmark::runCase(const Entry& entry, Result& result) const {
+    Case* c = entry.benchCase;
+
+    c->setUp();
+
+    for (int i = 0; i < m_settings.warmupIterations; ++i) {
+        c->beforeIteration();
+        c->run();
+    }
+
+    // Iterations are timed with the cycle counter, which has much finer resolution
+    // than System::time(), and converted to seconds with the ratio of the two
+    // clocks over the whole run
+    Array<double> cycles;
+    const RealTime start = System::time();
+    const uint64 startCycles = System::getCycleCount();
+    while ((cycles.size() < m_settings.maxIterations) &&
+           ((cycles.size() < m_settings.minIterations) || (System::time() - start < m_settings.minTime))) {
+
+        c->beforeIteration();
+
+        const uint64 c0 = System::getCycleCount();
+        c->run();
+        const uint64 c1 = System::getCycleCount();
+
+        cycles.append((double)(c1 - c0));
+    }
+    const RealTime elapsed = System::time() - start;
+    const uint64 elapsedCycles = System::getCycleCount() - startCycles;
+    const double secondsPerCycle = elapsed / (double)((elapsedCycles > 0) ? elapsedCycles : 1);
+
+    c->tearDown();
+
+    Array<double> seconds;
+    seconds.resize(cycles.size());
+    for (int i = 0; i < cycles.size(); ++i) {
+        seconds[i] = cycles[i] * secondsPerCycle;
+    }
+
+    const int n = seconds.size();
+    debugAssert(n > 0);
+    double sum = 0;
+    for (int i = 0; i < n; ++i) {
+        sum += seconds[i];
+    }
+    const double mean = sum / n;
+
+    double variance = 0;
+    for (int i = 0; i < n; ++i) {
+        variance += square(seconds[i] - mean);
+    }
+    if (n > 1) {
+        variance /= n - 1;
+    }
+
+    seconds.sort();
+    cycles.sort();
+
+    result.name                 = entry.name;
+    result.iterations           = n;
+    result.elementsPerIteration = entry.elements;
+    result.median               = percentile(seconds, 0.5);
+    result.p95                  = percentile(seconds, 0.95);
+    result.mean                 = mean;
+    result.stddev               = sqrt(variance);
+    result.min                  = seconds[0];
+    result.cyclesPerElement     = percentile(cycles, 0.5) / entry.elements;
+    result.hasBaseline          = false;
+    result.baselineMedian       = 0;
+    result.regressed            = false;
+}
+
+
+static std::string describe(const Benchmark::Result& r) {
+    std::string s = format("%-52s %10.4f %10.4f %8.4f %12.2f",
+                           r.name.c_str(), r.median * 1000, r.p95 * 1000,
+                           r.stddev * 1000, r.cyclesPerElement);
+    if (r.hasBaseline) {
+        s += format("  %+6.1f%%%s", (r.median / r.baselineMedian - 1) * 100,
+                    r.regressed ? "  REGRESSED" : "");
+    }
+    return s;
+}
+
+
+static const char* header() {
+    return "Case                                                  median ms     p95 ms   std ms   cycles/elt\n";
+}
+
+
+void Benchmark::run() {
+    m_result.fastClear();
+
+    if (m_settings.verbose) {
+        printf("%s", header());
+    }
+
+    for (int i = 0; i < m_entry.size(); ++i) {
+        const Entry& e = m_entry[i];
+        if ((m_settings.filter != "") && (e.name.find(m_settings.filter) == std::string::npos)) {
+            continue;
+        }
+
+        Result& r = m_result.next();
+        runCase(e, r);
+
+        if (m_settings.verbose) {
+            printf("%s\n", describe(r).c_str());
+            fflush(stdout);
+        }
+    }
+}
+
+
+std::string Benchmark::report() const {
+    std::string s = header();
+    for (int i = 0; i < m_result.size(); ++i) {
+        s += describe(m_result[i]) + "\n";
+    }
+    return s;
+}
+
+
+void Benchmark::writeJSON(const std::string& filename) const {
+    TextOutput::Options options;
+    options.wordWrap = TextOutput::Options::WRAP_NONE;
+    TextOutput t(filename, options);
+
+    t.printf("{\"results\":[");
+    for (int i = 0; i < m_result.size(); ++i) {
+        const Result& r = m_result[i];
+        t.printf("%s\n{\"name\":\"%s\",\"iterations\":%d,\"elements\":%d,"
+                 "\"median\":%.9g,\"p95\":%.9g,\"mean\":%.9g,\"stddev\":%.9g,\"min\":%.9g,"
+                 "\"cyclesPerElement\":%.9g",
+                 (i == 0) ? "" : ",",
+                 r.name.c_str(), r.iterations, r.elementsPerIteration,
+                 r.median, r.p95, r.mean, r.stddev, r.min, r.cyclesPerElement);
+        if (r.hasBaseline) {
+            t.printf(",\"baselineMedian\":%.9g,\"regressed\":%s",
+                     r.baselineMedian, r.regressed ? "true" : "false");
+        }
+        t.printf("}");
+    }
+    t.printf("\n]}\n");
+    t.commit();
+}
+
+
+void Benchmark::writeCSV(const std::string& filename) const {
+    TextOutput::Options options;
+    options.wordWrap = TextOutput::Options::WRAP_NONE;
+    TextOutput t(filename, options);
+
+    t.printf("name,iterations,elements,median,p95,mean,stddev,min,cyclesPerElement\n");
+    for (int i = 0; i < m_result.size(); ++i) {
+        const Result& r = m_result[i];
+        t.printf("%s,%d,%d,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g\n",
+                 r.name.c_str(), r.iterations, r.elementsPerIteration,
+                 r.median, r.p95, r.mean, r.stddev, r.min, r.cyclesPerElement);
+    }
+    t.commit();
+}
+
+
+int Benchmark::compareToBaseline(const std::string& filename) {
+    if (! fileExists(filename)) {
+        return -1;
+    }
+
+    const Array<std::string> line = stringSplit(readFileAsString(filename), '\n');
+
+    int regressions = 0;
+
+    // Line 0 is the header
+    for (int i = 1; i < line.size(); ++i) {
+        const Array<std::string> field = stringSplit(trimWhitespace(line[i]), ',');
+        if (field.size() < 4) {
+            continue;
+        }
+
+        for (int r = 0; r < m_result.size(); ++r) {
+            Result& result = m_result[r];
+            if (result.name == field[0]) {
+                result.hasBaseline    = true;
+                result.baselineMedian = atof(field[3].c_str());
+                result.regressed      =
+                    (result.baselineMedian > 0) &&
+                    (result.median > result.baselineMedian * (1.0 + m_settings.regressionThreshold));
+                if (result.regressed) {
+                    ++regressions;
+                }
+                break;
+            }
+        }
+    }
+
+    return regressions;
+}
+
+}
@@ -35,15 +35,117 @@
 #include "G3D/BinaryInput.h"
 #include "G3D/Array.h"
 #include "G3D/fileutils.h"
+#include "G3D/ThreadPool.h"
 #ifdef G3D_WIN32
   #include "../zlib/zlib.h"
 #else
   #include <zlib.h>
+  #include <sys/mman.h>
+  #include <fcntl.h>
+  #include <unistd.h>
 #endif
 #include <stdio.h>
 
 namespace G3D {
 
+/**
+ Maps the whole of a file of the given length read-only.  Returns NULL if
+ the file cannot be mapped, in which case the caller should read it instead.
+ */
+static uint8* mapFile(const std::string& filename, int64 length, BinaryInput::MemoryMap hint) {
+    if ((length <= 0) || ((int64)(size_t)length != length)) {
+        // Empty, or too large for the address space
+        return NULL;
+    }
+
+#   ifdef G3D_WIN32
+        DWORD flags = FILE_ATTRIBUTE_NORMAL | 
+            ((hint == BinaryInput::MAP_SEQUENTIAL) ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS);
+
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                  OPEN_EXISTING, flags, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return NULL;
+        }
+
+        HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if (mapping == NULL) {
+            return NULL;
+        }
+
+        // The view keeps the mapping object alive
+        void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+
+        return (uint8*)ptr;
+#   else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return NULL;
+        }
+
+        void* ptr = mmap(NULL, (size_t)length, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED) {
+            return NULL;
+        }
+
+        // The hint is only advice; ignore failure
+        madvise(ptr, (size_t)length, (hint == BinaryInput::MAP_SEQUENTIAL) ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+        return (uint8*)ptr;
+#   endif
+}
+
+
+namespace _internal {
+const uint8 blockCompressedMagic[8] = {'G', '3', 'D', 'B', 'L', 'K', 'Z', 0};
+}
+
+/** Inflates a range of blocks of a block-compressed file; a ThreadPool::parallelFor body. */
+class BlockDecompressor {
+public:
+    /** Compressed data, beginning at the first block */
+    const uint8*            src;
+
+    /** File offsets of the blocks, beginning at the first block, 
+        followed by the offset just past the last block */
+    const int64*            offset;
+
+    uint8*                  dst;
+    int64                   blockSize;
+
+    /** Uncompressed bytes from the start of the first block to the end of the file */
+    int64                   length;
+
+    /** Cleared if any block is corrupt */
+    volatile bool*          ok;
+
+    void operator()(int begin, int end) const {
+        for (int b = begin; b < end; ++b) {
+            const int64 dLen = G3D::min<int64>(blockSize, length - b * blockSize);
+            unsigned long L = (unsigned long)dLen;
+            int result = uncompress(dst + b * blockSize, &L, src + (offset[b] - offset[0]), 
+                                    (unsigned long)(offset[b + 1] - offset[b]));
+            if ((result != Z_OK) || ((int64)L != dLen)) {
+                *ok = false;
+            }
+        }
+    }
+};
+
+
+static void unmapFile(uint8* ptr, int64 length) {
+#   ifdef G3D_WIN32
+        (void)length;
+        UnmapViewOfFile(ptr);
+#   else
+        munmap(ptr, (size_t)length);
+#   endif
+}
+
+
 void BinaryInput::readBool8(std::vector<bool>& out, int64 n) {
     out.resize(n);
     // std::vector optimizes bool in a way that prevents fast reading
@@ -128,7 +230,144 @@ IMPLEMENT_READER(Float64, float64)
 
 #undef IMPLEMENT_READER
 
+void BinaryInput::readCompressed(int64 offset, int64 count, uint8* dst) const {
+    debugAssert(offset + count <= compressedLength);
+
+    if (compressedView != NULL) {
+        System::memcpy(dst, compressedView + offset, (size_t)count);
+        return;
+    }
+
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == NULL) {
+        throw format("File not found: \"%s\"", filename.c_str());
+    }
+
+#   ifdef G3D_WIN32
+        // TODO: large file support
+        int ret = fseek(file, (long)offset, SEEK_SET);
+#   else
+        int ret = fseeko(file, (off_t)offset, SEEK_SET);
+#   endif
+    debugAssert(ret == 0); (void)ret;
+
+    size_t count2 = fread(dst, 1, (size_t)count, file);
+    fclose(file);
+    file = NULL;
+
+    if ((int64)count2 != count) {
+        throw format("Truncated block-compressed file: \"%s\"", filename.c_str());
+    }
+}
+
+
+void BinaryInput::openBlocks() {
+    // Layout (integers in file byte order):
+    //   8-byte magic, uint32 blockSize, uint32 unused
+    //   compressed blocks
+    //   index: int64 file offset of each block
+    //   trailer: int64 uncompressed length, int64 index offset, uint32 numBlocks, uint32 unused
+    const int64 headerSize = 16;
+    const int64 trailerSize = 24;
+
+    if (compressedLength < headerSize + trailerSize) {
+        throw format("Corrupt block-compressed file: \"%s\"", filename.c_str());
+    }
+
+    uint8 header[headerSize];
+    readCompressed(0, headerSize, header);
+    blockSize = BinaryInput(header + 8, 4, fileEndian, false, NO_COPY).readUInt32();
+
+    uint8 trailerData[trailerSize];
+    readCompressed(compressedLength - trailerSize, trailerSize, trailerData);
+    BinaryInput trailer(trailerData, trailerSize, fileEndian, false, NO_COPY);
+    length = trailer.readInt64();
+    const int64 indexOffset = trailer.readInt64();
+    const int numBlocks = trailer.readInt32();
+
+    if ((blockSize <= 0) || (indexOffset + numBlocks * 8 + trailerSize != compressedLength) ||
+        (numBlocks != (length + blockSize - 1) / blockSize)) {
+        throw format("Corrupt block-compressed file: \"%s\"", filename.c_str());
+    }
+
+    Array<uint8> indexData(numBlocks * 8);
+    readCompressed(indexOffset, numBlocks * 8, indexData.getCArray());
+    BinaryInput index(indexData.getCArray(), indexData.size(), fileEndian, false, NO_COPY);
+    index.readInt64(blockOffset, numBlocks);
+    blockOffset.append(indexOffset);
+
+    alreadyRead = 0;
+    pos = 0;
+    bufferLength = 0;
+    blockBufferCapacity = 0;
+}
+
+
+void BinaryInput::loadBlocks(int64 startPosition, int64 minLength) {
+    const int64 absPos = alreadyRead + pos;
+    const int numBlocks = blockOffset.size() - 1;
+
+    if (numBlocks == 0) {
+        alreadyRead = startPosition;
+        pos = absPos - alreadyRead;
+        return;
+    }
+
+    const int first = (int)G3D::min<int64>(startPosition / blockSize, numBlocks - 1);
+    const int last  = (int)G3D::min<int64>((startPosition + G3D::max<int64>(minLength, 1) - 1) / blockSize, numBlocks - 1);
+    const int count = last - first + 1;
+
+    const int64 needed = count * blockSize;
+    if (needed > blockBufferCapacity) {
+        System::free(buffer);
+        buffer = (uint8*)System::malloc((size_t)needed);
+        if (buffer == NULL) {
+            throw "Tried to read a larger memory chunk than could fit in memory. (3)";
+        }
+        blockBufferCapacity = needed;
+    }
+
+    // Get the compressed data for all of the blocks in one read
+    const int64 srcOffset = blockOffset[first];
+    const int64 srcLength = blockOffset[last + 1] - srcOffset;
+    uint8* temp = NULL;
+    const uint8* src;
+    if (compressedView != NULL) {
+        src = compressedView + srcOffset;
+    } else {
+        temp = (uint8*)System::malloc((size_t)srcLength);
+        readCompressed(srcOffset, srcLength, temp);
+        src = temp;
+    }
+
+    volatile bool ok = true;
+    BlockDecompressor body;
+    body.src       = src;
+    body.offset    = blockOffset.getCArray() + first;
+    body.dst       = buffer;
+    body.blockSize = blockSize;
+    body.length    = length - first * blockSize;
+    body.ok        = &ok;
+    ThreadPool::common().parallelFor(0, count, 1, body);
+
+    System::free(temp);
+
+    if (! ok) {
+        throw format("Corrupt block-compressed file: \"%s\"", filename.c_str());
+    }
+
+    alreadyRead  = first * blockSize;
+    bufferLength = G3D::min<int64>(needed, length - alreadyRead);
+    pos = absPos - alreadyRead;
+}
+
+
 void BinaryInput::loadIntoMemory(int64 startPosition, int64 minLength) {
+    if (blockSize > 0) {
+        loadBlocks(startPosition, minLength);
+        return;
+    }
+
     // Load the next section of the file
     debugAssertM(filename != "<memory>", "Read past end of file.");
 
@@ -212,6 +451,11 @@ BinaryInput::BinaryInput(
     bitPos = 0;
     alreadyRead = 0;
     bufferLength = 0;
+    mapped = false;
+    blockSize = 0;
+    compressedView = NULL;
+    compressedLength = 0;
+    blockBufferCapacity = 0;
 
     freeBuffer = copyMemory || compressed;
 
@@ -220,7 +464,22 @@ BinaryInput::BinaryInput(
     pos = 0;
     swapBytes = needSwapBytes(fileEndian);
 
-    if (compressed) {
+    if (compressed && (dataLen >= 8) &&
+        (memcmp(data, _internal::blockCompressedMagic, 8) == 0)) {
+
+        // Decompress every block now, since the caller may free data
+        compressedView = const_cast<uint8*>(data);
+        compressedLength = dataLen;
+        openBlocks();
+        loadBlocks(0, length);
+        debugAssert(bufferLength == length);
+
+        // From here on this behaves like an uncompressed in-memory file
+        compressedView = NULL;
+        blockSize = 0;
+        blockOffset.clear();
+
+    } else if (compressed) {
         // Read the decompressed size from the first 4 bytes
         length = G3D::readUInt32(data, swapBytes);
 
@@ -252,10 +511,16 @@ BinaryInput::BinaryInput(
 BinaryInput::BinaryInput(
     const std::string&  filename,
     G3DEndian           fileEndian,
-    bool                compressed) {
+    bool                compressed,
+    MemoryMap           memoryMap) {
 
     alreadyRead = 0;
     freeBuffer = true;
+    mapped = false;
+    blockSize = 0;
+    compressedView = NULL;
+    compressedLength = 0;
+    blockBufferCapacity = 0;
     this->fileEndian = fileEndian;
     this->filename = filename;
 	buffer = NULL;
@@ -281,6 +546,60 @@ BinaryInput::BinaryInput(
 		return;
 	}
 
+    if (compressed && (length >= 8)) {
+        uint8 magic[8];
+        size_t n = fread(magic, 1, 8, file);
+        if ((n == 8) && (memcmp(magic, _internal::blockCompressedMagic, 8) == 0)) {
+            // Block-compressed; decompress lazily.
+            fclose(file);
+            file = NULL;
+
+            compressedLength = length;
+            if (memoryMap != NO_MEMORY_MAP) {
+                compressedView = mapFile(filename, compressedLength, memoryMap);
+            }
+            openBlocks();
+            return;
+        }
+        fseek(file, 0, SEEK_SET);
+    }
+
+    if (memoryMap != NO_MEMORY_MAP) {
+        uint8* view = mapFile(filename, length, memoryMap);
+
+        if (view != NULL) {
+            fclose(file);
+            file = NULL;
+
+            if (compressed) {
+                // Decompress straight out of the mapping; there is no
+                // need to keep it afterwards.
+                const int64 viewLength = length;
+                length = G3D::readUInt32(view, swapBytes);
+                buffer = (uint8*)System::malloc(length);
+                if (buffer == NULL) {
+                    unmapFile(view, viewLength);
+                    throw "Not enough memory to load compressed file. (3)";
+                }
+
+                unsigned long L = length;
+                int64 result = uncompress(buffer, &L, view + 4, viewLength - 4);
+                length = L;
+                bufferLength = length;
+                debugAssert(result == Z_OK); (void)result;
+
+                unmapFile(view, viewLength);
+            } else {
+                buffer = view;
+                bufferLength = length;
+                freeBuffer = false;
+                mapped = true;
+            }
+            return;
+        }
+        // Fall through and read the file normally
+    }
+
     if (! compressed && (length > INITIAL_BUFFER_LENGTH)) {
         // Read only a subset of the file so we don't consume
         // all available memory.
@@ -357,8 +676,15 @@ BinaryInput::~BinaryInput() {
 
     if (freeBuffer) {
         System::free(buffer);
+    } else if (mapped) {
+        unmapFile(buffer, length);
     }
     buffer = NULL;
+
+    if (compressedView != NULL) {
+        unmapFile(compressedView, compressedLength);
+        compressedView = NULL;
+    }
 }
 
 
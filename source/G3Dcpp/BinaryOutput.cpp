@@ -27,6 +27,19 @@
 
 namespace G3D {
 
+/** Creates the directory that will contain filename if it does not exist. */
+static void createParentDirectory(const std::string& filename) {
+    std::string root, base, ext, path;
+    Array<std::string> pathArray;
+    parseFilename(filename, root, pathArray, base, ext); 
+
+    path = root + stringJoin(pathArray, '/');
+    if (! fileExists(path)) {
+        createDirectory(path);
+    }
+}
+
+
 void BinaryOutput::writeBool8(const std::vector<bool>& out, int n) {
     for (int i = 0; i < n; ++i) {
         writeBool8(out[i]);
@@ -109,6 +122,29 @@ IMPLEMENT_WRITER(Float64, float64)
 void BinaryOutput::reallocBuffer(size_t bytes, size_t oldBufferLen) {
     //debugPrintf("reallocBuffer(%d, %d)\n", bytes, oldBufferLen);
 
+    if (blockSize > 0) {
+        // Instead of growing the buffer, stream complete blocks to disk.
+        // Keep one complete block for seeking backwards and never write
+        // out the block that is about to be written to.
+        const int n = iMin((int)oldBufferLen / blockSize - 1, pos / blockSize);
+        if (n > 0) {
+            bufferLen = oldBufferLen;
+            writeBlocks(n * blockSize);
+            reserveBytes(bytes);
+            return;
+        }
+    }
+
+    if ((asyncFlushThreshold > 0) && ((int)oldBufferLen >= asyncFlushThreshold) && 
+        (pos >= (int)oldBufferLen / 2)) {
+        // Instead of growing the buffer, hand the part already written
+        // to the background writer.
+        bufferLen = oldBufferLen;
+        flushAsync();
+        reserveBytes(bytes);
+        return;
+    }
+
     size_t newBufferLen = (int)(bufferLen * 1.5) + 100;
     uint8* newBuffer = NULL;
 
@@ -155,6 +191,8 @@ void BinaryOutput::reserveBytesWhenOutOfMemory(size_t bytes) {
 
         //debugPrintf("Writing %d bytes to disk\n", writeBytes);
 
+        waitForPendingWrite();
+
         const char* mode = (alreadyWritten > 0) ? "ab" : "wb";
         FILE* file = fopen(filename.c_str(), mode);
         debugAssert(file);
@@ -202,6 +240,9 @@ BinaryOutput::BinaryOutput() {
     bitString = 0;
     bitPos = 0;
     committed = false;
+    blockSize = 0;
+    compressedWritten = 0;
+    asyncFlushThreshold = 0;
 }
 
 
@@ -220,6 +261,9 @@ BinaryOutput::BinaryOutput(
     bitString = 0;
     bitPos = 0;
     committed = false;
+    blockSize = 0;
+    compressedWritten = 0;
+    asyncFlushThreshold = 0;
 }
 
 
@@ -253,7 +297,132 @@ void BinaryOutput::setEndian(G3DEndian fileEndian) {
 }
 
 
+void BinaryOutput::enableBlockCompression(int b) {
+    alwaysAssertM(filename != "<memory>", "Block compression is only supported for files.");
+    alwaysAssertM((bufferLen == 0) && (alreadyWritten == 0),
+                  "enableBlockCompression must be called before writing.");
+    alwaysAssertM(b > 0, "Block size must be positive.");
+    blockSize = b;
+}
+
+
+void BinaryOutput::setAsyncFlushThreshold(int bytes) {
+    alwaysAssertM(filename != "<memory>", "Asynchronous flushing is only supported for files.");
+    alwaysAssertM(blockSize == 0, "Asynchronous flushing cannot be combined with block compression.");
+    alwaysAssertM(bytes >= 0, "Threshold must be non-negative.");
+    asyncFlushThreshold = bytes;
+}
+
+
+void BinaryOutput::flushAsync() {
+    debugAssert(pos > 0);
+
+    // Give the old buffer to the writer rather than copying out of it
+    uint8* old = buffer;
+    buffer = (uint8*)System::malloc(maxBufferLen);
+    if (buffer == NULL) {
+        buffer = old;
+        throw "Out of memory while writing to disk in BinaryOutput.";
+    }
+    System::memcpy(buffer, old + pos, bufferLen - pos);
+
+    pendingWrite = AsyncFileWriter::write(filename, old, pos, alreadyWritten > 0);
+
+    alreadyWritten += pos;
+    bufferLen -= pos;
+    pos = 0;
+}
+
+
+void BinaryOutput::waitForPendingWrite() {
+    if (pendingWrite.notNull()) {
+        pendingWrite->wait();
+        pendingWrite = NULL;
+    }
+}
+
+
+/** The byte order that BinaryOutput::swapBytes implies */
+static G3DEndian fileEndian(bool swapBytes) {
+    if (swapBytes == (System::machineEndian() == G3D_LITTLE_ENDIAN)) {
+        return G3D_BIG_ENDIAN;
+    } else {
+        return G3D_LITTLE_ENDIAN;
+    }
+}
+
+
+/** Closes file and throws if it could not take all the data of a
+    block-compressed file.  Release builds must not leave a corrupt file
+    behind silently. */
+static void checkBlockWrite(bool ok, FILE* file, const std::string& filename) {
+    if (! ok) {
+        fclose(file);
+        throw format("Could not write block-compressed file: \"%s\"", filename.c_str());
+    }
+}
+
+
+void BinaryOutput::writeBlocks(int numBytes) {
+    debugAssert(blockSize > 0);
+    debugAssert(numBytes <= bufferLen);
+
+    const char* mode = "ab";
+    if (compressedWritten == 0) {
+        createParentDirectory(filename);
+        mode = "wb";
+    }
+
+    FILE* file = fopen(filename.c_str(), mode);
+    alwaysAssertM(file, std::string("Could not open '") + filename + "'");
+
+    if (compressedWritten == 0) {
+        BinaryOutput header("<memory>", fileEndian(swapBytes));
+        header.writeBytes(_internal::blockCompressedMagic, 8);
+        header.writeUInt32(blockSize);
+        header.writeUInt32(0);
+        checkBlockWrite(fwrite(header.getCArray(), header.size(), 1, file) == 1, file, filename);
+        compressedWritten = header.size();
+    }
+
+    // Zlib requires the output buffer to be this big
+    const unsigned long maxSize = iCeil(blockSize * 1.01) + 12;
+    uint8* temp = (uint8*)System::malloc(maxSize);
+
+    for (int offset = 0; offset < numBytes; offset += blockSize) {
+        unsigned long size = maxSize;
+        const int result = compress2(temp, &size, buffer + offset, iMin(blockSize, numBytes - offset), 
+                                     Z_DEFAULT_COMPRESSION);
+        const bool ok = (result == Z_OK) && (fwrite(temp, 1, size, file) == size);
+        if (! ok) {
+            System::free(temp);
+        }
+        checkBlockWrite(ok, file, filename);
+
+        blockOffset.append(compressedWritten);
+        compressedWritten += size;
+    }
+
+    System::free(temp);
+    if (fclose(file) != 0) {
+        throw format("Could not write block-compressed file: \"%s\"", filename.c_str());
+    }
+    file = NULL;
+
+    // Shift the unwritten data to the front of the buffer
+    memmove(buffer, buffer + numBytes, bufferLen - numBytes);
+    alreadyWritten += numBytes;
+    bufferLen -= numBytes;
+    pos -= numBytes;
+    debugAssert(pos >= 0);
+}
+
+
 void BinaryOutput::compress() {
+    if (blockSize > 0) {
+        throw "Cannot compress() a file that uses block compression.";
+    }
+
     if (alreadyWritten > 0) {
         throw "Cannot compress huge files (part of this file has already been written to disk).";
     }
@@ -300,16 +469,32 @@ void BinaryOutput::commit(bool flush) {
     committed = true;
     debugAssertM(beginEndBits == 0, "Missing endBits before commit");
 
-    // Make sure the directory exists.
-    std::string root, base, ext, path;
-    Array<std::string> pathArray;
-    parseFilename(filename, root, pathArray, base, ext); 
-
-    path = root + stringJoin(pathArray, '/');
-    if (! fileExists(path)) {
-        createDirectory(path);
+    if (blockSize > 0) {
+        // Write the remaining (possibly partial) blocks and then the index
+        writeBlocks(bufferLen);
+
+        BinaryOutput index("<memory>", fileEndian(swapBytes));
+        index.writeInt64(blockOffset, blockOffset.size());
+        index.writeInt64(alreadyWritten);
+        index.writeInt64(compressedWritten);
+        index.writeUInt32(blockOffset.size());
+        index.writeUInt32(0);
+
+        FILE* file = fopen(filename.c_str(), "ab");
+        alwaysAssertM(file, std::string("Could not open '") + filename + "'");
+        checkBlockWrite(fwrite(index.getCArray(), index.size(), 1, file) == 1, file, filename);
+        if (fclose(file) != 0) {
+            throw format("Could not write block-compressed file: \"%s\"", filename.c_str());
+        }
+        file = NULL;
+        return;
     }
 
+    waitForPendingWrite();
+
+    // Make sure the directory exists.
+    createParentDirectory(filename);
+
     const char* mode = (alreadyWritten > 0) ? "ab" : "wb";
 
     FILE* file = fopen(filename.c_str(), mode);
@@ -327,6 +512,25 @@ void BinaryOutput::commit(bool flush) {
 }
 
 
+AsyncWriteRef BinaryOutput::commitAsync() {
+    debugAssertM(! committed, "Cannot commit twice");
+    committed = true;
+    debugAssertM(beginEndBits == 0, "Missing endBits before commit");
+    alwaysAssertM(filename != "<memory>", "Cannot commitAsync to memory.");
+    alwaysAssertM(blockSize == 0, "Cannot commitAsync a file that uses block compression.");
+
+    pendingWrite = AsyncFileWriter::write(filename, buffer, bufferLen, alreadyWritten > 0);
+
+    alreadyWritten += bufferLen;
+    buffer = NULL;
+    bufferLen = 0;
+    maxBufferLen = 0;
+    pos = 0;
+
+    return pendingWrite;
+}
+
+
 void BinaryOutput::commit(
     uint8*                  out) {
     debugAssertM(! committed, "Cannot commit twice");
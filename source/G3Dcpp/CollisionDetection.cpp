@@ -23,6 +23,10 @@
 #include "G3D/Vector3.h"
 #include "G3D/AABox.h"
 
+#ifdef SSE
+    #include <xmmintrin.h>
+#endif
+
 namespace G3D {
 
 bool CollisionDetection::ignoreBool;
@@ -1545,6 +1549,499 @@ float CollisionDetection::collisionTimeForMovingSphereFixedTriangle(
 }
 
 
+void CollisionDetection::packTriangles(const Array<Triangle>& triangle, PackedTriangles& out) {
+    typedef PackedTriangles P;
+
+    out.triangle = triangle;
+
+    const int numGroups = (triangle.size() + 3) / 4;
+    out.data.resize(numGroups * P::NUM_COMPONENTS * 4);
+
+    for (int g = 0; g < numGroups; ++g) {
+        float* group = out.data.getCArray() + g * P::NUM_COMPONENTS * 4;
+
+        for (int lane = 0; lane < 4; ++lane) {
+            const Triangle& tri = triangle[iMin(g * 4 + lane, triangle.size() - 1)];
+
+            #define COMPONENT(c) group[(c) * 4 + lane]
+
+            Vector3 normal;
+            float d;
+            tri.plane().getEquation(normal, d);
+            COMPONENT(P::NORMAL_X) = normal.x;
+            COMPONENT(P::NORMAL_Y) = normal.y;
+            COMPONENT(P::NORMAL_Z) = normal.z;
+            COMPONENT(P::PLANE_D)  = d;
+
+            for (int v = 0; v < 3; ++v) {
+                for (int a = 0; a < 3; ++a) {
+                    COMPONENT(P::VERTEX + v * 3 + a)         = tri._vertex[v][a];
+                    COMPONENT(P::EDGE_DIRECTION + v * 3 + a) = tri.edgeDirection[v][a];
+                }
+                COMPONENT(P::EDGE_LENGTH + v) = (float)tri.edgeMagnitude[v];
+            }
+
+            // The same edges the ray test computes from the vertices
+            const Vector3 edge01 = tri._vertex[1] - tri._vertex[0];
+            const Vector3 edge02 = tri._vertex[2] - tri._vertex[0];
+            for (int a = 0; a < 3; ++a) {
+                COMPONENT(P::EDGE01 + a) = edge01[a];
+                COMPONENT(P::EDGE02 + a) = edge02[a];
+            }
+
+            // Same projection as isPointInsideTriangle
+            int i, j;
+            switch (tri.primaryAxis()) {
+            case Vector3::X_AXIS:
+                i = Vector3::Z_AXIS;
+                j = Vector3::Y_AXIS;
+                break;
+
+            case Vector3::Y_AXIS:
+                i = Vector3::Z_AXIS;
+                j = Vector3::X_AXIS;
+                break;
+
+            default:
+                i = Vector3::X_AXIS;
+                j = Vector3::Y_AXIS;
+                break;
+            }
+
+            for (int a = 0; a < 3; ++a) {
+                COMPONENT(P::AXIS_I + a) = (a == i) ? 1.0f : 0.0f;
+                COMPONENT(P::AXIS_J + a) = (a == j) ? 1.0f : 0.0f;
+            }
+
+            const Vector3& v0 = tri._vertex[0];
+            const Vector3& v1 = tri._vertex[1];
+            const Vector3& v2 = tri._vertex[2];
+            const float area = (v1[i] - v0[i]) * (v2[j] - v0[j]) - (v2[i] - v0[i]) * (v1[j] - v0[j]);
+            COMPONENT(P::INV_AREA)   = (area == 0) ? 0.0f : (1.0f / area);
+            COMPONENT(P::DEGENERATE) = (area == 0) ? 1.0f : 0.0f;
+
+            #undef COMPONENT
+        }
+    }
+}
+
+
+#ifndef SSE
+
+/** Index of the earliest hit by testing each triangle in turn, or -1 */
+static int earliestPointTriangle(
+    const Vector3&          orig,
+    const Vector3&          dir,
+    const CollisionDetection::PackedTriangles& triangles) {
+
+    float bestTime = inf();
+    int index = -1;
+    for (int i = 0; i < triangles.size(); ++i) {
+        const float t = CollisionDetection::collisionTimeForMovingPointFixedTriangle(orig, dir, triangles[i]);
+        if (t < bestTime) {
+            bestTime = t;
+            index = i;
+        }
+    }
+    return index;
+}
+
+
+/** Index of the earliest hit by testing each triangle in turn, or -1 */
+static int earliestSphereTriangle(
+    const Sphere&           sphere,
+    const Vector3&          velocity,
+    const CollisionDetection::PackedTriangles& triangles) {
+
+    float bestTime = inf();
+    int index = -1;
+    Vector3 location;
+    for (int i = 0; i < triangles.size(); ++i) {
+        const float t = CollisionDetection::collisionTimeForMovingSphereFixedTriangle(sphere, velocity, triangles[i], location);
+        if (t < bestTime) {
+            bestTime = t;
+            index = i;
+        }
+    }
+    return index;
+}
+
+#else
+
+/** Four-wide helpers for the batch triangle queries */
+namespace _internal {
+
+inline __m128 load(const float* group, int component) {
+    return _mm_loadu_ps(group + component * 4);
+}
+
+inline __m128 dot(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+inline __m128 abs(__m128 a) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+}
+
+/** eps(a, b) of g3dmath for comparisons against zero */
+inline __m128 eps(__m128 a) {
+    return _mm_mul_ps(_mm_set1_ps((float)fuzzyEpsilon), _mm_add_ps(abs(a), _mm_set1_ps(1.0f)));
+}
+
+/** mask ? a : b */
+inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/** Twice the signed area of the triangle (d, e, f) in the plane of the
+    projection, as in isPointInsideTriangle */
+inline __m128 area2(__m128 di, __m128 dj, __m128 ei, __m128 ej, __m128 fi, __m128 fj) {
+    return _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(ei, di), _mm_sub_ps(fj, dj)),
+                      _mm_mul_ps(_mm_sub_ps(fi, di), _mm_sub_ps(ej, dj)));
+}
+
+/** Relative tolerance within which the vector and scalar tests may round
+    differently.  Lanes this close to a decision are re-tested. */
+static const float laneSlack = 1e-4f;
+
+/** |a - b| <= laneSlack * scale */
+inline __m128 near(__m128 a, __m128 b, __m128 scale) {
+    return _mm_cmple_ps(abs(_mm_sub_ps(a, b)), _mm_mul_ps(_mm_set1_ps(laneSlack), scale));
+}
+
+/** Bit mask of the lanes that may be the earliest hit and must be re-tested
+    with the scalar routine: those with a time no later than bestTime (within
+    laneSlack), those with a NaN time, and the grazing ones */
+inline int candidateLanes(__m128 time, __m128 grazing, float bestTime) {
+    const __m128 limit = _mm_set1_ps(bestTime + laneSlack * ((float)G3D::abs(bestTime) + 1.0f));
+    const __m128 early = _mm_and_ps(_mm_cmple_ps(time, limit), _mm_cmplt_ps(time, _mm_set1_ps(inf())));
+    return _mm_movemask_ps(_mm_or_ps(_mm_or_ps(early, grazing), _mm_cmpunord_ps(time, time)));
+}
+}
+
+#endif
+
+
+float CollisionDetection::collisionTimeForMovingPointFixedTriangles(
+    const Vector3&          orig,
+    const Vector3&          dir,
+    const PackedTriangles&  triangles,
+    int&                    outIndex,
+    Vector3&                location,
+    Vector3&                normal) {
+
+    outIndex = -1;
+
+#ifdef SSE
+    float bestTime = inf();
+    using namespace _internal;
+    typedef PackedTriangles P;
+
+    const __m128 ox = _mm_set1_ps(orig.x);
+    const __m128 oy = _mm_set1_ps(orig.y);
+    const __m128 oz = _mm_set1_ps(orig.z);
+    const __m128 dx = _mm_set1_ps(dir.x);
+    const __m128 dy = _mm_set1_ps(dir.y);
+    const __m128 dz = _mm_set1_ps(dir.z);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one  = _mm_set1_ps(1.0f);
+    const __m128 infinity = _mm_set1_ps(inf());
+    const __m128 detMin = _mm_set1_ps(0.000001f);
+
+    const int numGroups = triangles.data.size() / (P::NUM_COMPONENTS * 4);
+    const float* group = triangles.data.getCArray();
+    for (int g = 0; g < numGroups; ++g, group += P::NUM_COMPONENTS * 4) {
+        // Ray::intersectionTime, four triangles at a time
+        const __m128 e1x = load(group, P::EDGE01);
+        const __m128 e1y = load(group, P::EDGE01 + 1);
+        const __m128 e1z = load(group, P::EDGE01 + 2);
+        const __m128 e2x = load(group, P::EDGE02);
+        const __m128 e2y = load(group, P::EDGE02 + 1);
+        const __m128 e2z = load(group, P::EDGE02 + 2);
+
+        // pvec = dir x edge2
+        const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+        const __m128 det = dot(e1x, e1y, e1z, px, py, pz);
+        __m128 miss = _mm_cmplt_ps(det, detMin);
+
+        // tvec = orig - vertex 0
+        const __m128 tx = _mm_sub_ps(ox, load(group, P::VERTEX));
+        const __m128 ty = _mm_sub_ps(oy, load(group, P::VERTEX + 1));
+        const __m128 tz = _mm_sub_ps(oz, load(group, P::VERTEX + 2));
+
+        const __m128 u = dot(tx, ty, tz, px, py, pz);
+        miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmpgt_ps(u, det)));
+
+        // qvec = tvec x edge1
+        const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+        const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+        const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+        const __m128 v = dot(dx, dy, dz, qx, qy, qz);
+        miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmplt_ps(v, zero), _mm_cmpgt_ps(_mm_add_ps(u, v), det)));
+
+        const __m128 t = dot(e2x, e2y, e2z, qx, qy, qz);
+        miss = _mm_or_ps(miss, _mm_cmplt_ps(t, zero));
+
+        // Barycentric coordinates and time; lanes near any of the bounds
+        // above may round the other way in the scalar test
+        const __m128 invDet = _mm_div_ps(one, det);
+        const __m128 ub = _mm_mul_ps(u, invDet);
+        const __m128 uvb = _mm_mul_ps(_mm_add_ps(u, v), invDet);
+        const __m128 time = _mm_mul_ps(t, invDet);
+        const __m128 grazing =
+            _mm_or_ps(near(det, detMin, _mm_add_ps(abs(det), detMin)),
+                      _mm_andnot_ps(_mm_cmplt_ps(det, zero),
+                          _mm_or_ps(_mm_or_ps(near(ub, zero, one), near(ub, one, one)),
+                                    _mm_or_ps(_mm_or_ps(near(_mm_mul_ps(v, invDet), zero, one), near(uvb, one, one)),
+                                              near(time, zero, one)))));
+
+        for (int lanes = candidateLanes(select(miss, infinity, time), grazing, bestTime), lane = 0; lanes != 0; lanes >>= 1, ++lane) {
+            const int i = g * 4 + lane;
+            if ((lanes & 1) && (i < triangles.size())) {
+                // Scalar test, in index order so that ties keep the lowest
+                Vector3 laneLocation, laneNormal;
+                const float laneTime = collisionTimeForMovingPointFixedTriangle(orig, dir, triangles[i], laneLocation, laneNormal);
+                if (laneTime < bestTime) {
+                    bestTime = laneTime;
+                    outIndex = i;
+                    location = laneLocation;
+                    normal   = laneNormal;
+                }
+            }
+        }
+    }
+
+    if (outIndex == -1) {
+        location = Vector3::inf();
+    }
+    return bestTime;
+#else
+    outIndex = earliestPointTriangle(orig, dir, triangles);
+    if (outIndex == -1) {
+        location = Vector3::inf();
+        return inf();
+    }
+    return collisionTimeForMovingPointFixedTriangle(orig, dir, triangles[outIndex], location, normal);
+#endif
+}
+
+
+float CollisionDetection::collisionTimeForMovingSphereFixedTriangles(
+    const Sphere&           sphere,
+    const Vector3&          velocity,
+    const PackedTriangles&  triangles,
+    int&                    outIndex,
+    Vector3&                outLocation,
+    Vector3&                outNormal) {
+
+    outIndex = -1;
+
+#ifdef SSE
+    float bestTime = inf();
+    using namespace _internal;
+    typedef PackedTriangles P;
+
+    const __m128 cx = _mm_set1_ps(sphere.center.x);
+    const __m128 cy = _mm_set1_ps(sphere.center.y);
+    const __m128 cz = _mm_set1_ps(sphere.center.z);
+    const __m128 r  = _mm_set1_ps(sphere.radius);
+    const __m128 r2 = _mm_set1_ps(sphere.radius * sphere.radius);
+    const __m128 vx = _mm_set1_ps(velocity.x);
+    const __m128 vy = _mm_set1_ps(velocity.y);
+    const __m128 vz = _mm_set1_ps(velocity.z);
+
+    // The perimeter test moves the triangle towards the sphere
+    const float speed = velocity.magnitude();
+    const __m128 speedV = _mm_set1_ps(speed);
+    const __m128 invSpeed = _mm_set1_ps(1.0f / speed);
+    const __m128 wx = _mm_set1_ps(-velocity.x / speed);
+    const __m128 wy = _mm_set1_ps(-velocity.y / speed);
+    const __m128 wz = _mm_set1_ps(-velocity.z / speed);
+
+    // A sphere of zero radius is tested as a point against the plane, which
+    // skips the backface and interpenetration tests
+    const __m128 isSphere = (sphere.radius == 0) ? _mm_setzero_ps() : _mm_cmpeq_ps(r, r);
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one  = _mm_set1_ps(1.0f);
+    const __m128 infinity = _mm_set1_ps(inf());
+
+    const int numGroups = triangles.data.size() / (P::NUM_COMPONENTS * 4);
+    const float* group = triangles.data.getCArray();
+    for (int g = 0; g < numGroups; ++g, group += P::NUM_COMPONENTS * 4) {
+        const __m128 nx = load(group, P::NORMAL_X);
+        const __m128 ny = load(group, P::NORMAL_Y);
+        const __m128 nz = load(group, P::NORMAL_Z);
+        const __m128 d  = load(group, P::PLANE_D);
+
+        // collisionTimeForMovingSphereFixedPlane
+        const __m128 vdotN = dot(vx, vy, vz, nx, ny, nz);
+        const __m128 backface = _mm_and_ps(isSphere, _mm_cmpgt_ps(vdotN, eps(vdotN)));
+
+        const __m128 distance = _mm_add_ps(dot(cx, cy, cz, nx, ny, nz), d);
+        const __m128 absDistance = abs(distance);
+        const __m128 penetrating = _mm_and_ps(isSphere, _mm_cmplt_ps(absDistance, _mm_add_ps(r, eps(absDistance))));
+
+        // Point on the sphere that hits the plane first
+        const __m128 px = _mm_sub_ps(cx, _mm_mul_ps(r, nx));
+        const __m128 py = _mm_sub_ps(cy, _mm_mul_ps(r, ny));
+        const __m128 pz = _mm_sub_ps(cz, _mm_mul_ps(r, nz));
+
+        // collisionTimeForMovingPointFixedPlane
+        const __m128 pdotN = _mm_add_ps(dot(px, py, pz, nx, ny, nz), d);
+        const __m128 inPlane = _mm_andnot_ps(penetrating,
+            _mm_or_ps(_mm_cmpeq_ps(pdotN, zero), _mm_cmple_ps(abs(pdotN), eps(pdotN))));
+
+        const __m128 tPlane = _mm_div_ps(pdotN, _mm_sub_ps(zero, vdotN));
+        const __m128 touching = _mm_or_ps(penetrating, inPlane);
+        const __m128 planeMiss = _mm_or_ps(backface,
+            _mm_andnot_ps(touching, _mm_or_ps(_mm_cmpge_ps(vdotN, zero), _mm_cmplt_ps(tPlane, zero))));
+
+        const __m128 time = select(touching, zero, tPlane);
+
+        // Location of the collision with the plane
+        __m128 lx = _mm_add_ps(px, _mm_mul_ps(vx, tPlane));
+        __m128 ly = _mm_add_ps(py, _mm_mul_ps(vy, tPlane));
+        __m128 lz = _mm_add_ps(pz, _mm_mul_ps(vz, tPlane));
+        lx = select(inPlane, px, lx);
+        ly = select(inPlane, py, ly);
+        lz = select(inPlane, pz, lz);
+        lx = select(penetrating, _mm_sub_ps(cx, _mm_mul_ps(distance, nx)), lx);
+        ly = select(penetrating, _mm_sub_ps(cy, _mm_mul_ps(distance, ny)), ly);
+        lz = select(penetrating, _mm_sub_ps(cz, _mm_mul_ps(distance, nz)), lz);
+
+        // isPointInsideTriangle, projected onto the axes chosen when packing
+        const __m128 ix = load(group, P::AXIS_I);
+        const __m128 iy = load(group, P::AXIS_I + 1);
+        const __m128 iz = load(group, P::AXIS_I + 2);
+        const __m128 jx = load(group, P::AXIS_J);
+        const __m128 jy = load(group, P::AXIS_J + 1);
+        const __m128 jz = load(group, P::AXIS_J + 2);
+
+        __m128 vertex[3][3];
+        for (int v = 0; v < 3; ++v) {
+            for (int a = 0; a < 3; ++a) {
+                vertex[v][a] = load(group, P::VERTEX + v * 3 + a);
+            }
+        }
+
+        const __m128 li  = dot(lx, ly, lz, ix, iy, iz);
+        const __m128 lj  = dot(lx, ly, lz, jx, jy, jz);
+        const __m128 v0i = dot(vertex[0][0], vertex[0][1], vertex[0][2], ix, iy, iz);
+        const __m128 v0j = dot(vertex[0][0], vertex[0][1], vertex[0][2], jx, jy, jz);
+        const __m128 v1i = dot(vertex[1][0], vertex[1][1], vertex[1][2], ix, iy, iz);
+        const __m128 v1j = dot(vertex[1][0], vertex[1][1], vertex[1][2], jx, jy, jz);
+        const __m128 v2i = dot(vertex[2][0], vertex[2][1], vertex[2][2], ix, iy, iz);
+        const __m128 v2j = dot(vertex[2][0], vertex[2][1], vertex[2][2], jx, jy, jz);
+
+        const __m128 invArea = load(group, P::INV_AREA);
+        const __m128 a = _mm_mul_ps(area2(li, lj, v1i, v1j, v2i, v2j), invArea);
+        const __m128 b = _mm_mul_ps(area2(v0i, v0j, li, lj, v2i, v2j), invArea);
+        const __m128 inside = _mm_andnot_ps(
+            _mm_cmpneq_ps(load(group, P::DEGENERATE), zero),
+            _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(a, zero), _mm_cmpge_ps(b, zero)),
+                       _mm_cmpge_ps(_mm_sub_ps(one, _mm_add_ps(a, b)), zero)));
+
+        // closestPointToTrianglePerimeter
+        __m128 closest[3][3];
+        __m128 distance2[3];
+        for (int e = 0; e < 3; ++e) {
+            const int next = (e + 1) % 3;
+            const __m128 ex = load(group, P::EDGE_DIRECTION + e * 3);
+            const __m128 ey = load(group, P::EDGE_DIRECTION + e * 3 + 1);
+            const __m128 ez = load(group, P::EDGE_DIRECTION + e * 3 + 2);
+            const __m128 t = dot(ex, ey, ez,
+                                 _mm_sub_ps(lx, vertex[e][0]),
+                                 _mm_sub_ps(ly, vertex[e][1]),
+                                 _mm_sub_ps(lz, vertex[e][2]));
+            const __m128 before = _mm_cmplt_ps(t, zero);
+            const __m128 after  = _mm_cmpgt_ps(t, load(group, P::EDGE_LENGTH + e));
+            const __m128 e3[3] = {ex, ey, ez};
+            for (int k = 0; k < 3; ++k) {
+                closest[e][k] = select(before, vertex[e][k],
+                                       select(after, vertex[next][k],
+                                              _mm_add_ps(vertex[e][k], _mm_mul_ps(e3[k], t))));
+            }
+            const __m128 ddx = _mm_sub_ps(closest[e][0], lx);
+            const __m128 ddy = _mm_sub_ps(closest[e][1], ly);
+            const __m128 ddz = _mm_sub_ps(closest[e][2], lz);
+            distance2[e] = dot(ddx, ddy, ddz, ddx, ddy, ddz);
+        }
+
+        // The same tie breaking as closestPointToTrianglePerimeter
+        const __m128 pick0 = _mm_and_ps(_mm_cmplt_ps(distance2[0], distance2[1]), _mm_cmplt_ps(distance2[0], distance2[2]));
+        const __m128 pick1 = _mm_andnot_ps(_mm_cmplt_ps(distance2[0], distance2[1]), _mm_cmplt_ps(distance2[1], distance2[2]));
+        __m128 q[3];
+        for (int k = 0; k < 3; ++k) {
+            q[k] = select(pick0, closest[0][k], select(pick1, closest[1][k], closest[2][k]));
+        }
+
+        // collisionTimeForMovingPointFixedSphere with the triangle moving
+        // towards the sphere
+        const __m128 Lx = _mm_sub_ps(cx, q[0]);
+        const __m128 Ly = _mm_sub_ps(cy, q[1]);
+        const __m128 Lz = _mm_sub_ps(cz, q[2]);
+        const __m128 Ld = dot(Lx, Ly, Lz, wx, wy, wz);
+        const __m128 L2 = dot(Lx, Ly, Lz, Lx, Ly, Lz);
+        const __m128 M2 = _mm_sub_ps(L2, _mm_mul_ps(Ld, Ld));
+        const __m128 outside = _mm_cmpgt_ps(L2, r2);
+        const __m128 sphereMiss = _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(Ld, zero), outside), _mm_cmpgt_ps(M2, r2));
+        const __m128 root = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(r2, M2), zero));
+        const __m128 tSphere = _mm_mul_ps(select(outside, _mm_sub_ps(Ld, root), _mm_add_ps(Ld, root)), invSpeed);
+
+        const __m128 result =
+            select(planeMiss, infinity,
+                   select(inside, time,
+                          select(sphereMiss, infinity, tSphere)));
+
+        // Lanes near any decision above may round the other way in the
+        // scalar test
+        const __m128 grazing =
+            _mm_andnot_ps(_mm_and_ps(isSphere, _mm_cmpgt_ps(vdotN, _mm_add_ps(eps(vdotN), _mm_mul_ps(_mm_set1_ps(laneSlack), speedV)))),
+            _mm_or_ps(
+                _mm_or_ps(_mm_or_ps(near(vdotN, eps(vdotN), speedV), near(vdotN, zero, speedV)),
+                          _mm_or_ps(near(absDistance, _mm_add_ps(r, eps(absDistance)), _mm_add_ps(_mm_add_ps(r, absDistance), one)),
+                                    near(abs(pdotN), eps(pdotN), _mm_add_ps(abs(pdotN), one)))),
+                _mm_or_ps(
+                    _mm_or_ps(_mm_or_ps(near(tPlane, zero, one), near(a, zero, one)),
+                              _mm_or_ps(near(b, zero, one), near(_mm_add_ps(a, b), one, one))),
+                    _mm_or_ps(near(M2, r2, _mm_add_ps(L2, r2)), near(L2, r2, _mm_add_ps(L2, r2))))));
+
+        for (int lanes = candidateLanes(result, grazing, bestTime), lane = 0; lanes != 0; lanes >>= 1, ++lane) {
+            const int i = g * 4 + lane;
+            if ((lanes & 1) && (i < triangles.size())) {
+                // Scalar test, in index order so that ties keep the lowest
+                Vector3 laneLocation, laneNormal;
+                const float laneTime = collisionTimeForMovingSphereFixedTriangle(sphere, velocity, triangles[i], laneLocation, laneNormal);
+                if (laneTime < bestTime) {
+                    bestTime = laneTime;
+                    outIndex = i;
+                    outLocation = laneLocation;
+                    outNormal   = laneNormal;
+                }
+            }
+        }
+    }
+
+    if (outIndex == -1) {
+        outLocation = Vector3::inf();
+    }
+    return bestTime;
+#else
+    outIndex = earliestSphereTriangle(sphere, velocity, triangles);
+    if (outIndex == -1) {
+        outLocation = Vector3::inf();
+        return inf();
+    }
+    return collisionTimeForMovingSphereFixedTriangle(sphere, velocity, triangles[outIndex], outLocation, outNormal);
+#endif
+}
+
+
 float CollisionDetection::collisionTimeForMovingSphereFixedRectangle(
     const Sphere&       sphere,
     const Vector3&      velocity,
@@ -9,6 +9,11 @@
 
 #include "G3D/GThread.h"
 #include "G3D/debugAssert.h"
+#include "G3D/System.h"
+
+#ifndef G3D_WIN32
+#   include <sched.h>
+#endif
 
 
 namespace G3D {
@@ -44,6 +49,7 @@ public:
         current->pthread->running = true;
         current->pthread->completed = false;
         current->threadMain();
+        System::releaseMallocThreadCache();
         current->pthread->running = false;
         current->pthread->completed = true;
         ::SetEvent(current->pthread->event);
@@ -57,6 +63,7 @@ public:
         current->pthread->running = true;
         current->pthread->completed = false;
         current->threadMain();
+        System::releaseMallocThreadCache();
         current->pthread->running = false;
         current->pthread->completed = true;
         return (void*)NULL;
@@ -178,6 +185,14 @@ void GThread::waitForCompletion() {
 #   endif
 }
 
+void GThread::yield() {
+#   ifdef G3D_WIN32
+    ::Sleep(0);
+#   else
+    sched_yield();
+#   endif
+}
+
 
 GMutex::GMutex() {
 #   ifdef G3D_WIN32
@@ -196,13 +211,13 @@ GMutex::~GMutex() {
 #   endif
 }
 
-//bool GMutex::tryLock() {
-//#   ifdef G3D_WIN32
-//    return ::TryEnterCriticalSection(&handle);
-//#   else
-//    return pthread_mutex_trylock(&handle);
-//#   endif
-//}
+bool GMutex::tryLock() {
+#   ifdef G3D_WIN32
+    return (::TryEnterCriticalSection(&handle) != 0);
+#   else
+    return (pthread_mutex_trylock(&handle) == 0);
+#   endif
+}
 
 void GMutex::lock() {
 #   ifdef G3D_WIN32
@@ -220,4 +235,69 @@ void GMutex::unlock() {
 #   endif
 }
 
+
+GSemaphore::GSemaphore(int initialCount) {
+    debugAssert(initialCount >= 0);
+#   ifdef G3D_WIN32
+    handle = ::CreateSemaphore(NULL, initialCount, 0x7FFFFFFF, NULL);
+    debugAssert(handle);
+#   else
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&condition, NULL);
+    count = initialCount;
+#   endif
+}
+
+GSemaphore::~GSemaphore() {
+#   ifdef G3D_WIN32
+    ::CloseHandle(handle);
+#   else
+    pthread_cond_destroy(&condition);
+    pthread_mutex_destroy(&mutex);
+#   endif
+}
+
+void GSemaphore::acquire() {
+#   ifdef G3D_WIN32
+    ::WaitForSingleObject(handle, INFINITE);
+#   else
+    pthread_mutex_lock(&mutex);
+    while (count == 0) {
+        pthread_cond_wait(&condition, &mutex);
+    }
+    --count;
+    pthread_mutex_unlock(&mutex);
+#   endif
+}
+
+bool GSemaphore::tryAcquire() {
+#   ifdef G3D_WIN32
+    return (::WaitForSingleObject(handle, 0) == WAIT_OBJECT_0);
+#   else
+    pthread_mutex_lock(&mutex);
+    bool acquired = (count > 0);
+    if (acquired) {
+        --count;
+    }
+    pthread_mutex_unlock(&mutex);
+    return acquired;
+#   endif
+}
+
+void GSemaphore::release(int n) {
+    debugAssert(n > 0);
+#   ifdef G3D_WIN32
+    ::ReleaseSemaphore(handle, n, NULL);
+#   else
+    pthread_mutex_lock(&mutex);
+    count += n;
+    if (n == 1) {
+        pthread_cond_signal(&condition);
+    } else {
+        pthread_cond_broadcast(&condition);
+    }
+    pthread_mutex_unlock(&mutex);
+#   endif
+}
+
 } // namespace G3D
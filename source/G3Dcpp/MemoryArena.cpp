@@ -0,0 +1,116 @@
+/**
+ @file MemoryArena.cpp
+
+ @maintainer Morgan McGuire, matrix@graphics3d.com
+
+ @created 2026-10-17
+ @edited  2026-10-17
+ */
+
+#include "G3D/platform.h"
+#include "G3D/MemoryArena.h"
+#include "G3D/System.h"
+#include "G3D/format.h"
+
+namespace G3D {
+
+MemoryArena::MemoryArena(size_t c) : first(NULL), current(NULL), offset(0),
+    chunkSize(c), used(0), peak(0), lastPeak(0), capacity(0), numChunks(0) {
+    debugAssert(chunkSize > 0);
+}
+
+
+MemoryArena::~MemoryArena() {
+    freeChunks(first);
+    first   = NULL;
+    current = NULL;
+}
+
+
+void MemoryArena::freeChunks(Chunk* c) {
+    while (c != NULL) {
+        Chunk* next = c->next;
+        capacity -= c->size;
+        --numChunks;
+        System::alignedFree(c);
+        c = next;
+    }
+}
+
+
+void* MemoryArena::allocFromNextChunk(size_t bytes, size_t alignment) {
+    Chunk* next = (current == NULL) ? first : current->next;
+
+    // Chunks after current are unused.  Reuse the next one if it is big
+    // enough, otherwise discard it and the rest of the list.
+    if ((next != NULL) && (next->size < bytes + alignment)) {
+        freeChunks(next);
+        next = NULL;
+        if (current == NULL) {
+            first = NULL;
+        } else {
+            current->next = NULL;
+        }
+    }
+
+    if (next == NULL) {
+        const size_t size = (bytes + alignment > chunkSize) ? (bytes + alignment) : chunkSize;
+        next = (Chunk*)System::alignedMalloc(sizeof(Chunk) + size, 16);
+        next->next = NULL;
+        next->size = size;
+        capacity  += size;
+        ++numChunks;
+
+        if (current == NULL) {
+            first = next;
+        } else {
+            current->next = next;
+        }
+    }
+
+    current = next;
+    offset  = 0;
+
+    void* ptr = alloc(bytes, alignment);
+    debugAssert(ptr != NULL);
+    return ptr;
+}
+
+
+void MemoryArena::release(const Marker& m) {
+    debugAssertM(m.used <= used, "Released a MemoryArena marker out of order");
+    current = m.chunk;
+    offset  = m.offset;
+    used    = m.used;
+}
+
+
+void MemoryArena::reset() {
+    lastPeak = peak;
+    peak     = 0;
+    used     = 0;
+    current  = NULL;
+    offset   = 0;
+
+    if (numChunks > 1) {
+        // Replace the chunk list with a single chunk that can hold everything
+        // that was held before.
+        const size_t total = capacity;
+        freeChunks(first);
+
+        first = (Chunk*)System::alignedMalloc(sizeof(Chunk) + total, 16);
+        first->next = NULL;
+        first->size = total;
+        capacity    = total;
+        numChunks   = 1;
+    }
+}
+
+
+std::string MemoryArena::status() const {
+    return format("MemoryArena: %d kB used (%d kB peak, %d kB previous peak) of %d kB in %d chunk%s",
+                  (int)(used / 1024), (int)(peak / 1024), (int)(lastPeak / 1024),
+                  (int)(capacity / 1024), numChunks, (numChunks == 1) ? "" : "s");
+}
+
+}
@@ -16,12 +16,134 @@
 #include "G3D/Box.h"
 #include "G3D/Sphere.h"
 #include "G3D/vectorMath.h"
+#include "G3D/ThreadPool.h"
+#include <algorithm>
 
 namespace G3D {
 
 const int MeshAlg::Face::NONE             = INT_MIN;
 
 
+/** Elements per parallelFor index in RadixSort */
+static const int RADIX_CHUNK = 16384;
+
+enum {RADIX_BITS = 11, RADIX = 1 << RADIX_BITS};
+
+/** Counts the digits of each chunk */
+class RadixCountBody {
+public:
+    const uint64*   key;
+    int             n;
+    int             shift;
+    int*            count;
+
+    void operator()(int begin, int end) const {
+        for (int c = begin; c < end; ++c) {
+            int* C = count + c * RADIX;
+            for (int d = 0; d < RADIX; ++d) {
+                C[d] = 0;
+            }
+            const int last = iMin((c + 1) * RADIX_CHUNK, n);
+            for (int i = c * RADIX_CHUNK; i < last; ++i) {
+                ++C[(key[i] >> shift) & (RADIX - 1)];
+            }
+        }
+    }
+};
+
+
+/** Moves each chunk's elements to the ranges given by the prefix sum */
+class RadixScatterBody {
+public:
+    const uint64*   key;
+    const int*      value;
+    uint64*         outKey;
+    int*            outValue;
+    int             n;
+    int             shift;
+    int*            offset;
+
+    void operator()(int begin, int end) const {
+        for (int c = begin; c < end; ++c) {
+            int* O = offset + c * RADIX;
+            const int last = iMin((c + 1) * RADIX_CHUNK, n);
+            for (int i = c * RADIX_CHUNK; i < last; ++i) {
+                const int j = O[(key[i] >> shift) & (RADIX - 1)]++;
+                outKey[j]   = key[i];
+                outValue[j] = value[i];
+            }
+        }
+    }
+};
+
+
+void MeshAlg::RadixSort::sort(
+    Array<uint64>&  key,
+    Array<int>&     value,
+    int             numBits,
+    const uint64*&  sortedKey,
+    const int*&     sortedValue) {
+
+    debugAssert(key.size() == value.size());
+    const int n = key.size();
+    const int chunks = (n + RADIX_CHUNK - 1) / RADIX_CHUNK;
+
+    tempKey.resize(n, DONT_SHRINK_UNDERLYING_ARRAY);
+    tempValue.resize(n, DONT_SHRINK_UNDERLYING_ARRAY);
+    count.resize(chunks * RADIX, DONT_SHRINK_UNDERLYING_ARRAY);
+
+    uint64* srcKey   = key.getCArray();
+    int*    srcValue = value.getCArray();
+    uint64* dstKey   = tempKey.getCArray();
+    int*    dstValue = tempValue.getCArray();
+
+    // Each pass counts the digits of every chunk, takes the prefix sum over
+    // (digit, chunk), and scatters each chunk to its own ranges
+    for (int shift = 0; shift < numBits; shift += RADIX_BITS) {
+        RadixCountBody countBody;
+        countBody.key   = srcKey;
+        countBody.n     = n;
+        countBody.shift = shift;
+        countBody.count = count.getCArray();
+        ThreadPool::common().parallelFor(0, chunks, 1, countBody);
+
+        // Turn the counts into starting offsets, ordered by digit and
+        // then by chunk so that the sort is stable.  A pass in which
+        // every key has the same digit would not move anything.
+        bool trivial = false;
+        int sum = 0;
+        for (int d = 0; d < RADIX; ++d) {
+            const int start = sum;
+            for (int c = 0; c < chunks; ++c) {
+                int& C = count[c * RADIX + d];
+                const int k = C;
+                C = sum;
+                sum += k;
+            }
+            trivial = trivial || (sum - start == n);
+        }
+
+        if (! trivial) {
+            RadixScatterBody scatterBody;
+            scatterBody.key      = srcKey;
+            scatterBody.value    = srcValue;
+            scatterBody.outKey   = dstKey;
+            scatterBody.outValue = dstValue;
+            scatterBody.n        = n;
+            scatterBody.shift    = shift;
+            scatterBody.offset   = count.getCArray();
+            ThreadPool::common().parallelFor(0, chunks, 1, scatterBody);
+
+            std::swap(srcKey, dstKey);
+            std::swap(srcValue, dstValue);
+        }
+    }
+
+    sortedKey   = srcKey;
+    sortedValue = srcValue;
+}
+
+
 MeshAlg::Face::Face() {
     for (int i = 0; i < 3; ++i) {
         edgeIndex[i]   = 0;
@@ -85,71 +207,6 @@ void MeshAlg::computeNormals(
         vertexNormalArray, faceNormalArray);
 }
 
-    
-void MeshAlg::computeNormals(
-    const Array<Vector3>&   vertexGeometry,
-    const Array<Face>&      faceArray,
-    const Array<Vertex>&    vertexArray,
-    Array<Vector3>&         vertexNormalArray,
-    Array<Vector3>&         faceNormalArray) {
-
-    // Face normals (not unit length)
-    faceNormalArray.resize(faceArray.size());
-    for (int f = 0; f < faceArray.size(); ++f) {
-        const Face& face = faceArray[f];
-
-        Vector3 vertex[3];
-        for (int j = 0; j < 3; ++j) {
-            vertex[j] = vertexGeometry[face.vertexIndex[j]];
-        }
-
-        faceNormalArray[f] = (vertex[1] - vertex[0]).cross(vertex[2] - vertex[0]);
-    }
-
-    // Per-vertex normals, computed by averaging
-    vertexNormalArray.resize(vertexGeometry.size());
-    for (int v = 0; v < vertexNormalArray.size(); ++v) {
-        Vector3 sum = Vector3::zero();
-        for (int k = 0; k < vertexArray[v].faceIndex.size(); ++k) {
-            const int f = vertexArray[v].faceIndex[k];
-            sum += faceNormalArray[f];
-        }
-        vertexNormalArray[v] = sum.directionOrZero();
-    }
-
-
-    for (int f = 0; f < faceArray.size(); ++f) {
-        faceNormalArray[f] = faceNormalArray[f].directionOrZero();
-    }
-
-}
-
-
-void MeshAlg::computeFaceNormals(
-    const Array<Vector3>&           vertexArray,
-    const Array<MeshAlg::Face>&     faceArray,
-    Array<Vector3>&                 faceNormals,
-    bool                            normalize) {
-
-    faceNormals.resize(faceArray.size());
-
-    for (int f = 0; f < faceArray.size(); ++f) {
-        const MeshAlg::Face& face = faceArray[f];
-
-        const Vector3& v0 = vertexArray[face.vertexIndex[0]];
-        const Vector3& v1 = vertexArray[face.vertexIndex[1]];
-        const Vector3& v2 = vertexArray[face.vertexIndex[2]];
-        
-        faceNormals[f] = (v1 - v0).cross(v2 - v0);
-    }
-
-    if (normalize) {
-        for (int f = 0; f < faceArray.size(); ++f) {
-            faceNormals[f] = faceNormals[f].direction();
-        }
-    }
-}
-
 
 void MeshAlg::identifyBackfaces(
     const Array<Vector3>&           vertexArray,
@@ -450,197 +507,5 @@ void MeshAlg::computeBounds(
 }
 
 
-void MeshAlg::computeTangentVectors(
-    const Vector3&  normal,
-    const Vector3   position[3],
-    const Vector2   texCoord[3],
-    Vector3&        tangent, 
-    Vector3&        binormal) {
-
-    Vector3 v[3];
-    Vector2 t[3];
-
-    // TODO: don't need the copy
-    // Make a copy so that we can sort
-    for (int i = 0; i < 3; ++i) {
-        v[i] = position[i];
-        t[i] = texCoord[i];
-    }
-
-    /////////////////////////////////////////////////
-    // Begin by computing the tangent
-
-    // Bubble sort the vertices by decreasing texture coordinate y.
-    if (t[0].y < t[1].y) {
-        std::swap(v[0], v[1]);
-        std::swap(t[0], t[1]);
-    }
-
-    // t0 >= t1
-
-    if (t[0].y < t[2].y) {
-        std::swap(v[0], v[2]);
-        std::swap(t[0], t[2]);
-    }
-
-    // t0 >= t2, t0 >= t1
-
-    if (t[1].y < t[2].y) {
-        std::swap(v[1], v[2]);
-        std::swap(t[1], t[2]);
-    }
-
-    // t0 >= t1 >= t2
-
-    float amount;
-
-    // Compute the direction of constant y.
-    if (fuzzyEq(t[2].y, t[0].y)) {
-        // Degenerate case-- the texture coordinates do not vary across this 
-        // triangle.
-        amount = 1.0;
-    } else {
-        // Solve lerp(t[0].y, t[2].y, amount) = t[1].y for amount:
-        //
-        // t0 + (t2 - t0) * a = t1
-        // a = (t1 - t0) / (t2 - t0)
-
-        amount = (t[1].y - t[0].y) / (t[2].y - t[0].y);
-    }
-
-    tangent = lerp(v[0], v[2], amount) - v[1];
-
-    // Make sure the tangent points in the right direction and is 
-    // perpendicular to the normal.
-    if (lerp(t[0].x, t[2].x, amount) < t[1].x) {
-        tangent = -tangent;
-    }
-
-    // TODO: do we need this?  We take this component off
-    // at the end anyway
-    tangent -= tangent.dot(normal) * normal;
-
-    // Normalize the tangent so it contributes
-    // equally at the vertex (TODO: do we need this?)
-    if (fuzzyEq(tangent.magnitude(), 0.0)) {
-        tangent = Vector3::unitX();
-    } else {
-        tangent = tangent.direction();
-    }
-
-    //////////////////////////////////////////////////
-    // Now compute the binormal (same code, but in x)
-
-    // Sort the vertices by texture coordinate x.
-    if (t[0].x < t[1].x) {
-        std::swap(v[0], v[1]);
-        std::swap(t[0], t[1]);
-    }
-
-    if (t[0].x < t[2].x) {
-        std::swap(v[0], v[2]);
-        std::swap(t[0], t[2]);
-    }
-
-    if (t[1].x < t[2].x) {
-        std::swap(v[1], v[2]);
-        std::swap(t[1], t[2]);
-    }
-
-    // Compute the direction of constant x.
-    if (fuzzyEq(t[2].x, t[0].x)) {
-        amount = 1.0;
-    } else {
-        amount = (t[1].x - t[0].x) / (t[2].x - t[0].x);
-    }
-
-    binormal = lerp(v[0], v[2], amount) - v[1];
-
-    // Make sure the binormal points in the right direction and is 
-    // perpendicular to the normal.
-    if (lerp(t[0].y, t[2].y, amount) < t[1].y) {
-        binormal = -binormal;
-    }
-
-    binormal -= binormal.dot(normal) * normal;
-
-    // Normalize the binormal so that it contributes
-    // an equal amount to the per-vertex value (TODO: do we need this? 
-    // Nelson Max showed that we don't for computing per-vertex normals)
-    if (fuzzyEq(binormal.magnitude(), 0.0)) {
-        binormal = Vector3::unitZ();
-    } else {
-        binormal = binormal.direction();
-    }
-
-    // This computation gives the opposite convention of what we want.
-    binormal = -binormal;
-
-}
-
-
-void MeshAlg::computeTangentSpaceBasis(
-    const Array<Vector3>&       vertexArray,
-    const Array<Vector2>&       texCoordArray,
-    const Array<Vector3>&       vertexNormalArray,
-    const Array<Face>&          faceArray,
-    Array<Vector3>&             tangent,
-    Array<Vector3>&             binormal) {
-
-    debugAssertM(faceArray.size() != 0, "Unable to calculate valid tangent space without faces.");
-
-    // The three vertices and texCoords of each face
-    Vector3 position[3];
-    Vector2 texCoord[3];
-    Vector3 t, b;
-
-    tangent.resize(vertexArray.size());
-    binormal.resize(vertexArray.size());
-
-    // Zero the output arrays.
-    System::memset(tangent.getCArray(), 0, sizeof(Vector3) * tangent.size());
-    System::memset(binormal.getCArray(), 0, sizeof(Vector3) * binormal.size());
-
-    // Iterate over faces, computing the tangent vectors for each 
-    // vertex.  Accumulate those into the tangent and binormal arrays
-    // and then orthonormalize at the end.
-
-    for (int f = 0; f < faceArray.size(); ++f) {
-        const Face& face = faceArray[f];
-
-        for (int v = 0; v < 3; ++v) {
-            int i = face.vertexIndex[v];
-            position[v] = vertexArray[i];
-            texCoord[v] = texCoordArray[i];
-        }
-
-        const Vector3 faceNormal((position[1] - position[0]).cross(position[2] - position[0]).direction());
-        computeTangentVectors(faceNormal, position, texCoord, t, b);
-
-        for (int v = 0; v < 3; ++v) {
-            int i = face.vertexIndex[v];
-            tangent[i]  += t;
-            binormal[i] += b;
-        }
-    }
-
-    // Normalize the basis vectors
-    for (int v = 0; v < vertexArray.size(); ++v) {
-        // Remove the component parallel to the normal
-        const Vector3& N = vertexNormalArray[v];
-        debugAssertM(N.isUnit() || N.isZero(), "Input normals must have unit length");
-
-        tangent[v]  -= tangent[v].dot(N) * N;
-        binormal[v] -= binormal[v].dot(N) * N;
-
-        // Normalize
-        tangent[v]  = tangent[v].directionOrZero();
-        binormal[v] = binormal[v].directionOrZero();
-
-        // Note that the tangent and binormal might not be perpendicular anymore
-    }
-}
-
-
 
 } // G3D namespace
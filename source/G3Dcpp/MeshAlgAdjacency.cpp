@@ -10,144 +10,294 @@
 
  */
 
+#include "G3D/Table.h"
+#include "G3D/MeshAlg.h"
+#include "G3D/Set.h"
+#include "G3D/SmallArray.h"
+#include "G3D/ThreadPool.h"
+
 namespace G3D {
 
 /**
- A half [i.e. directed] edge.
+ computeAdjacency works on arrays split into chunks of this many
+ elements, one chunk per parallelFor index.
  */
-class MeshDirectedEdgeKey {
-public:
+static const int ADJACENCY_CHUNK = 16384;
 
-    /** vertexIndex[0] <= vertexIndex[1] */
-    int     vertexIndex[2];
+static inline int numChunks(int n) {
+    return (n + ADJACENCY_CHUNK - 1) / ADJACENCY_CHUNK;
+}
 
-    MeshDirectedEdgeKey() {}
-    
-    MeshDirectedEdgeKey(
-        const int        i0,
-        const int        i1) {
+/** Number of bits needed to store the integers [0, n) */
+static int bitsFor(int n) {
+    int b = 0;
+    while ((b < 31) && ((1 << b) < n)) {
+        ++b;
+    }
+    return b;
+}
 
-        if (i0 <= i1) {
-            vertexIndex[0] = i0;
-            vertexIndex[1] = i1;
-        } else {
-            vertexIndex[0] = i1;
-            vertexIndex[1] = i0;
-        }
+/**
+ First index at or after i that begins a run of equal keys.  Chunks of a
+ sorted array start at these indices so that each run is processed by
+ exactly one chunk.
+ */
+static inline int runStart(const uint64* key, int n, int i) {
+    while ((i > 0) && (i < n) && (key[i] == key[i - 1])) {
+        ++i;
     }
+    return i;
+}
 
 
-    bool operator==(const MeshDirectedEdgeKey& e2) const {
-        for (int i = 0; i < 2; ++i) {
-            if (vertexIndex[i] != e2.vertexIndex[i]) {
-                return false;
+/** The next vertex of a face, by position within the face */
+static const int nextIndex[] = {1, 2, 0};
+
+
+/** Builds the faces, face normals, and half-edge keys */
+class MeshFaceBody {
+public:
+    const Vector3*      vertexGeometry;
+    const int*          index;
+    int                 vertexBits;
+    MeshAlg::Face*      face;
+    Vector3*            faceNormal;
+
+    /** The two vertices of each half-edge, lower index in the high bits */
+    uint64*             key;
+    int*                halfEdge;
+
+    void operator()(int begin, int end) const {
+        for (int f = begin; f < end; ++f) {
+            MeshAlg::Face& F = face[f];
+            const int* v = index + f * 3;
+            for (int j = 0; j < 3; ++j) {
+                F.vertexIndex[j] = v[j];
+                F.edgeIndex[j]   = MeshAlg::Face::NONE;
+
+                const int i0 = v[j];
+                const int i1 = v[nextIndex[j]];
+                key[f * 3 + j] = ((uint64)iMin(i0, i1) << vertexBits) | (uint64)iMax(i0, i1);
+                halfEdge[f * 3 + j] = f * 3 + j;
             }
+
+            const Vector3 N = (vertexGeometry[v[1]] - vertexGeometry[v[0]]).cross(vertexGeometry[v[2]] - vertexGeometry[v[0]]);
+            faceNormal[f] = N.directionOrZero();
         }
-        return true;
     }
 };
 
-}
-
-unsigned int hashCode(const G3D::MeshDirectedEdgeKey& e) {
-    return e.vertexIndex[0] + (e.vertexIndex[1] << 16);
-}
-
-#include "G3D/Table.h"
-#include "G3D/MeshAlg.h"
-#include "G3D/Set.h"
-
-namespace G3D {
 
 /**
- A hashtable mapping edges to lists of indices for
- faces.  This is used instead of Table because of the
- special logic in insert.
+ An undirected edge before it has been placed in the edge array.  forward
+ is the half-edge that runs from vertexIndex[0] to vertexIndex[1], and
+ backward the one that runs the other way; either may be -1.
+ */
+class MeshEdgeRecord {
+public:
+    int                 vertexIndex[2];
+    int                 forward;
+    int                 backward;
+};
 
- Used only for MeshAlg::computeAdjacency.
 
- In the face lists, index <I>f</I> >= 0 indicates that
- <I>f</I> contains the edge as a forward edge.  Index <I>f</I> < 0 
- indicates that ~<I>f</I> contains the edge as a backward edge.
+/**
+ Pairs up the opposite half-edges within each run of equal keys.  Each
+ chunk collects its interior and boundary edges separately so that the
+ boundary edges can be placed at the end of the edge array.
  */
-class MeshEdgeTable {
+class MeshPairBody {
 public:
-    typedef Table<MeshDirectedEdgeKey, Array<int> > ET;
+    const uint64*       key;
+    const int*          halfEdge;
+    int                 n;
+    const int*          index;
+    const Vector3*      faceNormal;
+    Array<MeshEdgeRecord>* interior;
+    Array<MeshEdgeRecord>* boundary;
+
+    /** True if half-edge h runs from the lower vertex index to the higher */
+    inline bool isForward(int h) const {
+        const int f = h / 3;
+        return index[h] <= index[f * 3 + nextIndex[h - f * 3]];
+    }
 
-private:
-    
-    ET                   table;
+    void operator()(int begin, int end) const {
+        SmallArray<int, 4> list;
+
+        for (int c = begin; c < end; ++c) {
+            Array<MeshEdgeRecord>& in = interior[c];
+            Array<MeshEdgeRecord>& bd = boundary[c];
+            in.fastClear();
+            bd.fastClear();
+
+            const int last = runStart(key, n, iMin((c + 1) * ADJACENCY_CHUNK, n));
+            int i = runStart(key, n, c * ADJACENCY_CHUNK);
+            while (i < last) {
+                // Gather the run of half-edges between the same two vertices,
+                // in the order of the faces
+                list.fastClear();
+                const int i0 = i;
+                do {
+                    list.append(halfEdge[i]);
+                    ++i;
+                } while ((i < n) && (key[i] == key[i0]));
+
+                const int h = list[0];
+                const int a = index[h];
+                const int b = index[(h / 3) * 3 + nextIndex[h % 3]];
+
+                while (list.size() > 0) {
+                    const int h0 = list.pop();
+                    const bool forward0 = isForward(h0);
+                    const Vector3& n0 = faceNormal[h0 / 3];
+
+                    // We try to find the matching face with the closest
+                    // normal.  This ensures that we don't introduce a lot
+                    // of artificial ridges into flat parts of a mesh.
+                    double ndotn = -2;
+                    int i1 = -1;
+                    for (int k = list.size() - 1; k >= 0; --k) {
+                        if (isForward(list[k]) != forward0) {
+                            const double d = faceNormal[list[k] / 3].dot(n0);
+                            if ((i1 == -1) || (d > ndotn)) {
+                                ndotn = d;
+                                i1    = k;
+                            }
+                        }
+                    }
 
-public:
-    
-    /**
-     Clears the table.
-     */
-    void clear() {
-        table.clear();
-    }
-    
-    /**
-     Inserts the faceIndex into the edge's face list.
-     The index may be a negative number indicating a backface.
-     */
-    void insert(const MeshDirectedEdgeKey& edge, int faceIndex) {
-        
-        // debugAssertM((table.size() > 20) && (table.debugGetLoad() < 0.5 || table.debugGetNumBuckets() < 20),
-        //    "MeshEdgeTable is using a poor hash function.");
-
-        if (! table.containsKey(edge)) {
-            // First time
-            Array<int> x(1);
-            x[0] = faceIndex;
-            table.set(edge, x);
-        } else {
-            table[edge].append(faceIndex);
+                    MeshEdgeRecord r;
+                    r.vertexIndex[0] = iMin(a, b);
+                    r.vertexIndex[1] = iMax(a, b);
+                    r.forward  = forward0 ? h0 : -1;
+                    r.backward = forward0 ? -1 : h0;
+
+                    if (i1 == -1) {
+                        bd.append(r);
+                    } else {
+                        const int h1 = list[i1];
+                        list.fastRemove(i1);
+                        if (forward0) {
+                            r.backward = h1;
+                        } else {
+                            r.forward = h1;
+                        }
+                        in.append(r);
+                    }
+                }
+            }
         }
     }
+};
 
-    /**
-     Returns the face list for a given edge
-     */
-    const Array<int>& get(const MeshDirectedEdgeKey& edge) {
-        return table[edge];
-    }
 
-    ET::Iterator begin() {
-        return table.begin();
-    }
+/** Copies each chunk's edges to the edge array and points the faces at them */
+class MeshEdgeBody {
+public:
+    const Array<MeshEdgeRecord>* interior;
+    const Array<MeshEdgeRecord>* boundary;
+    const int*          interiorOffset;
+    const int*          boundaryOffset;
+    MeshAlg::Edge*      edge;
+    MeshAlg::Face*      face;
+
+    void copy(const Array<MeshEdgeRecord>& record, int offset) const {
+        for (int k = 0; k < record.size(); ++k) {
+            const MeshEdgeRecord& r = record[k];
+            const int e = offset + k;
+            MeshAlg::Edge& E = edge[e];
+            E.vertexIndex[0] = r.vertexIndex[0];
+            E.vertexIndex[1] = r.vertexIndex[1];
+
+            // Slot j of a face holds the edge from its vertex j to vertex j + 1
+            if (r.forward >= 0) {
+                E.faceIndex[0] = r.forward / 3;
+                face[r.forward / 3].edgeIndex[r.forward % 3] = e;
+            } else {
+                E.faceIndex[0] = MeshAlg::Face::NONE;
+            }
 
-    const ET::Iterator end() const {
-        return table.end();
+            if (r.backward >= 0) {
+                E.faceIndex[1] = r.backward / 3;
+                face[r.backward / 3].edgeIndex[r.backward % 3] = ~e;
+            } else {
+                E.faceIndex[1] = MeshAlg::Face::NONE;
+            }
+        }
     }
 
+    void operator()(int begin, int end) const {
+        for (int c = begin; c < end; ++c) {
+            copy(interior[c], interiorOffset[c]);
+            copy(boundary[c], boundaryOffset[c]);
+        }
+    }
 };
 
 
 /**
- edgeTable[edgeKey] is a list of faces containing
- 
- Used and cleared by MeshModel::computeAdjacency()
+ Groups values by vertex, keeping their order: afterwards the values for
+ vertex v are list[start[v]] through list[start[v + 1] - 1].
  */
-static MeshEdgeTable            edgeTable;
+static void bucketByVertex(
+    const int*          vertex,
+    const int*          value,
+    int                 n,
+    int                 numVertices,
+    Array<int>&         start,
+    Array<int>&         list) {
+
+    start.resize(numVertices + 1, DONT_SHRINK_UNDERLYING_ARRAY);
+    list.resize(n, DONT_SHRINK_UNDERLYING_ARRAY);
+    int* S = start.getCArray();
+
+    for (int v = 0; v <= numVertices; ++v) {
+        S[v] = 0;
+    }
+    for (int i = 0; i < n; ++i) {
+        ++S[vertex[i] + 1];
+    }
+    for (int v = 0; v < numVertices; ++v) {
+        S[v + 1] += S[v];
+    }
 
-/**
- Assigns the edge index into the next unassigned edge
- index.  The edge index may be negative, indicating
- a reverse edge.
- */
-static void assignEdgeIndex(MeshAlg::Face& face, int e) {
-    for (int i = 0; i < 3; ++i) {
-        if (face.edgeIndex[i] == MeshAlg::Face::NONE) {
-            face.edgeIndex[i] = e;
-            return;
-        }
+    // Advances S[v] to the start of v + 1...
+    for (int i = 0; i < n; ++i) {
+        list[S[vertex[i]]++] = value[i];
     }
 
-    debugAssertM(false, "Face has already been assigned 3 edges");
+    // ...so shift it back
+    for (int v = numVertices; v > 0; --v) {
+        S[v] = S[v - 1];
+    }
+    S[0] = 0;
 }
 
 
+/** Appends each vertex's values from bucketByVertex to its face or edge list */
+class MeshVertexBody {
+public:
+    const int*          start;
+    const int*          list;
+    MeshAlg::Vertex*    vertex;
+    bool                faces;
+
+    void operator()(int begin, int end) const {
+        for (int v = begin; v < end; ++v) {
+            MeshAlg::Vertex& V = vertex[v];
+            for (int i = start[v]; i < start[v + 1]; ++i) {
+                if (faces) {
+                    V.faceIndex.append(list[i]);
+                } else {
+                    V.edgeIndex.append(list[i]);
+                }
+            }
+        }
+    }
+};
+
+
 void MeshAlg::computeAdjacency(
     const Array<Vector3>&   vertexGeometry,
     const Array<int>&       indexArray,
@@ -163,7 +313,7 @@ void MeshAlg::computeAdjacency(
     adjacentFaceArray.clear();
     adjacentFaceArray.resize(vertexArray.size());
     for (int v = 0; v < adjacentFaceArray.size(); ++v) {
-        adjacentFaceArray[v] = vertexArray[v].faceIndex;
+        vertexArray[v].faceIndex.getArray(adjacentFaceArray[v]);
     }
 }
 
@@ -174,233 +324,127 @@ void MeshAlg::computeAdjacency(
     Array<Face>&            faceArray,
     Array<Edge>&            edgeArray,
     Array<Vertex>&          vertexArray) {
-    
+
+    // Instead of a hash table of edges, the half-edges are sorted by their
+    // two vertex indices so that the half-edges to pair up are adjacent.
+    // The sort and the passes over faces, edges, and vertices run in
+    // parallel, and there is no shared state, so adjacency may be computed
+    // on several threads at once.
+
+    const int numFaces = indexArray.size() / 3;
+    const int numHalfEdges = numFaces * 3;
+    const int vertexBits = bitsFor(vertexGeometry.size());
+
     edgeArray.clear();
     vertexArray.clear();
     faceArray.clear();
-    edgeTable.clear();
-    
-    // Face normals
-    Array<Vector3> faceNormal;
 
-    // This array has the same size as the vertex array
+    faceArray.resize(numFaces);
     vertexArray.resize(vertexGeometry.size());
 
-    // Iterate through the triangle list
-    for (int q = 0; q < indexArray.size(); q += 3) {
-
-        Vector3 vertex[3];
-        int f = faceArray.size();
-        MeshAlg::Face& face = faceArray.next();
-
-        // Construct the face
-        for (int j = 0; j < 3; ++j) {
-            int v = indexArray[q + j];
-            face.vertexIndex[j] = v;
-            face.edgeIndex[j]   = Face::NONE;
-
-            // Store back pointers in the vertices
-            vertexArray[v].faceIndex.append(f);
-
-            // We'll need these vertices to find the face normal
-            vertex[j]           = vertexGeometry[v];
-        }
-
-        // Compute the face normal
-        Vector3 N = (vertex[1] - vertex[0]).cross(vertex[2] - vertex[0]);
-        faceNormal.append(N.directionOrZero());
-
-        static const int nextIndex[] = {1, 2, 0};
-
-        // Add each edge to the edge table.
-        for (int j = 0; j < 3; ++j) {
-            const int      i0 = indexArray[q + j];
-            const int      i1 = indexArray[q + nextIndex[j]];
+    Array<Vector3> faceNormal;
+    faceNormal.resize(numFaces);
 
-            const MeshDirectedEdgeKey edge(i0, i1);
+    Array<uint64> key;
+    Array<int>    value;
+    key.resize(numHalfEdges);
+    value.resize(numHalfEdges);
 
-            if (i0 == edge.vertexIndex[0]) {
-                // The edge was directed in the same manner as in the face
-                edgeTable.insert(edge, f);
-            } else {
-                // The edge was directed in the opposite manner as in the face
-                edgeTable.insert(edge, ~f);
-            }
-        }
+    {
+        MeshFaceBody body;
+        body.vertexGeometry = vertexGeometry.getCArray();
+        body.index          = indexArray.getCArray();
+        body.vertexBits     = vertexBits;
+        body.face           = faceArray.getCArray();
+        body.faceNormal     = faceNormal.getCArray();
+        body.key            = key.getCArray();
+        body.halfEdge       = value.getCArray();
+        ThreadPool::common().parallelFor(0, numFaces, ADJACENCY_CHUNK / 3, body);
     }
-    
-    // For each edge in the edge table, create an edge in the edge array.
-    // Collapse every 2 edges from adjacent faces.
-
-    MeshEdgeTable::ET::Iterator cur = edgeTable.begin();
-    MeshEdgeTable::ET::Iterator end = edgeTable.end();
-
-    Array<Edge> tempEdgeArray;
-    while (cur != end) {
-        MeshDirectedEdgeKey&  edgeKey        = cur->key; 
-        Array<int>&           faceIndexArray = cur->value;
-
-        // Process this edge
-        while (faceIndexArray.size() > 0) {
-
-            // Remove the last index
-            int f0 = faceIndexArray.pop();
-
-            // Find the normal to that face
-            const Vector3& n0 = faceNormal[(f0 >= 0) ? f0 : ~f0];
-
-            bool found = false;
-
-            // We try to find the matching face with the closest
-            // normal.  This ensures that we don't introduce a lot
-            // of artificial ridges into flat parts of a mesh.
-            double ndotn = -2;
-            int f1 = -1, i1 = -1;
-            
-            // Try to Find the face with the matching edge
-            for (int i = faceIndexArray.size() - 1; i >= 0; --i) {
-                int f = faceIndexArray[i];
-
-                if ((f >= 0) != (f0 >= 0)) {
-                    // This face contains the oppositely oriented edge
-                    // and has not been assigned too many edges
-
-                    const Vector3& n1 = faceNormal[(f >= 0) ? f : ~f];
-                    double d = n1.dot(n0);
-
-                    if (found) {
-                        // We previously found a good face; see if this
-                        // one is better.
-                        if (d > ndotn) {
-                            // This face is better.
-                            ndotn = d;
-                            f1    = f;
-                            i1    = i;
-                        }
-                    } else {
-                        // This is the first face we've found
-                        found = true;
-                        ndotn = d;
-                        f1    = f;
-                        i1    = i;
-                    }
-                }
-            }
-
-            // Create the new edge
-            int e = tempEdgeArray.size();
-            Edge& edge = tempEdgeArray.next();
-            
-            edge.vertexIndex[0] = edgeKey.vertexIndex[0];
-            edge.vertexIndex[1] = edgeKey.vertexIndex[1];
-
-            if (f0 >= 0) {
-                edge.faceIndex[0] = f0;
-                edge.faceIndex[1] = Face::NONE;
-                assignEdgeIndex(faceArray[f0], e); 
-            } else {
-                // The face indices above are two's complemented.
-                // this code restores them to regular indices.
-                debugAssert((~f0) >= 0);
-                edge.faceIndex[1] = ~f0;
-                edge.faceIndex[0] = Face::NONE;
-
-                // The edge index *does* need to be inverted, however.
-                assignEdgeIndex(faceArray[~f0], ~e); 
-            }
-
-            if (found) {
-                // We found a matching face; remove both
-                // faces from the active list.
-                faceIndexArray.fastRemove(i1);
-
-                if (f1 >= 0) {
-                    edge.faceIndex[0] = f1;
-                    assignEdgeIndex(faceArray[f1], e); 
-                } else {
-                    edge.faceIndex[1] = ~f1;
-                    assignEdgeIndex(faceArray[~f1], ~e); 
-                }
-            }
-        }
 
-        ++cur;
+    RadixSort radix;
+    const uint64* sortedKey;
+    const int*    sortedValue;
+    radix.sort(key, value, vertexBits * 2, sortedKey, sortedValue);
+
+    // Pair the half-edges
+    const int chunks = numChunks(numHalfEdges);
+    Array< Array<MeshEdgeRecord> > interior;
+    Array< Array<MeshEdgeRecord> > boundary;
+    interior.resize(chunks);
+    boundary.resize(chunks);
+    {
+        MeshPairBody body;
+        body.key        = sortedKey;
+        body.halfEdge   = sortedValue;
+        body.n          = numHalfEdges;
+        body.index      = indexArray.getCArray();
+        body.faceNormal = faceNormal.getCArray();
+        body.interior   = interior.getCArray();
+        body.boundary   = boundary.getCArray();
+        ThreadPool::common().parallelFor(0, chunks, 1, body);
     }
 
-    edgeTable.clear();
+    // Interior edges first, then boundary edges, each in chunk order
+    Array<int> interiorOffset, boundaryOffset;
+    interiorOffset.resize(chunks);
+    boundaryOffset.resize(chunks);
+    int numEdges = 0;
+    for (int c = 0; c < chunks; ++c) {
+        interiorOffset[c] = numEdges;
+        numEdges += interior[c].size();
+    }
+    for (int c = 0; c < chunks; ++c) {
+        boundaryOffset[c] = numEdges;
+        numEdges += boundary[c].size();
+    }
 
-    // Move boundary edges to the end of the list and then
-    // clean up the face references into them
+    edgeArray.resize(numEdges);
     {
-        // Map old edge indices to new edge indices
-        Array<int> newIndex(tempEdgeArray.size());
-
-
-        // Index of the start and end of the edge array
-        int i = 0;
-        int j = tempEdgeArray.size() - 1;
-
-        edgeArray.resize(tempEdgeArray.size());
-        for (int e = 0; e < tempEdgeArray.size(); ++e) {
-            if (tempEdgeArray[e].boundary()) {
-                newIndex[e] = j;
-                --j;
-            } else {
-                newIndex[e] = i;
-                ++i;
-            }
-            edgeArray[newIndex[e]] = tempEdgeArray[e];
-        }
-
-        debugAssertM(i == j + 1, "Counting from front and back of array did not match");
-
-        // Fix the faces
-        for (int f = 0; f < faceArray.size(); ++f) {
-            Face& face = faceArray[f];
-            for (int q = 0; q < 3; ++q) {
-                int e = face.edgeIndex[q];
-                if (e < 0) {
-                    // Backwards edge; twiddle before and after conversion
-                    face.edgeIndex[q] = ~newIndex[~e];
-                } else {
-                    // Regular edge; remap the index
-                    face.edgeIndex[q] = newIndex[e];
-                }
-            }
-        }
+        MeshEdgeBody body;
+        body.interior       = interior.getCArray();
+        body.boundary       = boundary.getCArray();
+        body.interiorOffset = interiorOffset.getCArray();
+        body.boundaryOffset = boundaryOffset.getCArray();
+        body.edge           = edgeArray.getCArray();
+        body.face           = faceArray.getCArray();
+        ThreadPool::common().parallelFor(0, chunks, 1, body);
     }
 
-    // Now order the edge indices inside the faces correctly.
-    for (int f = 0; f < faceArray.size(); ++f) {
-        Face& face = faceArray[f];
-        int e0 = face.edgeIndex[0];
-        int e1 = face.edgeIndex[1];
-        int e2 = face.edgeIndex[2];
-
-        // e0 will always remain first.  The only 
-        // question is whether e1 and e2 should be swapped.
-    
-        // See if e1 begins at the vertex where e1 ends.
-        const int e0End = (e0 < 0) ? 
-            edgeArray[~e0].vertexIndex[0] :
-            edgeArray[e0].vertexIndex[1];
-
-        const int e1Begin = (e1 < 0) ? 
-            edgeArray[~e1].vertexIndex[1] :
-            edgeArray[e1].vertexIndex[0];
-
-        if (e0End != e1Begin) {
-            // We must swap e1 and e2
-            face.edgeIndex[1] = e2;
-            face.edgeIndex[2] = e1;
-        }
+    // Faces of each vertex, in face order
+    const int numVertices = vertexGeometry.size();
+    Array<int> start, list;
+    for (int i = 0; i < numHalfEdges; ++i) {
+        value[i] = i / 3;
+    }
+    bucketByVertex(indexArray.getCArray(), value.getCArray(), numHalfEdges, numVertices, start, list);
+    {
+        MeshVertexBody body;
+        body.start  = start.getCArray();
+        body.list   = list.getCArray();
+        body.vertex = vertexArray.getCArray();
+        body.faces  = true;
+        ThreadPool::common().parallelFor(0, numVertices, ADJACENCY_CHUNK / 8, body);
     }
 
-    // Fill out the edge adjacency information in the vertex array
-    for (int e = 0; e < edgeArray.size(); ++e) {
-        const Edge& edge = edgeArray[e];
-        vertexArray[edge.vertexIndex[0]].edgeIndex.append(e);
-        vertexArray[edge.vertexIndex[1]].edgeIndex.append(~e);
+    // Edges of each vertex, in edge order: e at its first vertex and ~e at its second
+    Array<int> endpoint;
+    endpoint.resize(numEdges * 2);
+    value.resize(numEdges * 2);
+    for (int e = 0; e < numEdges; ++e) {
+        endpoint[e * 2]     = edgeArray[e].vertexIndex[0];
+        value[e * 2]        = e;
+        endpoint[e * 2 + 1] = edgeArray[e].vertexIndex[1];
+        value[e * 2 + 1]    = ~e;
+    }
+    bucketByVertex(endpoint.getCArray(), value.getCArray(), numEdges * 2, numVertices, start, list);
+    {
+        MeshVertexBody body;
+        body.start  = start.getCArray();
+        body.list   = list.getCArray();
+        body.vertex = vertexArray.getCArray();
+        body.faces  = false;
+        ThreadPool::common().parallelFor(0, numVertices, ADJACENCY_CHUNK / 8, body);
     }
 }
 
@@ -0,0 +1,543 @@
+/**
+  @file MeshAlgNormals.cpp
+
+  The MeshAlg::computeNormals, MeshAlg::computeFaceNormals, and
+  MeshAlg::computeTangentSpaceBasis methods.  Each stage runs in parallel
+  on ThreadPool::common(), with four-wide SSE kernels for the cross
+  products and the normalization.  Every vertex gathers its own sums from
+  the faces around it, so no two threads write the same element and the
+  sums are added in the same order as the scalar loops.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#include "G3D/MeshAlg.h"
+#include "G3D/ThreadPool.h"
+#include "G3D/vectorMath.h"
+#include <algorithm>
+
+#ifdef SSE
+    #include <xmmintrin.h>
+#endif
+
+namespace G3D {
+
+/** Faces or vertices per parallelFor subrange */
+static const int NORMAL_GRAIN = 4096;
+
+/** How a kernel leaves the vectors that it writes */
+enum Normalization {
+    /** As computed */
+    NORMALIZE_NONE,
+
+    /** Vector3::direction; zero vectors become NaN */
+    NORMALIZE_DIRECTION,
+
+    /** Vector3::directionOrZero, to within fuzzyEpsilon */
+    NORMALIZE_OR_ZERO};
+
+#ifdef SSE
+
+/** Loads four consecutive Vector3s as x, y, and z lanes */
+static inline void loadVector3x4(const Vector3* v, __m128& x, __m128& y, __m128& z) {
+    const float* f = reinterpret_cast<const float*>(v);
+    // (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3)
+    const __m128 a = _mm_loadu_ps(f);
+    const __m128 b = _mm_loadu_ps(f + 4);
+    const __m128 c = _mm_loadu_ps(f + 8);
+
+    x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+    y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+
+/** Inverse of loadVector3x4 */
+static inline void storeVector3x4(Vector3* v, __m128 x, __m128 y, __m128 z) {
+    float* f = reinterpret_cast<float*>(v);
+    const __m128 lo = _mm_unpacklo_ps(x, y);    // x0 y0 x1 y1
+    const __m128 hi = _mm_unpackhi_ps(x, y);    // x2 y2 x3 y3
+
+    _mm_storeu_ps(f,     _mm_shuffle_ps(lo, _mm_shuffle_ps(z, lo, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+    _mm_storeu_ps(f + 4, _mm_shuffle_ps(_mm_shuffle_ps(lo, z, _MM_SHUFFLE(1, 1, 3, 3)), hi, _MM_SHUFFLE(1, 0, 2, 0)));
+    _mm_storeu_ps(f + 8, _mm_shuffle_ps(_mm_shuffle_ps(z, hi, _MM_SHUFFLE(2, 2, 2, 2)), _mm_shuffle_ps(hi, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+
+/** Gathers corner j of faces f through f + 3 */
+static inline void loadCorner(const Vector3* vertex, const MeshAlg::Face* face, int j, __m128& x, __m128& y, __m128& z) {
+    const Vector3& a = vertex[face[0].vertexIndex[j]];
+    const Vector3& b = vertex[face[1].vertexIndex[j]];
+    const Vector3& c = vertex[face[2].vertexIndex[j]];
+    const Vector3& d = vertex[face[3].vertexIndex[j]];
+    x = _mm_set_ps(d.x, c.x, b.x, a.x);
+    y = _mm_set_ps(d.y, c.y, b.y, a.y);
+    z = _mm_set_ps(d.z, c.z, b.z, a.z);
+}
+
+
+/** Scales four vectors as Vector3::direction or Vector3::directionOrZero would */
+static inline void normalize4(__m128& x, __m128& y, __m128& z, Normalization normalization) {
+    const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+    __m128 s = _mm_div_ps(_mm_set1_ps(1.0f), length);
+    if (normalization == NORMALIZE_OR_ZERO) {
+        s = _mm_and_ps(s, _mm_cmpgt_ps(length, _mm_set1_ps((float)fuzzyEpsilon)));
+    }
+    x = _mm_mul_ps(x, s);
+    y = _mm_mul_ps(y, s);
+    z = _mm_mul_ps(z, s);
+}
+
+#endif
+
+
+static inline Vector3 normalize(const Vector3& v, Normalization normalization) {
+    switch (normalization) {
+    case NORMALIZE_DIRECTION:
+        return v.direction();
+
+    case NORMALIZE_OR_ZERO:
+        return v.directionOrZero();
+
+    default:
+        return v;
+    }
+}
+
+
+/** Normalizes v[begin] through v[end - 1] in place */
+static void normalizeRange(Vector3* v, int begin, int end, Normalization normalization) {
+    if (normalization == NORMALIZE_NONE) {
+        return;
+    }
+
+    int i = begin;
+#   ifdef SSE
+        for (; i + 4 <= end; i += 4) {
+            __m128 x, y, z;
+            loadVector3x4(v + i, x, y, z);
+            normalize4(x, y, z, normalization);
+            storeVector3x4(v + i, x, y, z);
+        }
+#   endif
+    for (; i < end; ++i) {
+        v[i] = normalize(v[i], normalization);
+    }
+}
+
+
+/** Computes the face normals (v1 - v0) x (v2 - v0) of a range of faces */
+class FaceNormalBody {
+public:
+    const Vector3*          vertex;
+    const MeshAlg::Face*    face;
+    Vector3*                faceNormal;
+    Normalization           normalization;
+
+    void operator()(int begin, int end) const {
+        int f = begin;
+#       ifdef SSE
+            for (; f + 4 <= end; f += 4) {
+                __m128 x0, y0, z0, x1, y1, z1, x2, y2, z2;
+                loadCorner(vertex, face + f, 0, x0, y0, z0);
+                loadCorner(vertex, face + f, 1, x1, y1, z1);
+                loadCorner(vertex, face + f, 2, x2, y2, z2);
+
+                x1 = _mm_sub_ps(x1, x0);  y1 = _mm_sub_ps(y1, y0);  z1 = _mm_sub_ps(z1, z0);
+                x2 = _mm_sub_ps(x2, x0);  y2 = _mm_sub_ps(y2, y0);  z2 = _mm_sub_ps(z2, z0);
+
+                __m128 nx = _mm_sub_ps(_mm_mul_ps(y1, z2), _mm_mul_ps(z1, y2));
+                __m128 ny = _mm_sub_ps(_mm_mul_ps(z1, x2), _mm_mul_ps(x1, z2));
+                __m128 nz = _mm_sub_ps(_mm_mul_ps(x1, y2), _mm_mul_ps(y1, x2));
+                if (normalization != NORMALIZE_NONE) {
+                    normalize4(nx, ny, nz, normalization);
+                }
+                storeVector3x4(faceNormal + f, nx, ny, nz);
+            }
+#       endif
+        for (; f < end; ++f) {
+            const int* i = face[f].vertexIndex;
+            const Vector3& v0 = vertex[i[0]];
+            faceNormal[f] = normalize((vertex[i[1]] - v0).cross(vertex[i[2]] - v0), normalization);
+        }
+    }
+};
+
+
+/** Sums the face normals around each vertex of a range and normalizes them */
+class VertexNormalBody {
+public:
+    const MeshAlg::Vertex*  adjacency;
+    const Vector3*          faceNormal;
+    Vector3*                vertexNormal;
+
+    void operator()(int begin, int end) const {
+        for (int v = begin; v < end; ++v) {
+            const SmallArray<int, 8>& faceIndex = adjacency[v].faceIndex;
+            Vector3 sum = Vector3::zero();
+            for (int k = 0; k < faceIndex.size(); ++k) {
+                sum += faceNormal[faceIndex[k]];
+            }
+            vertexNormal[v] = sum;
+        }
+        normalizeRange(vertexNormal, begin, end, NORMALIZE_OR_ZERO);
+    }
+};
+
+
+/** Normalizes a range of vectors */
+class NormalizeBody {
+public:
+    Vector3*                v;
+    Normalization           normalization;
+
+    void operator()(int begin, int end) const {
+        normalizeRange(v, begin, end, normalization);
+    }
+};
+
+
+/**
+ Computes the tangent space basis vectors for
+ a counter-clockwise oriented face.
+
+ @cite Max McGuire
+ */
+static void computeTangentVectors(
+    const Vector3&  normal,
+    const Vector3   position[3],
+    const Vector2   texCoord[3],
+    Vector3&        tangent, 
+    Vector3&        binormal) {
+
+    Vector3 v[3];
+    Vector2 t[3];
+
+    // TODO: don't need the copy
+    // Make a copy so that we can sort
+    for (int i = 0; i < 3; ++i) {
+        v[i] = position[i];
+        t[i] = texCoord[i];
+    }
+
+    /////////////////////////////////////////////////
+    // Begin by computing the tangent
+
+    // Bubble sort the vertices by decreasing texture coordinate y.
+    if (t[0].y < t[1].y) {
+        std::swap(v[0], v[1]);
+        std::swap(t[0], t[1]);
+    }
+
+    // t0 >= t1
+
+    if (t[0].y < t[2].y) {
+        std::swap(v[0], v[2]);
+        std::swap(t[0], t[2]);
+    }
+
+    // t0 >= t2, t0 >= t1
+
+    if (t[1].y < t[2].y) {
+        std::swap(v[1], v[2]);
+        std::swap(t[1], t[2]);
+    }
+
+    // t0 >= t1 >= t2
+
+    float amount;
+
+    // Compute the direction of constant y.
+    if (fuzzyEq(t[2].y, t[0].y)) {
+        // Degenerate case-- the texture coordinates do not vary across this 
+        // triangle.
+        amount = 1.0;
+    } else {
+        // Solve lerp(t[0].y, t[2].y, amount) = t[1].y for amount:
+        //
+        // t0 + (t2 - t0) * a = t1
+        // a = (t1 - t0) / (t2 - t0)
+
+        amount = (t[1].y - t[0].y) / (t[2].y - t[0].y);
+    }
+
+    tangent = lerp(v[0], v[2], amount) - v[1];
+
+    // Make sure the tangent points in the right direction and is 
+    // perpendicular to the normal.
+    if (lerp(t[0].x, t[2].x, amount) < t[1].x) {
+        tangent = -tangent;
+    }
+
+    // TODO: do we need this?  We take this component off
+    // at the end anyway
+    tangent -= tangent.dot(normal) * normal;
+
+    // Normalize the tangent so it contributes
+    // equally at the vertex (TODO: do we need this?)
+    if (fuzzyEq(tangent.magnitude(), 0.0)) {
+        tangent = Vector3::unitX();
+    } else {
+        tangent = tangent.direction();
+    }
+
+    //////////////////////////////////////////////////
+    // Now compute the binormal (same code, but in x)
+
+    // Sort the vertices by texture coordinate x.
+    if (t[0].x < t[1].x) {
+        std::swap(v[0], v[1]);
+        std::swap(t[0], t[1]);
+    }
+
+    if (t[0].x < t[2].x) {
+        std::swap(v[0], v[2]);
+        std::swap(t[0], t[2]);
+    }
+
+    if (t[1].x < t[2].x) {
+        std::swap(v[1], v[2]);
+        std::swap(t[1], t[2]);
+    }
+
+    // Compute the direction of constant x.
+    if (fuzzyEq(t[2].x, t[0].x)) {
+        amount = 1.0;
+    } else {
+        amount = (t[1].x - t[0].x) / (t[2].x - t[0].x);
+    }
+
+    binormal = lerp(v[0], v[2], amount) - v[1];
+
+    // Make sure the binormal points in the right direction and is 
+    // perpendicular to the normal.
+    if (lerp(t[0].y, t[2].y, amount) < t[1].y) {
+        binormal = -binormal;
+    }
+
+    binormal -= binormal.dot(normal) * normal;
+
+    // Normalize the binormal so that it contributes
+    // an equal amount to the per-vertex value (TODO: do we need this? 
+    // Nelson Max showed that we don't for computing per-vertex normals)
+    if (fuzzyEq(binormal.magnitude(), 0.0)) {
+        binormal = Vector3::unitZ();
+    } else {
+        binormal = binormal.direction();
+    }
+
+    // This computation gives the opposite convention of what we want.
+    binormal = -binormal;
+
+}
+
+
+/** Computes the tangent and binormal of a range of faces */
+class FaceTangentBody {
+public:
+    const Vector3*          vertex;
+    const Vector2*          texCoord;
+    const MeshAlg::Face*    face;
+    Vector3*                faceTangent;
+    Vector3*                faceBinormal;
+
+    void operator()(int begin, int end) const {
+        Vector3 position[3];
+        Vector2 t[3];
+        for (int f = begin; f < end; ++f) {
+            for (int j = 0; j < 3; ++j) {
+                const int i = face[f].vertexIndex[j];
+                position[j] = vertex[i];
+                t[j]        = texCoord[i];
+            }
+
+            // Degenerate faces have no normal, but still get a tangent
+            const Vector3 faceNormal((position[1] - position[0]).cross(position[2] - position[0]).directionOrZero());
+            computeTangentVectors(faceNormal, position, t, faceTangent[f], faceBinormal[f]);
+        }
+    }
+};
+
+
+/**
+ Sums the face tangents and binormals around each vertex of a range, then
+ removes the component parallel to the normal and normalizes them.
+ */
+class VertexTangentBody {
+public:
+    /** The faces around vertex v are face[faceStart[v]] through face[faceStart[v + 1] - 1] */
+    const int*              faceStart;
+    const int*              face;
+    const Vector3*          faceTangent;
+    const Vector3*          faceBinormal;
+    const Vector3*          normal;
+    Vector3*                tangent;
+    Vector3*                binormal;
+
+    /** Makes v[begin] through v[end - 1] unit length and perpendicular to the normals */
+    void orthonormalize(Vector3* v, int begin, int end) const {
+        int i = begin;
+#       ifdef SSE
+            for (; i + 4 <= end; i += 4) {
+                __m128 x, y, z, nx, ny, nz;
+                loadVector3x4(v + i, x, y, z);
+                loadVector3x4(normal + i, nx, ny, nz);
+                const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, nx), _mm_mul_ps(y, ny)), _mm_mul_ps(z, nz));
+                x = _mm_sub_ps(x, _mm_mul_ps(d, nx));
+                y = _mm_sub_ps(y, _mm_mul_ps(d, ny));
+                z = _mm_sub_ps(z, _mm_mul_ps(d, nz));
+                normalize4(x, y, z, NORMALIZE_OR_ZERO);
+                storeVector3x4(v + i, x, y, z);
+            }
+#       endif
+        for (; i < end; ++i) {
+            const Vector3& N = normal[i];
+            v[i] = (v[i] - v[i].dot(N) * N).directionOrZero();
+        }
+    }
+
+    void operator()(int begin, int end) const {
+        for (int v = begin; v < end; ++v) {
+            debugAssertM(normal[v].isUnit() || normal[v].isZero(), "Input normals must have unit length");
+
+            Vector3 t = Vector3::zero();
+            Vector3 b = Vector3::zero();
+            for (int k = faceStart[v]; k < faceStart[v + 1]; ++k) {
+                t += faceTangent[face[k]];
+                b += faceBinormal[face[k]];
+            }
+            tangent[v]  = t;
+            binormal[v] = b;
+        }
+
+        // Note that the tangent and binormal might not be perpendicular anymore
+        orthonormalize(tangent, begin, end);
+        orthonormalize(binormal, begin, end);
+    }
+};
+
+
+void MeshAlg::computeNormals(
+    const Array<Vector3>&   vertexGeometry,
+    const Array<Face>&      faceArray,
+    const Array<Vertex>&    vertexArray,
+    Array<Vector3>&         vertexNormalArray,
+    Array<Vector3>&         faceNormalArray) {
+
+    debugAssert(vertexArray.size() == vertexGeometry.size());
+
+    // Face normals (not unit length), so that larger faces count for more
+    faceNormalArray.resize(faceArray.size());
+    FaceNormalBody faceBody;
+    faceBody.vertex        = vertexGeometry.getCArray();
+    faceBody.face          = faceArray.getCArray();
+    faceBody.faceNormal    = faceNormalArray.getCArray();
+    faceBody.normalization = NORMALIZE_NONE;
+    ThreadPool::common().parallelFor(0, faceArray.size(), NORMAL_GRAIN, faceBody);
+
+    // Per-vertex normals, computed by averaging
+    vertexNormalArray.resize(vertexGeometry.size());
+    VertexNormalBody vertexBody;
+    vertexBody.adjacency    = vertexArray.getCArray();
+    vertexBody.faceNormal   = faceNormalArray.getCArray();
+    vertexBody.vertexNormal = vertexNormalArray.getCArray();
+    ThreadPool::common().parallelFor(0, vertexNormalArray.size(), NORMAL_GRAIN, vertexBody);
+
+    NormalizeBody normalizeBody;
+    normalizeBody.v             = faceNormalArray.getCArray();
+    normalizeBody.normalization = NORMALIZE_OR_ZERO;
+    ThreadPool::common().parallelFor(0, faceNormalArray.size(), NORMAL_GRAIN, normalizeBody);
+}
+
+
+void MeshAlg::computeFaceNormals(
+    const Array<Vector3>&           vertexArray,
+    const Array<MeshAlg::Face>&     faceArray,
+    Array<Vector3>&                 faceNormals,
+    bool                            normalize) {
+
+    faceNormals.resize(faceArray.size());
+
+    FaceNormalBody body;
+    body.vertex        = vertexArray.getCArray();
+    body.face          = faceArray.getCArray();
+    body.faceNormal    = faceNormals.getCArray();
+    body.normalization = normalize ? NORMALIZE_DIRECTION : NORMALIZE_NONE;
+    ThreadPool::common().parallelFor(0, faceArray.size(), NORMAL_GRAIN, body);
+}
+
+
+void MeshAlg::computeTangentSpaceBasis(
+    const Array<Vector3>&       vertexArray,
+    const Array<Vector2>&       texCoordArray,
+    const Array<Vector3>&       vertexNormalArray,
+    const Array<Face>&          faceArray,
+    Array<Vector3>&             tangent,
+    Array<Vector3>&             binormal) {
+
+    debugAssertM(faceArray.size() != 0, "Unable to calculate valid tangent space without faces.");
+    debugAssert(texCoordArray.size() == vertexArray.size());
+    debugAssert(vertexNormalArray.size() == vertexArray.size());
+
+    const int numVertices = vertexArray.size();
+    const int numFaces    = faceArray.size();
+
+    // The tangent vectors of each face
+    Array<Vector3> faceTangent, faceBinormal;
+    faceTangent.resize(numFaces);
+    faceBinormal.resize(numFaces);
+
+    FaceTangentBody faceBody;
+    faceBody.vertex       = vertexArray.getCArray();
+    faceBody.texCoord     = texCoordArray.getCArray();
+    faceBody.face         = faceArray.getCArray();
+    faceBody.faceTangent  = faceTangent.getCArray();
+    faceBody.faceBinormal = faceBinormal.getCArray();
+    ThreadPool::common().parallelFor(0, numFaces, NORMAL_GRAIN, faceBody);
+
+    // The faces around each vertex, in face order (a face appears once
+    // for each of its corners at the vertex)
+    Array<int> faceStart, vertexFace;
+    faceStart.resize(numVertices + 1);
+    vertexFace.resize(numFaces * 3);
+    {
+        int* start = faceStart.getCArray();
+        System::memset(start, 0, sizeof(int) * (numVertices + 1));
+        for (int f = 0; f < numFaces; ++f) {
+            for (int j = 0; j < 3; ++j) {
+                debugAssert((faceArray[f].vertexIndex[j] >= 0) && (faceArray[f].vertexIndex[j] < numVertices));
+                ++start[faceArray[f].vertexIndex[j] + 1];
+            }
+        }
+        for (int v = 0; v < numVertices; ++v) {
+            start[v + 1] += start[v];
+        }
+
+        Array<int> fill = faceStart;
+        int* next = fill.getCArray();
+        int* out  = vertexFace.getCArray();
+        for (int f = 0; f < numFaces; ++f) {
+            const int* i = faceArray[f].vertexIndex;
+            out[next[i[0]]++] = f;
+            out[next[i[1]]++] = f;
+            out[next[i[2]]++] = f;
+        }
+    }
+
+    tangent.resize(numVertices);
+    binormal.resize(numVertices);
+
+    VertexTangentBody vertexBody;
+    vertexBody.faceStart    = faceStart.getCArray();
+    vertexBody.face         = vertexFace.getCArray();
+    vertexBody.faceTangent  = faceTangent.getCArray();
+    vertexBody.faceBinormal = faceBinormal.getCArray();
+    vertexBody.normal       = vertexNormalArray.getCArray();
+    vertexBody.tangent      = tangent.getCArray();
+    vertexBody.binormal     = binormal.getCArray();
+    ThreadPool::common().parallelFor(0, numVertices, NORMAL_GRAIN, vertexBody);
+}
+
+} // G3D namespace
@@ -0,0 +1,571 @@
+/**
+  @file MeshAlgSimplify.cpp
+
+  The MeshAlg::simplify and MeshAlg::computeLODChain methods.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#include "G3D/MeshAlg.h"
+#include <algorithm>
+
+namespace G3D {
+
+/** Weight of the planes that hold boundary edges in place, relative to a face plane */
+static const double BOUNDARY_WEIGHT = 100.0;
+
+/** A collapse is rejected if it turns a face normal by more than about 80 degrees */
+static const double MIN_NORMAL_COSINE = 0.2;
+
+/** The optimal point of a nearly singular quadric can be far away; it is
+    only used when this close to the edge, in edge lengths */
+static const double MAX_OPTIMUM_DISTANCE = 2.0;
+
+
+/**
+ Sum of weighted squared distances to a set of planes, as the symmetric
+ matrix [A b; b' c] applied to the homogeneous point.
+ */
+class Quadric {
+public:
+    double      a00, a01, a02, a11, a12, a22;
+    double      b0, b1, b2;
+    double      c;
+
+    Quadric() : a00(0), a01(0), a02(0), a11(0), a12(0), a22(0), b0(0), b1(0), b2(0), c(0) {}
+
+    /** Squared distance to the plane through point with unit normal n, times weight */
+    Quadric(const Vector3& n, const Vector3& point, double weight) {
+        const double d = -n.dot(point);
+        a00 = weight * n.x * n.x;  a01 = weight * n.x * n.y;  a02 = weight * n.x * n.z;
+        a11 = weight * n.y * n.y;  a12 = weight * n.y * n.z;  a22 = weight * n.z * n.z;
+        b0  = weight * n.x * d;    b1  = weight * n.y * d;    b2  = weight * n.z * d;
+        c   = weight * d * d;
+    }
+
+    Quadric& operator+=(const Quadric& q) {
+        a00 += q.a00;  a01 += q.a01;  a02 += q.a02;
+        a11 += q.a11;  a12 += q.a12;  a22 += q.a22;
+        b0  += q.b0;   b1  += q.b1;   b2  += q.b2;
+        c   += q.c;
+        return *this;
+    }
+
+    Quadric operator+(const Quadric& q) const {
+        Quadric r = *this;
+        r += q;
+        return r;
+    }
+
+    double operator()(const Vector3& v) const {
+        const double x = v.x, y = v.y, z = v.z;
+        return x * (a00 * x + a01 * y + a02 * z) +
+               y * (a01 * x + a11 * y + a12 * z) +
+               z * (a02 * x + a12 * y + a22 * z) +
+               2 * (b0 * x + b1 * y + b2 * z) + c;
+    }
+
+    /** Solves A v = -b.  Returns false if A is singular. */
+    bool minimum(Vector3& v) const {
+        const double c00 = a11 * a22 - a12 * a12;
+        const double c01 = a02 * a12 - a01 * a22;
+        const double c02 = a01 * a12 - a02 * a11;
+        const double det = a00 * c00 + a01 * c01 + a02 * c02;
+
+        const double scale = a00 + a11 + a22;
+        if (fabs(det) <= 1e-10 * scale * scale * scale) {
+            return false;
+        }
+
+        const double c11 = a00 * a22 - a02 * a02;
+        const double c12 = a01 * a02 - a00 * a12;
+        const double c22 = a00 * a11 - a01 * a01;
+        const double s = -1.0 / det;
+        v.x = (float)(s * (c00 * b0 + c01 * b1 + c02 * b2));
+        v.y = (float)(s * (c01 * b0 + c11 * b1 + c12 * b2));
+        v.z = (float)(s * (c02 * b0 + c12 * b1 + c22 * b2));
+        return true;
+    }
+};
+
+
+/** A candidate collapse of vertex v[1] into vertex v[0] */
+class Collapse {
+public:
+    float       cost;
+    int         v[2];
+
+    /** Versions of the vertices when the cost was computed */
+    int         version[2];
+
+    /** New position of v[0] */
+    Vector3     position;
+
+    /** Fraction of the way from v[0] to v[1] that position lies, for the attributes */
+    float       t;
+
+    /** Orders a heap with the least cost on top */
+    inline bool operator<(const Collapse& other) const {
+        return cost > other.cost;
+    }
+};
+
+
+/** The mesh during simplification */
+class MeshSimplifier {
+public:
+    Array<Vector3>          position;
+    Array<Vector3>          normal;
+    Array<Vector2>          texCoord;
+    Array<int>              index;
+
+    /** faceIndex lists live faces and may list faces that have since been removed */
+    Array<MeshAlg::Vertex>  vertexArray;
+    Array<Quadric>          quadric;
+
+    /** Increases whenever a vertex moves, which changes the cost of its collapses */
+    Array<int>              version;
+    Array<bool>             vertexAlive;
+    Array<bool>             faceAlive;
+    int                     numFaces;
+
+    Array<Collapse>         heap;
+    float                   maxError;
+
+    MeshSimplifier(const MeshAlg::Geometry& geometry, const Array<Vector2>& texCoord, const Array<int>& index);
+
+    inline const int* face(int f) const {
+        return index.getCArray() + 3 * f;
+    }
+
+    /** Removes faces that are gone from the list of vertex v */
+    void cleanFaces(int v);
+
+    /** Unique vertices other than v that share a live face with v */
+    void getNeighbors(int v, SmallArray<int, 16>& neighbor) const;
+
+    /** True if moving the vertices in the faces of v (other than those
+        containing w as well) to p flips none of them */
+    bool preservesOrientation(int v, int w, const Vector3& p) const;
+
+    /** Fills c with the cheapest position for collapsing v1 into v0.  If
+        checkOrientation, positions that flip a face are skipped and false
+        is returned when every position does. */
+    bool evaluate(int v0, int v1, bool checkOrientation, Collapse& c) const;
+
+    /** True if collapsing keeps the mesh manifold: the edge's endpoints
+        share exactly the neighbors opposite it in its faces, and no two
+        faces end up with the same vertices */
+    bool linkConditionHolds(int v0, int v1) const;
+
+    void push(int v0, int v1);
+
+    void collapse(const Collapse& c);
+
+    /** Collapses edges until at most targetFaceCount faces remain or no collapse is possible */
+    void collapseTo(int targetFaceCount);
+
+    /** Copies the live mesh into lod */
+    void getLOD(MeshAlg::LOD& lod) const;
+};
+
+
+MeshSimplifier::MeshSimplifier(
+    const MeshAlg::Geometry&    geometry,
+    const Array<Vector2>&       _texCoord,
+    const Array<int>&           _index) :
+    position(geometry.vertexArray), normal(geometry.normalArray), texCoord(_texCoord),
+    index(_index), numFaces(0), maxError(0) {
+
+    debugAssert((normal.size() == 0) || (normal.size() == position.size()));
+    debugAssert((texCoord.size() == 0) || (texCoord.size() == position.size()));
+
+    Array<MeshAlg::Face> faceArray;
+    Array<MeshAlg::Edge> edgeArray;
+    MeshAlg::computeAdjacency(position, index, faceArray, edgeArray, vertexArray);
+
+    const int n = position.size();
+    quadric.resize(n);
+    version.resize(n);
+    vertexAlive.resize(n);
+    for (int v = 0; v < n; ++v) {
+        version[v] = 0;
+        vertexAlive[v] = true;
+    }
+
+    Array<Vector3> faceNormal;
+    faceNormal.resize(faceArray.size());
+    faceAlive.resize(faceArray.size());
+    for (int f = 0; f < faceArray.size(); ++f) {
+        const int* v = face(f);
+        const Vector3 cross = (position[v[1]] - position[v[0]]).cross(position[v[2]] - position[v[0]]);
+        faceAlive[f] = (v[0] != v[1]) && (v[1] != v[2]) && (v[2] != v[0]);
+        faceNormal[f] = cross.directionOrZero();
+        if (faceAlive[f]) {
+            ++numFaces;
+            const Quadric q(faceNormal[f], position[v[0]], 1.0);
+            for (int j = 0; j < 3; ++j) {
+                quadric[v[j]] += q;
+            }
+        }
+    }
+
+    for (int v = 0; v < n; ++v) {
+        cleanFaces(v);
+    }
+
+    for (int e = 0; e < edgeArray.size(); ++e) {
+        const MeshAlg::Edge& edge = edgeArray[e];
+        const int v0 = edge.vertexIndex[0];
+        const int v1 = edge.vertexIndex[1];
+        if (v0 == v1) {
+            continue;
+        }
+
+        if (edge.boundary()) {
+            // Plane through the edge, perpendicular to its face
+            const int f = (edge.faceIndex[0] == MeshAlg::Face::NONE) ? edge.faceIndex[1] : edge.faceIndex[0];
+            const Vector3 n = (position[v1] - position[v0]).cross(faceNormal[f]).directionOrZero();
+            const Quadric q(n, position[v0], BOUNDARY_WEIGHT);
+            quadric[v0] += q;
+            quadric[v1] += q;
+        }
+    }
+
+    for (int e = 0; e < edgeArray.size(); ++e) {
+        const MeshAlg::Edge& edge = edgeArray[e];
+        if (edge.vertexIndex[0] != edge.vertexIndex[1]) {
+            push(edge.vertexIndex[0], edge.vertexIndex[1]);
+        }
+    }
+}
+
+
+void MeshSimplifier::cleanFaces(int v) {
+    SmallArray<int, 8>& list = vertexArray[v].faceIndex;
+    for (int i = list.size() - 1; i >= 0; --i) {
+        if (! faceAlive[list[i]] || contains(&list[0], i, list[i])) {
+            list.fastRemove(i);
+        }
+    }
+}
+
+
+void MeshSimplifier::getNeighbors(int v, SmallArray<int, 16>& neighbor) const {
+    neighbor.fastClear();
+    const SmallArray<int, 8>& list = vertexArray[v].faceIndex;
+    for (int i = 0; i < list.size(); ++i) {
+        if (faceAlive[list[i]]) {
+            const int* w = face(list[i]);
+            for (int j = 0; j < 3; ++j) {
+                if ((w[j] != v) && ! neighbor.contains(w[j])) {
+                    neighbor.append(w[j]);
+                }
+            }
+        }
+    }
+}
+
+
+bool MeshSimplifier::preservesOrientation(int v, int w, const Vector3& p) const {
+    const SmallArray<int, 8>& list = vertexArray[v].faceIndex;
+    for (int i = 0; i < list.size(); ++i) {
+        const int f = list[i];
+        const int* u = face(f);
+        if (! faceAlive[f] || contains(u, 3, w)) {
+            continue;
+        }
+
+        Vector3 before[3], after[3];
+        for (int j = 0; j < 3; ++j) {
+            before[j] = position[u[j]];
+            after[j]  = (u[j] == v) ? p : before[j];
+        }
+        const Vector3 n0 = (before[1] - before[0]).cross(before[2] - before[0]);
+        const Vector3 n1 = (after[1] - after[0]).cross(after[2] - after[0]);
+        if ((double)n0.dot(n1) < MIN_NORMAL_COSINE * (double)n0.length() * (double)n1.length()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool MeshSimplifier::evaluate(int v0, int v1, bool checkOrientation, Collapse& c) const {
+    const Quadric q = quadric[v0] + quadric[v1];
+    const Vector3& p0 = position[v0];
+    const Vector3& p1 = position[v1];
+    const Vector3 edge = p1 - p0;
+
+    Vector3 candidate[4];
+    int numCandidates = 0;
+    candidate[numCandidates++] = (p0 + p1) * 0.5f;
+    candidate[numCandidates++] = p0;
+    candidate[numCandidates++] = p1;
+
+    Vector3 optimum;
+    if (q.minimum(optimum) &&
+        ((optimum - candidate[0]).squaredLength() <= square(MAX_OPTIMUM_DISTANCE) * edge.squaredLength())) {
+        candidate[numCandidates++] = optimum;
+    }
+
+    double cost[4];
+    for (int i = 0; i < numCandidates; ++i) {
+        cost[i] = q(candidate[i]);
+    }
+
+    // Take the cheapest candidate that does not flip a face
+    double bestCost = inf();
+    for (int tries = 0; tries < numCandidates; ++tries) {
+        int cheapest = 0;
+        for (int i = 1; i < numCandidates; ++i) {
+            if (cost[i] < cost[cheapest]) {
+                cheapest = i;
+            }
+        }
+
+        if (cost[cheapest] == inf()) {
+            break;
+        } else if (! checkOrientation ||
+                   (preservesOrientation(v0, v1, candidate[cheapest]) &&
+                    preservesOrientation(v1, v0, candidate[cheapest]))) {
+            bestCost = cost[cheapest];
+            c.position = candidate[cheapest];
+            break;
+        }
+        cost[cheapest] = inf();
+    }
+
+    if (bestCost == inf()) {
+        return false;
+    }
+
+    c.cost = (float)max(bestCost, 0.0);
+    c.v[0] = v0;
+    c.v[1] = v1;
+    c.version[0] = version[v0];
+    c.version[1] = version[v1];
+
+    const float length2 = edge.squaredLength();
+    c.t = (length2 > 0) ? clamp((c.position - p0).dot(edge) / length2, 0.0f, 1.0f) : 0.5f;
+    return true;
+}
+
+
+bool MeshSimplifier::linkConditionHolds(int v0, int v1) const {
+    int numShared = 0;
+    const SmallArray<int, 8>& list = vertexArray[v0].faceIndex;
+    for (int i = 0; i < list.size(); ++i) {
+        if (faceAlive[list[i]] && contains(face(list[i]), 3, v1)) {
+            ++numShared;
+        }
+    }
+
+    SmallArray<int, 16> n0, n1;
+    getNeighbors(v0, n0);
+    getNeighbors(v1, n1);
+    int numCommon = 0;
+    for (int i = 0; i < n0.size(); ++i) {
+        if ((n0[i] != v1) && n1.contains(n0[i])) {
+            ++numCommon;
+        }
+    }
+
+    if ((numShared == 0) || (numCommon != numShared)) {
+        return false;
+    }
+
+    // Collapsing a closed tetrahedron would leave two faces back to back
+    const SmallArray<int, 8>& list1 = vertexArray[v1].faceIndex;
+    for (int i = 0; i < list.size(); ++i) {
+        const int* a = face(list[i]);
+        if (! faceAlive[list[i]] || contains(a, 3, v1)) {
+            continue;
+        }
+        for (int k = 0; k < list1.size(); ++k) {
+            const int* b = face(list1[k]);
+            if (faceAlive[list1[k]] && ! contains(b, 3, v0) &&
+                contains(b, 3, a[0]) + contains(b, 3, a[1]) + contains(b, 3, a[2]) == 2) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+void MeshSimplifier::push(int v0, int v1) {
+    // Flips are checked when the collapse comes off the heap
+    evaluate(v0, v1, false, heap.next());
+    std::push_heap(heap.getCArray(), heap.getCArray() + heap.size());
+}
+
+
+void MeshSimplifier::collapse(const Collapse& c) {
+    const int v0 = c.v[0];
+    const int v1 = c.v[1];
+
+    position[v0] = c.position;
+    if (normal.size() > 0) {
+        normal[v0] = normal[v0].lerp(normal[v1], c.t).directionOrZero();
+    }
+    if (texCoord.size() > 0) {
+        texCoord[v0] += (texCoord[v1] - texCoord[v0]) * c.t;
+    }
+    quadric[v0] += quadric[v1];
+
+    SmallArray<int, 8>& list0 = vertexArray[v0].faceIndex;
+    const SmallArray<int, 8>& list1 = vertexArray[v1].faceIndex;
+    for (int i = 0; i < list1.size(); ++i) {
+        const int f = list1[i];
+        if (! faceAlive[f]) {
+            continue;
+        }
+
+        int* u = index.getCArray() + 3 * f;
+        if (contains(u, 3, v0)) {
+            faceAlive[f] = false;
+            --numFaces;
+        } else {
+            for (int j = 0; j < 3; ++j) {
+                if (u[j] == v1) {
+                    u[j] = v0;
+                }
+            }
+            list0.append(f);
+        }
+    }
+    cleanFaces(v0);
+
+    vertexAlive[v1] = false;
+    vertexArray[v1].faceIndex.clear();
+    ++version[v0];
+    maxError = max(maxError, sqrt(c.cost));
+
+    // Collapses between other vertices keep their cost; whether they flip
+    // a face is checked again when they come off the heap
+    SmallArray<int, 16> neighbor;
+    getNeighbors(v0, neighbor);
+    for (int i = 0; i < neighbor.size(); ++i) {
+        push(v0, neighbor[i]);
+    }
+}
+
+
+void MeshSimplifier::collapseTo(int targetFaceCount) {
+    while ((numFaces > targetFaceCount) && (heap.size() > 0)) {
+        std::pop_heap(heap.getCArray(), heap.getCArray() + heap.size());
+        const Collapse c = heap.pop();
+
+        if (! vertexAlive[c.v[0]] || ! vertexAlive[c.v[1]] ||
+            (c.version[0] != version[c.v[0]]) || (c.version[1] != version[c.v[1]]) ||
+            ! linkConditionHolds(c.v[0], c.v[1])) {
+            continue;
+        }
+
+        // The neighborhood may have moved since c was evaluated
+        Collapse current;
+        if (! evaluate(c.v[0], c.v[1], true, current)) {
+            continue;
+        }
+
+        if (current.cost > c.cost) {
+            heap.append(current);
+            std::push_heap(heap.getCArray(), heap.getCArray() + heap.size());
+        } else {
+            collapse(current);
+        }
+    }
+}
+
+
+void MeshSimplifier::getLOD(MeshAlg::LOD& lod) const {
+    Array<int> toNew;
+    toNew.resize(position.size());
+    for (int v = 0; v < toNew.size(); ++v) {
+        toNew[v] = -1;
+    }
+
+    lod.geometry.clear();
+    lod.texCoordArray.clear();
+    lod.indexArray.fastClear();
+    for (int f = 0; f < faceAlive.size(); ++f) {
+        if (faceAlive[f]) {
+            for (int j = 0; j < 3; ++j) {
+                const int v = face(f)[j];
+                if (toNew[v] == -1) {
+                    toNew[v] = lod.geometry.vertexArray.size();
+                    lod.geometry.vertexArray.append(position[v]);
+                    if (normal.size() > 0) {
+                        lod.geometry.normalArray.append(normal[v]);
+                    }
+                    if (texCoord.size() > 0) {
+                        lod.texCoordArray.append(texCoord[v]);
+                    }
+                }
+                lod.indexArray.append(toNew[v]);
+            }
+        }
+    }
+    lod.geometricError = maxError;
+
+    const int numVertices = lod.geometry.vertexArray.size();
+    Array<int> toOld;
+    MeshAlg::optimizeVertexCache(lod.indexArray, numVertices);
+    MeshAlg::optimizeVertexFetch(lod.indexArray, numVertices, toOld);
+    MeshAlg::reorderVertexArray(toOld, lod.geometry.vertexArray);
+    if (normal.size() > 0) {
+        MeshAlg::reorderVertexArray(toOld, lod.geometry.normalArray);
+    }
+    if (texCoord.size() > 0) {
+        MeshAlg::reorderVertexArray(toOld, lod.texCoordArray);
+    }
+}
+
+
+void MeshAlg::simplify(
+    const Geometry&         geometry,
+    const Array<Vector2>&   texCoord,
+    const Array<int>&       index,
+    int                     targetFaceCount,
+    LOD&                    lod) {
+
+    MeshSimplifier simplifier(geometry, texCoord, index);
+    simplifier.collapseTo(targetFaceCount);
+    simplifier.getLOD(lod);
+}
+
+
+void MeshAlg::computeLODChain(
+    const Geometry&         geometry,
+    const Array<Vector2>&   texCoord,
+    const Array<int>&       index,
+    Array<LOD>&             chain,
+    float                   ratio,
+    int                     minFaceCount) {
+
+    debugAssert((ratio > 0) && (ratio < 1));
+
+    chain.resize(1);
+    chain[0].geometry       = geometry;
+    chain[0].texCoordArray  = texCoord;
+    chain[0].indexArray     = index;
+    chain[0].geometricError = 0;
+
+    MeshSimplifier simplifier(geometry, texCoord, index);
+    int target = iFloor(simplifier.numFaces * ratio);
+    while (target >= minFaceCount) {
+        simplifier.collapseTo(target);
+        if (simplifier.numFaces > target) {
+            // The topology does not allow a level this small
+            break;
+        }
+
+        simplifier.getLOD(chain.next());
+        target = iFloor(simplifier.numFaces * ratio);
+    }
+}
+
+} // G3D namespace
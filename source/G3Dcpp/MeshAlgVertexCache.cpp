@@ -0,0 +1,294 @@
+/**
+  @file MeshAlgVertexCache.cpp
+
+  The MeshAlg::optimizeVertexCache, MeshAlg::optimizeVertexFetch, and
+  MeshAlg::computeVertexCacheStatistics methods.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#include "G3D/MeshAlg.h"
+#include <algorithm>
+
+namespace G3D {
+
+/** Score of a vertex used by the triangle just drawn.  Less than that of
+    the vertices used shortly before, so that strips do not double back. */
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+
+/** Falloff of the score with position in the cache */
+static const float CACHE_DECAY_POWER = 1.5f;
+
+/** Scale and falloff of the score for vertices with few triangles left, so
+    that lone triangles are not left behind */
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+/** Vertex valences with a precomputed score */
+static const int MAX_SCORED_VALENCE = 64;
+
+
+/** The simulated cache and the scores of optimizeVertexCache */
+class VertexCacheScore {
+public:
+    int             cacheSize;
+    Array<float>    cacheScore;
+    Array<float>    valenceScore;
+
+    VertexCacheScore(int cacheSize) : cacheSize(cacheSize) {
+        cacheScore.resize(cacheSize);
+        for (int p = 0; p < cacheSize; ++p) {
+            if (p < 3) {
+                cacheScore[p] = LAST_TRIANGLE_SCORE;
+            } else {
+                cacheScore[p] = pow(1.0f - (float)(p - 3) / (cacheSize - 3), CACHE_DECAY_POWER);
+            }
+        }
+
+        valenceScore.resize(MAX_SCORED_VALENCE);
+        valenceScore[0] = 0;
+        for (int v = 1; v < MAX_SCORED_VALENCE; ++v) {
+            valenceScore[v] = VALENCE_BOOST_SCALE * pow((float)v, -VALENCE_BOOST_POWER);
+        }
+    }
+
+    /** Score of a vertex at cache position (-1 when not cached) with numTriangles not yet drawn */
+    inline float operator()(int position, int numTriangles) const {
+        if (numTriangles == 0) {
+            return -1.0f;
+        }
+
+        const float c = (position < 0) ? 0.0f : cacheScore[position];
+        if (numTriangles < MAX_SCORED_VALENCE) {
+            return c + valenceScore[numTriangles];
+        } else {
+            return c + VALENCE_BOOST_SCALE * pow((float)numTriangles, -VALENCE_BOOST_POWER);
+        }
+    }
+};
+
+
+void MeshAlg::optimizeVertexCache(
+    Array<int>&         index,
+    int                 numVertices,
+    int                 cacheSize) {
+
+    debugAssertM(index.size() % 3 == 0, "optimizeVertexCache requires a triangle list");
+    debugAssertM(cacheSize > 3, "The cache must hold more than one triangle");
+
+    const int numTriangles = index.size() / 3;
+    if (numTriangles == 0) {
+        return;
+    }
+
+    const VertexCacheScore score(cacheSize);
+
+    // Triangles not yet drawn around each vertex are
+    // vertexTriangle[triangleStart[v]] through vertexTriangle[triangleStart[v] + remaining[v] - 1]
+    Array<int> remaining, triangleStart, vertexTriangle;
+    remaining.resize(numVertices);
+    System::memset(remaining.getCArray(), 0, sizeof(int) * numVertices);
+    for (int i = 0; i < index.size(); ++i) {
+        debugAssert((index[i] >= 0) && (index[i] < numVertices));
+        ++remaining[index[i]];
+    }
+
+    triangleStart.resize(numVertices);
+    int sum = 0;
+    for (int v = 0; v < numVertices; ++v) {
+        triangleStart[v] = sum;
+        sum += remaining[v];
+    }
+
+    vertexTriangle.resize(index.size());
+    {
+        Array<int> fill = triangleStart;
+        for (int i = 0; i < index.size(); ++i) {
+            vertexTriangle[fill[index[i]]] = i / 3;
+            ++fill[index[i]];
+        }
+    }
+
+    Array<float> vertexScoreArray;
+    vertexScoreArray.resize(numVertices);
+    for (int v = 0; v < numVertices; ++v) {
+        vertexScoreArray[v] = score(-1, remaining[v]);
+    }
+
+    // Start with the best triangle overall
+    Array<bool> drawnArray;
+    drawnArray.resize(numTriangles);
+    int best = -1;
+    float bestScore = -inf();
+    for (int t = 0; t < numTriangles; ++t) {
+        const float s = vertexScoreArray[index[3 * t]] + vertexScoreArray[index[3 * t + 1]] + vertexScoreArray[index[3 * t + 2]];
+        drawnArray[t] = false;
+        if (s > bestScore) {
+            bestScore = s;
+            best = t;
+        }
+    }
+
+    // The cache is most recent first.  It briefly holds three extra
+    // vertices so that the ones pushed out are rescored.
+    Array<int> cacheArray, newCacheArray;
+    cacheArray.resize(cacheSize + 3);
+    newCacheArray.resize(cacheSize + 3);
+    int* cache    = cacheArray.getCArray();
+    int* newCache = newCacheArray.getCArray();
+    int cacheLength = 0;
+
+    Array<int> output;
+    output.resize(index.size());
+
+    const int* triangleIndex = index.getCArray();
+    const int* start         = triangleStart.getCArray();
+    int*       triangle      = vertexTriangle.getCArray();
+    int*       left          = remaining.getCArray();
+    float*     vertexScore   = vertexScoreArray.getCArray();
+    bool*      drawn         = drawnArray.getCArray();
+
+    // Triangles before this one have all been drawn
+    int nextUndrawn = 0;
+
+    for (int n = 0; n < numTriangles; ++n) {
+        if (best == -1) {
+            // Nothing in the cache has triangles left; start somewhere new
+            while (drawn[nextUndrawn]) {
+                ++nextUndrawn;
+            }
+            best = nextUndrawn;
+        }
+
+        const int* tri = triangleIndex + 3 * best;
+        output[3 * n]     = tri[0];
+        output[3 * n + 1] = tri[1];
+        output[3 * n + 2] = tri[2];
+        drawn[best] = true;
+
+        int newCacheLength = 0;
+        for (int j = 0; j < 3; ++j) {
+            const int v = tri[j];
+
+            // Remove the triangle from the vertex's list
+            int* list = triangle + start[v];
+            for (int k = 0; k < left[v]; ++k) {
+                if (list[k] == best) {
+                    list[k] = list[left[v] - 1];
+                    --left[v];
+                    break;
+                }
+            }
+
+            if (! contains(newCache, newCacheLength, v)) {
+                newCache[newCacheLength] = v;
+                ++newCacheLength;
+            }
+        }
+
+        for (int c = 0; c < cacheLength; ++c) {
+            const int v = cache[c];
+            if ((v != tri[0]) && (v != tri[1]) && (v != tri[2])) {
+                newCache[newCacheLength] = v;
+                ++newCacheLength;
+            }
+        }
+
+        // Rescore the vertices whose position changed
+        for (int c = 0; c < newCacheLength; ++c) {
+            const int v = newCache[c];
+            vertexScore[v] = score((c < cacheSize) ? c : -1, left[v]);
+        }
+
+        // Draw the best triangle around the cache next
+        best = -1;
+        bestScore = -inf();
+        for (int c = 0; c < newCacheLength; ++c) {
+            const int v = newCache[c];
+            const int* list = triangle + start[v];
+            for (int k = 0; k < left[v]; ++k) {
+                const int t = list[k];
+                const int* other = triangleIndex + 3 * t;
+                const float s = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+                if (s > bestScore) {
+                    bestScore = s;
+                    best = t;
+                }
+            }
+        }
+
+        std::swap(cache, newCache);
+        cacheLength = iMin(newCacheLength, cacheSize);
+    }
+
+    // Meshes authored in strips may already be better than the greedy order
+    double oldACMR, newACMR, atvr;
+    computeVertexCacheStatistics(index, numVertices, oldACMR, atvr, cacheSize);
+    computeVertexCacheStatistics(output, numVertices, newACMR, atvr, cacheSize);
+    if (newACMR < oldACMR) {
+        index.fastClear();
+        index.append(output);
+    }
+}
+
+
+void MeshAlg::optimizeVertexFetch(
+    Array<int>&         index,
+    int                 numVertices,
+    Array<int>&         toOld) {
+
+    Array<int> toNew;
+    toNew.resize(numVertices);
+    for (int v = 0; v < numVertices; ++v) {
+        toNew[v] = -1;
+    }
+
+    toOld.fastClear();
+    for (int i = 0; i < index.size(); ++i) {
+        const int v = index[i];
+        debugAssert((v >= 0) && (v < numVertices));
+        if (toNew[v] == -1) {
+            toNew[v] = toOld.size();
+            toOld.append(v);
+        }
+        index[i] = toNew[v];
+    }
+}
+
+
+void MeshAlg::computeVertexCacheStatistics(
+    const Array<int>&   index,
+    int                 numVertices,
+    double&             acmr,
+    double&             atvr,
+    int                 cacheSize) {
+
+    // A vertex is in the FIFO cache if fewer than cacheSize vertices were
+    // transformed after it.  0 means never transformed.
+    Array<int> transformed;
+    transformed.resize(numVertices);
+    System::memset(transformed.getCArray(), 0, sizeof(int) * numVertices);
+
+    int numTransforms = 0;
+    int numUsed = 0;
+    for (int i = 0; i < index.size(); ++i) {
+        const int v = index[i];
+        debugAssert((v >= 0) && (v < numVertices));
+        if (transformed[v] == 0) {
+            ++numUsed;
+        } else if (numTransforms - transformed[v] < cacheSize) {
+            continue;
+        }
+
+        ++numTransforms;
+        transformed[v] = numTransforms;
+    }
+
+    const int numTriangles = index.size() / 3;
+    acmr = (numTriangles == 0) ? 0.0 : ((double)numTransforms / numTriangles);
+    atvr = (numUsed == 0) ? 0.0 : ((double)numTransforms / numUsed);
+}
+
+} // G3D namespace
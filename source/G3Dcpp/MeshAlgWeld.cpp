@@ -13,189 +13,231 @@
  */
 
 #include "G3D/MeshAlg.h"
-#include "G3D/Table.h"
-#include "G3D/Set.h"
+#include "G3D/ThreadPool.h"
 
 namespace G3D {
 
-namespace _internal {
+/** Vertices per parallelFor subrange in computeWeld */
+static const int WELD_GRAIN = 8192;
 
-class Welder {
-private:
+/** Rounds of parallel resolution before the remaining vertices are
+    resolved one at a time, in order */
+static const int MAX_WELD_ROUNDS = 16;
 
-    // Intentionally illegal
-    Welder& operator=(const Welder& w);
+/** Welding state of an old vertex */
+enum WeldState {WELD_UNDECIDED = 0, WELD_REPRESENTATIVE, WELD_MERGED};
 
+/**
+ A uniform grid of cells twice as wide as the weld radius, hashed into about
+ as many buckets as there are vertices, so its size does not depend on the
+ extent of the mesh.  The vertices within the radius of a vertex are in the
+ 2x2x2 cells on the sides of the half cell that it lies in.  The vertices
+ of each bucket are stored together, with their coordinates in separate
+ arrays.
+ */
+class WeldGrid {
 public:
-    /** Indices of newVertexArray elements in <B>or near</B> a grid cell. */
-    typedef Array<int> List;
-
-    enum {GRID_RES = 32};
-
-    List grid[GRID_RES][GRID_RES][GRID_RES];
-
-    const Array<Vector3>& oldVertexArray;
-    Array<Vector3>&       newVertexArray;
-    Array<int>&           toNew;
-    Array<int>&           toOld;
-
-    /** Must be less than one grid cell, not checked */
-    const double          radius;
-
-    /** (oldVertexArray[i] - offset) * scale is on the range [0, 1] */
-    Vector3               offset;
-    Vector3               scale;
-
-    Welder(    
-        const Array<Vector3>& _oldVertexArray,
-        Array<Vector3>&       _newVertexArray,
-        Array<int>&           _toNew,
-        Array<int>&           _toOld,
-        double                _radius);
-        
-    /**
-     Computes the grid index from an ordinate.
-     */
-    void toGridCoords(Vector3 v, int& x, int& y, int& z) const;
-
-    /** Gets the index of a vertex, adding it to 
-        newVertexArray if necessary. */
-    int getIndex(const Vector3& vertex);
-    
-    void weld();
-};
+    /** One over the radius, the width of a half cell */
+    double              invHalfCellSize;
+    int                 bucketBits;
 
-}}
+    /** The vertices in bucket b are bucketStart[b] through bucketStart[b + 1] - 1 */
+    Array<int>          bucketStart;
 
+    /** Old index of each vertex, in bucket order */
+    Array<int>          id;
 
-G3D::uint32 hashCode(const G3D::_internal::Welder::List* x) {
-    return (G3D::uint32)x;
-}
+    Array<float>        x;
+    Array<float>        y;
+    Array<float>        z;
 
-namespace G3D {
-namespace _internal {
-
-Welder::Welder(    
-    const Array<Vector3>& _oldVertexArray,
-    Array<Vector3>&       _newVertexArray,
-    Array<int>&           _toNew,
-    Array<int>&           _toOld,
-    double                _radius) :
-    oldVertexArray(_oldVertexArray),
-    newVertexArray(_newVertexArray),
-    toNew(_toNew),
-    toOld(_toOld),
-    radius(_radius) {
-
-    // Compute a scale factor that moves the range
-    // of all ordinates to [0, 1]
-    Vector3 minBound = Vector3::inf();
-    Vector3 maxBound = -minBound;
-
-    for (int i = 0; i < oldVertexArray.size(); ++i) {
-        minBound = minBound.min(oldVertexArray[i]);
-        maxBound = maxBound.max(oldVertexArray[i]);
-    }
-
-    offset = minBound;
-    scale  = maxBound - minBound;
-    for (int i = 0; i < 3; ++i) {
-        // The model might have zero extent along some axis
-        if (fuzzyEq(scale[i], 0.0)) {
-            scale[i] = 1.0;
-        } else {
-            scale[i] = 1.0 / scale[i];
-        }
+    inline int halfCell(float v) const {
+        // Clamping merges distant cells, which only costs time
+        return iFloor(clamp(v * invHalfCellSize, -1073741824.0, 1073741823.0));
     }
-}
 
+    inline int bucket(int cx, int cy, int cz) const {
+        const uint32 h = ((uint32)cx * 73856093u) ^ ((uint32)cy * 19349663u) ^ ((uint32)cz * 83492791u);
+        return (int)((h * 2654435761u) >> (32 - bucketBits));
+    }
 
-void Welder::toGridCoords(Vector3 v, int& x, int& y, int& z) const {
-    v = (v - offset) * scale;
-    x = iClamp(iFloor(v.x * GRID_RES), 0, GRID_RES - 1);
-    y = iClamp(iFloor(v.y * GRID_RES), 0, GRID_RES - 1);
-    z = iClamp(iFloor(v.z * GRID_RES), 0, GRID_RES - 1);
-}
-
-
-int Welder::getIndex(const Vector3& vertex) {
-
-    int closestIndex = -1;
-    double distanceSquared = inf();
+    inline int bucket(const Vector3& v) const {
+        return bucket(halfCell(v.x) >> 1, halfCell(v.y) >> 1, halfCell(v.z) >> 1);
+    }
 
-    int ix, iy, iz;
-    toGridCoords(vertex, ix, iy, iz);
+    /** Buckets of the 8 cells that can hold neighbors of the vertex at
+        position p, some of which may repeat.  h is the half cell that b was
+        computed for; nothing is recomputed while consecutive vertices share
+        a half cell. */
+    inline void neighborBuckets(int p, int h[3], int b[8]) const {
+        const int hx = halfCell(x.getCArray()[p]);
+        const int hy = halfCell(y.getCArray()[p]);
+        const int hz = halfCell(z.getCArray()[p]);
+        if ((hx == h[0]) && (hy == h[1]) && (hz == h[2])) {
+            return;
+        }
+        h[0] = hx;
+        h[1] = hy;
+        h[2] = hz;
+
+        // The cell and its neighbor on the side of the half cell
+        const int cx[2] = {hx >> 1, (hx >> 1) + ((hx & 1) ? 1 : -1)};
+        const int cy[2] = {hy >> 1, (hy >> 1) + ((hy & 1) ? 1 : -1)};
+        const int cz[2] = {hz >> 1, (hz >> 1) + ((hz & 1) ? 1 : -1)};
+        for (int k = 0; k < 8; ++k) {
+            b[k] = bucket(cx[k & 1], cy[(k >> 1) & 1], cz[k >> 2]);
+        }
+    }
 
-    // Check against all vertices within radius of this grid cube
-    const List& list = grid[ix][iy][iz];
+    /** Squared distance between the vertices at positions p and q */
+    inline float distance2(int p, int q) const {
+        const float dx = x.getCArray()[q] - x.getCArray()[p];
+        const float dy = y.getCArray()[q] - y.getCArray()[p];
+        const float dz = z.getCArray()[q] - z.getCArray()[p];
+        return dx * dx + dy * dy + dz * dz;
+    }
+};
 
-    for (int i = 0; i < list.size(); ++i) {
-        double d = (newVertexArray[list[i]] - vertex).squaredMagnitude();
 
-        if (d < distanceSquared) {
-            distanceSquared = d;
-            closestIndex = list[i];
+/** Computes the bucket of every vertex */
+class WeldKeyBody {
+public:
+    const WeldGrid*     grid;
+    const Vector3*      vertex;
+    uint64*             key;
+    int*                value;
+
+    void operator()(int begin, int end) const {
+        for (int i = begin; i < end; ++i) {
+            key[i]   = grid->bucket(vertex[i]);
+            value[i] = i;
         }
     }
+};
 
-    if (distanceSquared <= radius * radius) {
-
-        return closestIndex;
 
-    } else {
+/** Fills the grid from the vertices sorted by bucket */
+class WeldGatherBody {
+public:
+    WeldGrid*           grid;
+    const Vector3*      vertex;
+    const uint64*       key;
+    const int*          value;
+
+    void operator()(int begin, int end) const {
+        int* start = grid->bucketStart.getCArray();
+        for (int i = begin; i < end; ++i) {
+            // Every bucket after the previous vertex's, up to this one's, starts here
+            const int previous = (i == 0) ? -1 : (int)key[i - 1];
+            for (int b = previous + 1; b <= (int)key[i]; ++b) {
+                start[b] = i;
+            }
 
-        // This is a new vertex
-        int newIndex = newVertexArray.size();
-        newVertexArray.append(vertex);
+            const Vector3& v = vertex[value[i]];
+            grid->id[i] = value[i];
+            grid->x[i]  = v.x;
+            grid->y[i]  = v.y;
+            grid->z[i]  = v.z;
+        }
+    }
+};
 
-        // Create a new vertex and store its index in the
-        // neighboring grid cells (usually, only 1 neighbor)
 
-        Set<List*> neighbors;
+/** A half cell that no vertex is in */
+static const int NO_CELL = 0x7FFFFFFF;
 
-        for (float dx = -1; dx <= +1; ++dx) {
-            for (float dy = -1; dy <= +1; ++dy) {
-                for (float dz = -1; dz <= +1; ++dz) {
-                    int ix, iy, iz;
-                    toGridCoords(vertex + Vector3(dx, dy, dz) * radius, ix, iy, iz);
-                    neighbors.insert(&(grid[ix][iy][iz]));
+/**
+ One round of choosing representatives.  A vertex becomes a representative
+ if no earlier vertex within the radius is one, which is what adding the
+ vertices one at a time in order produces.  A vertex is decided once every
+ earlier neighbor is, or as soon as one of them is a representative.  Each
+ round reads only the previous round's states, so the result does not
+ depend on the number of threads.  States are indexed by grid position so
+ that neighboring vertices are visited together.
+ */
+class WeldResolveBody {
+public:
+    const WeldGrid*     grid;
+    double              radius2;
+    const uint8*        state;
+    uint8*              next;
+
+    /** Decides the vertex at position p from the states of its earlier
+        neighbors, given the buckets around it */
+    inline uint8 resolve(int p, const int b[8], const uint8* s) const {
+        const int* start = grid->bucketStart.getCArray();
+        const int* id = grid->id.getCArray();
+        const int i = id[p];
+
+        bool waiting = false;
+        for (int k = 0; k < 8; ++k) {
+            for (int q = start[b[k]]; q < start[b[k] + 1]; ++q) {
+                if ((id[q] < i) && (s[q] != WELD_MERGED) && ((double)grid->distance2(p, q) <= radius2)) {
+                    if (s[q] == WELD_REPRESENTATIVE) {
+                        return WELD_MERGED;
+                    }
+                    waiting = true;
                 }
             }
         }
+        return waiting ? (uint8)WELD_UNDECIDED : (uint8)WELD_REPRESENTATIVE;
+    }
 
-        Set<List*>::Iterator neighbor(neighbors.begin());
-        Set<List*>::Iterator none(neighbors.end());
-
-        while (neighbor != none) {
-            (*neighbor)->append(newIndex);
-            ++neighbor;
+    void operator()(int begin, int end) const {
+        int h[3] = {NO_CELL, NO_CELL, NO_CELL};
+        int b[8];
+        for (int p = begin; p < end; ++p) {
+            if (state[p] == WELD_UNDECIDED) {
+                grid->neighborBuckets(p, h, b);
+                next[p] = resolve(p, b, state);
+            } else {
+                next[p] = state[p];
+            }
         }
-
-        return newIndex;
     }
-}
-
+};
 
-void Welder::weld() {
-    newVertexArray.resize(0);
 
-    // Prime the vertex positions
-    for (int i = 0; i < oldVertexArray.size(); ++i) {
-        getIndex(oldVertexArray[i]);
-    }
-
-    // Now create the official remapping by snapping to 
-    // nearby vertices.
-    toNew.resize(oldVertexArray.size());
-    toOld.resize(newVertexArray.size());
+/** Maps each merged vertex to the closest representative, preferring the
+    earliest on ties */
+class WeldMapBody {
+public:
+    const WeldGrid*     grid;
+    double              radius2;
+    const uint8*        state;
+    int*                toNew;
+
+    void operator()(int begin, int end) const {
+        const int* start = grid->bucketStart.getCArray();
+        const int* id = grid->id.getCArray();
+        int h[3] = {NO_CELL, NO_CELL, NO_CELL};
+        int b[8];
+
+        for (int p = begin; p < end; ++p) {
+            if (state[p] == WELD_REPRESENTATIVE) {
+                continue;
+            }
+            grid->neighborBuckets(p, h, b);
+
+            int closest = -1;
+            float closestDistance2 = inf();
+            for (int k = 0; k < 8; ++k) {
+                for (int q = start[b[k]]; q < start[b[k] + 1]; ++q) {
+                    if (state[q] == WELD_REPRESENTATIVE) {
+                        const float d2 = grid->distance2(p, q);
+                        if ((d2 < closestDistance2) || ((d2 == closestDistance2) && (id[q] < closest))) {
+                            closestDistance2 = d2;
+                            closest = id[q];
+                        }
+                    }
+                }
+            }
 
-    for (int oi = 0; oi < oldVertexArray.size(); ++oi) {
-        toNew[oi] = getIndex(oldVertexArray[oi]);
-        toOld[toNew[oi]] = oi;
+            debugAssert((closest != -1) && ((double)closestDistance2 <= radius2));
+            toNew[id[p]] = toNew[closest];
+        }
     }
-}
-
-} // internal namespace
+};
 
 
 void MeshAlg::computeWeld(
@@ -205,8 +247,122 @@ void MeshAlg::computeWeld(
     Array<int>&           toOld,
     double                radius) {
 
-    _internal::Welder welder(oldVertexArray, newVertexArray, toNew, toOld, radius);
-    welder.weld();
+    const int n = oldVertexArray.size();
+    const Vector3* vertex = oldVertexArray.getCArray();
+    const double radius2 = radius * radius;
+
+    // Bucket phase: sort the vertices by hashed grid cell
+    WeldGrid grid;
+    grid.invHalfCellSize = (radius > 0) ? (1.0 / radius) : 1.0;
+    grid.bucketBits = 1;
+    while ((grid.bucketBits < 30) && ((1 << grid.bucketBits) < n)) {
+        ++grid.bucketBits;
+    }
+    const int numBuckets = 1 << grid.bucketBits;
+
+    grid.bucketStart.resize(numBuckets + 1);
+    grid.id.resize(n);
+    grid.x.resize(n);
+    grid.y.resize(n);
+    grid.z.resize(n);
+    {
+        Array<uint64> key;
+        Array<int>    value;
+        key.resize(n);
+        value.resize(n);
+
+        WeldKeyBody keyBody;
+        keyBody.grid   = &grid;
+        keyBody.vertex = vertex;
+        keyBody.key    = key.getCArray();
+        keyBody.value  = value.getCArray();
+        ThreadPool::common().parallelFor(0, n, WELD_GRAIN, keyBody);
+
+        RadixSort radix;
+        const uint64* sortedKey;
+        const int*    sortedValue;
+        radix.sort(key, value, grid.bucketBits, sortedKey, sortedValue);
+
+        WeldGatherBody gatherBody;
+        gatherBody.grid   = &grid;
+        gatherBody.vertex = vertex;
+        gatherBody.key    = sortedKey;
+        gatherBody.value  = sortedValue;
+        ThreadPool::common().parallelFor(0, n, WELD_GRAIN, gatherBody);
+
+        for (int b = (n == 0) ? 0 : ((int)sortedKey[n - 1] + 1); b <= numBuckets; ++b) {
+            grid.bucketStart[b] = n;
+        }
+    }
+
+    // Resolve phase: choose the representatives in parallel rounds
+    Array<uint8> state, next;
+    state.resize(n);
+    next.resize(n);
+    System::memset(state.getCArray(), WELD_UNDECIDED, n);
+
+    WeldResolveBody resolveBody;
+    resolveBody.grid    = &grid;
+    resolveBody.radius2 = radius2;
+
+    int undecided = n;
+    for (int round = 0; (round < MAX_WELD_ROUNDS) && (undecided > 0); ++round) {
+        resolveBody.state = state.getCArray();
+        resolveBody.next  = next.getCArray();
+        ThreadPool::common().parallelFor(0, n, WELD_GRAIN, resolveBody);
+
+        System::memcpy(state.getCArray(), next.getCArray(), n);
+        undecided = 0;
+        for (int p = 0; p < n; ++p) {
+            undecided += (state[p] == WELD_UNDECIDED) ? 1 : 0;
+        }
+    }
+
+    if (undecided > 0) {
+        // Long chains of dependent vertices; finish in order, at which
+        // point every earlier vertex is decided
+        Array<int> position;
+        position.resize(n);
+        for (int p = 0; p < n; ++p) {
+            position[grid.id[p]] = p;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            const int p = position[i];
+            if (state[p] == WELD_UNDECIDED) {
+                int h[3] = {NO_CELL, NO_CELL, NO_CELL};
+                int b[8];
+                grid.neighborBuckets(p, h, b);
+                state[p] = resolveBody.resolve(p, b, state.getCArray());
+                debugAssert(state[p] != WELD_UNDECIDED);
+            }
+        }
+    }
+
+    // Number the representatives in order
+    toNew.resize(n);
+    for (int p = 0; p < n; ++p) {
+        toNew[grid.id[p]] = (state[p] == WELD_REPRESENTATIVE) ? 0 : -1;
+    }
+    newVertexArray.fastClear();
+    for (int i = 0; i < n; ++i) {
+        if (toNew[i] != -1) {
+            toNew[i] = newVertexArray.size();
+            newVertexArray.append(vertex[i]);
+        }
+    }
+
+    WeldMapBody mapBody;
+    mapBody.grid    = &grid;
+    mapBody.radius2 = radius2;
+    mapBody.state   = state.getCArray();
+    mapBody.toNew   = toNew.getCArray();
+    ThreadPool::common().parallelFor(0, n, WELD_GRAIN, mapBody);
+
+    toOld.resize(newVertexArray.size());
+    for (int i = 0; i < n; ++i) {
+        toOld[toNew[i]] = i;
+    }
 }
 
 } // G3D namespace
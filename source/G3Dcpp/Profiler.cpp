@@ -0,0 +1,470 @@
+/**
+ @file Profiler.cpp
+
+ @maintainer Morgan McGuire, matrix@graphics3d.com
+
+ @created 2026-10-17
+ @edited  2026-10-17
+ */
+
+#include "G3D/platform.h"
+#include "G3D/Profiler.h"
+#include "G3D/SPSCQueue.h"
+#include "G3D/GThread.h"
+#include "G3D/System.h"
+#include "G3D/TextOutput.h"
+#include "G3D/format.h"
+#include "G3D/stringutils.h"
+#include <string.h>
+
+namespace G3D {
+
+/** Events per thread between calls to Profiler::endFrame */
+#define PROFILER_BUFFER_SIZE 8192
+
+static bool sameName(const char* a, const char* b) {
+    return (a == b) || (strcmp(a, b) == 0);
+}
+
+namespace _internal {
+
+/** Zones recorded by one thread.  The events buffer is written by the
+    thread and read by Profiler::endFrame; everything else belongs to
+    endFrame except openDepth, which belongs to the thread. */
+class ProfilerThread {
+public:
+
+    class Event {
+    public:
+        /** NULL for the end of a zone */
+        const char*     name;
+        uint64          cycles;
+    };
+
+    /** A zone that has begun but not ended */
+    class Open {
+    public:
+        const char*     name;
+
+        /** Node in the current frame's tree */
+        int             node;
+
+        /** Start of the zone or of the current frame, whichever is later */
+        uint64          start;
+
+        /** Actual start, for tracing */
+        uint64          traceStart;
+    };
+
+    SPSCQueue<Event>    events;
+
+    int                 id;
+
+    /** Protected by the registry lock */
+    std::string         name;
+
+    /** Number of zones begun and not ended by the thread */
+    int                 openDepth;
+
+    Array<Open>         stack;
+
+    /** Tree for the current frame; node order is that of first entry */
+    Array<Profiler::Node> node;
+    Array<uint64>       inclusiveCycles;
+    Array<int>          firstChild;
+    Array<int>          lastChild;
+    Array<int>          nextSibling;
+
+    ProfilerThread(int i) : events(PROFILER_BUFFER_SIZE), id(i),
+        name(format("Thread %d", i)), openDepth(0) {}
+
+    /** Returns the child of parent named name, creating it if needed */
+    int findOrAddChild(int parent, const char* name) {
+        int c = (parent == -1) ? ((node.size() > 0) ? 0 : -1) : firstChild[parent];
+        while (c != -1) {
+            if (sameName(node[c].name, name)) {
+                return c;
+            }
+            c = nextSibling[c];
+        }
+
+        c = node.size();
+        Profiler::Node& n = node.next();
+        n.name          = name;
+        n.parent        = parent;
+        n.depth         = (parent == -1) ? 0 : node[parent].depth + 1;
+        n.callCount     = 0;
+        n.inclusiveTime = 0;
+        n.exclusiveTime = 0;
+        inclusiveCycles.append(0);
+        firstChild.append(-1);
+        lastChild.append(-1);
+        nextSibling.append(-1);
+
+        if (parent == -1) {
+            // Roots are chained as siblings of node 0
+            if (c > 0) {
+                int r = 0;
+                while (nextSibling[r] != -1) {
+                    r = nextSibling[r];
+                }
+                nextSibling[r] = c;
+            }
+        } else {
+            if (lastChild[parent] == -1) {
+                firstChild[parent] = c;
+            } else {
+                nextSibling[lastChild[parent]] = c;
+            }
+            lastChild[parent] = c;
+        }
+        return c;
+    }
+
+    /** Starts a new tree containing the zones that are still open */
+    void beginFrame(uint64 now) {
+        node.fastClear();
+        inclusiveCycles.fastClear();
+        firstChild.fastClear();
+        lastChild.fastClear();
+        nextSibling.fastClear();
+
+        int parent = -1;
+        for (int i = 0; i < stack.size(); ++i) {
+            stack[i].node  = findOrAddChild(parent, stack[i].name);
+            stack[i].start = now;
+            parent = stack[i].node;
+        }
+    }
+
+    /** Appends the subtree at n to out in depth-first order */
+    void appendDepthFirst(int n, double secondsPerCycle, Array<Profiler::Node>& out, int parent) const {
+        const int index = out.size();
+        Profiler::Node& dst = out.next();
+        dst = node[n];
+        dst.parent = parent;
+        dst.inclusiveTime = inclusiveCycles[n] * secondsPerCycle;
+
+        uint64 childCycles = 0;
+        for (int c = firstChild[n]; c != -1; c = nextSibling[c]) {
+            childCycles += inclusiveCycles[c];
+            appendDepthFirst(c, secondsPerCycle, out, index);
+        }
+
+        // Clock skew between processors can make the children appear longer
+        out[index].exclusiveTime =
+            (inclusiveCycles[n] > childCycles) ? (inclusiveCycles[n] - childCycles) * secondsPerCycle : 0;
+    }
+};
+
+
+class ProfilerTraceEvent {
+public:
+    const char*     name;
+    int             thread;
+    uint64          start;
+    uint64          end;
+};
+
+} // _internal
+
+using _internal::ProfilerThread;
+
+volatile bool Profiler::m_enabled = false;
+
+/** Protects thread and the thread names */
+static GMutex                   registryLock;
+static Array<ProfilerThread*>   thread;
+
+#ifdef G3D_WIN32
+static DWORD                    currentThreadIndex;
+#else
+static pthread_key_t            currentThreadKey;
+#endif
+static bool                     keyInitialized = false;
+
+/** The rest of the state is used only by endFrame and its callers */
+static Array<Profiler::Tree>    frameTree;
+static bool                     tracing = false;
+static uint64                   traceStartCycles = 0;
+static Array<_internal::ProfilerTraceEvent> trace;
+
+/** Cycle count and time when the profiler was first enabled, for
+    converting cycles to seconds */
+static uint64                   calibrationCycles = 0;
+static RealTime                 calibrationTime = 0;
+
+/** The last ratio that secondsPerCycle measured */
+static double                   lastSecondsPerCycle = 0;
+
+
+static void initKey() {
+    if (! keyInitialized) {
+#       ifdef G3D_WIN32
+            currentThreadIndex = TlsAlloc();
+#       else
+            pthread_key_create(&currentThreadKey, NULL);
+#       endif
+        keyInitialized = true;
+    }
+}
+
+
+static ProfilerThread* currentThread() {
+    ProfilerThread* t = NULL;
+
+    if (keyInitialized) {
+#       ifdef G3D_WIN32
+            t = (ProfilerThread*)TlsGetValue(currentThreadIndex);
+#       else
+            t = (ProfilerThread*)pthread_getspecific(currentThreadKey);
+#       endif
+    }
+
+    if (t == NULL) {
+        // First zone on this thread.  The ProfilerThread is never freed
+        // because endFrame may still be reading it after the thread exits.
+        GMutexLock lock(&registryLock);
+        initKey();
+        t = new ProfilerThread(thread.size());
+        thread.append(t);
+#       ifdef G3D_WIN32
+            TlsSetValue(currentThreadIndex, t);
+#       else
+            pthread_setspecific(currentThreadKey, t);
+#       endif
+    }
+
+    return t;
+}
+
+
+/** Returns the previous ratio (0 at first) when the profiler was enabled
+    too recently for a meaningful one, rather than waiting in endFrame. */
+static double secondsPerCycle() {
+    const RealTime elapsed = System::time() - calibrationTime;
+    if (elapsed >= 0.01) {
+        lastSecondsPerCycle = elapsed / (double)(System::getCycleCount() - calibrationCycles);
+    }
+    return lastSecondsPerCycle;
+}
+
+
+bool Profiler::beginZone(const char* name) {
+    ProfilerThread* t = currentThread();
+
+    // Leave room to end this zone and every open one, so that ends are never dropped
+    if (t->events.capacity() - t->events.size() < t->openDepth + 2) {
+        return false;
+    }
+
+    ProfilerThread::Event e;
+    e.name   = name;
+    e.cycles = System::getCycleCount();
+    t->events.tryPush(e);
+    ++t->openDepth;
+    return true;
+}
+
+
+void Profiler::endZone() {
+    ProfilerThread* t = currentThread();
+
+    ProfilerThread::Event e;
+    e.name   = NULL;
+    e.cycles = System::getCycleCount();
+    bool pushed = t->events.tryPush(e);
+    debugAssert(pushed); (void)pushed;
+    --t->openDepth;
+}
+
+
+void Profiler::setEnabled(bool e) {
+    if (e && (calibrationCycles == 0)) {
+        calibrationTime   = System::time();
+        calibrationCycles = System::getCycleCount();
+    }
+    m_enabled = e;
+}
+
+
+void Profiler::setThreadName(const std::string& name) {
+    ProfilerThread* t = currentThread();
+    GMutexLock lock(&registryLock);
+    t->name = name;
+}
+
+
+void Profiler::endFrame() {
+    registryLock.lock();
+    Array<ProfilerThread*> all = thread;
+    registryLock.unlock();
+
+    const uint64 now = System::getCycleCount();
+    const double spc = (calibrationCycles == 0) ? 0.0 : secondsPerCycle();
+
+    frameTree.fastClear();
+
+    for (int i = 0; i < all.size(); ++i) {
+        ProfilerThread* t = all[i];
+
+        // Replay the events into the tree
+        ProfilerThread::Event e;
+        while (t->events.tryPop(e)) {
+            if (e.name != NULL) {
+                const int parent = (t->stack.size() > 0) ? t->stack.last().node : -1;
+                ProfilerThread::Open& open = t->stack.next();
+                open.name       = e.name;
+                open.node       = t->findOrAddChild(parent, e.name);
+                open.start      = e.cycles;
+                open.traceStart = e.cycles;
+                ++t->node[open.node].callCount;
+            } else {
+                debugAssert(t->stack.size() > 0);
+                const ProfilerThread::Open open = t->stack.pop();
+                if (e.cycles > open.start) {
+                    t->inclusiveCycles[open.node] += e.cycles - open.start;
+                }
+
+                if (tracing && (open.traceStart >= traceStartCycles)) {
+                    _internal::ProfilerTraceEvent& te = trace.next();
+                    te.name   = open.name;
+                    te.thread = t->id;
+                    te.start  = open.traceStart;
+                    te.end    = e.cycles;
+                }
+            }
+        }
+
+        // Charge zones that are still open up to now
+        for (int s = 0; s < t->stack.size(); ++s) {
+            if (now > t->stack[s].start) {
+                t->inclusiveCycles[t->stack[s].node] += now - t->stack[s].start;
+            }
+        }
+
+        if (t->node.size() > 0) {
+            Tree& tree = frameTree.next();
+            registryLock.lock();
+            tree.threadName = t->name;
+            registryLock.unlock();
+            tree.node.fastClear();
+            for (int r = 0; r != -1; r = t->nextSibling[r]) {
+                t->appendDepthFirst(r, spc, tree.node, -1);
+            }
+        }
+
+        t->beginFrame(now);
+    }
+}
+
+
+const Array<Profiler::Tree>& Profiler::previousFrame() {
+    return frameTree;
+}
+
+
+void Profiler::getTopZones(Array<Summary>& out, int maxCount) {
+    out.fastClear();
+
+    for (int t = 0; t < frameTree.size(); ++t) {
+        const Array<Node>& node = frameTree[t].node;
+        for (int n = 0; n < node.size(); ++n) {
+            int s = 0;
+            while ((s < out.size()) && ! sameName(out[s].name, node[n].name)) {
+                ++s;
+            }
+
+            if (s == out.size()) {
+                Summary& summary = out.next();
+                summary.name = node[n].name;
+                summary.callCount = 0;
+                summary.inclusiveTime = 0;
+                summary.exclusiveTime = 0;
+            }
+
+            out[s].callCount     += node[n].callCount;
+            out[s].inclusiveTime += node[n].inclusiveTime;
+            out[s].exclusiveTime += node[n].exclusiveTime;
+        }
+    }
+
+    // Sort by decreasing exclusive time
+    for (int i = 1; i < out.size(); ++i) {
+        Summary s = out[i];
+        int j = i - 1;
+        while ((j >= 0) && (out[j].exclusiveTime < s.exclusiveTime)) {
+            out[j + 1] = out[j];
+            --j;
+        }
+        out[j + 1] = s;
+    }
+
+    if (out.size() > maxCount) {
+        out.resize(maxCount, DONT_SHRINK_UNDERLYING_ARRAY);
+    }
+}
+
+
+/** Escapes s for use inside a JSON string */
+static std::string jsonEscape(const char* s) {
+    std::string result;
+    for (; *s != '\0'; ++s) {
+        const unsigned char c = *s;
+        if ((c == '"') || (c == '\\')) {
+            result += '\\';
+            result += c;
+        } else if (c < 0x20) {
+            result += format("\\u%04x", c);
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+
+void Profiler::beginTrace() {
+    trace.fastClear();
+    traceStartCycles = System::getCycleCount();
+    tracing = true;
+}
+
+
+void Profiler::endTrace(const std::string& filename) {
+    tracing = false;
+    const double spc = (calibrationCycles == 0) ? 0.0 : secondsPerCycle();
+
+    TextOutput::Options options;
+    options.wordWrap = TextOutput::Options::WRAP_NONE;
+    TextOutput t(filename, options);
+
+    t.printf("{\"traceEvents\":[");
+
+    // Each event is preceded by a separator so that there is no trailing comma
+    const char* separator = "\n";
+
+    registryLock.lock();
+    for (int i = 0; i < thread.size(); ++i) {
+        t.printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 separator, thread[i]->id, jsonEscape(thread[i]->name.c_str()).c_str());
+        separator = ",\n";
+    }
+    registryLock.unlock();
+
+    for (int i = 0; i < trace.size(); ++i) {
+        const _internal::ProfilerTraceEvent& e = trace[i];
+        t.printf("%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                 separator, jsonEscape(e.name).c_str(), e.thread,
+                 (e.start - traceStartCycles) * spc * 1e6,
+                 (e.end - e.start) * spc * 1e6);
+        separator = ",\n";
+    }
+
+    t.printf("\n]}\n");
+    t.commit();
+
+    trace.clear();
+}
+
+}
@@ -0,0 +1,289 @@
+/**
+ @file SweepAndPrune.cpp
+
+ @maintainer Morgan McGuire, matrix@graphics3d.com
+
+ @created 2026-10-17
+ @edited  2026-10-17
+ */
+
+#include "G3D/platform.h"
+#include "G3D/SweepAndPrune.h"
+#include "G3D/CoordinateFrame.h"
+#include "G3D/Box.h"
+#include <algorithm>
+
+namespace G3D {
+
+SweepAndPrune::SweepAndPrune() : m_size(0) {
+}
+
+
+int SweepAndPrune::insert(const AABox& bounds) {
+    int b;
+    if (freeBody.size() > 0) {
+        b = freeBody.pop();
+    } else {
+        b = body.size();
+        body.next();
+    }
+
+    Body& B = body[b];
+    B.bounds = bounds;
+    B.alive  = true;
+
+    inserted.append(b);
+    ++m_size;
+    return b;
+}
+
+
+int SweepAndPrune::insert(const AABox& objectBounds, const PhysicsFrame& frame) {
+    const int b = insert(objectBounds);
+    setBounds(b, objectBounds, frame);
+    return b;
+}
+
+
+void SweepAndPrune::remove(int b) {
+    debugAssert(b >= 0 && b < body.size() && body[b].alive);
+    body[b].alive = false;
+    removed.append(b);
+    --m_size;
+}
+
+
+void SweepAndPrune::setBounds(int b, const AABox& objectBounds, const PhysicsFrame& frame) {
+    AABox bounds;
+    frame.toCoordinateFrame().toWorldSpace(objectBounds).getBounds(bounds);
+    setBounds(b, bounds);
+}
+
+
+void SweepAndPrune::addPair(int a, int b) {
+    const uint64 k = key(a, b);
+    if (pairIndex.containsKey(k)) {
+        return;
+    }
+    pairIndex.set(k, m_pairs.size());
+    m_pairs.append(Pair(a, b));
+    m_added.append(Pair(a, b));
+}
+
+
+void SweepAndPrune::removePair(int a, int b) {
+    int i;
+    if (pairIndex.get(key(a, b), i)) {
+        m_removed.append(m_pairs[i]);
+        removePairAt(i);
+    }
+}
+
+
+void SweepAndPrune::removePairAt(int i) {
+    pairIndex.remove(key(m_pairs[i].a, m_pairs[i].b));
+    const int last = m_pairs.size() - 1;
+    if (i < last) {
+        m_pairs[i] = m_pairs[last];
+        pairIndex.set(key(m_pairs[i].a, m_pairs[i].b), i);
+    }
+    m_pairs.pop();
+}
+
+
+void SweepAndPrune::processRemovals() {
+    if (removed.size() == 0) {
+        return;
+    }
+
+    for (int i = 0; i < m_pairs.size(); ) {
+        const Pair& p = m_pairs[i];
+        if (! body[p.a].alive || ! body[p.b].alive) {
+            m_removed.append(p);
+            // Moves the last pair to i
+            removePairAt(i);
+        } else {
+            ++i;
+        }
+    }
+
+    for (int a = 0; a < 3; ++a) {
+        Array<Endpoint>& E = endpoint[a];
+        int n = 0;
+        for (int i = 0; i < E.size(); ++i) {
+            if (body[E[i].body()].alive) {
+                E[n] = E[i];
+                ++n;
+            }
+        }
+        E.resize(n, DONT_SHRINK_UNDERLYING_ARRAY);
+    }
+
+    int n = 0;
+    for (int i = 0; i < inserted.size(); ++i) {
+        if (body[inserted[i]].alive) {
+            inserted[n] = inserted[i];
+            ++n;
+        }
+    }
+    inserted.resize(n, DONT_SHRINK_UNDERLYING_ARRAY);
+
+    for (int i = 0; i < removed.size(); ++i) {
+        freeBody.append(removed[i]);
+    }
+    removed.fastClear();
+}
+
+
+void SweepAndPrune::refreshEndpoints() {
+    const Body* B = body.getCArray();
+    for (int a = 0; a < 3; ++a) {
+        Endpoint* E = endpoint[a].getCArray();
+        const int n = endpoint[a].size();
+        for (int i = 0; i < n; ++i) {
+            const AABox& bounds = B[E[i].body()].bounds;
+            E[i].value = E[i].isHigh() ? bounds.high()[a] : bounds.low()[a];
+        }
+    }
+}
+
+
+void SweepAndPrune::appendEndpoints(int b) {
+    const AABox& bounds = body[b].bounds;
+    for (int a = 0; a < 3; ++a) {
+        Endpoint& low = endpoint[a].next();
+        low.value = bounds.low()[a];
+        low.data  = (uint32)b << 1;
+
+        Endpoint& high = endpoint[a].next();
+        high.value = bounds.high()[a];
+        high.data  = ((uint32)b << 1) | 1;
+    }
+}
+
+
+void SweepAndPrune::sortAxis(int axis) {
+    Endpoint* E = endpoint[axis].getCArray();
+    const int n = endpoint[axis].size();
+
+    for (int i = 1; i < n; ++i) {
+        const Endpoint e = E[i];
+        int j = i;
+        while ((j > 0) && (e < E[j - 1])) {
+            const Endpoint& other = E[j - 1];
+
+            // Each pair of ends passes at most once during an insertion sort,
+            // and the bounds are already final, so the test is final as well.
+            if (! e.isHigh() && other.isHigh()) {
+                // A low end moved below a high end: the bodies may overlap now
+                if (overlaps(e.body(), other.body())) {
+                    addPair(e.body(), other.body());
+                }
+            } else if (e.isHigh() && ! other.isHigh()) {
+                // A high end moved below a low end: separated on this axis
+                removePair(e.body(), other.body());
+            }
+
+            E[j] = other;
+            --j;
+        }
+        E[j] = e;
+    }
+}
+
+
+void SweepAndPrune::rebuild() {
+    for (int a = 0; a < 3; ++a) {
+        std::sort(endpoint[a].getCArray(), endpoint[a].getCArray() + endpoint[a].size());
+    }
+
+    // Whether each existing pair was found again
+    Array<bool> found;
+    found.resize(m_pairs.size());
+    for (int i = 0; i < found.size(); ++i) {
+        found[i] = false;
+    }
+
+    // Bodies whose x intervals contain the current position, and the index
+    // of each in active
+    Array<int> active;
+    Array<int> activeIndex;
+    activeIndex.resize(body.size());
+
+    const Array<Endpoint>& E = endpoint[0];
+    for (int i = 0; i < E.size(); ++i) {
+        const int b = E[i].body();
+        if (E[i].isHigh()) {
+            const int last = active.last();
+            active[activeIndex[b]] = last;
+            activeIndex[last] = activeIndex[b];
+            active.pop();
+        } else {
+            for (int j = 0; j < active.size(); ++j) {
+                const int other = active[j];
+                if (overlaps(b, other)) {
+                    int p;
+                    if (pairIndex.get(key(b, other), p)) {
+                        found[p] = true;
+                    } else {
+                        addPair(b, other);
+                        found.append(true);
+                    }
+                }
+            }
+            activeIndex[b] = active.size();
+            active.append(b);
+        }
+    }
+
+    // Working backwards, the pair that removePairAt moves down was already checked
+    for (int i = m_pairs.size() - 1; i >= 0; --i) {
+        if (! found[i]) {
+            m_removed.append(m_pairs[i]);
+            removePairAt(i);
+            found[i] = found.last();
+            found.pop();
+        }
+    }
+}
+
+
+void SweepAndPrune::step() {
+    m_added.fastClear();
+    m_removed.fastClear();
+
+    processRemovals();
+    refreshEndpoints();
+
+    const bool incremental = (inserted.size() <= MAX_INCREMENTAL_INSERTS);
+    for (int i = 0; i < inserted.size(); ++i) {
+        appendEndpoints(inserted[i]);
+    }
+    inserted.fastClear();
+
+    if (incremental) {
+        for (int a = 0; a < 3; ++a) {
+            sortAxis(a);
+        }
+    } else {
+        rebuild();
+    }
+}
+
+
+void SweepAndPrune::clear() {
+    body.clear();
+    freeBody.clear();
+    inserted.clear();
+    removed.clear();
+    for (int a = 0; a < 3; ++a) {
+        endpoint[a].clear();
+    }
+    m_pairs.clear();
+    m_added.clear();
+    m_removed.clear();
+    pairIndex.clear();
+    m_size = 0;
+}
+
+}
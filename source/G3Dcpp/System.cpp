@@ -26,6 +26,9 @@
 #include "G3D/TextOutput.h"
 #include "G3D/G3DGameUnits.h"
 #include "G3D/Crypto.h"
+#include "G3D/GThread.h"
+#include "G3D/AtomicInt32.h"
+#include <new>
 
 #ifdef G3D_WIN32
 
@@ -1051,326 +1054,563 @@ RealTime System::time() {
 
 ////////////////////////////////////////////////////////////////
 
-#define REALPTR_TO_USERPTR(x)   ((uint8*)(x) + sizeof (void *))
-#define USERPTR_TO_REALPTR(x)   ((uint8*)(x) - sizeof (void *))
-#define REALBLOCK_SIZE(x)       ((x) + sizeof (void *))
+/*
+  System::malloc is a thread-caching allocator.
 
-class BufferPool {
+  Requests up to MemoryPool::maxPooledSize bytes are rounded up to one
+  of a small number of size classes.  Every thread owns a ThreadCache
+  holding a free list per size class, so the common malloc and free
+  paths touch only thread-local data and take no locks.
+
+  A block freed by a thread other than the one that allocated it is
+  pushed onto the owner's lock-free "remote" stack.  The owner drains
+  that stack into its own free lists the next time one of them runs
+  dry.  Only the owner ever pops from the remote stack, and it always
+  takes the whole stack at once, so the stack is immune to ABA.
+
+  When a thread's free list is empty it refills a batch of blocks at
+  once from the CentralHeap, which carves new blocks out of large
+  slabs.  When a thread's free list grows too long it returns a batch
+  to the CentralHeap.  The central free lists are the only place that
+  locks and each size class has its own mutex.
+
+  Larger requests go straight to ::malloc.
+
+  Every block is preceded by a BlockHeader recording its owner and
+  size.
+ */
+
+namespace _internal {
+
+class ThreadCache;
+
+/** Atomic pointer compare-and-set: if <code>*p == comperand</code> then
+    <code>*p := exchange</code>.  Returns true if the exchange happened. */
+static inline bool compareAndSetPointer(void* volatile* p, void* comperand, void* exchange) {
+#   if defined(G3D_WIN32)
+        return InterlockedCompareExchangePointer((PVOID volatile*)p, exchange, comperand) == comperand;
+#   elif defined(G3D_OSX)
+        return OSAtomicCompareAndSwapPtrBarrier(comperand, exchange, p);
+#   else
+        void* old;
+        asm volatile ("lock; cmpxchg %2, %1"
+                      : "=a" (old), "+m" (*p)
+                      : "r" (exchange), "0" (comperand)
+                      : "memory", "cc");
+        return old == comperand;
+#   endif
+}
+
+
+class BlockHeader {
 public:
+    /** Cache that handed out this block, or NULL if the block
+        came directly from the heap.*/
+    ThreadCache*    owner;
+
+    /** Size class for pooled blocks, size in bytes for heap blocks. */
+    size_t          info;
+};
+
+#define USERPTR_TO_HEADER(x)    ((BlockHeader*)((uint8*)(x) - sizeof(BlockHeader)))
+#define HEADER_TO_USERPTR(x)    ((void*)((uint8*)(x) + sizeof(BlockHeader)))
+
+/** Free blocks are chained through their first word. */
+#define NEXT_BLOCK(x)           (*(void**)(x))
+
+
+class MemoryPool {
+public:
+    /** Largest request served from the size classes. */
+    enum {maxPooledSize = 4096};
+
+    enum {numSizeClasses = 16};
+
+    /** Bytes (excluding the header) available in each class. */
+    static const size_t classSize[numSizeClasses];
+
+    /** Size class for every multiple of 16 bytes up to maxPooledSize,
+        indexed by (bytes + 15) / 16. */
+    static uint8 classOfSize[maxPooledSize / 16 + 1];
+
+    /** Number of blocks moved between a ThreadCache and the
+        CentralHeap at once. */
+    static int batchSize[numSizeClasses];
+
+    static void init() {
+        int c = 0;
+        for (int i = 0; i <= maxPooledSize / 16; ++i) {
+            while (classSize[c] < (size_t)i * 16) {
+                ++c;
+            }
+            classOfSize[i] = c;
+        }
 
-    /** Only store buffers up to these sizes (in bytes) in each pool->
-        Different pools have different management strategies.
+        for (c = 0; c < numSizeClasses; ++c) {
+            // Move about 16k at a time
+            batchSize[c] = iClamp(16384 / (int)(classSize[c] + sizeof(BlockHeader)), 4, 64);
+        }
+    }
 
-        A large block is preallocated for tiny buffers; they are used with
-        tremendous frequency.  Other buffers are allocated as demanded.
-      */
-    enum {tinyBufferSize = 128, smallBufferSize = 1024, medBufferSize = 4096};
+    static inline int sizeClass(size_t bytes) {
+        debugAssert(bytes <= maxPooledSize);
+        return classOfSize[(bytes + 15) >> 4];
+    }
+};
+
+const size_t MemoryPool::classSize[MemoryPool::numSizeClasses] = 
+    {16, 32, 48, 64, 80, 96, 112, 128, 192, 256, 384, 512, 768, 1024, 2048, 4096};
+uint8 MemoryPool::classOfSize[MemoryPool::maxPooledSize / 16 + 1];
+int MemoryPool::batchSize[MemoryPool::numSizeClasses];
 
-    /** 
-       Most buffers we're allowed to store.
-       64000 * 128  = 8 MB (preallocated)
-        1024 * 1024 = 1 MB (allocated on demand)
-        1024 * 4096 = 4 MB (allocated on demand)
-     */
-    enum {maxTinyBuffers = 64000, maxSmallBuffers = 1024, maxMedBuffers = 1024};
 
+/** Shared free lists that refill the ThreadCaches. */
+class CentralHeap {
 private:
 
-    class MemBlock {
+    class FreeList {
     public:
-        void*           ptr;
-        size_t          bytes;
+        GMutex          mutex;
+        void*           head;
+        int             count;
 
-        inline MemBlock() : ptr(NULL), bytes(0) {}
-        inline MemBlock(void* p, size_t b) : ptr(p), bytes(b) {}
+        FreeList() : head(NULL), count(0) {}
     };
 
-    MemBlock smallPool[maxSmallBuffers];
-    int smallPoolSize;
+    FreeList            freeList[MemoryPool::numSizeClasses];
 
-    MemBlock medPool[maxMedBuffers];
-    int medPoolSize;
+    /** Size of the slabs from which blocks are carved.  Slabs are never
+        returned to the operating system. */
+    enum {slabSize = 64 * 1024};
 
-    /** The tiny pool is a single block of storage into which all tiny
-        objects are allocated.  This provides better locality for
-        small objects and avoids the search time, since all tiny
-        blocks are exactly the same size. */
-    void* tinyPool[maxTinyBuffers];
-    int tinyPoolSize;
+public:
 
-    /** Pointer to the data in the tiny pool */
-    void* tinyHeap;
+    /** Total bytes in slabs.  Only modified while a free list is locked,
+        so this is approximate when read without a lock.*/
+    AtomicInt32         slabBytes;
 
-#   ifdef G3D_WIN32
-    CRITICAL_SECTION    mutex;
-#   else
-    pthread_mutex_t     mutex;
-#   endif
+    CentralHeap() : slabBytes(0) {}
 
-    /** Provide synchronization between threads */
-    void lock() {
-#       ifdef G3D_WIN32
-            EnterCriticalSection(&mutex);
-#       else
-            pthread_mutex_lock(&mutex);
-#       endif
+    /** Locks the free list for class c, counting the lock as contended
+        if another thread held it. */
+    inline void lock(int c, int& contention) {
+        if (! freeList[c].mutex.tryLock()) {
+            ++contention;
+            freeList[c].mutex.lock();
+        }
     }
 
-    void unlock() {
-#       ifdef G3D_WIN32
-            LeaveCriticalSection(&mutex);
-#       else
-            pthread_mutex_unlock(&mutex);
-#       endif
+    inline void unlock(int c) {
+        freeList[c].mutex.unlock();
     }
 
-    /** 
-     Malloc out of the tiny heap.
-     */
-    inline void* tinyMalloc(size_t bytes) {
-        // Note that we ignore the actual byte size
-        // and create a constant size block.
-        (void)bytes;
-        debugAssert(tinyBufferSize >= bytes);
-
-        void* ptr = NULL;
-
-        if (tinyPoolSize > 0) {
-            --tinyPoolSize;
-            // Return the last one
-            ptr = tinyPool[tinyPoolSize];
+    /** Removes up to n blocks of class c and returns them as a chain.
+        Allocates a new slab if the free list is empty.  Returns the 
+        number of blocks in count (0 if out of memory).*/
+    void* removeBatch(int c, int n, int& count, int& contention) {
+        lock(c, contention);
+
+        FreeList& list = freeList[c];
+        if (list.count == 0) {
+            carveSlab(c);
         }
 
-        return ptr;
+        void* head = list.head;
+        void* tail = head;
+        count = 0;
+        if (head != NULL) {
+            count = 1;
+            while ((count < n) && (NEXT_BLOCK(tail) != NULL)) {
+                tail = NEXT_BLOCK(tail);
+                ++count;
+            }
+            list.head = NEXT_BLOCK(tail);
+            NEXT_BLOCK(tail) = NULL;
+            list.count -= count;
+        }
+
+        unlock(c);
+        return head;
     }
 
-    /** Returns true if this is a pointer into the tiny heap. */
-    bool inTinyHeap(void* ptr) {
-        return (ptr >= tinyHeap) && 
-               (ptr < (uint8*)tinyHeap + maxTinyBuffers * tinyBufferSize);
+    /** Returns a chain of n blocks of class c.*/
+    void insertBatch(int c, void* head, void* tail, int n, int& contention) {
+        lock(c, contention);
+        FreeList& list = freeList[c];
+        NEXT_BLOCK(tail) = list.head;
+        list.head = head;
+        list.count += n;
+        unlock(c);
     }
 
-    void tinyFree(void* ptr) {
-        debugAssert(tinyPoolSize < maxTinyBuffers);
+    /** Number of free blocks in class c (unsynchronized). */
+    int freeCount(int c) const {
+        return freeList[c].count;
+    }
 
-        // Put the pointer back into the free list
-        tinyPool[tinyPoolSize] = ptr;
-        ++tinyPoolSize;
+private:
 
-    }
+    /** Called with freeList[c] locked. */
+    void carveSlab(int c) {
+        const size_t blockBytes = MemoryPool::classSize[c] + sizeof(BlockHeader);
+        const size_t bytes = iMax(slabSize, (int)blockBytes * MemoryPool::batchSize[c]);
 
-    void flushPool(MemBlock* pool, int& poolSize) {
-        for (int i = 0; i < poolSize; ++i) {
-            ::free(pool->ptr);
-            pool->ptr = NULL;
-            pool->bytes = 0;
+        uint8* slab = (uint8*)::malloc(bytes);
+        if (slab == NULL) {
+            return;
+        }
+        slabBytes.add((int32)bytes);
+
+        FreeList& list = freeList[c];
+        const int n = (int)(bytes / blockBytes);
+        for (int i = n - 1; i >= 0; --i) {
+            void* block = HEADER_TO_USERPTR(slab + i * blockBytes);
+            NEXT_BLOCK(block) = list.head;
+            list.head = block;
         }
-        poolSize = 0;
+        list.count += n;
     }
+};
 
 
-    /**  Allocate out of a specific pool->  Return NULL if no suitable 
-         memory was found. 
-    
-         */
-    void* malloc(MemBlock* pool, int& poolSize, size_t bytes) {
+/** Per-thread free lists.  All fields except remoteHead are only read
+    and written by the owning thread (the statistics are read without
+    synchronization by System::mallocPerformance). */
+class ThreadCache {
+public:
 
-        // OPT: find the smallest block that satisfies the request.
+    class FreeList {
+    public:
+        void*           head;
+        int             count;
+    };
 
-        // See if there's something we can use in the buffer pool->
-        // Search backwards since usually we'll re-use the last one.
-        for (int i = (int)poolSize - 1; i >= 0; --i) {
-            if (pool[i].bytes >= bytes) {
-                // We found a suitable entry in the pool->
+    FreeList            freeList[MemoryPool::numSizeClasses];
 
-                // No need to offset the pointer; it is already offset
-                void* ptr = pool[i].ptr;
+    /** Registry of all ThreadCaches ever created. */
+    ThreadCache*        nextCache;
 
-                // Remove this element from the pool
-                --poolSize;
-                pool[i] = pool[poolSize];
+    /** Sequential index used for reporting. */
+    int                 index;
 
-                return ptr;
-            }
-        }
+    /** True while a thread is using this cache. */
+    bool                active;
 
-        return NULL;
-    }
+    /** Number of System::malloc calls */
+    int                 mallocs;
 
-public:
+    /** Mallocs served from freeList without draining or refilling */
+    int                 hits;
+
+    /** Mallocs served after draining the remote stack */
+    int                 remoteHits;
+
+    /** Batches fetched from the CentralHeap */
+    int                 refills;
+
+    /** Mallocs larger than MemoryPool::maxPooledSize */
+    int                 heapMallocs;
 
-    /** Count of memory allocations that have occurred. */
-    int totalMallocs;
-    int mallocsFromTinyPool;
-    int mallocsFromSmallPool;
-    int mallocsFromMedPool;
+    /** Blocks this thread freed that belong to another thread */
+    int                 remoteFreesOut;
 
-    /** Amount of memory currently allocated (according to the application). 
-        This does not count the memory still remaining in the buffer pool,
-        but does count extra memory required for rounding off to the size
-        of a buffer.
-        Primarily useful for detecting leaks.*/
-    // TODO: make me an atomic int!
-    int bytesAllocated;
+    /** Blocks other threads freed back to this thread */
+    int                 remoteFreesIn;
 
-    BufferPool() {
-        totalMallocs         = 0;
+    /** Number of times a CentralHeap lock was already held */
+    int                 centralContention;
 
-        mallocsFromTinyPool  = 0;
-        mallocsFromSmallPool = 0;
-        mallocsFromMedPool   = 0;
+    /** Number of failed compare-and-sets pushing onto remote stacks */
+    int                 remoteContention;
 
-        bytesAllocated       = true;
+private:
+
+    /** Keep the remote stack on its own cache line so that remote frees
+        do not invalidate the owner's free lists. */
+    uint8               pad0[64];
 
-        tinyPoolSize         = 0;
-        tinyHeap             = NULL;
+public:
 
-        smallPoolSize        = 0;
+    /** Lock-free stack of blocks freed by other threads. */
+    void* volatile      remoteHead;
 
-        medPoolSize          = 0;
+private:
 
+    uint8               pad1[64];
 
-        // Initialize the tiny heap as a bunch of pointers into one
-        // pre-allocated buffer.
-        tinyHeap = ::malloc(maxTinyBuffers * tinyBufferSize);
-        for (int i = 0; i < maxTinyBuffers; ++i) {
-            tinyPool[i] = (uint8*)tinyHeap + (tinyBufferSize * i);
+public:
+
+    ThreadCache(int i) : nextCache(NULL), index(i), active(true), remoteHead(NULL) {
+        for (int c = 0; c < MemoryPool::numSizeClasses; ++c) {
+            freeList[c].head  = NULL;
+            freeList[c].count = 0;
         }
-        tinyPoolSize = maxTinyBuffers;
+        resetCounters();
+    }
 
-#       ifdef G3D_WIN32
-            InitializeCriticalSection(&mutex);
-#       else
-            pthread_mutex_init(&mutex, NULL);
-#       endif
+    void resetCounters() {
+        mallocs             = 0;
+        hits                = 0;
+        remoteHits          = 0;
+        refills             = 0;
+        heapMallocs         = 0;
+        remoteFreesOut      = 0;
+        remoteFreesIn       = 0;
+        centralContention   = 0;
+        remoteContention    = 0;
     }
 
+    inline void push(int c, void* block) {
+        NEXT_BLOCK(block) = freeList[c].head;
+        freeList[c].head = block;
+        ++freeList[c].count;
+    }
 
-    ~BufferPool() {
-        ::free(tinyHeap);
-#       ifdef G3D_WIN32
-            DeleteCriticalSection(&mutex);
-#       else
-            // No destruction on pthreads
-#       endif
+    inline void* pop(int c) {
+        void* block = freeList[c].head;
+        freeList[c].head = NEXT_BLOCK(block);
+        --freeList[c].count;
+        return block;
     }
 
-    
-    void* realloc(void* ptr, size_t bytes) {
-        if (ptr == NULL) {
-            return malloc(bytes);
+    /** Called from any thread other than the owner. */
+    void pushRemote(void* block, int& contention) {
+        void* old;
+        do {
+            old = remoteHead;
+            NEXT_BLOCK(block) = old;
+            if (compareAndSetPointer(&remoteHead, old, block)) {
+                return;
+            }
+            ++contention;
+        } while (true);
+    }
+
+    /** Moves everything on the remote stack into the free lists.
+        Returns false if the stack was empty.*/
+    bool drainRemote() {
+        if (remoteHead == NULL) {
+            return false;
         }
 
-        if (inTinyHeap(ptr)) {
-            if (bytes <= tinyBufferSize) {
-                // The old pointer actually had enough space.
-                return ptr;
-            } else {
-                // Free the old pointer and malloc
-                
-                void* newPtr = malloc(bytes);
-                System::memcpy(newPtr, ptr, tinyBufferSize);
-                tinyFree(ptr);
-                return newPtr;
+        void* block;
+        do {
+            block = remoteHead;
+        } while (! compareAndSetPointer(&remoteHead, block, NULL));
 
-            }
-        } else {
-            // In one of our heaps.
+        while (block != NULL) {
+            void* next = NEXT_BLOCK(block);
+            push((int)USERPTR_TO_HEADER(block)->info, block);
+            ++remoteFreesIn;
+            block = next;
+        }
+        return true;
+    }
 
-            // See how big the block really was
-            size_t realSize = *(uint32*)USERPTR_TO_REALPTR(ptr);
-            if (bytes <= realSize) {
-                // The old block was big enough.
-                return ptr;
-            }
+    /** Moves one batch of class c to the central heap. */
+    void releaseBatch(CentralHeap* central, int c) {
+        const int n = MemoryPool::batchSize[c];
+        void* head = freeList[c].head;
+        void* tail = head;
+        for (int i = 1; i < n; ++i) {
+            tail = NEXT_BLOCK(tail);
+        }
+        freeList[c].head = NEXT_BLOCK(tail);
+        freeList[c].count -= n;
+        central->insertBatch(c, head, tail, n, centralContention);
+    }
 
-            // Need to reallocate
-            void* newPtr = malloc(bytes);
-            System::memcpy(newPtr, ptr, realSize);
-            free(ptr);
-            return newPtr;
+    /** Returns every cached block to the central heap.*/
+    void releaseAll(CentralHeap* central) {
+        drainRemote();
+        for (int c = 0; c < MemoryPool::numSizeClasses; ++c) {
+            if (freeList[c].count > 0) {
+                void* tail = freeList[c].head;
+                while (NEXT_BLOCK(tail) != NULL) {
+                    tail = NEXT_BLOCK(tail);
+                }
+                central->insertBatch(c, freeList[c].head, tail, freeList[c].count, centralContention);
+                freeList[c].head = NULL;
+                freeList[c].count = 0;
+            }
         }
     }
+};
 
 
-    void* malloc(size_t bytes) {
-        lock();
-        ++totalMallocs;
+class ThreadCachingAllocator {
+private:
 
-        if (bytes <= tinyBufferSize) {
+    CentralHeap         central;
 
-            void* ptr = tinyMalloc(bytes);
+    /** Protects the cache registry */
+    GMutex              registryMutex;
 
-            if (ptr) {
-                ++mallocsFromTinyPool;
-                unlock();
-                return ptr;
-            }
+    ThreadCache*        firstCache;
 
-        } 
-        
-        // Failure to allocate a tiny buffer is allowed to flow
-        // through to a small buffer
-        if (bytes <= smallBufferSize) {
-            
-            void* ptr = malloc(smallPool, smallPoolSize, bytes);
+    int                 numCaches;
 
-            if (ptr) {
-                ++mallocsFromSmallPool;
-                unlock();
-                return ptr;
-            }
+#   ifdef G3D_WIN32
+    DWORD               tlsIndex;
 
-        } else  if (bytes <= medBufferSize) {
-            // Note that a small allocation failure does *not* fall
-            // through into a medium allocation because that would
-            // waste the medium buffer's resources.
+    /** FlsSetValue from kernel32, or NULL before Windows Server 2003 */
+    typedef BOOL (WINAPI *FlsSetValueFunction)(DWORD, void*);
+    FlsSetValueFunction flsSetValue;
 
-            void* ptr = malloc(medPool, medPoolSize, bytes);
+    /** Fiber local storage slot that holds the same pointer as tlsIndex, so
+        that Windows calls flsExit when a thread that has a cache exits. */
+    DWORD               flsIndex;
 
-            if (ptr) {
-                ++mallocsFromMedPool;
-                unlock();
-                return ptr;
-            }
+    static void WINAPI flsExit(void* cache);
+#   else
+    pthread_key_t       tlsKey;
+#   endif
+
+    /** Called by pthreads when a thread that has a cache exits. */
+    static void threadExit(void* cache);
+
+    /** Returns the calling thread's cache, creating one if needed. */
+    inline ThreadCache* currentCache() {
+#       ifdef G3D_WIN32
+            ThreadCache* cache = (ThreadCache*)TlsGetValue(tlsIndex);
+#       else
+            ThreadCache* cache = (ThreadCache*)pthread_getspecific(tlsKey);
+#       endif
+        if (cache == NULL) {
+            cache = createCache();
+        }
+        return cache;
+    }
+
+    /** Reuses a cache abandoned by an exited thread, or creates a new one. */
+    ThreadCache* createCache() {
+        registryMutex.lock();
+        ThreadCache* cache = firstCache;
+        while ((cache != NULL) && cache->active) {
+            cache = cache->nextCache;
         }
 
-        bytesAllocated += REALBLOCK_SIZE(bytes);
-        unlock();
+        if (cache == NULL) {
+            // Allocate directly from the system; ThreadCaches are never freed
+            void* mem = ::malloc(sizeof(ThreadCache));
+            cache = new (mem) ThreadCache(numCaches);
+            ++numCaches;
+            cache->nextCache = firstCache;
+            firstCache = cache;
+        } else {
+            cache->active = true;
+        }
+        registryMutex.unlock();
 
-        // Heap allocate
+#       ifdef G3D_WIN32
+            TlsSetValue(tlsIndex, cache);
+            if (flsSetValue != NULL) {
+                flsSetValue(flsIndex, cache);
+            }
+#       else
+            pthread_setspecific(tlsKey, cache);
+#       endif
+        return cache;
+    }
 
-        // Allocate 4 extra bytes for our size header (unfortunate,
-        // since malloc already added its own header).
-        void* ptr = ::malloc(REALBLOCK_SIZE(bytes));
+    /** Slow path of malloc for pooled sizes. */
+    void* refill(ThreadCache* cache, int c) {
+        if (cache->drainRemote() && (cache->freeList[c].head != NULL)) {
+            ++cache->remoteHits;
+            return cache->pop(c);
+        }
 
-        if (ptr == NULL) {
-            // Flush memory pools to try and recover space
-            flushPool(smallPool, smallPoolSize);
-            flushPool(medPool, medPoolSize);
-            ptr = ::malloc(REALBLOCK_SIZE(bytes + 4));
+        int n = 0;
+        void* head = central.removeBatch(c, MemoryPool::batchSize[c], n, cache->centralContention);
+        if (n == 0) {
+            return NULL;
         }
+        ++cache->refills;
+
+        cache->freeList[c].head = head;
+        cache->freeList[c].count += n;
+        return cache->pop(c);
+    }
 
+    void* heapMalloc(size_t bytes) {
+        const size_t realBytes = bytes + sizeof(BlockHeader);
+        void* ptr = ::malloc(realBytes);
 
         if (ptr == NULL) {
             if ((System::outOfMemoryCallback != NULL) &&
-                (System::outOfMemoryCallback(REALBLOCK_SIZE(bytes), true) == true)) {
+                (System::outOfMemoryCallback(realBytes, true) == true)) {
                 // Re-attempt the malloc
-                ptr = ::malloc(REALBLOCK_SIZE(bytes));
+                ptr = ::malloc(realBytes);
             }
         }
 
         if (ptr == NULL) {
             if (System::outOfMemoryCallback != NULL) {
                 // Notify the application
-                System::outOfMemoryCallback(REALBLOCK_SIZE(bytes), false);
+                System::outOfMemoryCallback(realBytes, false);
             }
             return NULL;
         }
 
-        *(uint32*)ptr = bytes;
+        BlockHeader* header = (BlockHeader*)ptr;
+        header->owner = NULL;
+        header->info  = bytes;
+        return HEADER_TO_USERPTR(header);
+    }
+
+public:
+
+    ThreadCachingAllocator() : firstCache(NULL), numCaches(0) {
+        MemoryPool::init();
+#       ifdef G3D_WIN32
+            tlsIndex = TlsAlloc();
+
+            // Fiber local storage is the only thread exit callback that a
+            // static library gets on Windows.  Look it up at runtime so that
+            // older systems and headers still work.
+            typedef DWORD (WINAPI *FlsAllocFunction)(void (WINAPI *)(void*));
+            HMODULE kernel = GetModuleHandleA("kernel32.dll");
+            FlsAllocFunction flsAlloc = (FlsAllocFunction)GetProcAddress(kernel, "FlsAlloc");
+            flsSetValue = (FlsSetValueFunction)GetProcAddress(kernel, "FlsSetValue");
+            flsIndex = TLS_OUT_OF_INDEXES;
+            if ((flsAlloc != NULL) && (flsSetValue != NULL)) {
+                flsIndex = flsAlloc(&ThreadCachingAllocator::flsExit);
+            }
+            if (flsIndex == TLS_OUT_OF_INDEXES) {
+                flsSetValue = NULL;
+            }
+#       else
+            pthread_key_create(&tlsKey, &ThreadCachingAllocator::threadExit);
+#       endif
+    }
+
+    void* malloc(size_t bytes) {
+        ThreadCache* cache = currentCache();
+        ++cache->mallocs;
+
+        if (bytes > MemoryPool::maxPooledSize) {
+            ++cache->heapMallocs;
+            return heapMalloc(bytes);
+        }
+
+        const int c = MemoryPool::sizeClass(bytes);
+        void* block;
+        if (cache->freeList[c].head != NULL) {
+            ++cache->hits;
+            block = cache->pop(c);
+        } else {
+            block = refill(cache, c);
+            if (block == NULL) {
+                // The central heap is out of memory
+                ++cache->heapMallocs;
+                return heapMalloc(bytes);
+            }
+        }
 
-        return REALPTR_TO_USERPTR(ptr);
+        BlockHeader* header = USERPTR_TO_HEADER(block);
+        header->owner = cache;
+        header->info  = c;
+        return block;
     }
 
 
@@ -1382,71 +1622,172 @@ public:
 
         debugAssert(isValidPointer(ptr));
 
-        if (inTinyHeap(ptr)) {
-            lock();
-            tinyFree(ptr);
-            unlock();
+        BlockHeader* header = USERPTR_TO_HEADER(ptr);
+        ThreadCache* owner = header->owner;
+
+        if (owner == NULL) {
+            ::free(header);
             return;
         }
 
-        uint32 bytes = *(uint32*)USERPTR_TO_REALPTR(ptr);
-
-        lock();
-        if (bytes <= smallBufferSize) {
-            if (smallPoolSize < maxSmallBuffers) {
-                smallPool[smallPoolSize] = MemBlock(ptr, bytes);
-                ++smallPoolSize;
-                unlock();
-                return;
-            }
-        } else if (bytes <= medBufferSize) {
-            if (medPoolSize < maxMedBuffers) {
-                medPool[medPoolSize] = MemBlock(ptr, bytes);
-                ++medPoolSize;
-                unlock();
-                return;
+        ThreadCache* cache = currentCache();
+        if (owner == cache) {
+            const int c = (int)header->info;
+            cache->push(c, ptr);
+            if (cache->freeList[c].count > 2 * MemoryPool::batchSize[c]) {
+                cache->releaseBatch(&central, c);
             }
+        } else {
+            ++cache->remoteFreesOut;
+            owner->pushRemote(ptr, cache->remoteContention);
         }
-        bytesAllocated -= REALBLOCK_SIZE(bytes);
-        unlock();
+    }
+
 
-        // Free; the buffer pools are full or this is too big to store.
-        ::free(USERPTR_TO_REALPTR(ptr));
+    void* realloc(void* ptr, size_t bytes) {
+        if (ptr == NULL) {
+            return malloc(bytes);
+        }
+
+        const BlockHeader* header = USERPTR_TO_HEADER(ptr);
+        const size_t realSize = 
+            (header->owner == NULL) ? header->info : MemoryPool::classSize[header->info];
+
+        if (bytes <= realSize) {
+            // The old block was big enough.
+            return ptr;
+        }
+
+        void* newPtr = malloc(bytes);
+        if (newPtr == NULL) {
+            return NULL;
+        }
+        System::memcpy(newPtr, ptr, realSize);
+        free(ptr);
+        return newPtr;
     }
 
-    std::string performance() const {
-        if (totalMallocs > 0) {
-            int pooled = mallocsFromTinyPool +
-                         mallocsFromSmallPool + 
-                         mallocsFromMedPool;
-
-            int total = totalMallocs;
-
-            return format("malloc performance: %5.1f%% <= %db, %5.1f%% <= %db, "
-                          "%5.1f%% <= %db, %5.1f%% > %db",
-                          100.0 * mallocsFromTinyPool  / total,
-                          BufferPool::tinyBufferSize,
-                          100.0 * mallocsFromSmallPool / total,
-                          BufferPool::smallBufferSize,
-                          100.0 * mallocsFromMedPool   / total,
-                          BufferPool::medBufferSize,
-                          100.0 * (1.0 - (double)pooled / total),
-                          BufferPool::medBufferSize);
+
+    std::string performance() {
+        int total = 0, hits = 0, remoteHits = 0, refills = 0, heap = 0;
+
+        std::string threads;
+        registryMutex.lock();
+        for (ThreadCache* cache = firstCache; cache != NULL; cache = cache->nextCache) {
+            total      += cache->mallocs;
+            hits       += cache->hits;
+            remoteHits += cache->remoteHits;
+            refills    += cache->refills;
+            heap       += cache->heapMallocs;
+
+            if (cache->mallocs > 0) {
+                threads += format("\n  thread %2d: %9d mallocs, %5.1f%% hits, %6d refills, "
+                                  "%6d remote frees in, %6d out, contention: %d central, %d remote",
+                                  cache->index, cache->mallocs, 
+                                  100.0 * cache->hits / cache->mallocs,
+                                  cache->refills,
+                                  cache->remoteFreesIn, cache->remoteFreesOut,
+                                  cache->centralContention, cache->remoteContention);
+            }
+        }
+        registryMutex.unlock();
+
+        if (total > 0) {
+            return format("malloc performance: %5.1f%% thread cache, %5.1f%% remote frees, "
+                          "%5.1f%% central heap <= %db, %5.1f%% > %db",
+                          100.0 * hits / total,
+                          100.0 * remoteHits / total,
+                          100.0 * refills / total,
+                          MemoryPool::maxPooledSize,
+                          100.0 * heap / total,
+                          MemoryPool::maxPooledSize) + threads;
         } else {
             return "No System::malloc calls made yet.";
         }
     }
 
-    std::string status() const {
-        return format("preallocated shared buffers: %5d/%d x %db",
-            maxTinyBuffers - tinyPoolSize, maxTinyBuffers, tinyBufferSize);
+    std::string status() {
+        int cached = 0, active = 0;
+        registryMutex.lock();
+        for (ThreadCache* cache = firstCache; cache != NULL; cache = cache->nextCache) {
+            if (cache->active) {
+                ++active;
+            }
+            for (int c = 0; c < MemoryPool::numSizeClasses; ++c) {
+                cached += cache->freeList[c].count;
+            }
+        }
+        registryMutex.unlock();
+
+        int centralFree = 0;
+        for (int c = 0; c < MemoryPool::numSizeClasses; ++c) {
+            centralFree += central.freeCount(c);
+        }
+
+        return format("thread caches: %d/%d active, %d blocks cached by threads, "
+                      "%d blocks in central heap, %d kb of slabs",
+                      active, numCaches, cached, centralFree, central.slabBytes.value() / 1024);
+    }
+
+    void resetCounters() {
+        registryMutex.lock();
+        for (ThreadCache* cache = firstCache; cache != NULL; cache = cache->nextCache) {
+            cache->resetCounters();
+        }
+        registryMutex.unlock();
+    }
+
+    /** Abandons the calling thread's cache, if it has one.  The
+        thread gets a new cache if it allocates again. */
+    void releaseCurrentCache() {
+#       ifdef G3D_WIN32
+            ThreadCache* cache = (ThreadCache*)TlsGetValue(tlsIndex);
+            TlsSetValue(tlsIndex, NULL);
+            if (flsSetValue != NULL) {
+                // Windows does not call flsExit for NULL values
+                flsSetValue(flsIndex, NULL);
+            }
+#       else
+            ThreadCache* cache = (ThreadCache*)pthread_getspecific(tlsKey);
+            // pthreads does not call threadExit for NULL values
+            pthread_setspecific(tlsKey, NULL);
+#       endif
+        if (cache != NULL) {
+            abandon(cache);
+        }
+    }
+
+    /** Called when a thread exits. */
+    void abandon(ThreadCache* cache) {
+        cache->releaseAll(&central);
+        registryMutex.lock();
+        cache->active = false;
+        registryMutex.unlock();
     }
 };
 
+} // namespace _internal
+
 // Dynamically allocated because we need to ensure that
-// the buffer pool is still around when the last global variable 
+// the allocator is still around when the last global variable 
 // is deallocated.
-static BufferPool* bufferpool = NULL;
+static _internal::ThreadCachingAllocator* bufferpool = NULL;
+
+void _internal::ThreadCachingAllocator::threadExit(void* cache) {
+    // Blocks still on this cache's remote stack or freed to it after this
+    // point are recovered by the next thread that adopts the cache.
+    bufferpool->abandon((ThreadCache*)cache);
+}
+
+#ifdef G3D_WIN32
+void WINAPI _internal::ThreadCachingAllocator::flsExit(void* cache) {
+    bufferpool->abandon((ThreadCache*)cache);
+}
+#endif
+
+#undef NEXT_BLOCK
+#undef HEADER_TO_USERPTR
+#undef USERPTR_TO_HEADER
 
 std::string System::mallocPerformance() {    
 #ifndef NO_BUFFERPOOL
@@ -1467,10 +1808,16 @@ std::string System::mallocStatus() {
 
 void System::resetMallocPerformanceCounters() {
 #ifndef NO_BUFFERPOOL
-    bufferpool->totalMallocs         = 0;
-    bufferpool->mallocsFromMedPool   = 0;
-    bufferpool->mallocsFromSmallPool = 0;
-    bufferpool->mallocsFromTinyPool  = 0;
+    bufferpool->resetCounters();
+#endif
+}
+
+
+void System::releaseMallocThreadCache() {
+#ifndef NO_BUFFERPOOL
+    if (bufferpool != NULL) {
+        bufferpool->releaseCurrentCache();
+    }
 #endif
 }
 
@@ -1481,7 +1828,7 @@ inline void initMem() {
     // initialized, even when globals are being allocated.
     static bool initialized = false;
     if (! initialized) {
-        bufferpool = new BufferPool();
+        bufferpool = new _internal::ThreadCachingAllocator();
         initialized = true;
     }
 }
@@ -1683,4 +2030,22 @@ int System::cpuSpeedMHz() {
     return _CPUSpeed;
 }
 
+
+int System::numCores() {
+    static int n = 0;
+
+    if (n == 0) {
+#       ifdef G3D_WIN32
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            n = (int)info.dwNumberOfProcessors;
+#       else
+            n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#       endif
+        n = iMax(n, 1);
+    }
+
+    return n;
+}
+
 }  // namespace
@@ -20,7 +20,9 @@ TextOutput::TextOutput(const TextOutput::Options& opt) :
     currentColumn(0),
 	inDQuote(false),
 	filename(""),
-	indentLevel(0)
+	indentLevel(0),
+    asyncFlushThreshold(0),
+    flushedAsync(false)
 {
     setOptions(opt);
 }
@@ -31,7 +33,9 @@ TextOutput::TextOutput(const std::string& fil, const TextOutput::Options& opt) :
     currentColumn(0),
 	inDQuote(false),
 	filename(fil),
-	indentLevel(0) 
+	indentLevel(0),
+    asyncFlushThreshold(0),
+    flushedAsync(false)
 {
 
     setOptions(opt);
@@ -383,11 +387,53 @@ void TextOutput::vprintf(const char* formatString, va_list argPtr) {
     std::string clean;
     convertNewlines(str, clean);
     wordWrapIndentAppend(clean);
+
+    if (asyncFlushThreshold > 0) {
+        maybeFlushAsync();
+    }
+}
+
+
+void TextOutput::setAsyncFlushThreshold(int bytes) {
+    alwaysAssertM(filename != "", "Asynchronous flushing is only supported for files.");
+    alwaysAssertM(bytes >= 0, "Threshold must be non-negative.");
+    asyncFlushThreshold = bytes;
+}
+
+
+void TextOutput::maybeFlushAsync() {
+    if (data.size() <= asyncFlushThreshold) {
+        return;
+    }
+
+    // Word wrapping may rewrite the current line, so only flush complete lines
+    int n = data.size();
+    while ((n > 0) && (data[n - 1] != '\n')) {
+        --n;
+    }
+
+    if (n == 0) {
+        return;
+    }
+
+    uint8* buffer = (uint8*)System::malloc(n);
+    System::memcpy(buffer, data.getCArray(), n);
+    pendingWrite = AsyncFileWriter::write(filename, buffer, n, flushedAsync);
+    flushedAsync = true;
+
+    const int remaining = data.size() - n;
+    memmove(data.getCArray(), data.getCArray() + n, remaining);
+    data.resize(remaining, DONT_SHRINK_UNDERLYING_ARRAY);
 }
 
 
 void TextOutput::commit(bool flush) {
-    FILE* f = fopen(filename.c_str(), "wb");
+    if (pendingWrite.notNull()) {
+        pendingWrite->wait();
+        pendingWrite = NULL;
+    }
+
+    FILE* f = fopen(filename.c_str(), flushedAsync ? "ab" : "wb");
     fwrite(data.getCArray(), 1, data.size(), f);
     if (flush) {
         fflush(f);
@@ -396,6 +442,14 @@ void TextOutput::commit(bool flush) {
 }
 
 
+AsyncWriteRef TextOutput::commitAsync() {
+    uint8* buffer = (uint8*)System::malloc(data.size());
+    System::memcpy(buffer, data.getCArray(), data.size());
+    pendingWrite = AsyncFileWriter::write(filename, buffer, data.size(), flushedAsync);
+    return pendingWrite;
+}
+
+
 void TextOutput::commitString(std::string& out) {
     // Null terminate
     data.push('\0');
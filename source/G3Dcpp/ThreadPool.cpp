@@ -0,0 +1,257 @@
+/**
+ @file ThreadPool.cpp
+
+ @maintainer Morgan McGuire, matrix@graphics3d.com
+
+ @created 2026-10-17
+ @edited  2026-10-17
+ */
+
+#include "G3D/platform.h"
+#include "G3D/ThreadPool.h"
+#include "G3D/format.h"
+
+namespace G3D {
+
+namespace _internal {
+
+class ThreadPoolWorker : public GThread {
+public:
+    ThreadPool*     pool;
+    int             index;
+
+    ThreadPoolWorker(ThreadPool* p, int i) :
+        GThread(format("ThreadPool worker %d", i)), pool(p), index(i) {}
+
+protected:
+    virtual void threadMain();
+};
+
+} // _internal
+
+
+/** Thread-local pointer to the ThreadPoolWorker running on the
+    current thread, or NULL. */
+#ifdef G3D_WIN32
+static DWORD         currentWorkerIndex;
+#else
+static pthread_key_t currentWorkerKey;
+#endif
+
+static GMutex        currentWorkerLock;
+static bool          currentWorkerInitialized = false;
+
+static void setCurrentWorker(_internal::ThreadPoolWorker* w) {
+#   ifdef G3D_WIN32
+        TlsSetValue(currentWorkerIndex, w);
+#   else
+        pthread_setspecific(currentWorkerKey, w);
+#   endif
+}
+
+static _internal::ThreadPoolWorker* currentWorker() {
+#   ifdef G3D_WIN32
+        return (_internal::ThreadPoolWorker*)TlsGetValue(currentWorkerIndex);
+#   else
+        return (_internal::ThreadPoolWorker*)pthread_getspecific(currentWorkerKey);
+#   endif
+}
+
+
+void _internal::ThreadPoolWorker::threadMain() {
+    setCurrentWorker(this);
+
+    ThreadPool::Job job;
+    while (! pool->quit) {
+        if (pool->findJob(index, job)) {
+            ThreadPool::execute(job);
+            continue;
+        }
+
+        // Announce that this worker is going to sleep, then look once more
+        // so that a job pushed before the announcement is not missed
+        pool->idleWorkers.increment();
+        if (pool->findJob(index, job)) {
+            if (! pool->claimIdleWorker()) {
+                // A push already woke this worker; take the wake-up
+                pool->workAvailable.acquire();
+            }
+            ThreadPool::execute(job);
+        } else {
+            pool->workAvailable.acquire();
+        }
+    }
+}
+
+
+ThreadPool::ThreadPool(int numWorkers) : workAvailable(0), idleWorkers(0), quit(false) {
+    debugAssert(numWorkers >= 0);
+
+    currentWorkerLock.lock();
+    if (! currentWorkerInitialized) {
+#       ifdef G3D_WIN32
+            currentWorkerIndex = TlsAlloc();
+#       else
+            pthread_key_create(&currentWorkerKey, NULL);
+#       endif
+        currentWorkerInitialized = true;
+    }
+    currentWorkerLock.unlock();
+
+    for (int i = 0; i <= numWorkers; ++i) {
+        deque.append(new JobDeque());
+    }
+
+    for (int i = 0; i < numWorkers; ++i) {
+        _internal::ThreadPoolWorker* w = new _internal::ThreadPoolWorker(this, i);
+        worker.append(w);
+        bool started = w->start();
+        alwaysAssertM(started, "Could not start a ThreadPool worker."); (void)started;
+    }
+}
+
+
+ThreadPool::~ThreadPool() {
+    quit = true;
+    if (worker.size() > 0) {
+        workAvailable.release(worker.size());
+    }
+
+    for (int i = 0; i < worker.size(); ++i) {
+        worker[i]->waitForCompletion();
+        delete worker[i];
+    }
+    worker.clear();
+
+    deque.deleteAll();
+}
+
+
+int ThreadPool::currentDequeIndex() const {
+    _internal::ThreadPoolWorker* w = currentWorker();
+    if ((w != NULL) && (w->pool == this)) {
+        return w->index;
+    } else {
+        return worker.size();
+    }
+}
+
+
+void ThreadPool::push(const Job& job) {
+    JobDeque* d = deque[currentDequeIndex()];
+    d->lock.lock();
+    d->queue.pushBack(job);
+    d->lock.unlock();
+
+    // Wake one sleeping worker, if there is one.  Busy workers look for
+    // jobs before they sleep, and without workers nothing ever acquires.
+    if (claimIdleWorker()) {
+        workAvailable.release();
+    }
+}
+
+
+bool ThreadPool::claimIdleWorker() {
+    while (true) {
+        const int32 n = idleWorkers.value();
+        if (n == 0) {
+            return false;
+        }
+        if (idleWorkers.compareAndSet(n, n - 1) == n) {
+            return true;
+        }
+    }
+}
+
+
+bool ThreadPool::findJob(int index, Job& job) {
+    // Newest job from our own deque
+    JobDeque* d = deque[index];
+    d->lock.lock();
+    if (d->queue.size() > 0) {
+        job = d->queue.popBack();
+        d->lock.unlock();
+        return true;
+    }
+    d->lock.unlock();
+
+    // Oldest job from another deque
+    for (int i = 1; i < deque.size(); ++i) {
+        d = deque[(index + i) % deque.size()];
+        if (d->queue.size() == 0) {
+            // Unsynchronized peek; avoids locking empty deques
+            continue;
+        }
+
+        d->lock.lock();
+        if (d->queue.size() > 0) {
+            job = d->queue.popFront();
+            d->lock.unlock();
+            return true;
+        }
+        d->lock.unlock();
+    }
+
+    return false;
+}
+
+
+void ThreadPool::execute(const Job& job) {
+    job.task->run();
+    if (job.deleteWhenDone) {
+        delete job.task;
+    }
+    job.group->pending.decrement();
+}
+
+
+void ThreadPool::TaskGroup::run(Task* task, bool deleteWhenDone) {
+    Job job;
+    job.task = task;
+    job.group = this;
+    job.deleteWhenDone = deleteWhenDone;
+
+    pending.increment();
+    pool.push(job);
+}
+
+
+void ThreadPool::TaskGroup::wait() {
+    const int index = pool.currentDequeIndex();
+    Job job;
+
+    while (pending.value() > 0) {
+        if (pool.findJob(index, job)) {
+            ThreadPool::execute(job);
+        } else {
+            // The remaining tasks are running on other threads
+            GThread::yield();
+        }
+    }
+}
+
+
+static ThreadPool* commonPool = NULL;
+static GMutex      commonPoolLock;
+
+/** Stops the common pool when the program exits */
+static class ThreadPoolShutdown {
+public:
+    ~ThreadPoolShutdown() {
+        delete commonPool;
+        commonPool = NULL;
+    }
+} threadPoolShutdown;
+
+
+ThreadPool& ThreadPool::common() {
+    // Always lock, so that no thread can see the pointer before the pool
+    // is constructed.  This is cheap next to the work that is dispatched.
+    GMutexLock lock(&commonPoolLock);
+    if (commonPool == NULL) {
+        commonPool = new ThreadPool(System::numCores() - 1);
+    }
+    return *commonPool;
+}
+
+}
@@ -322,7 +322,7 @@ Texture::DDSTexture::DDSTexture(const std::string& filename) :
 
     try {
 
-        BinaryInput ddsInput(filename, G3D_LITTLE_ENDIAN);
+        BinaryInput ddsInput(filename, G3D_LITTLE_ENDIAN, false, BinaryInput::MAP_SEQUENTIAL);
         DDSURFACEDESC2 ddsSurfaceDesc;
 
         std::string ddsString = ddsInput.readString(4);
@@ -14,6 +14,7 @@
 #include "G3D/fileutils.h"
 #include "G3D/Log.h"
 #include "G3D/NetworkDevice.h"
+#include "G3D/Profiler.h"
 #include "GLG3D/FirstPersonManipulator.h"
 #include "GLG3D/UserInput.h"
 #include "GLG3D/GWindow.h"
@@ -298,6 +299,21 @@ void GApp::renderDebugInfo() {
 
                 pos.x = x;
                 pos.y += size * 3;
+
+                if (Profiler::enabled()) {
+                    // Zones from the previous frame, most expensive first
+                    Array<Profiler::Summary> zone;
+                    Profiler::getTopZones(zone, 8);
+                    for (int i = 0; i < zone.size(); ++i) {
+                        debugFont->draw2D(renderDevice, 
+                            format("%6.2f ms %6.2f ms incl %5dx  %s", 
+                                   zone[i].exclusiveTime * 1000, zone[i].inclusiveTime * 1000,
+                                   zone[i].callCount, zone[i].name),
+                            pos, size, statColor);
+                        pos.y += size * 1.5;
+                    }
+                    pos.y += size * 1.5;
+                }
             }
 
             for (int i = 0; i < debugText.length(); ++i) {
@@ -361,7 +377,7 @@ void GApplet::onGraphics(RenderDevice* rd) {
     // 3D
     if (posedArray.size() > 0) {
         Vector3 lookVector = app->renderDevice->getCameraToWorldMatrix().lookVector();
-        PosedModel::sort(posedArray, lookVector, opaque, transparent);
+        PosedModel::sort(posedArray, lookVector, opaque, transparent, &app->renderDevice->frameArena());
 
         for (int i = 0; i < opaque.size(); ++i) {
             opaque[i]->render(app->renderDevice);
@@ -413,20 +429,28 @@ void GApplet::oneFrame() {
 
     // User input
     app->m_userInputWatch.tick();
-    onUserInput(app->userInput);
-    app->m_moduleManager->onUserInput(app->userInput);
-    m_moduleManager->onUserInput(app->userInput);
+    {
+        G3D_PROFILE_ZONE("GApplet::onUserInput");
+        onUserInput(app->userInput);
+        app->m_moduleManager->onUserInput(app->userInput);
+        m_moduleManager->onUserInput(app->userInput);
+    }
     app->m_userInputWatch.tock();
 
     // Network
     app->m_networkWatch.tick();
-    onNetwork();
-    app->m_moduleManager->onNetwork();
-    m_moduleManager->onNetwork();
+    {
+        G3D_PROFILE_ZONE("GApplet::onNetwork");
+        onNetwork();
+        app->m_moduleManager->onNetwork();
+        m_moduleManager->onNetwork();
+    }
     app->m_networkWatch.tock();
 
     // Simulation
     app->m_simulationWatch.tick();
+    {
+        G3D_PROFILE_ZONE("GApplet::onSimulation");
         // TODO: Replace with module manager calls
 		app->debugController->onSimulation(clamp(timeStep, 0.0, 0.1),clamp(timeStep, 0.0, 0.1),clamp(timeStep, 0.0, 0.1));
 		app->debugCamera.setCoordinateFrame(app->debugController->frame());
@@ -443,13 +467,17 @@ void GApplet::oneFrame() {
 		setRealTime(realTime() + rdt);
 		setSimTime(simTime() + sdt);
 		setIdealSimTime(idealSimTime() + idt);
+    }
     app->m_simulationWatch.tock();
 
     // Logic
     app->m_logicWatch.tick();
+    {
+        G3D_PROFILE_ZONE("GApplet::onLogic");
         onLogic();
         app->m_moduleManager->onLogic();
         m_moduleManager->onLogic();
+    }
     app->m_logicWatch.tock();
 
     // Wait 
@@ -460,6 +488,7 @@ void GApplet::oneFrame() {
 
     app->m_waitWatch.tick();
     {
+        G3D_PROFILE_ZONE("GApplet::onWait");
         RealTime now = System::time();
         // Compute accumulated time
         onWait(now - lastWaitTime, desiredFrameDuration());
@@ -469,6 +498,8 @@ void GApplet::oneFrame() {
 
     // Graphics
     app->m_graphicsWatch.tick();
+    {
+        G3D_PROFILE_ZONE("GApplet::onGraphics");
         app->renderDevice->beginFrame();
             app->renderDevice->pushState();
                 onGraphics(app->renderDevice);
@@ -476,8 +507,11 @@ void GApplet::oneFrame() {
             app->renderDebugInfo();
         app->renderDevice->endFrame();
         app->debugText.clear();
+    }
     app->m_graphicsWatch.tock();
 
+    Profiler::endFrame();
+
     if ((endApplet || app->endProgram) && app->window()->requiresMainLoop()) {
         app->window()->popLoopBody();
     }
@@ -46,19 +46,19 @@ void IFSModel::reset() {
 }
 
 
-IFSModelRef IFSModel::create(const std::string& filename, double scale, const CoordinateFrame& cframe, const bool weld) {
-    return create(filename, Vector3(scale, scale, scale), cframe, weld);
+IFSModelRef IFSModel::create(const std::string& filename, double scale, const CoordinateFrame& cframe, const bool weld, const bool optimize) {
+    return create(filename, Vector3(scale, scale, scale), cframe, weld, optimize);
 }
 
 
-IFSModelRef IFSModel::create(const std::string& filename, const Vector3& scale, const CoordinateFrame& cframe, const bool weld) {
+IFSModelRef IFSModel::create(const std::string& filename, const Vector3& scale, const CoordinateFrame& cframe, const bool weld, const bool optimize) {
     IFSModel* ret = new IFSModel();
-    ret->load(filename, scale, cframe, weld);
+    ret->load(filename, scale, cframe, weld, optimize);
     return ret;
 }
 
 
-void IFSModel::load(const std::string& filename, const Vector3& scale, const CoordinateFrame& cframe, const bool weld) {
+void IFSModel::load(const std::string& filename, const Vector3& scale, const CoordinateFrame& cframe, const bool weld, const bool optimize) {
     reset();
 
     this->filename = filename;
@@ -67,6 +67,16 @@ void IFSModel::load(const std::string& filename, const Vector3& scale, const Coo
     debugAssert(geometry.vertexArray.size() > 0);
     debugAssert(indexArray.size() > 0);
 
+    if (optimize) {
+        Array<int> toOld;
+        MeshAlg::optimizeVertexCache(indexArray, geometry.vertexArray.size());
+        MeshAlg::optimizeVertexFetch(indexArray, geometry.vertexArray.size(), toOld);
+        MeshAlg::reorderVertexArray(toOld, geometry.vertexArray);
+        if (texArray.size() > 0) {
+            MeshAlg::reorderVertexArray(toOld, texArray);
+        }
+    }
+
     for (int i = 0; i < geometry.vertexArray.size(); ++i) {
         geometry.vertexArray[i] = cframe.pointToWorldSpace(geometry.vertexArray[i] * scale);
     }
@@ -190,7 +200,7 @@ void IFSModel::load(
 
 
 	if (filenameExt(filename) == "ifs" ) {
-		BinaryInput bi(filename, G3D_LITTLE_ENDIAN);
+		BinaryInput bi(filename, G3D_LITTLE_ENDIAN, false, BinaryInput::MAP_SEQUENTIAL);
 
 		if (bi.getLength() == 0) {
 			throw std::string("Failed to open " + filename);
@@ -11,6 +11,8 @@
 #include "GLG3D/RenderDevice.h"
 #include "G3D/Sphere.h"
 #include "G3D/Box.h"
+#include "G3D/GCamera.h"
+#include "G3D/Rect2D.h"
 
 namespace G3D {
 
@@ -22,7 +24,7 @@ public:
     ModelSorter() {}
 
     ModelSorter(const PosedModelRef& m, const Vector3& axis) : model(m) {
-        static Sphere s;
+        Sphere s;
         m->getWorldSpaceBoundingSphere(s);
         sortKey = axis.dot(s.center);
     }
@@ -37,17 +39,23 @@ public:
 };
 
 
-void PosedModel::sort(
+/** Sorts inModels into opaque and transparent, or all into opaque when
+    transparent is NULL.  The sort keys are allocated from arena, or from
+    the heap if arena is NULL. */
+static void sortModels(
     const Array<PosedModelRef>& inModels, 
     const Vector3&              wsLook,
+    MemoryArena*                arena,
     Array<PosedModelRef>&       opaque,
-    Array<PosedModelRef>&       transparent) {
+    Array<PosedModelRef>*       transparent) {
 
     Array<ModelSorter> op;
     Array<ModelSorter> tr;
+    op.clearAndSetMemoryArena(arena);
+    tr.clearAndSetMemoryArena(arena);
     
     for (int m = 0; m < inModels.size(); ++m) {
-        if (inModels[m]->hasTransparency()) {
+        if ((transparent != NULL) && inModels[m]->hasTransparency()) {
             tr.append(ModelSorter(inModels[m], wsLook));
         } else {
             op.append(ModelSorter(inModels[m], wsLook));
@@ -58,9 +66,11 @@ void PosedModel::sort(
     tr.sort(SORT_DECREASING);
     op.sort(SORT_INCREASING);
 
-    transparent.resize(tr.size(), DONT_SHRINK_UNDERLYING_ARRAY);
-    for (int m = 0; m < tr.size(); ++m) {
-        transparent[m] = tr[m].model;
+    if (transparent != NULL) {
+        transparent->resize(tr.size(), DONT_SHRINK_UNDERLYING_ARRAY);
+        for (int m = 0; m < tr.size(); ++m) {
+            (*transparent)[m] = tr[m].model;
+        }
     }
 
     opaque.resize(op.size(), DONT_SHRINK_UNDERLYING_ARRAY);
@@ -73,27 +83,37 @@ void PosedModel::sort(
 void PosedModel::sort(
     const Array<PosedModelRef>& inModels, 
     const Vector3&              wsLook,
-    Array<PosedModelRef>&       opaque) { 
+    Array<PosedModelRef>&       opaque,
+    Array<PosedModelRef>&       transparent,
+    MemoryArena*                scratch) {
+
+    if (scratch != NULL) {
+        MemoryArena::Scope scope(*scratch);
+        sortModels(inModels, wsLook, scratch, opaque, &transparent);
+    } else {
+        sortModels(inModels, wsLook, NULL, opaque, &transparent);
+    }
+}
+
+
+void PosedModel::sort(
+    const Array<PosedModelRef>& inModels, 
+    const Vector3&              wsLook,
+    Array<PosedModelRef>&       opaque,
+    MemoryArena*                scratch) { 
 
     if (&inModels == &opaque) {
         // The user is trying to sort in place.  Make a separate array for them.
         Array<PosedModelRef> temp = inModels;
-        sort(temp, wsLook, opaque);
+        sort(temp, wsLook, opaque, scratch);
         return;
     }
 
-    Array<ModelSorter> op;
-    
-    for (int m = 0; m < inModels.size(); ++m) {
-        op.append(ModelSorter(inModels[m], wsLook));
-    }
-
-    // Sort
-    op.sort(SORT_INCREASING);
-
-    opaque.resize(op.size(), DONT_SHRINK_UNDERLYING_ARRAY);
-    for (int m = 0; m < op.size(); ++m) {
-        opaque[m] = op[m].model;
+    if (scratch != NULL) {
+        MemoryArena::Scope scope(*scratch);
+        sortModels(inModels, wsLook, scratch, opaque, NULL);
+    } else {
+        sortModels(inModels, wsLook, NULL, opaque, NULL);
     }
 }
 
@@ -137,6 +157,32 @@ Sphere PosedModel::worldSpaceBoundingSphere() const {
 }
 
 
+PosedModelRef PosedModel::selectLOD(
+    const Array<PosedModelRef>& levels,
+    const GCamera&              camera,
+    const Rect2D&               viewport,
+    float                       pixelsPerTriangle) {
+
+    debugAssert(levels.size() > 0);
+
+    const Sphere sphere = levels[0]->worldSpaceBoundingSphere();
+    const float z = camera.getCoordinateFrame().pointToObjectSpace(sphere.center).z;
+    if (z > -sphere.radius) {
+        return levels[0];
+    }
+
+    const float pixels = camera.worldToScreenSpaceArea((float)(pi() * square(sphere.radius)), z, viewport);
+    const int numTriangles = iCeil(pixels / pixelsPerTriangle);
+
+    for (int i = levels.size() - 1; i > 0; --i) {
+        if (levels[i]->triangleIndices().size() / 3 >= numTriangles) {
+            return levels[i];
+        }
+    }
+    return levels[0];
+}
+
+
 Box PosedModel::objectSpaceBoundingBox() const {
     Box b;
     getObjectSpaceBoundingBox(b);
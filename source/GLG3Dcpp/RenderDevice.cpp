@@ -1344,6 +1344,8 @@ void RenderDevice::endFrame() {
 
     debugAssertM(stateStack.size() == 0, "Missing RenderDevice::popState or RenderDevice::pop2D.");
 
+    _frameArena.reset();
+
     double now = System::time();
     double dt = now - lastTime;
     if (dt == 0) {
@@ -138,7 +138,11 @@ void markShadows(
     const Array<MeshAlg::Edge>& edgeArray = model->weldedEdges();
     const Array<MeshAlg::Face>& faceArray = model->weldedFaces();
 
+    // The temporaries below live only for this call
+    MemoryArena::Scope scratch(renderDevice->frameArena());
+
     Array<bool> backface;
+    backface.clearAndSetMemoryArena(&renderDevice->frameArena());
     MeshAlg::identifyBackfaces(vertexArray, faceArray, L, backface);
 
     bool directional = (light.w == 0);
@@ -156,7 +160,9 @@ void markShadows(
     }
 
     // Create an array of float4 for use on the graphics card.
-    Array<Vector4> cpuVertex(numPts);
+    Array<Vector4> cpuVertex;
+    cpuVertex.clearAndSetMemoryArena(&renderDevice->frameArena());
+    cpuVertex.resize(numPts);
     vertexCopy(vertexArray, cpuVertex);
 
     if (directional) {
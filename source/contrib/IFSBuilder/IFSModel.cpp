@@ -1166,13 +1166,30 @@ void XIFSModel::render() {
 }
 
 
-void XIFSModel::save(const std::string& filename) {
+void XIFSModel::save(const std::string& filename, bool optimize) {
 
     Array<int> index;
     for (int i = 0; i < triangleArray.size(); ++i) {
         index.append(triangleArray[i].index[0], triangleArray[i].index[1], triangleArray[i].index[2]);
     }
 
-    IFSModel::save(filename, name, index, geometry.vertexArray, texCoordArray);
+    if (! optimize) {
+        IFSModel::save(filename, name, index, geometry.vertexArray, texCoordArray);
+        return;
+    }
+
+    Array<Vector3> vertex = geometry.vertexArray;
+    Array<Vector2> texCoord = texCoordArray;
+    Array<int> toOld;
+
+    MeshAlg::optimizeVertexCache(index, vertex.size());
+    MeshAlg::optimizeVertexFetch(index, vertex.size(), toOld);
+
+    MeshAlg::reorderVertexArray(toOld, vertex);
+    if (texCoord.size() > 0) {
+        MeshAlg::reorderVertexArray(toOld, texCoord);
+    }
+
+    IFSModel::save(filename, name, index, vertex, texCoord);
 }
 
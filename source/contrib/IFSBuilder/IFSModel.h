@@ -99,8 +99,12 @@ public:
 
     /**
      Write the IFS file to disk.
+
+     @param optimize When true, the triangles and vertices are written in
+     vertex cache order (see MeshAlg::optimizeVertexCache) instead of the
+     model's own order.  The model in memory is unchanged.
      */
-    void save(const std::string& filename);
+    void save(const std::string& filename, bool optimize = false);
 };
 
 #endif
@@ -185,7 +185,8 @@ bool Map::load(
         return false;
     }
 
-    BinaryInput bi(full, G3D_LITTLE_ENDIAN);
+    // Lumps are read in a different order than they appear in the file
+    BinaryInput bi(full, G3D_LITTLE_ENDIAN, false, BinaryInput::MAP_RANDOM);
 
     
     // Determine file type
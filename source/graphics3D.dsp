@@ -95,6 +95,14 @@ SOURCE=.\G3Dcpp\AnyVal.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\G3Dcpp\AsyncFileWriter.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\G3Dcpp\Benchmark.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\G3Dcpp\BinaryFormat.cpp
 # End Source File
 # Begin Source File
@@ -247,6 +255,10 @@ SOURCE=.\G3Dcpp\Matrix4.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\G3Dcpp\MemoryArena.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\G3Dcpp\MeshAlg.cpp
 # End Source File
 # Begin Source File
@@ -255,6 +267,18 @@ SOURCE=.\G3Dcpp\MeshAlgAdjacency.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\G3Dcpp\MeshAlgNormals.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\G3Dcpp\MeshAlgSimplify.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\G3Dcpp\MeshAlgVertexCache.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\G3Dcpp\MeshAlgWeld.cpp
 # End Source File
 # Begin Source File
@@ -279,6 +303,10 @@ SOURCE=.\G3Dcpp\Plane.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\G3Dcpp\Profiler.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\G3Dcpp\prompt.cpp
 # End Source File
 # Begin Source File
@@ -307,6 +335,10 @@ SOURCE=.\G3Dcpp\stringutils.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\G3Dcpp\SweepAndPrune.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\G3Dcpp\System.cpp
 # End Source File
 # Begin Source File
@@ -319,6 +351,10 @@ SOURCE=.\G3Dcpp\TextOutput.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\G3Dcpp\ThreadPool.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\G3Dcpp\Triangle.cpp
 # End Source File
 # Begin Source File
@@ -363,10 +399,18 @@ SOURCE=.\include\G3D\Array.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\G3D\AsyncFileWriter.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\G3D\AtomicInt32.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\G3D\Benchmark.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\G3D\BinaryFormat.h
 # End Source File
 # Begin Source File
@@ -447,10 +491,22 @@ SOURCE=.\include\G3D\fileutils.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\G3D\FlatSet.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\G3D\FlatTable.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\G3D\format.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\G3D\FrozenAABSPTree.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\G3D\G3D.h
 # End Source File
 # Begin Source File
@@ -507,6 +563,10 @@ SOURCE=.\include\G3D\Matrix4.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\G3D\MemoryArena.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\G3D\MeshAlg.h
 # End Source File
 # Begin Source File
@@ -515,6 +575,10 @@ SOURCE=.\include\G3D\MeshBuilder.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\G3D\MPMCQueue.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\G3D\NetAddress.h
 # End Source File
 # Begin Source File
@@ -535,6 +599,10 @@ SOURCE=.\include\G3D\platform.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\G3D\Profiler.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\G3D\prompt.h
 # End Source File
 # Begin Source File
@@ -567,6 +635,10 @@ SOURCE=.\include\G3D\Set.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\G3D\SmallArray.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\G3D\Sphere.h
 # End Source File
 # Begin Source File
@@ -575,6 +647,10 @@ SOURCE=.\include\G3D\spline.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\G3D\SPSCQueue.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\G3D\Stopwatch.h
 # End Source File
 # Begin Source File
@@ -583,6 +659,10 @@ SOURCE=.\include\G3D\stringutils.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\G3D\SweepAndPrune.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\G3D\System.h
 # End Source File
 # Begin Source File
@@ -599,6 +679,10 @@ SOURCE=.\include\G3D\TextOutput.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\G3D\ThreadPool.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\G3D\Triangle.h
 # End Source File
 # Begin Source File
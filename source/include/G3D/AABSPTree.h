@@ -17,6 +17,7 @@
 #include "G3D/platform.h"
 #include "G3D/Array.h"
 #include "G3D/Table.h"
+#include "G3D/FlatTable.h"
 #include "G3D/Vector3.h"
 #include "G3D/AABox.h"
 #include "G3D/Sphere.h"
@@ -27,6 +28,7 @@
 #include "G3D/BinaryInput.h"
 #include "G3D/BinaryOutput.h"
 #include "G3D/CollisionDetection.h"
+#include "G3D/ThreadPool.h"
 #include <algorithm>
 
 inline void getBounds(const G3D::Vector3& v, G3D::AABox& out) {
@@ -79,6 +81,8 @@ inline void getBounds(const G3D::Triangle* t, G3D::AABox& out) {
 
 namespace G3D {
 
+template<class T> class FrozenAABSPTree;
+
 /**
  A set that supports spatial queries using an axis-aligned
  BSP tree for speed.
@@ -136,10 +140,16 @@ namespace G3D {
  for data distributed along 2 or 1 axes by simply returning bounds
  that are always zero along one or more dimensions.
 
+ <B>Static sets</B>
+ For a set that will not change, build the tree and convert it to a
+ G3D::FrozenAABSPTree, which answers queries faster.
+
 */
 template<class T> class AABSPTree {
 private:
 
+    friend class FrozenAABSPTree<T>;
+
     /** Wrapper for a value that includes a cache of its bounds. */
     class Handle {
     public:
@@ -265,8 +275,26 @@ private:
             this is a leaf node). */
         Array<Handle>       valueArray;
 
+        /** Bounds of all values at this node and its children.  Tight as
+            of the last balance, balanceSAH, or refit of the tree, grown by
+            each insert since, and infinite for nodes made since.  Box, sphere, and plane queries
+            skip the nodes whose bounds they miss. */
+        AABox               bounds;
+
+        /** Number of values at this node and its children, as of the last
+            AABSPTree::refit */
+        int                 subtreeSize;
+
+        /** Expected number of member tests for a query that reaches this
+            node, as of the last AABSPTree::refit */
+        float               cost;
+
+        /** cost when the subtree was built by refit, or at the first refit
+            after it was built some other way.  0 if not yet known. */
+        float               builtCost;
+
         /** Creates node with NULL children */
-        Node() {
+        Node() : bounds(AABox::inf()), subtreeSize(0), cost(0), builtCost(0) {
             splitAxis     = Vector3::X_AXIS;
             splitLocation = 0;
             splitBounds   = AABox(-Vector3::inf(), Vector3::inf());
@@ -278,7 +306,8 @@ private:
         /**
          Doesn't clone children.
          */
-        Node(const Node& other) : valueArray(other.valueArray) {
+        Node(const Node& other) : valueArray(other.valueArray), bounds(other.bounds),
+            subtreeSize(other.subtreeSize), cost(other.cost), builtCost(other.builtCost) {
             splitAxis       = other.splitAxis;
             splitLocation   = other.splitLocation;
             splitBounds     = other.splitBounds;            
@@ -289,7 +318,7 @@ private:
 
         /** Copies the specified subarray of pt into point, NULLs the children.
             Assumes a second pass will set splitBounds. */
-        Node(const Array<Handle>& pt, int beginIndex, int endIndex) {
+        Node(const Array<Handle>& pt, int beginIndex, int endIndex) : bounds(AABox::inf()), subtreeSize(0), cost(0), builtCost(0) {
             splitAxis     = Vector3::X_AXIS;
             splitLocation = 0;
             for (int i = 0; i < 2; ++i) {
@@ -404,21 +433,24 @@ private:
             }
         }
 
-        /** Returns the deepest node that completely contains bounds. */
-        Node* findDeepestContainingNode(const AABox& bounds) {
+        /** Returns the deepest node that completely contains valueBounds,
+            growing the bounds of every node on the way to contain it. */
+        Node* findDeepestContainingNode(const AABox& valueBounds) {
+
+            bounds = AABox(bounds.low().min(valueBounds.low()), bounds.high().max(valueBounds.high()));
 
             // See which side of the splitting plane the bounds are on
-            if (bounds.high()[splitAxis] < splitLocation) {
+            if (valueBounds.high()[splitAxis] < splitLocation) {
                 // Bounds are on the low side.  Recurse into the child
                 // if it exists.
                 if (child[0] != NULL) {
-                    return child[0]->findDeepestContainingNode(bounds);
+                    return child[0]->findDeepestContainingNode(valueBounds);
                 }
-            } else if (bounds.low()[splitAxis] > splitLocation) {
+            } else if (valueBounds.low()[splitAxis] > splitLocation) {
                 // Bounds are on the high side, recurse into the child
                 // if it exists.
                 if (child[1] != NULL) {
-                    return child[1]->findDeepestContainingNode(bounds);
+                    return child[1]->findDeepestContainingNode(valueBounds);
                 }
             }
 
@@ -429,31 +461,91 @@ private:
 
 
         /** Appends all members that intersect the box. 
-            If useSphere is true, members that pass the box test
+            If sphere is not NULL, members that pass the box test
             face a second test against the sphere. */
         void getIntersectingMembers(
             const AABox&        box, 
-            const Sphere&       sphere,
-            Array<T>&           members,
-            bool                useSphere) const {
+            const Sphere*       sphere,
+            Array<T>&           members) const {
 
             // Test all values at this node
             for (int v = 0; v < valueArray.size(); ++v) {
                 const AABox& bounds = valueArray[v].bounds;
                 if (bounds.intersects(box) &&
-                    (! useSphere || bounds.intersects(sphere))) {
+                    ((sphere == NULL) || bounds.intersects(*sphere))) {
                     members.append(valueArray[v].value);
                 }
             }
 
             // If the left child overlaps the box, recurse into it
-            if ((child[0] != NULL) && (box.low()[splitAxis] < splitLocation)) {
-                child[0]->getIntersectingMembers(box, sphere, members, useSphere);
+            if ((child[0] != NULL) && (box.low()[splitAxis] < splitLocation) &&
+                child[0]->bounds.intersects(box)) {
+                child[0]->getIntersectingMembers(box, sphere, members);
             }
 
             // If the right child overlaps the box, recurse into it
-            if ((child[1] != NULL) && (box.high()[splitAxis] > splitLocation)) {
-                child[1]->getIntersectingMembers(box, sphere, members, useSphere);
+            if ((child[1] != NULL) && (box.high()[splitAxis] > splitLocation) &&
+                child[1]->bounds.intersects(box)) {
+                child[1]->getIntersectingMembers(box, sphere, members);
+            }
+        }
+
+        /** Counts the nodes and values that getIntersectingMembers visits for box. */
+        int countVisits(const AABox& box, int& valuesTested) const {
+            valuesTested += valueArray.size();
+            int nodes = 1;
+            if ((child[0] != NULL) && (box.low()[splitAxis] < splitLocation) &&
+                child[0]->bounds.intersects(box)) {
+                nodes += child[0]->countVisits(box, valuesTested);
+            }
+            if ((child[1] != NULL) && (box.high()[splitAxis] > splitLocation) &&
+                child[1]->bounds.intersects(box)) {
+                nodes += child[1]->countVisits(box, valuesTested);
+            }
+            return nodes;
+        }
+
+        /**
+         Recomputes bounds, subtreeSize, and cost for this node and its
+         descendants.  The cost of a node is one traversal step plus the
+         number of values at it plus, for each child, the probability that
+         a query reaching this node reaches the child (the ratio of their
+         bounds' areas) times the child's cost.
+         */
+        void refit() {
+            Vector3 lo = Vector3::inf();
+            Vector3 hi = -lo;
+            subtreeSize = valueArray.size();
+            for (int v = 0; v < valueArray.size(); ++v) {
+                lo = lo.min(valueArray[v].bounds.low());
+                hi = hi.max(valueArray[v].bounds.high());
+            }
+
+            for (int c = 0; c < 2; ++c) {
+                if (child[c] != NULL) {
+                    child[c]->refit();
+                    if (child[c]->subtreeSize > 0) {
+                        subtreeSize += child[c]->subtreeSize;
+                        lo = lo.min(child[c]->bounds.low());
+                        hi = hi.max(child[c]->bounds.high());
+                    }
+                }
+            }
+
+            if (subtreeSize == 0) {
+                bounds = AABox::inf();
+                cost = 0;
+                return;
+            }
+
+            bounds = AABox(lo, hi);
+            const float area = bounds.area();
+            cost = 1.0f + valueArray.size();
+            for (int c = 0; c < 2; ++c) {
+                if ((child[c] != NULL) && (child[c]->subtreeSize > 0)) {
+                    const float p = (area > 0) ? (child[c]->bounds.area() / area) : 1.0f;
+                    cost += p * child[c]->cost;
+                }
             }
         }
 
@@ -585,6 +677,273 @@ private:
 	    return node;
     }
 
+    /** True if the high side of the bounds is below the location on the axis.
+        Used by makeNodeSAH. */
+    class HighLT {
+    public:
+        Vector3::Axis           axis;
+        float                   location;
+
+        HighLT(Vector3::Axis a, float l) : axis(a), location(l) {}
+
+        inline bool operator()(const Handle& h) const {
+            return h.bounds.high()[axis] < location;
+        }
+    };
+
+    /** True if the low side of the bounds is not above the location on the axis.
+        Used by makeNodeSAH. */
+    class LowLE {
+    public:
+        Vector3::Axis           axis;
+        float                   location;
+
+        LowLE(Vector3::Axis a, float l) : axis(a), location(l) {}
+
+        inline bool operator()(const Handle& h) const {
+            return h.bounds.low()[axis] <= location;
+        }
+    };
+
+    enum {
+        /** Upper bound on the numBins argument of balanceSAH */
+        MAX_SAH_BINS = 64,
+
+        /** Bins used by balanceSAH by default and by refit */
+        DEFAULT_SAH_BINS = 16,
+
+        /** Subtrees with at least this many values are built as separate
+            tasks by balanceSAH */
+        MIN_PARALLEL_SAH_BUILD = 1024};
+
+    /** Builds the subtree for a subarray on a thread pool.  Used by makeNodeSAH. */
+    class SAHBuildTask : public ThreadPool::Task {
+    public:
+        Node**                  result;
+        Array<Handle>&          point;
+        int                     beginIndex;
+        int                     endIndex;
+        int                     valuesPerNode;
+        int                     numBins;
+        ThreadPool::TaskGroup&  group;
+
+        SAHBuildTask(Node** r, Array<Handle>& p, int b, int e, int v, int n, ThreadPool::TaskGroup& g) :
+            result(r), point(p), beginIndex(b), endIndex(e), valuesPerNode(v), numBins(n), group(g) {}
+
+        virtual void run() {
+            *result = makeNodeSAH(point, beginIndex, endIndex, valuesPerNode, numBins, group);
+        }
+    };
+
+    /** Bin index of location x in [lo, lo + numBins / scale) */
+    static inline int sahBin(float x, float lo, float scale, int numBins) {
+        return iClamp(iFloor((x - lo) * scale), 0, numBins - 1);
+    }
+
+    /**
+     Like makeNode, but chooses each splitting plane with a binned surface
+     area heuristic: the expected cost of a query that reaches the node is
+     one traversal step plus one test for every straddling value, plus one
+     test for every value in each child weighted by the probability that
+     the query reaches the child (the area of the child's side of the
+     node's bounds over the area of the node's bounds).  Candidate planes are the numBins - 1 bin boundaries on each
+     axis.  The node becomes a leaf if no plane beats testing every value.
+
+     Children with at least MIN_PARALLEL_SAH_BUILD values are built as
+     tasks in group.  Does not touch the memberTable, so that subtrees can
+     be built concurrently; balanceSAH fills it in afterwards.
+     */
+    static Node* makeNodeSAH(Array<Handle>& point, int beginIndex,
+                             int endIndex, int valuesPerNode, 
+                             int numBins, ThreadPool::TaskGroup& group) {
+
+        const int n = endIndex - beginIndex + 1;
+        if (n <= valuesPerNode) {
+            return new Node(point, beginIndex, endIndex);
+        }
+
+        const AABox bounds = computeBounds(point, beginIndex, endIndex);
+        const float parentArea = bounds.area();
+
+        // Each value is binned twice: by its low and by its high coordinate.  Plane k
+        // lies between bins k - 1 and k.  Values whose high is in a bin below k are
+        // on the low side; values whose low is in bin k or above are on the high side.
+        int     lowCount[MAX_SAH_BINS];
+        int     highCount[MAX_SAH_BINS];
+
+        float         bestCost     = (float)n;
+        Vector3::Axis bestAxis     = Vector3::X_AXIS;
+        float         bestLocation = 0;
+        bool          found        = false;
+
+        for (int a = 0; a < 3; ++a) {
+            const Vector3::Axis axis = (Vector3::Axis)a;
+            const float lo = bounds.low()[axis];
+            const float extent = bounds.high()[axis] - lo;
+            if (! (extent > 0)) {
+                continue;
+            }
+            const float scale = numBins / extent;
+
+            for (int b = 0; b < numBins; ++b) {
+                lowCount[b] = highCount[b] = 0;
+            }
+
+            for (int i = beginIndex; i <= endIndex; ++i) {
+                const AABox& box = point[i].bounds;
+                ++lowCount[sahBin(box.low()[axis], lo, scale, numBins)];
+                ++highCount[sahBin(box.high()[axis], lo, scale, numBins)];
+            }
+
+            int left = 0;
+            int right = n;
+            for (int k = 1; k < numBins; ++k) {
+                left  += highCount[k - 1];
+                right -= lowCount[k - 1];
+
+                if (left + right == 0) {
+                    // Every value straddles this plane
+                    continue;
+                }
+
+                const float location = lo + k / scale;
+                // Roundoff can put the plane on the boundary, which would
+                // leave a child with every value
+                if ((location <= lo) || (location >= bounds.high()[axis])) {
+                    continue;
+                }
+
+                // A query reaches a child if it enters the child's half of the
+                // node's bounds.  Bounds with no area are a line along this
+                // axis, where the chance is in proportion to length.
+                float leftFraction, rightFraction;
+                if (parentArea > 0) {
+                    Vector3 splitHi = bounds.high();
+                    Vector3 splitLo = bounds.low();
+                    splitHi[axis] = location;
+                    splitLo[axis] = location;
+                    leftFraction  = AABox(bounds.low(), splitHi).area() / parentArea;
+                    rightFraction = AABox(splitLo, bounds.high()).area() / parentArea;
+                } else {
+                    leftFraction  = (location - lo) / extent;
+                    rightFraction = (bounds.high()[axis] - location) / extent;
+                }
+
+                const int straddle = n - left - right;
+                const float cost = 1.0f + straddle +
+                    leftFraction * left + rightFraction * right;
+
+                if (cost < bestCost) {
+                    bestCost     = cost;
+                    bestAxis     = axis;
+                    bestLocation = location;
+                    found        = true;
+                }
+            }
+        }
+
+        if (! found) {
+            // Splitting would not make queries cheaper
+            return new Node(point, beginIndex, endIndex);
+        }
+
+        Node* node = new Node();
+        node->splitAxis     = bestAxis;
+        node->splitLocation = bestLocation;
+
+        // Partition into low side, straddling, and high side
+        Handle* begin = point.getCArray() + beginIndex;
+        Handle* end   = point.getCArray() + endIndex + 1;
+        Handle* overlapBegin = std::partition(begin, end, HighLT(bestAxis, bestLocation));
+        Handle* overlapEnd   = std::partition(overlapBegin, end, LowLE(bestAxis, bestLocation));
+
+        node->valueArray.resize(overlapEnd - overlapBegin);
+        for (int i = 0; i < node->valueArray.size(); ++i) {
+            node->valueArray[i] = overlapBegin[i];
+        }
+
+        const int childBegin[2] = {beginIndex, endIndex + 1 - (int)(end - overlapEnd)};
+        const int childEnd[2]   = {beginIndex + (int)(overlapBegin - begin) - 1, endIndex};
+
+        for (int c = 0; c < 2; ++c) {
+            const int count = childEnd[c] - childBegin[c] + 1;
+            if (count >= MIN_PARALLEL_SAH_BUILD) {
+                group.run(new SAHBuildTask(&node->child[c], point, childBegin[c], childEnd[c],
+                                           valuesPerNode, numBins, group), true);
+            } else if (count > 0) {
+                node->child[c] = makeNodeSAH(point, childBegin[c], childEnd[c],
+                                             valuesPerNode, numBins, group);
+            }
+        }
+
+        return node;
+    }
+
+    /**
+     Deletes node if its subtree is empty and rebuilds it if its cost has
+     grown by more than costThreshold; otherwise recurses into the children.
+     Returns the node that replaces node, which may be NULL.  Node::refit()
+     must have been called on the subtree.  Used by refit.
+     */
+    Node* maintainNode(Node* node, int valuesPerNode, float costThreshold) {
+        if (node->subtreeSize == 0) {
+            // Deleting the node removes its splitting plane; the values that
+            // would have gone below it go to the parent until the next rebuild
+            delete node;
+            return NULL;
+        }
+
+        if (node->builtCost == 0) {
+            node->builtCost = node->cost;
+        } else if ((node->subtreeSize > valuesPerNode) &&
+                   (node->cost > costThreshold * node->builtCost)) {
+            return rebuildNode(node, valuesPerNode);
+        }
+
+        for (int c = 0; c < 2; ++c) {
+            if (node->child[c] != NULL) {
+                node->child[c] = maintainNode(node->child[c], valuesPerNode, costThreshold);
+            }
+        }
+        return node;
+    }
+
+    /** Replaces the subtree with one built by makeNodeSAH over the same
+        region of space.  Used by refit. */
+    Node* rebuildNode(Node* node, int valuesPerNode) {
+        Array<Handle> handleArray;
+        node->getHandles(handleArray);
+        const AABox region = node->splitBounds;
+        delete node;
+
+        Node* result;
+        {
+            ThreadPool::TaskGroup group;
+            result = makeNodeSAH(handleArray, 0, handleArray.size() - 1, 
+                valuesPerNode, DEFAULT_SAH_BINS, group);
+            group.wait();
+        }
+
+        setMemberTable(result);
+        result->assignSplitBounds(region);
+        result->refit();
+        result->builtCost = result->cost;
+        return result;
+    }
+
+    /** Points the memberTable entries for the values in the subtree at
+        their nodes. */
+    void setMemberTable(Node* node) {
+        for (int i = 0; i < node->valueArray.size(); ++i) {
+            memberTable.set(node->valueArray[i].value, node);
+        }
+        for (int c = 0; c < 2; ++c) {
+            if (node->child[c] != NULL) {
+                setMemberTable(node->child[c]);
+            }
+        }
+    }
+
     /**
      Recursively clone the passed in node tree, setting
      pointers for members in the memberTable as appropriate.
@@ -609,7 +968,7 @@ private:
     }
 
     /** Maps members to the node containing them */
-    Table<T, Node*>         memberTable;
+    FlatTable<T, Node*>     memberTable;
 
     Node*                   root;
 
@@ -759,6 +1118,18 @@ public:
     }
 
 
+    /**
+     Calls update(value) on every element of the array.  Follow a batch of
+     updates with refit() to limit how much queries slow down as members
+     move.
+     */
+    void update(const Array<T>& valueArray) {
+        for (int i = 0; i < valueArray.size(); ++i) {
+            update(valueArray[i]);
+        }
+    }
+
+
     /**
      Rebalances the tree (slow).  Call when objects
      have moved substantially from their original positions
@@ -798,12 +1169,102 @@ public:
         // Walk the tree, assigning splitBounds.  We start with unbounded
         // space.
         root->assignSplitBounds(AABox::maxFinite());
+        root->refit();
 
         #ifdef _DEBUG
         root->verifyNode(Vector3::minFinite(), Vector3::maxFinite());
         #endif
     }
 
+
+    /**
+     Rebalances the tree like balance(), choosing splitting planes with a
+     surface area heuristic instead of the mean or median.  This adapts to
+     clustered and unevenly sized members, and usually lowers the number of
+     nodes and members that ray and box queries visit, at a higher cost to
+     build.  Large subtrees are built in parallel on ThreadPool::common().
+
+     @param valuesPerNode Nodes with this many or fewer values are never split.
+     Nodes with more become leaves only when no split is estimated to make
+     queries cheaper.
+
+     @param numBins Number of candidate planes + 1 per axis at each node,
+     between 2 and 64.
+     */
+    void balanceSAH(int valuesPerNode = 5, int numBins = DEFAULT_SAH_BINS) {
+        if (root == NULL) {
+            // Tree is empty
+            return;
+        }
+
+        Array<Handle> handleArray;
+        root->getHandles(handleArray);
+
+        // Delete the old tree
+        clear();
+
+        numBins = iClamp(numBins, 2, MAX_SAH_BINS);
+        {
+            ThreadPool::TaskGroup group;
+            root = makeNodeSAH(handleArray, 0, handleArray.size() - 1, 
+                valuesPerNode, numBins, group);
+            group.wait();
+        }
+
+        setMemberTable(root);
+        root->assignSplitBounds(AABox::maxFinite());
+        root->refit();
+
+        #ifdef _DEBUG
+        root->verifyNode(Vector3::minFinite(), Vector3::maxFinite());
+        #endif
+    }
+
+
+    /**
+     Incremental alternative to balance() for trees whose members move,
+     e.g., once per frame after update()s.
+
+     Recomputes the bounds of the members below every node and the
+     expected cost of a query through it, deletes subtrees that have
+     become empty, and rebuilds (as balanceSAH does) every subtree whose
+     cost has grown to more than costThreshold times its cost when it was
+     built.  The cost of a subtree built by balance(), balanceSAH(),
+     or insert() is measured at the first refit().  Subtrees that are
+     still efficient keep their splitting planes, so when few members move
+     far, refit() costs a walk over the nodes.
+
+     Box, sphere, and plane queries skip every subtree whose members'
+     bounds they miss.  Inserts since the last refit() grow these bounds;
+     removes do not shrink them.  The expected cost of a query is kept
+     within about costThreshold times the cost of the same subtrees when
+     they were built, not the cost of a fresh balanceSAH(); lower
+     costThreshold to rebuild more often.
+
+     @param valuesPerNode Subtrees with this many or fewer values are not rebuilt.
+     */
+    void refit(int valuesPerNode = 5, float costThreshold = 1.5f) {
+        if (root == NULL) {
+            return;
+        }
+
+        root->refit();
+        root = maintainNode(root, valuesPerNode, costThreshold);
+    }
+
+
+    /**
+     Returns the number of nodes that getIntersectingMembers(box) visits
+     and adds the number of member bounds it tests to valuesTested.  For
+     measuring the quality of a tree.
+     */
+    int debugCountBoxQueryVisits(const AABox& box, int& valuesTested) const {
+        if (root == NULL) {
+            return 0;
+        }
+        return root->countVisits(box, valuesTested);
+    }
+
 private:
 
     /**
@@ -843,7 +1304,8 @@ private:
             // Iterate through child nodes
             for (int c = 0; c < 2; ++c) {
                 if (node->child[c] &&
-                    ! node->child[c]->splitBounds.culledBy(plane, dummy, parentMask, childMask)) {
+                    ! node->child[c]->splitBounds.culledBy(plane, dummy, parentMask, childMask) &&
+                    ! node->child[c]->bounds.culledBy(plane, dummy, parentMask)) {
                     // This node was not culled
                     getIntersectingMembers(plane, members, node->child[c], childMask);
                 }
@@ -1079,7 +1541,7 @@ public:
         if (root == NULL) {
             return;
         }
-        root->getIntersectingMembers(box, Sphere(Vector3::zero(), 0), members, false);
+        root->getIntersectingMembers(box, NULL, members);
     }
 
 
@@ -1093,8 +1555,420 @@ public:
 
         AABox box;
         sphere.getBounds(box);
-        root->getIntersectingMembers(box, sphere, members, true);
+        root->getIntersectingMembers(box, &sphere, members);
+
+    }
+
+    /**
+     Holds the results of the batched getIntersectingMembers.  Keep one
+     between calls; its arrays (and the per-thread scratch arrays) only
+     grow, so a steady stream of batches does not allocate.
+     */
+    class IntersectionBatch {
+    private:
+        friend class AABSPTree<T>;
+
+        /** Members found for each block of BATCH_BLOCK_SIZE queries */
+        Array< Array<T> >   block;
+
+    public:
+        /** The members intersecting query i are members[offset[i]]
+            through members[offset[i + 1] - 1]. */
+        Array<T>            members;
+
+        /** One more than the number of queries */
+        Array<int>          offset;
+
+        int numQueries() const {
+            return iMax(offset.size() - 1, 0);
+        }
+
+        /** Number of members intersecting query i */
+        int count(int i) const {
+            return offset[i + 1] - offset[i];
+        }
+
+        /** Frees all memory */
+        void clear() {
+            block.clear();
+            members.clear();
+            offset.clear();
+        }
+    };
+
+private:
+
+    enum {BATCH_BLOCK_SIZE = 32};
+
+    /** parallelFor body for the batched getIntersectingMembers.  Each index
+        is a block of queries.  If sphere is NULL the queries are boxes. */
+    class IntersectionBody {
+    public:
+        const Node*             root;
+        const AABox*            box;
+        const Sphere*           sphere;
+        int                     numQueries;
+        IntersectionBatch*      batch;
+
+        void operator()(int begin, int end) const {
+            for (int b = begin; b < end; ++b) {
+                Array<T>& out = batch->block[b];
+                out.fastClear();
+
+                const int last = iMin((b + 1) * BATCH_BLOCK_SIZE, numQueries);
+                for (int i = b * BATCH_BLOCK_SIZE; i < last; ++i) {
+                    const int old = out.size();
+                    if (root != NULL) {
+                        if (sphere == NULL) {
+                            root->getIntersectingMembers(box[i], NULL, out);
+                        } else {
+                            AABox bounds;
+                            sphere[i].getBounds(bounds);
+                            root->getIntersectingMembers(bounds, sphere + i, out);
+                        }
+                    }
+                    // Count for query i until the prefix sum
+                    batch->offset[i + 1] = out.size() - old;
+                }
+            }
+        }
+    };
+
+    /** parallelFor body that copies each block to its place in members */
+    class GatherBody {
+    public:
+        IntersectionBatch*      batch;
+
+        void operator()(int begin, int end) const {
+            for (int b = begin; b < end; ++b) {
+                const Array<T>& in = batch->block[b];
+                T* out = batch->members.getCArray() + batch->offset[b * BATCH_BLOCK_SIZE];
+                for (int j = 0; j < in.size(); ++j) {
+                    out[j] = in[j];
+                }
+            }
+        }
+    };
+
+    void getIntersectingMembers(
+        const AABox*        box,
+        const Sphere*       sphere,
+        int                 n,
+        IntersectionBatch&  batch,
+        ThreadPool*         pool) const {
+
+        if (pool == NULL) {
+            pool = &ThreadPool::common();
+        }
+
+        const int numBlocks = (n + BATCH_BLOCK_SIZE - 1) / BATCH_BLOCK_SIZE;
+        if (batch.block.size() < numBlocks) {
+            batch.block.resize(numBlocks);
+        }
+        batch.offset.resize(n + 1, DONT_SHRINK_UNDERLYING_ARRAY);
+
+        IntersectionBody body;
+        body.root       = root;
+        body.box        = box;
+        body.sphere     = sphere;
+        body.numQueries = n;
+        body.batch      = &batch;
+        pool->parallelFor(0, numBlocks, 1, body);
+
+        batch.offset[0] = 0;
+        for (int i = 0; i < n; ++i) {
+            batch.offset[i + 1] += batch.offset[i];
+        }
+
+        batch.members.resize(batch.offset[n], DONT_SHRINK_UNDERLYING_ARRAY);
+        GatherBody gather;
+        gather.batch = &batch;
+        pool->parallelFor(0, numBlocks, 1, gather);
+    }
+
+public:
+
+    /**
+     Finds the members intersecting each box, e.g., one query per entity
+     per frame for interest management.  Blocks of queries run in
+     parallel on pool, or on ThreadPool::common() if pool is NULL.  batch
+     keeps its storage between calls, so reusing one batch does not
+     allocate once it has grown to size.  The results replace the
+     contents of batch; see IntersectionBatch.
+     */
+    void getIntersectingMembers(const Array<AABox>& box, IntersectionBatch& batch, ThreadPool* pool = NULL) const {
+        getIntersectingMembers(box.getCArray(), NULL, box.size(), batch, pool);
+    }
+
+    /**
+     Finds the members intersecting each sphere.  See the batched
+     getIntersectingMembers for boxes.
+     */
+    void getIntersectingMembers(const Array<Sphere>& sphere, IntersectionBatch& batch, ThreadPool* pool = NULL) const {
+        getIntersectingMembers(NULL, sphere.getCArray(), sphere.size(), batch, pool);
+    }
+
+private:
+
+    /** Distance from the point to the closest point of the box; 0 inside */
+    static inline float distanceToBox(const Vector3& point, const AABox& box) {
+        const Vector3 d = (box.low() - point).max(point - box.high()).max(Vector3::zero());
+        return d.length();
+    }
+
+    /** Node waiting to be searched by findNearest */
+    class NodeDistance {
+    public:
+        const Node*         node;
+        float               distance;
+
+        /** Orders a heap with the closest node on top */
+        inline bool operator<(const NodeDistance& other) const {
+            return distance > other.distance;
+        }
+    };
+
+    /** Member found by findNearest */
+    class Neighbor {
+    public:
+        const T*            value;
+        float               distance;
+
+        /** Orders a heap with the farthest member on top */
+        inline bool operator<(const Neighbor& other) const {
+            return distance < other.distance;
+        }
+    };
+
+    /**
+     Best-first search for the k members closest to point.  Nodes are
+     visited in order of the distance to their split bounds, and the search
+     stops when the closest remaining node is farther than the kth member
+     found so far.  Members are only passed to distance if their bounds are
+     close enough.
+
+     @param best Set to the members found, sorted by increasing distance.
+     @param queue Scratch space.
+     */
+    template<class Distance>
+    void findNearest(
+        const Vector3&          point,
+        int                     k,
+        float                   maxDistance,
+        Distance&               distance,
+        Array<Neighbor>&        best,
+        Array<NodeDistance>&    queue) const {
+
+        best.fastClear();
+        queue.fastClear();
+        if ((root == NULL) || (k <= 0)) {
+            return;
+        }
+
+        NodeDistance& first = queue.next();
+        first.node     = root;
+        first.distance = distanceToBox(point, root->splitBounds);
+
+        while (queue.size() > 0) {
+            std::pop_heap(queue.getCArray(), queue.getCArray() + queue.size());
+            const NodeDistance current = queue.pop();
+
+            // Distance that a member must beat to be kept
+            const float bound = (best.size() < k) ? maxDistance : best[0].distance;
+            if (current.distance > bound) {
+                break;
+            }
+
+            const Node* node = current.node;
+            for (int v = 0; v < node->valueArray.size(); ++v) {
+                const Handle& h = node->valueArray[v];
+                const float limit = (best.size() < k) ? maxDistance : best[0].distance;
+                if (distanceToBox(point, h.bounds) > limit) {
+                    continue;
+                }
+
+                const float d = distance(point, h.value);
+                if (best.size() < k) {
+                    if (d <= maxDistance) {
+                        Neighbor& n = best.next();
+                        n.value    = &h.value;
+                        n.distance = d;
+                        std::push_heap(best.getCArray(), best.getCArray() + best.size());
+                    }
+                } else if (d < best[0].distance) {
+                    // Replace the farthest
+                    std::pop_heap(best.getCArray(), best.getCArray() + best.size());
+                    Neighbor& n = best.last();
+                    n.value    = &h.value;
+                    n.distance = d;
+                    std::push_heap(best.getCArray(), best.getCArray() + best.size());
+                }
+            }
+
+            for (int c = 0; c < 2; ++c) {
+                if (node->child[c] != NULL) {
+                    const float d = distanceToBox(point, node->child[c]->splitBounds);
+                    if (d <= ((best.size() < k) ? maxDistance : best[0].distance)) {
+                        NodeDistance& n = queue.next();
+                        n.node     = node->child[c];
+                        n.distance = d;
+                        std::push_heap(queue.getCArray(), queue.getCArray() + queue.size());
+                    }
+                }
+            }
+        }
+
+        std::sort_heap(best.getCArray(), best.getCArray() + best.size());
+    }
+
+    /** parallelFor body for the batched getNearestMembers.  Writes up to k
+        members per point at stride k. */
+    template<class Distance>
+    class NearestBody {
+    public:
+        const AABSPTree<T>*     tree;
+        const Vector3*          point;
+        int                     k;
+        float                   maxDistance;
+        Distance*               distance;
+        T*                      member;
+        int*                    count;
+
+        void operator()(int begin, int end) const {
+            Array<Neighbor>     best;
+            Array<NodeDistance> queue;
+            for (int i = begin; i < end; ++i) {
+                tree->findNearest(point[i], k, maxDistance, *distance, best, queue);
+                count[i] = best.size();
+                for (int j = 0; j < best.size(); ++j) {
+                    member[i * k + j] = *best[j].value;
+                }
+            }
+        }
+    };
+
+public:
+
+    /** Distance from a point to the bounds of a member; the default
+        distance for getNearestMembers and getNearestMember. */
+    class BoundsDistance {
+    public:
+        inline float operator()(const Vector3& point, const T& value) const {
+            AABox bounds;
+            getBounds(value, bounds);
+            return distanceToBox(point, bounds);
+        }
+    };
+
+    /**
+     Appends the k members closest to point (fewer if the tree is smaller
+     or if fewer are within maxDistance), closest first.
+
+     @param distance A function object
+     <CODE>float distance(const Vector3& point, const T& value)</CODE>
+     that returns the exact distance from the point to the member.  It
+     must never be less than the distance to the member's bounds, which is
+     used to skip members.  See BoundsDistance.
+     */
+    template<class Distance>
+    void getNearestMembers(
+        const Vector3&      point,
+        int                 k,
+        Array<T>&           members,
+        Distance&           distance,
+        float               maxDistance = inf()) const {
+
+        Array<Neighbor> best;
+        Array<NodeDistance> queue;
+        findNearest(point, k, maxDistance, distance, best, queue);
+        for (int i = 0; i < best.size(); ++i) {
+            members.append(*best[i].value);
+        }
+    }
+
+    /** Measures distance to the bounds of the members. */
+    void getNearestMembers(const Vector3& point, int k, Array<T>& members, float maxDistance = inf()) const {
+        BoundsDistance distance;
+        getNearestMembers(point, k, members, distance, maxDistance);
+    }
+
+    /**
+     Finds the member closest to point within maxDistance.  Returns false
+     if there is none.  See getNearestMembers for the distance function.
+     */
+    template<class Distance>
+    bool getNearestMember(const Vector3& point, T& member, Distance& distance, float maxDistance = inf()) const {
+        Array<Neighbor> best;
+        Array<NodeDistance> queue;
+        findNearest(point, 1, maxDistance, distance, best, queue);
+        if (best.size() == 0) {
+            return false;
+        }
+        member = *best[0].value;
+        return true;
+    }
+
+    /** Measures distance to the bounds of the members. */
+    bool getNearestMember(const Vector3& point, T& member, float maxDistance = inf()) const {
+        BoundsDistance distance;
+        return getNearestMember(point, member, distance, maxDistance);
+    }
+
+    /**
+     Finds the k nearest members of each point in parallel on
+     ThreadPool::common().  The members for point[i] are
+     members[offset[i]] through members[offset[i + 1] - 1], closest first.
+
+     @param members Resized; previous contents are lost
+     @param offset Resized to point.size() + 1
+     @param distance Called concurrently from several threads.
+     */
+    template<class Distance>
+    void getNearestMembers(
+        const Array<Vector3>&   point,
+        int                     k,
+        Array<T>&               members,
+        Array<int>&             offset,
+        Distance&               distance,
+        float                   maxDistance = inf()) const {
+
+        const int n = point.size();
+        k = iMax(k, 0);
+        members.resize(n * k, DONT_SHRINK_UNDERLYING_ARRAY);
+        offset.resize(n + 1, DONT_SHRINK_UNDERLYING_ARRAY);
+
+        NearestBody<Distance> body;
+        body.tree        = this;
+        body.point       = point.getCArray();
+        body.k           = k;
+        body.maxDistance = maxDistance;
+        body.distance    = &distance;
+        body.member      = members.getCArray();
+        // offset[i + 1] holds the count for point i until the prefix sum below
+        body.count       = offset.getCArray() + 1;
+        ThreadPool::common().parallelFor(0, n, 64, body);
+
+        // Close the gaps left by points with fewer than k members
+        offset[0] = 0;
+        for (int i = 0; i < n; ++i) {
+            const int count = offset[i + 1];
+            for (int j = 0; j < count; ++j) {
+                members[offset[i] + j] = members[i * k + j];
+            }
+            offset[i + 1] = offset[i] + count;
+        }
+        members.resize(offset[n], DONT_SHRINK_UNDERLYING_ARRAY);
+    }
 
+    /** Measures distance to the bounds of the members. */
+    void getNearestMembers(
+        const Array<Vector3>&   point,
+        int                     k,
+        Array<T>&               members,
+        Array<int>&             offset,
+        float                   maxDistance = inf()) const {
+        BoundsDistance distance;
+        getNearestMembers(point, k, members, offset, distance, maxDistance);
     }
 
     /** See AABSPTree::beginRayIntersection */
@@ -1552,11 +2426,11 @@ public:
     private:
         friend class AABSPTree<T>;
 
-        // Note: this is a Table iterator, we are currently defining
+        // Note: this is a FlatTable iterator, we are currently defining
         // Set iterator
-        typename Table<T, Node*>::Iterator it;
+        typename FlatTable<T, Node*>::Iterator it;
 
-        Iterator(const typename Table<T, Node*>::Iterator& it) : it(it) {}
+        Iterator(const typename FlatTable<T, Node*>::Iterator& it) : it(it) {}
 
     public:
         inline bool operator!=(const Iterator& other) const {
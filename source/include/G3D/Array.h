@@ -17,6 +17,7 @@
 #include "G3D/platform.h"
 #include "G3D/debug.h"
 #include "G3D/System.h"
+#include "G3D/MemoryArena.h"
 #include <vector>
 #include <algorithm>
 
@@ -75,6 +76,9 @@ const int SORT_DECREASING = -1;
  Array::getCArray.  Although (T*)std::vector::begin() can be used for
  this purpose, it is not guaranteed to succeed on all platforms.
 
+ An Array may be backed by a G3D::MemoryArena instead of the heap
+ for scratch data; see clearAndSetMemoryArena.
+
  Do not subclass an Array.
  */
 template <class T>
@@ -86,9 +90,14 @@ private:
     int             num;
     int             numAllocated;
 
+    /** If non-NULL, storage comes from here instead of System::alignedMalloc
+        and is never explicitly freed. */
+    MemoryArena*    arena;
+
     void init(int n, int a) {
         debugAssert(n <= a);
         debugAssert(n >= 0);
+        this->arena = NULL;
         this->num = 0;
         this->numAllocated = 0;
         data = NULL;
@@ -134,7 +143,11 @@ private:
          // elements are actually revealed to the application.  They 
          // will be constructed in the resize() method.
 
-         data = (T*)System::alignedMalloc(sizeof(T) * numAllocated, 16);
+         if (arena == NULL) {
+             data = (T*)System::alignedMalloc(sizeof(T) * numAllocated, 16);
+         } else {
+             data = (T*)arena->alloc(sizeof(T) * numAllocated, 16);
+         }
 
          // Call the copy constructors
          {const int N = iMin(oldNum, numAllocated);
@@ -157,8 +170,9 @@ private:
               ptr->~T();
          }}
 
-
-         System::alignedFree(oldData);
+         if (arena == NULL) {
+             System::alignedFree(oldData);
+         }
     }
 
 public:
@@ -242,7 +256,9 @@ public:
            (data + i)->~T();
        }
        
-       System::alignedFree(data);
+       if (arena == NULL) {
+           System::alignedFree(data);
+       }
        // Set to 0 in case this Array is global and gets referenced during app exit
        data = NULL;
 	   num = 0;
@@ -264,6 +280,33 @@ public:
        resize(0, false);
    }
 
+   /**
+    Removes all elements, releases the underlying storage, and then
+    allocates all future storage from arena (or from the heap if arena is
+    NULL).  Destroy or clear the Array before the arena is reset or released
+    past the Array's storage; declaring the Array inside a MemoryArena::Scope
+    guarantees this.
+
+    Copies of an arena-backed Array are heap-backed.
+    */
+   void clearAndSetMemoryArena(MemoryArena* a) {
+       for (int i = 0; i < num; ++i) {
+           (data + i)->~T();
+       }
+       if (arena == NULL) {
+           System::alignedFree(data);
+       }
+       data = NULL;
+       num = 0;
+       numAllocated = 0;
+       arena = a;
+   }
+
+   /** The arena set by clearAndSetMemoryArena, or NULL if heap-backed. */
+   inline MemoryArena* memoryArena() const {
+       return arena;
+   }
+
    /**
     Assignment operator.
     */
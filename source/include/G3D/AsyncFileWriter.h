@@ -0,0 +1,117 @@
+/**
+  @file AsyncFileWriter.h
+
+  Background thread that writes buffers to disk.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_ASYNCFILEWRITER_H
+#define G3D_ASYNCFILEWRITER_H
+
+#include "G3D/platform.h"
+#include "G3D/ReferenceCount.h"
+#include "G3D/GThread.h"
+#include <string>
+
+namespace G3D {
+
+namespace _internal {
+    class AsyncFileWriterThread;
+}
+
+typedef ReferenceCountedPointer<class AsyncWrite> AsyncWriteRef;
+
+/**
+ Completion handle for a buffer queued with AsyncFileWriter::write,
+ e.g., by BinaryOutput::commitAsync or TextOutput::commitAsync.
+
+ The handle may be discarded at any time; the write still completes.
+ */
+class AsyncWrite : public ReferenceCountedObject {
+private:
+    friend class AsyncFileWriter;
+    friend class _internal::AsyncFileWriterThread;
+
+    std::string         _filename;
+
+    /** Owned; freed with System::free once written. */
+    uint8*              data;
+    size_t              length;
+    bool                append;
+
+    /** Released once when the write finishes. */
+    GSemaphore          done;
+
+    /** Set by the writer thread before done is released. */
+    volatile bool       _completed;
+    bool                _ok;
+
+    AsyncWrite(const std::string& filename, uint8* data, size_t length, bool append);
+
+public:
+
+    ~AsyncWrite();
+
+    const std::string& filename() const {
+        return _filename;
+    }
+
+    /** True once the data has been written (or the write failed). */
+    bool completed() const {
+        return _completed;
+    }
+
+    /** Blocks until completed().  May be called multiple times and
+        from multiple threads. */
+    void wait();
+
+    /** False if the file could not be opened or fully written. Only
+        meaningful after completed(). */
+    bool ok() const {
+        return _ok;
+    }
+};
+
+
+/**
+ Writes files on a single background thread so that the calling thread
+ does not block on disk I/O.  Writes are performed in the order they were
+ queued, so a file may be built up with several appending writes.
+
+ At most maxPending() writes may be queued at once.  When the queue is
+ full, write() blocks until the oldest pending write finishes.  This bounds
+ the memory held by producers that generate data faster than the disk can
+ absorb it.
+
+ Pending writes are completed before the program exits normally.
+ */
+class AsyncFileWriter {
+public:
+
+    /**
+     Queues data for writing and returns immediately unless the queue is full.
+
+     @param data Allocated with System::malloc.  The writer takes ownership
+     and frees it once written; the caller must not touch it afterward.
+     @param append If false, the file is truncated first and its parent
+     directories are created if they do not exist.
+     */
+    static AsyncWriteRef write(const std::string& filename, uint8* data, size_t length, bool append = false);
+
+    /** Blocks until every write queued so far has completed. */
+    static void waitForAll();
+
+    /** Maximum number of writes that may be queued at once; default is 4.
+        Lowering the limit blocks until enough pending writes complete. */
+    static void setMaxPending(int n);
+
+    static int maxPending();
+};
+
+}
+
+#endif
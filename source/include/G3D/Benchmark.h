@@ -0,0 +1,218 @@
+/**
+  @file Benchmark.h
+
+  Harness for timing named cases with statistics and regression baselines.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_BENCHMARK_H
+#define G3D_BENCHMARK_H
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/G3DGameUnits.h"
+#include <string>
+
+namespace G3D {
+
+/**
+ Runs registered benchmark cases and reports statistics over repeated
+ timed iterations.
+
+ Each case first runs a few untimed warm-up iterations (to fill caches and
+ page in memory) and then timed iterations until both
+ Settings::minIterations and Settings::minTime have been reached, or
+ Settings::maxIterations is hit.  The result for each case holds the
+ median, 95th percentile, mean, standard deviation, and minimum time per
+ iteration, and the median cycles per element.
+
+ Results can be written as JSON or CSV.  A CSV file written by an earlier
+ run can be used as a baseline: compareToBaseline() marks every case whose
+ median is more than Settings::regressionThreshold slower than the
+ baseline's.
+
+ <PRE>
+    class AppendCase : public Benchmark::Case {
+    public:
+        Array<int> a;
+        virtual void run() {
+            a.fastClear();
+            for (int i = 0; i < 10000; ++i) {
+                a.append(i);
+            }
+        }
+    };
+    ...
+    Benchmark benchmark;
+    benchmark.add("Array::append", new AppendCase(), 10000);
+    benchmark.run();
+    printf("%s", benchmark.report().c_str());
+    if (benchmark.compareToBaseline("baseline.csv") > 0) {
+        ...
+    }
+ </PRE>
+
+ <B>BETA API</B>  This is unsupported and may change
+ */
+class Benchmark {
+public:
+
+    /** Work to be timed.  Subclass and override run(). */
+    class Case {
+    public:
+        virtual ~Case() {}
+
+        /** Called once before any iteration of the case; not timed. */
+        virtual void setUp() {}
+
+        /** Called before every iteration (including warm-up); not timed.
+            Use this to restore state that run() consumes. */
+        virtual void beforeIteration() {}
+
+        /** One timed iteration */
+        virtual void run() = 0;
+
+        /** Called once after the last iteration; not timed. */
+        virtual void tearDown() {}
+    };
+
+    class Settings {
+    public:
+        /** Untimed iterations before measuring */
+        int             warmupIterations;
+
+        int             minIterations;
+
+        /** Must be at least 1 */
+        int             maxIterations;
+
+        /** Keep iterating until at least this much time has been measured */
+        RealTime        minTime;
+
+        /** Fraction by which a median may exceed the baseline before
+            compareToBaseline() reports a regression */
+        double          regressionThreshold;
+
+        /** If not empty, only cases whose names contain this string run */
+        std::string     filter;
+
+        /** Print each result as it completes */
+        bool            verbose;
+
+        Settings() : warmupIterations(1), minIterations(5), maxIterations(1000),
+            minTime(0.2), regressionThreshold(0.10), verbose(true) {}
+    };
+
+    /** Statistics for one case.  Times are seconds per iteration. */
+    class Result {
+    public:
+        std::string     name;
+        int             iterations;
+        int             elementsPerIteration;
+
+        RealTime        median;
+        RealTime        p95;
+        RealTime        mean;
+        RealTime        stddev;
+        RealTime        min;
+
+        /** Median cycles per iteration divided by elementsPerIteration */
+        double          cyclesPerElement;
+
+        /** True if compareToBaseline() found this case in the baseline */
+        bool            hasBaseline;
+        RealTime        baselineMedian;
+
+        /** True if the median exceeds the baseline's by more than the threshold */
+        bool            regressed;
+    };
+
+private:
+
+    class Entry {
+    public:
+        std::string     name;
+        Case*           benchCase;
+        int             elements;
+    };
+
+    /** Adapts a function to a Case */
+    class FunctionCase : public Case {
+    public:
+        void            (*function)();
+        FunctionCase(void (*f)()) : function(f) {}
+        virtual void run() {
+            function();
+        }
+    };
+
+    Settings            m_settings;
+    Array<Entry>        m_entry;
+    Array<Result>       m_result;
+
+    void runCase(const Entry& entry, Result& result) const;
+
+    // Not implemented on purpose, don't use
+    Benchmark(const Benchmark&);
+    Benchmark& operator=(const Benchmark&);
+
+public:
+
+    Benchmark(const Settings& settings = Settings());
+
+    /** Deletes the cases */
+    ~Benchmark();
+
+    Settings& settings() {
+        return m_settings;
+    }
+
+    /**
+     Registers a case, which the Benchmark will delete.
+
+     @param name Unique; may not contain commas or quotes.  By convention,
+       "Class::operation (variant)".
+     @param elementsPerIteration Number of elements (operations, bytes, ...)
+       one iteration of run() processes, for cycles per element.
+     */
+    void add(const std::string& name, Case* benchCase, int elementsPerIteration = 1);
+
+    /** Registers a function as a case. */
+    void add(const std::string& name, void (*function)(), int elementsPerIteration = 1);
+
+    int numCases() const {
+        return m_entry.size();
+    }
+
+    /** Runs every case that passes the filter, replacing previous results. */
+    void run();
+
+    const Array<Result>& results() const {
+        return m_result;
+    }
+
+    /** Table of the results, with baseline comparisons if available. */
+    std::string report() const;
+
+    void writeJSON(const std::string& filename) const;
+
+    /** The CSV file can be loaded by compareToBaseline(). */
+    void writeCSV(const std::string& filename) const;
+
+    /**
+     Loads a CSV file written by writeCSV() and compares each result against
+     the case of the same name.  Cases missing from the baseline are not
+     regressions.
+
+     @return The number of regressed cases, or -1 if the file could not be read.
+     */
+    int compareToBaseline(const std::string& filename);
+};
+
+}
+
+#endif
@@ -48,6 +48,12 @@ namespace G3D {
     #define G3D_ALLOW_UNALIGNED_WRITES
 #endif
 
+namespace _internal {
+    /** First 8 bytes of a block-compressed file.  See 
+        BinaryOutput::enableBlockCompression for the format. */
+    extern const uint8 blockCompressedMagic[8];
+}
+
 /**
  Sequential or random access byte-order independent binary file access.
  Files compressed with zlib and beginning with an unsigned 32-bit int
@@ -67,6 +73,19 @@ namespace G3D {
  other appropriate function.  This is because it would be very hard to 
  debug the error sequence: <CODE>serialize(1.0, bo); ... float f; deserialize(f, bi);</CODE>
  in which a double is serialized and then deserialized as a float. 
+
+ Large files can be memory mapped instead of read into a buffer by passing
+ BinaryInput::MAP_SEQUENTIAL or BinaryInput::MAP_RANDOM to the file constructor.
+ The operating system then pages the file in on demand, getCArray() works for
+ files of any size, and readBytesInPlace() returns pointers directly into the
+ file.
+
+ Files written by BinaryOutput with block compression enabled (see
+ BinaryOutput::enableBlockCompression) are recognized automatically when
+ compressed = true.  They are decompressed one block at a time as the read
+ position advances, so the whole file never needs to be in memory and
+ setPosition only decompresses the block that contains the new position.
+ Reads that span many blocks decompress them on several threads.
  */
 class BinaryInput {
 private:
@@ -120,6 +139,40 @@ private:
      */
     bool            freeBuffer;
 
+    /**
+     When true, buffer is a read-only memory mapping of the whole file 
+     and is unmapped in the destructor.
+     */
+    bool            mapped;
+
+    /** Uncompressed bytes per block of a block-compressed file; 0 for
+        other files. */
+    int64           blockSize;
+
+    /** File offset of each compressed block, followed by the offset of the
+        block index (which is where the last block ends).*/
+    Array<int64>    blockOffset;
+
+    /** Memory mapping of a block-compressed file, or NULL if blocks are read
+        with fread. */
+    uint8*          compressedView;
+
+    /** Length of the compressed file */
+    int64           compressedLength;
+
+    /** Number of bytes allocated for buffer when blockSize > 0 */
+    int64           blockBufferCapacity;
+
+    /** Reads the block index of a block-compressed file.  buffer is empty 
+        afterwards. */
+    void openBlocks();
+
+    /** Copies bytes of the compressed file into dst. */
+    void readCompressed(int64 offset, int64 count, uint8* dst) const;
+
+    /** loadIntoMemory for block-compressed files. */
+    void loadBlocks(int64 startPosition, int64 minLength);
+
     /** Ensures that we are able to read at least minLength from startPosition (relative
         to start of file). */
     void loadIntoMemory(int64 startPosition, int64 minLength = 0);
@@ -143,13 +196,30 @@ public:
     /** false, constant to use with the copyMemory option */
     static const bool       NO_COPY;
 
+    /** Options for the memoryMap argument of the file constructor */
+    enum MemoryMap {
+        /** Read the file into a heap buffer, one window at a time for huge files */
+        NO_MEMORY_MAP,
+
+        /** Map the file and tell the OS that it will be read front to back */
+        MAP_SEQUENTIAL,
+
+        /** Map the file and tell the OS that reads will seek around */
+        MAP_RANDOM};
+
 	/**
 	 If the file cannot be opened, a zero length buffer is presented.
+
+     @param memoryMap If not NO_MEMORY_MAP, the file is memory mapped
+     instead of being copied into a buffer.  A compressed file is
+     decompressed directly out of the mapping.  If the platform or file
+     system cannot map the file, falls back to NO_MEMORY_MAP.
 	 */
     BinaryInput(
         const std::string&  filename,
         G3DEndian           fileEndian,
-        bool                compressed = false);
+        bool                compressed = false,
+        MemoryMap           memoryMap = NO_MEMORY_MAP);
 
     /**
      Creates input stream from an in memory source.
@@ -186,12 +256,18 @@ public:
         return filename;
     }
 
+    /** True if the file is memory mapped (see MemoryMap) */
+    inline bool memoryMapped() const {
+        return mapped;
+    }
+
     /**
      Returns a pointer to the internal memory buffer.
-     May throw an exception for huge files.
+     May throw an exception for huge files that are not memory mapped
+     and for block-compressed files.
      */
     const uint8* getCArray() const {
-        if (alreadyRead > 0) {
+        if ((alreadyRead > 0) || (bufferLength < length)) {
             throw "Cannot getCArray for a huge file";
         }
         return buffer;
@@ -340,6 +416,19 @@ public:
      */
     void readBytes(void* bytes, int64 n);
 
+    /**
+     Returns a pointer to the next n bytes and advances past them without
+     copying.  For a memory mapped or in-memory BinaryInput the pointer is
+     valid for the lifetime of this object; otherwise it is only valid until
+     the next read.  The data is in file byte order and need not be aligned.
+     */
+    inline const uint8* readBytesInPlace(int64 n) {
+        prepareToRead(n);
+        const uint8* ptr = buffer + pos;
+        pos += n;
+        return ptr;
+    }
+
     /**
      Reads an n character string.  The string is not
      required to end in NULL in the file but will
@@ -28,6 +28,7 @@
 #include "G3D/debug.h"
 #include "G3D/BinaryInput.h"
 #include "G3D/System.h"
+#include "G3D/AsyncFileWriter.h"
 
 #ifdef _MSC_VER
 #   pragma warning (push)
@@ -39,7 +40,15 @@ namespace G3D {
 /**
  Sequential or random access byte-order independent binary file access.
 
- The compress() call can be used to compress with zlib.
+ The compress() call can be used to compress with zlib.  For large
+ files, enableBlockCompression() instead compresses the data in
+ independent blocks as it is written, which keeps memory bounded and
+ lets BinaryInput decompress and seek lazily.
+
+ commitAsync() writes the file on a background thread.  With
+ setAsyncFlushThreshold(), data is also handed to that thread while it is
+ being written, so long-running output such as a replay recording
+ occupies bounded memory and never blocks on the disk.
 
  Any method call can trigger an out of memory error (thrown as char*) 
  when writing to "<memory>" instead of a file.
@@ -85,6 +94,32 @@ private:
     /** Number of bytes already written to the file.*/
     size_t          alreadyWritten;             
 
+    /** Uncompressed bytes per block when block compression is enabled, 0 otherwise */
+    int             blockSize;
+
+    /** File offset of each block written so far */
+    Array<int64>    blockOffset;
+
+    /** Bytes of the compressed file written so far, including the header */
+    int64           compressedWritten;
+
+    /** Compresses the first numBytes of the buffer as blocks, appends them to 
+        the file, and removes them from the buffer.  numBytes must be a multiple of
+        blockSize unless this is the end of the file.*/
+    void writeBlocks(int numBytes);
+
+    /** See setAsyncFlushThreshold.  0 when disabled. */
+    int             asyncFlushThreshold;
+
+    /** Most recent write handed to AsyncFileWriter by this object.*/
+    AsyncWriteRef   pendingWrite;
+
+    /** Hands the bytes before pos to AsyncFileWriter and removes them from the buffer. */
+    void flushAsync();
+
+    /** Waits for pendingWrite before the file is opened on this thread. */
+    void waitForPendingWrite();
+
     void reserveBytesWhenOutOfMemory(size_t bytes);
 
     void reallocBuffer(size_t bytes, size_t oldBufferLen);
@@ -137,6 +172,26 @@ public:
      */
     void compress();
 
+    /**
+     Compresses the file in independent blocks of blockSize uncompressed
+     bytes.  Completed blocks are compressed and written to disk while
+     writing continues, so at most a few blocks are held in memory.  
+     Seeking backwards is limited to the last two blocks.
+     Read the file with BinaryInput and compressed = true.
+
+     Must be called before anything is written.  Not supported for "<memory>"
+     and cannot be combined with compress().
+
+     File layout, with integers in the file's byte order:
+     <PRE>
+       "G3DBLKZ\0"  uint32 blockSize  uint32 0
+       zlib stream for each block
+       int64 file offset of each block
+       int64 uncompressed length  int64 offset of the block offsets  uint32 number of blocks  uint32 0
+     </PRE>
+     */
+    void enableBlockCompression(int blockSize = 1024 * 1024);
+
     /**
      Returns a pointer to the internal memory buffer.
      */
@@ -165,6 +220,28 @@ public:
     */
     void commit(bool flush = true);
 
+    /**
+     Queues the bytes for writing by AsyncFileWriter and returns
+     immediately (unless the queue is full).  The returned handle reports
+     when the file is ready for reading.
+
+     The buffer is handed to the writer thread, so getCArray() returns 
+     NULL afterwards.  Not supported for "<memory>" or with block compression.
+     */
+    AsyncWriteRef commitAsync();
+
+    /**
+     When the buffer would grow past bytes, everything before the current
+     position is handed to AsyncFileWriter and appended to the file, as if
+     by commitAsync().  The data is then no longer accessible: seeking 
+     before it throws and compress() is not supported, as for huge files.
+
+     Call commit() or commitAsync() at the end as usual to write the
+     remainder.  Set to 0 (the default) to disable.  Not supported for
+     "<memory>" or with block compression.
+     */
+    void setAsyncFlushThreshold(int bytes);
+
     /**
      Write the bytes to memory (which must be of
      at least size() bytes).
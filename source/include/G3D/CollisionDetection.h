@@ -776,6 +776,123 @@ public:
         Vector3&				outLocation,
         Vector3&                outNormal = ignore);
 
+    /**
+     A triangle soup packed for the batch queries
+     collisionTimeForMovingPointFixedTriangles() and
+     collisionTimeForMovingSphereFixedTriangles().  Each group of four
+     triangles stores every vertex, edge, and plane component as four
+     consecutive floats, so that one SSE instruction computes a step of the
+     test for all four.  Packing is slower than a query; build one for a
+     static soup and reuse it.
+
+     <B>BETA API</B>  This is unsupported and may change
+     */
+    class PackedTriangles {
+    private:
+        friend class CollisionDetection;
+
+        /** Offsets, in groups of four floats, of each component within a group */
+        enum {
+            NORMAL_X = 0, NORMAL_Y, NORMAL_Z,
+            /** Plane equation constant */
+            PLANE_D,
+            /** Three vertices, x, y, z each */
+            VERTEX = 4,
+            /** Unit direction from vertex i to vertex i + 1, x, y, z each */
+            EDGE_DIRECTION = 13,
+            EDGE_LENGTH = 22,
+            EDGE01 = 25,
+            EDGE02 = 28,
+            /** One-hot selectors of the two axes isPointInsideTriangle()
+                projects onto */
+            AXIS_I = 31,
+            AXIS_J = 34,
+            /** Reciprocal of twice the projected area; zero if the area is */
+            INV_AREA = 37,
+            /** Nonzero for triangles with zero projected area */
+            DEGENERATE = 38,
+            NUM_COMPONENTS = 39};
+
+        Array<Triangle>     triangle;
+
+        /** NUM_COMPONENTS * 4 floats per group.  The lanes past the end of the
+            last group repeat the last triangle. */
+        Array<float>        data;
+
+    public:
+
+        PackedTriangles() {}
+
+        PackedTriangles(const Array<Triangle>& t) {
+            set(t);
+        }
+
+        void set(const Array<Triangle>& t) {
+            packTriangles(t, *this);
+        }
+
+        inline int size() const {
+            return triangle.size();
+        }
+
+        inline const Triangle& operator[](int i) const {
+            return triangle[i];
+        }
+
+        void clear() {
+            triangle.clear();
+            data.clear();
+        }
+    };
+
+private:
+
+    /** Fills out with the components of triangle */
+    static void packTriangles(const Array<Triangle>& triangle, PackedTriangles& out);
+
+public:
+
+    /**
+     Earliest collision of a moving point with any of a set of fixed
+     triangles.  Returns the same time, location, and normal as calling
+     collisionTimeForMovingPointFixedTriangle() on each triangle and keeping
+     the earliest, testing four triangles at a time with SSE.  Every
+     triangle that SSE finds hit no later than the best so far, or that it
+     finds within rounding of a hit, is re-tested with the scalar routine.
+
+     @param outIndex Index of the triangle hit, or -1 if there is no
+            collision.  Among triangles hit at the same time, the lowest
+            index.
+     */
+    static float collisionTimeForMovingPointFixedTriangles(
+        const Vector3&          orig,
+        const Vector3&          dir,
+        const PackedTriangles&  triangles,
+        int&                    outIndex,
+        Vector3&                location = ignore,
+        Vector3&                normal   = ignore);
+
+    /**
+     Earliest collision of a moving sphere with any of a set of fixed
+     triangles, e.g., a character against the level geometry near it.
+     Returns the same time, location, and normal as calling
+     collisionTimeForMovingSphereFixedTriangle() on each triangle and keeping
+     the earliest, testing four triangles at a time with SSE.  Every
+     triangle that SSE finds hit no later than the best so far, or that it
+     finds within rounding of a hit, is re-tested with the scalar routine.
+
+     @param outIndex Index of the triangle hit, or -1 if there is no
+            collision.  Among triangles hit at the same time, the lowest
+            index.
+     */
+    static float collisionTimeForMovingSphereFixedTriangles(
+        const class Sphere&     sphere,
+        const Vector3&          velocity,
+        const PackedTriangles&  triangles,
+        int&                    outIndex,
+        Vector3&                outLocation,
+        Vector3&                outNormal = ignore);
+
 	/**
 	 Calculates time between the intersection of a moving sphere and a fixed
 	 rectangle defined by the points v0, v1, v2, & v3.
@@ -0,0 +1,168 @@
+/**
+  @file FlatSet.h
+
+  Open-addressing hash set
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_FLATSET_H
+#define G3D_FLATSET_H
+
+#include "G3D/platform.h"
+#include "G3D/FlatTable.h"
+#include <assert.h>
+#include <string>
+
+namespace G3D {
+
+/**
+  An unordered data structure that has at most one of each element,
+  with the same interface as G3D::Set.
+
+  FlatSet uses G3D::FlatTable internally, so members are stored inline
+  instead of in separately allocated nodes.  The template type T 
+  must define a hashCode and operator== function.  See G3D::Table for 
+  a discussion of these functions.
+ */
+// There is not copy constructor or assignment operator defined because
+// the default ones are correct for FlatSet.
+template<class T> 
+class FlatSet {
+
+    /**
+     If an object is a member, it is contained in
+     this table.
+     */
+    FlatTable<T, bool> memberTable;
+
+public:
+
+    virtual ~FlatSet() {}
+
+    int size() const {
+        return memberTable.size();
+    }
+
+    bool contains(const T& member) const {
+        return memberTable.containsKey(member);
+    }
+
+    /**
+     Inserts into the table if not already present.
+     */
+    void insert(const T& member) {
+        memberTable.set(member, true);
+    }
+
+    /**
+     It is an error to remove members that are not already
+     present.
+     */
+    void remove(const T& member) {
+        memberTable.remove(member);  
+    }
+
+    Array<T> getMembers() const {
+        return memberTable.getKeys();
+    }
+
+    void getMembers(Array<T>& keyArray) const {
+        memberTable.getKeys(keyArray);
+    }
+
+    void clear() {
+        memberTable.clear();
+    }
+
+    /**
+     Ensures that n members can be present without the set growing.
+     */
+    void reserve(int n) {
+        memberTable.reserve(n);
+    }
+
+    void deleteAll()  {
+        getMembers().deleteAll();
+        clear();
+    }
+
+    /**
+     C++ STL style iterator variable.  See begin().
+     */
+    class Iterator {
+    private:
+        friend class FlatSet<T>;
+
+        // Note: this is a FlatTable iterator, we are currently defining
+        // FlatSet iterator
+        typename FlatTable<T, bool>::Iterator it;
+
+        Iterator(const typename FlatTable<T, bool>::Iterator& it) : it(it) {}
+
+    public:
+        inline bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+        bool operator==(const Iterator& other) const {
+            return it == other.it;
+        }
+
+        /**
+         Pre increment.
+         */
+        Iterator& operator++() {
+            ++it;
+            return *this;
+        }
+
+        /**
+         Post increment (slower than preincrement).
+         */
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++(*this);
+            return old;
+        }
+
+        const T& operator*() const {
+            return it->key;
+        }
+
+        T* operator->() const {
+            return &(it->key);
+        }
+
+        operator T*() const {
+            return &(it->key);
+        }
+    };
+
+
+    /**
+     C++ STL style iterator method.  Returns the first member.  
+     Use preincrement (++entry) to get to the next element.  
+     Do not modify the set while iterating.
+     */
+    Iterator begin() const {
+        return Iterator(memberTable.begin());
+    }
+
+
+    /**
+     C++ STL style iterator method.  Returns one after the last iterator
+     element.
+     */
+    const Iterator end() const {
+        return Iterator(memberTable.end());
+    }
+};
+
+}
+
+#endif
+
@@ -0,0 +1,591 @@
+/**
+  @file FlatTable.h
+
+  Open-addressing hash table with inline storage.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_FLATTABLE_H
+#define G3D_FLATTABLE_H
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/debug.h"
+#include "G3D/System.h"
+#include "G3D/Table.h"
+#include <new>
+
+// Group probing uses SSE2 integer compares when available
+#if defined(SSE) && (defined(__SSE2__) || defined(_MSC_VER))
+#   define G3D_FLATTABLE_SSE2
+#   include <emmintrin.h>
+#endif
+
+#ifdef G3D_WIN32
+#   pragma warning (push)
+    // Debug name too long warning
+#   pragma warning (disable : 4786)
+#endif
+
+namespace G3D {
+
+namespace _internal {
+
+/**
+ Metadata helpers for FlatTable.  Each slot of a FlatTable has one
+ control byte that is either EMPTY, DELETED, or the low 7 bits of the
+ key's hash.  Control bytes are examined a group of 16 at a time; each
+ query returns a bitmask with bit i set if byte i matched.
+ */
+class FlatTableGroup {
+public:
+    enum {WIDTH = 16};
+
+    enum {EMPTY = -128, DELETED = -2};
+
+#   ifdef G3D_FLATTABLE_SSE2
+
+    /** Bytes equal to h2 */
+    static inline uint32 match(const int8* ctrl, int8 h2) {
+        const __m128i c = _mm_load_si128((const __m128i*)ctrl);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(h2)));
+    }
+
+    static inline uint32 matchEmpty(const int8* ctrl) {
+        return match(ctrl, (int8)EMPTY);
+    }
+
+    /** EMPTY and DELETED are the only negative values */
+    static inline uint32 matchEmptyOrDeleted(const int8* ctrl) {
+        return _mm_movemask_epi8(_mm_load_si128((const __m128i*)ctrl));
+    }
+
+#   else
+
+    static inline uint32 match(const int8* ctrl, int8 h2) {
+        uint32 m = 0;
+        for (int i = 0; i < WIDTH; ++i) {
+            m |= (uint32)(ctrl[i] == h2) << i;
+        }
+        return m;
+    }
+
+    static inline uint32 matchEmpty(const int8* ctrl) {
+        return match(ctrl, (int8)EMPTY);
+    }
+
+    static inline uint32 matchEmptyOrDeleted(const int8* ctrl) {
+        uint32 m = 0;
+        for (int i = 0; i < WIDTH; ++i) {
+            m |= (uint32)(ctrl[i] < 0) << i;
+        }
+        return m;
+    }
+
+#   endif
+
+    /** Index of the lowest set bit.  m must be non-zero. */
+    static inline int lowestBit(uint32 m) {
+        debugAssert(m != 0);
+#       if defined(__GNUC__)
+            return __builtin_ctz(m);
+#       else
+            int i = 0;
+            while ((m & 1) == 0) {
+                m >>= 1;
+                ++i;
+            }
+            return i;
+#       endif
+    }
+
+    /** Scrambles a hashCode() result so that both the low 7 bits and
+        the remaining bits are well distributed, even for the identity
+        hash that G3D uses for integers.*/
+    static inline uint32 mix(uint32 h) {
+        h *= 0x9E3779B1;
+        return h ^ (h >> 16);
+    }
+};
+
+} // namespace _internal
+
+
+/**
+ An unordered data structure mapping keys to values, with the same
+ interface as G3D::Table.
+
+ Unlike Table, which allocates a linked-list node for every entry,
+ FlatTable stores its entries inline in a single array using open
+ addressing.  Lookups touch one metadata group and usually one entry
+ instead of chasing pointers, inserting does not allocate unless the
+ table grows, and growing does not re-link nodes.  Prefer FlatTable for
+ large tables of small keys and values that are queried frequently.
+
+ Key must provide <code>unsigned int hashCode(const Key&)</code> and
+ <code>operator==</code>, exactly as for G3D::Table.
+
+ Inserting or removing may move entries, so pointers and references
+ into the table (including the result of get() and iterators) are
+ invalidated by set() and remove().
+ */
+template<class Key, class Value>
+class FlatTable {
+public:
+
+    /**
+     The pairs returned by iterator.
+     */
+    class Entry {
+    public:
+        Key    key;
+        Value  value;
+    };
+
+private:
+
+    typedef _internal::FlatTableGroup Group;
+
+    /** Number of full slots */
+    int         _size;
+
+    /** Number of DELETED control bytes */
+    int         numDeleted;
+
+    /** Number of slots; zero or a power of two that is at least Group::WIDTH. */
+    int         capacity;
+
+    /** One control byte per slot.  NULL when capacity == 0.
+        Shares its allocation with slot. */
+    int8*       ctrl;
+
+    /** Storage for entries.  Only slots whose control byte is
+        non-negative hold constructed entries. */
+    Entry*      slot;
+
+    inline int maxLoad() const {
+        return capacity - capacity / 8;
+    }
+
+    inline int groupMask() const {
+        return (capacity / Group::WIDTH) - 1;
+    }
+
+    /** Returns the index of key's slot or -1 */
+    int find(const Key& key, uint32 h) const {
+        if (_size == 0) {
+            return -1;
+        }
+
+        const int8 h2 = (int8)(h & 0x7F);
+        const int mask = groupMask();
+        int g = (int)(h >> 7) & mask;
+        for (int step = 1; true; ++step) {
+            const int8* c = ctrl + g * Group::WIDTH;
+            uint32 m = Group::match(c, h2);
+            while (m != 0) {
+                const int i = g * Group::WIDTH + Group::lowestBit(m);
+                if (slot[i].key == key) {
+                    return i;
+                }
+                m &= m - 1;
+            }
+
+            if (Group::matchEmpty(c) != 0) {
+                // Key would have been placed in this group
+                return -1;
+            }
+
+            // Triangular probing visits every group
+            g = (g + step) & mask;
+        }
+    }
+
+    /** Returns the first free slot on the probe sequence for h. */
+    int findFree(uint32 h) const {
+        const int mask = groupMask();
+        int g = (int)(h >> 7) & mask;
+        for (int step = 1; true; ++step) {
+            const uint32 m = Group::matchEmptyOrDeleted(ctrl + g * Group::WIDTH);
+            if (m != 0) {
+                return g * Group::WIDTH + Group::lowestBit(m);
+            }
+            g = (g + step) & mask;
+        }
+    }
+
+    /** Allocates storage for n slots, all EMPTY. */
+    void allocate(int n) {
+        debugAssert(isPow2(n) && (n >= Group::WIDTH));
+        capacity   = n;
+        numDeleted = 0;
+        ctrl = (int8*)System::alignedMalloc(n + n * sizeof(Entry), 16);
+        slot = (Entry*)(ctrl + n);
+        System::memset(ctrl, (uint8)Group::EMPTY, n);
+    }
+
+    /** Re-inserts every entry into a table with n slots. */
+    void rehash(int n) {
+        int8*  oldCtrl     = ctrl;
+        Entry* oldSlot     = slot;
+        int    oldCapacity = capacity;
+
+        allocate(n);
+
+        for (int i = 0; i < oldCapacity; ++i) {
+            if (oldCtrl[i] >= 0) {
+                const uint32 h = Group::mix(hashCode(oldSlot[i].key));
+                const int j = findFree(h);
+                ctrl[j] = (int8)(h & 0x7F);
+                new (slot + j) Entry(oldSlot[i]);
+                oldSlot[i].~Entry();
+            }
+        }
+
+        System::alignedFree(oldCtrl);
+    }
+
+    void copyFrom(const FlatTable<Key, Value>& h) {
+        _size = h._size;
+        if (h.capacity == 0) {
+            capacity   = 0;
+            numDeleted = 0;
+            ctrl       = NULL;
+            slot       = NULL;
+            return;
+        }
+
+        allocate(h.capacity);
+        numDeleted = h.numDeleted;
+        System::memcpy(ctrl, h.ctrl, capacity);
+        for (int i = 0; i < capacity; ++i) {
+            if (ctrl[i] >= 0) {
+                new (slot + i) Entry(h.slot[i]);
+            }
+        }
+    }
+
+    void freeMemory() {
+        for (int i = 0; i < capacity; ++i) {
+            if (ctrl[i] >= 0) {
+                slot[i].~Entry();
+            }
+        }
+        System::alignedFree(ctrl);
+        ctrl       = NULL;
+        slot       = NULL;
+        capacity   = 0;
+        numDeleted = 0;
+        _size      = 0;
+    }
+
+public:
+
+    /**
+     Creates an empty hash table.  No heap allocation occurs until the first set().
+     */
+    FlatTable() : _size(0), numDeleted(0), capacity(0), ctrl(NULL), slot(NULL) {}
+
+    /**
+     Destroys all of the memory allocated by the table, but does <B>not</B>
+     call delete on keys or values if they are pointers.
+     */
+    virtual ~FlatTable() {
+        freeMemory();
+    }
+
+    FlatTable(const FlatTable<Key, Value>& h) {
+        this->copyFrom(h);
+    }
+
+    FlatTable& operator=(const FlatTable<Key, Value>& h) {
+        // No need to copy if the argument is this
+        if (this != &h) {
+            freeMemory();
+            this->copyFrom(h);
+        }
+        return *this;
+    }
+
+    /**
+     Fraction of slots that are occupied or deleted.  The table grows
+     before this exceeds 7/8.  Unlike Table::debugGetLoad, this is
+     not a measure of hash function quality.
+     */
+    double debugGetLoad() const {
+        return (capacity == 0) ? 0.0 : (_size + numDeleted) / (double)capacity;
+    }
+
+    /**
+     Returns the number of slots.
+     */
+    int debugGetNumBuckets() const {
+        return capacity;
+    }
+
+    /**
+     C++ STL style iterator variable.  See begin().
+     */
+    class Iterator {
+    private:
+        friend class FlatTable<Key, Value>;
+
+        const FlatTable<Key, Value>*    table;
+        int                             index;
+
+        Iterator(const FlatTable<Key, Value>* t, int i) : table(t), index(i) {
+            findNext();
+        }
+
+        /** Advances to the next full slot, looking at the current one first. */
+        void findNext() {
+            while ((index < table->capacity) && (table->ctrl[index] < 0)) {
+                ++index;
+            }
+        }
+
+    public:
+        inline bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+        bool operator==(const Iterator& other) const {
+            return (table == other.table) && (index == other.index);
+        }
+
+        /**
+         Pre increment.
+         */
+        Iterator& operator++() {
+            ++index;
+            findNext();
+            return *this;
+        }
+
+        /**
+         Post increment (slower than preincrement).
+         */
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++(*this);
+            return old;
+        }
+
+        const Entry& operator*() const {
+            return table->slot[index];
+        }
+
+        Entry* operator->() const {
+            return table->slot + index;
+        }
+
+        operator Entry*() const {
+            return table->slot + index;
+        }
+    };
+
+
+    /**
+     C++ STL style iterator method.  Returns the first Entry, which
+     contains a key and value.  Use preincrement (++entry) to get to
+     the next element.  Do not modify the table while iterating.
+     */
+    Iterator begin() const {
+        return Iterator(this, 0);
+    }
+
+    /**
+     C++ STL style iterator method.  Returns one after the last iterator
+     element.
+     */
+    const Iterator end() const {
+        return Iterator(this, capacity);
+    }
+
+    /**
+     Removes all elements and releases the storage.
+     */
+    void clear() {
+        freeMemory();
+    }
+
+    /**
+     Returns the number of keys.
+     */
+    int size() const {
+        return _size;
+    }
+
+    /**
+     Ensures that n keys can be present without the table growing.
+     */
+    void reserve(int n) {
+        int c = Group::WIDTH;
+        while (c - c / 8 < n) {
+            c *= 2;
+        }
+        if (c > capacity) {
+            if (capacity == 0) {
+                allocate(c);
+            } else {
+                rehash(c);
+            }
+        }
+    }
+
+    /**
+     If you insert a pointer into the key or value of a table, you are
+     responsible for deallocating the object eventually.  Inserting
+     key into a table is O(1), but may cause a potentially slow rehashing.
+     */
+    void set(const Key& key, const Value& value) {
+        const uint32 h = Group::mix(hashCode(key));
+
+        int i = find(key, h);
+        if (i >= 0) {
+            // Replace the existing value
+            slot[i].value = value;
+            return;
+        }
+
+        if (capacity == 0) {
+            allocate(Group::WIDTH);
+        } else if (_size + numDeleted >= maxLoad()) {
+            if (_size * 2 < capacity) {
+                // Mostly deleted slots; reclaim them in place
+                rehash(capacity);
+            } else {
+                // Small tables grow faster because rehashing dominates
+                // the cost of filling them.
+                rehash(capacity * ((capacity < 1024) ? 4 : 2));
+            }
+        }
+
+        i = findFree(h);
+        if (ctrl[i] == Group::DELETED) {
+            --numDeleted;
+        }
+        ctrl[i] = (int8)(h & 0x7F);
+        Entry* e = new (slot + i) Entry();
+        e->key   = key;
+        e->value = value;
+        ++_size;
+    }
+
+    /**
+     Removes an element from the table if it is present.  It is an error
+     to remove an element that isn't present.
+     */
+    void remove(const Key& key) {
+        const int i = find(key, Group::mix(hashCode(key)));
+        alwaysAssertM(i >= 0, "Tried to remove a key that was not in the table.");
+
+        slot[i].~Entry();
+        --_size;
+
+        // A group that contains an EMPTY byte has never been full, so no
+        // probe sequence has ever continued past it and the slot can be
+        // made EMPTY instead of DELETED.
+        const int g = i & ~(Group::WIDTH - 1);
+        if (Group::matchEmpty(ctrl + g) != 0) {
+            ctrl[i] = Group::EMPTY;
+        } else {
+            ctrl[i] = Group::DELETED;
+            ++numDeleted;
+        }
+    }
+
+    /**
+     Returns the value associated with key.
+     @deprecated Use get(key, val) or
+     */
+    Value& get(const Key& key) const {
+        const int i = find(key, Group::mix(hashCode(key)));
+        debugAssertM(i >= 0, "Key not found");
+        return slot[i].value;
+    }
+
+    /**
+     If the key is present in the table, val is set to the associated value and returns true.
+     If the key is not present, returns false.
+     */
+    bool get(const Key& key, Value& val) const {
+        const int i = find(key, Group::mix(hashCode(key)));
+        if (i >= 0) {
+            val = slot[i].value;
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    /**
+     Returns true if key is in the table.
+     */
+    bool containsKey(const Key& key) const {
+        return find(key, Group::mix(hashCode(key))) >= 0;
+    }
+
+    /**
+     Short syntax for get.
+     */
+    inline Value& operator[](const Key &key) const {
+        return get(key);
+    }
+
+    /**
+     Returns an array of all of the keys in the table.
+     You can iterate over the keys to get the values.
+     */
+    Array<Key> getKeys() const {
+        Array<Key> keyArray;
+        getKeys(keyArray);
+        return keyArray;
+    }
+
+    void getKeys(Array<Key>& keyArray) const {
+        keyArray.resize(0, DONT_SHRINK_UNDERLYING_ARRAY);
+        for (int i = 0; i < capacity; ++i) {
+            if (ctrl[i] >= 0) {
+                keyArray.append(slot[i].key);
+            }
+        }
+    }
+
+    /**
+     Calls delete on all of the keys.  Does not clear the table,
+     however, so you are left with a table of dangling pointers.
+     */
+    void deleteKeys() {
+        getKeys().deleteAll();
+    }
+
+    /**
+     Calls delete on all of the values.  This is unsafe--
+     do not call unless you know that each value appears
+     at most once.
+
+     Does not clear the table, so you are left with a table
+     of dangling pointers.
+     */
+    void deleteValues() {
+        for (int i = 0; i < capacity; ++i) {
+            if (ctrl[i] >= 0) {
+                delete slot[i].value;
+            }
+        }
+    }
+};
+
+} // namespace
+
+#undef G3D_FLATTABLE_SSE2
+
+#ifdef G3D_WIN32
+#   pragma warning (pop)
+#endif
+
+#endif
@@ -0,0 +1,904 @@
+/**
+  @file FrozenAABSPTree.h
+
+  Read-only, flattened form of G3D::AABSPTree.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_FROZENAABSPTREE_H
+#define G3D_FROZENAABSPTREE_H
+
+#include "G3D/platform.h"
+#include "G3D/AABSPTree.h"
+#include "G3D/Array.h"
+#include "G3D/AABox.h"
+#include "G3D/Sphere.h"
+#include "G3D/Ray.h"
+#include "G3D/GCamera.h"
+#include "G3D/BinaryInput.h"
+#include "G3D/BinaryOutput.h"
+#include "G3D/System.h"
+
+namespace G3D {
+
+/**
+ A snapshot of an AABSPTree that cannot be modified but answers box,
+ sphere, frustum, and ray queries faster.  Use it for static scenery.
+
+ An AABSPTree allocates every node separately and each node holds its own
+ array of values, so a traversal jumps around the heap.  The frozen tree
+ stores the nodes in one array in depth-first order as 16-byte records (the
+ child on the low side of a split immediately follows its parent), and
+ stores the bounds and the values of all members in two more arrays that
+ each node references by offset and count.  Queries test the packed bounds
+ and only read a value when its bounds pass.  The split bounds of the
+ AABSPTree nodes are not stored; the frustum query computes them on the
+ way down.
+
+ <PRE>
+    AABSPTree<Triangle> tree;
+    tree.insert(triangleArray);
+    tree.balanceSAH();
+
+    FrozenAABSPTree<Triangle> frozen(tree);
+    ...
+    frozen.getIntersectingMembers(box, members);
+ </PRE>
+
+ Convert back with thaw() to modify the set.
+
+ serialize() writes the whole tree, values included, and deserialize()
+ loads it without rebuilding anything.  When the file is memory mapped
+ the tree is queried in place, so a large static scene is ready as soon
+ as the file is opened:
+
+ <PRE>
+    BinaryInput file("scene.bsp", G3D_LITTLE_ENDIAN, false, BinaryInput::MAP_RANDOM);
+    FrozenAABSPTree<Triangle> frozen;
+    frozen.deserialize(file);
+ </PRE>
+
+ <B>BETA API</B>  This is unsupported and may change
+ */
+template<class T>
+class FrozenAABSPTree {
+private:
+
+    typedef typename AABSPTree<T>::Node SourceNode;
+    typedef typename AABSPTree<T>::Handle SourceHandle;
+
+    class Node {
+    public:
+        float               splitLocation;
+
+        /** Index of the child on the high side of the plane, 0 if there is none
+            (the root is never a child).  The child on the low side, if any,
+            is the next node. */
+        uint32              highChild;
+
+        /** Index in bounds and value of the first value at this node */
+        uint32              firstValue;
+
+        /** Bits 0-1 are the split axis, bit 2 is set if there is a child on the
+            low side, and the remaining bits are the number of values */
+        uint32              info;
+
+        inline Vector3::Axis splitAxis() const {
+            return (Vector3::Axis)(info & 3);
+        }
+
+        inline bool hasLowChild() const {
+            return (info & 4) != 0;
+        }
+
+        inline int numValues() const {
+            return (int)(info >> 3);
+        }
+    };
+
+    enum {SERIALIZE_VERSION = 1};
+
+    /** Storage for the nodes when they are not in a memory mapped file */
+    Array<Node>             nodeArray;
+
+    /** Bounds of the values at each node, in the order of the nodes */
+    Array<AABox>            boundsArray;
+
+    Array<T>                valueArray;
+
+    /** The nodes, bounds, and values that queries read.  These point into
+        the arrays above or into a memory mapped file (see deserialize). */
+    const Node*             node;
+    const AABox*            bounds;
+    const T*                value;
+
+    int                     m_numNodes;
+    int                     m_numValues;
+
+    /** Points node, bounds, and value at the arrays */
+    void useArrays() {
+        node        = nodeArray.getCArray();
+        bounds      = boundsArray.getCArray();
+        value       = valueArray.getCArray();
+        m_numNodes  = nodeArray.size();
+        m_numValues = valueArray.size();
+    }
+
+    /** Writes zeros up to the next multiple of 16 bytes from the start of bo,
+        then the bytes.  See serialize(). */
+    static void writeAligned(BinaryOutput& bo, const void* bytes, int numBytes) {
+        while ((bo.position() & 15) != 0) {
+            bo.writeUInt8(0);
+        }
+        if (numBytes > 0) {
+            bo.writeBytes(bytes, numBytes);
+        }
+    }
+
+    /** Skips the padding written by writeAligned */
+    static void skipPadding(BinaryInput& bi) {
+        bi.skip((16 - (bi.getPosition() & 15)) & 15);
+    }
+
+    /** Reads what writeAligned wrote */
+    static void readAligned(BinaryInput& bi, void* bytes, int numBytes) {
+        skipPadding(bi);
+        if (numBytes > 0) {
+            bi.readBytes(bytes, numBytes);
+        }
+    }
+
+    /** The position skipPadding() moves to from p */
+    static int64 alignUp(int64 p) {
+        return (p + 15) & ~(int64)15;
+    }
+
+    static bool isAligned(const void* ptr) {
+        return ((size_t)ptr & 15) == 0;
+    }
+
+    /** True if every child index and value range in n[0 .. numNodes - 1]
+        lies within the tree, so that queries cannot read out of bounds.
+        Children always follow their parent, so this also rules out cycles. */
+    static bool validNodes(const Node* n, int numNodes, int numValues) {
+        for (int i = 0; i < numNodes; ++i) {
+            const Node& cur = n[i];
+            if ((cur.splitAxis() > Vector3::Z_AXIS) ||
+                (cur.hasLowChild() && (i + 1 >= numNodes)) ||
+                ((cur.highChild != 0) &&
+                 ((cur.highChild <= (uint32)i) || (cur.highChild >= (uint32)numNodes))) ||
+                ((uint64)cur.firstValue + (uint64)cur.numValues() > (uint64)numValues)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** Appends src and its descendants to nodeArray and returns the index of src */
+    int flatten(const SourceNode* src) {
+        const int index = nodeArray.size();
+        nodeArray.next();
+
+        const int first = valueArray.size();
+        const int n = src->valueArray.size();
+        for (int i = 0; i < n; ++i) {
+            boundsArray.append(src->valueArray[i].bounds);
+            valueArray.append(src->valueArray[i].value);
+        }
+
+        if (src->child[0] != NULL) {
+            flatten(src->child[0]);
+        }
+
+        int high = 0;
+        if (src->child[1] != NULL) {
+            high = flatten(src->child[1]);
+        }
+
+        Node& dst = nodeArray[index];
+        dst.splitLocation = src->splitLocation;
+        dst.highChild     = high;
+        dst.firstValue    = first;
+        dst.info          = (uint32)src->splitAxis | ((src->child[0] != NULL) ? 4 : 0) | ((uint32)n << 3);
+
+        return index;
+    }
+
+    SourceNode* thawNode(int index, AABSPTree<T>& tree) const {
+        const Node& src = node[index];
+        SourceNode* dst = new SourceNode();
+        dst->splitAxis     = src.splitAxis();
+        dst->splitLocation = src.splitLocation;
+
+        const int n = src.numValues();
+        dst->valueArray.resize(n);
+        for (int i = 0; i < n; ++i) {
+            SourceHandle& h = dst->valueArray[i];
+            h.value  = value[src.firstValue + i];
+            h.bounds = bounds[src.firstValue + i];
+            h.center = h.bounds.center();
+            tree.memberTable.set(h.value, dst);
+        }
+
+        if (src.hasLowChild()) {
+            dst->child[0] = thawNode(index + 1, tree);
+        }
+        if (src.highChild != 0) {
+            dst->child[1] = thawNode(src.highChild, tree);
+        }
+        return dst;
+    }
+
+    /** If useSphere is true, members that pass the box test face a second
+        test against the sphere. */
+    void getIntersectingMembers(
+        int                 index,
+        const AABox&        box,
+        const Sphere&       sphere,
+        Array<T>&           members,
+        bool                useSphere) const {
+
+        while (true) {
+            const Node& n = node[index];
+
+            const int end = n.firstValue + n.numValues();
+            for (int v = n.firstValue; v < end; ++v) {
+                if (bounds[v].intersects(box) &&
+                    (! useSphere || bounds[v].intersects(sphere))) {
+                    members.append(value[v]);
+                }
+            }
+
+            const Vector3::Axis axis = n.splitAxis();
+            const bool low  = n.hasLowChild() && (box.low()[axis] < n.splitLocation);
+            const bool high = (n.highChild != 0) && (box.high()[axis] > n.splitLocation);
+
+            if (low) {
+                if (high) {
+                    getIntersectingMembers(n.highChild, box, sphere, members, useSphere);
+                }
+                ++index;
+            } else if (high) {
+                index = n.highChild;
+            } else {
+                return;
+            }
+        }
+    }
+
+    /**
+     @param splitBounds Space covered by the node
+     @param parentMask The mask that this node returned from culledBy.
+     */
+    void getIntersectingMembers(
+        int                 index,
+        const AABox&        splitBounds,
+        const Array<Plane>& plane,
+        Array<T>&           members,
+        uint32              parentMask) const {
+
+        if (parentMask == 0) {
+            // None of these planes can cull anything
+            getSubtreeMembers(index, members);
+            return;
+        }
+
+        const Node& n = node[index];
+        int dummy;
+
+        const int end = n.firstValue + n.numValues();
+        for (int v = n.firstValue; v < end; ++v) {
+            if (! bounds[v].culledBy(plane, dummy, parentMask)) {
+                members.append(value[v]);
+            }
+        }
+
+        AABox childBounds[2];
+        splitBounds.split(n.splitAxis(), n.splitLocation, childBounds[0], childBounds[1]);
+        const int child[2] = {n.hasLowChild() ? (index + 1) : 0, (int)n.highChild};
+
+        for (int c = 0; c < 2; ++c) {
+            uint32 childMask = 0xFFFFFF;
+            if ((child[c] != 0) &&
+                ! childBounds[c].culledBy(plane, dummy, parentMask, childMask)) {
+                getIntersectingMembers(child[c], childBounds[c], plane, members, childMask);
+            }
+        }
+    }
+
+    /** Appends the values of the node and its descendants, which are
+        contiguous because the nodes are in depth-first order. */
+    void getSubtreeMembers(int index, Array<T>& members) const {
+        // The last node of the subtree is reached by always taking the
+        // high child if there is one
+        int last = index;
+        while (true) {
+            const Node& n = node[last];
+            if (n.highChild != 0) {
+                last = n.highChild;
+            } else if (n.hasLowChild()) {
+                ++last;
+            } else {
+                break;
+            }
+        }
+
+        const int begin = node[index].firstValue;
+        const int end   = node[last].firstValue + node[last].numValues();
+        const int old   = members.size();
+        members.resize(old + end - begin, DONT_SHRINK_UNDERLYING_ARRAY);
+        for (int v = begin; v < end; ++v) {
+            members[old + v - begin] = value[v];
+        }
+    }
+
+    /** True if the ray enters the box before maxTime.  invDirection is the
+        reciprocal of the direction per axis, infinite for 0. */
+    static inline bool rayHitsBox(
+        const AABox&        box,
+        const Vector3&      origin,
+        const Vector3&      invDirection,
+        float               maxTime) {
+
+        float t0 = 0;
+        float t1 = maxTime;
+        for (int a = 0; a < 3; ++a) {
+            float tNear = (box.low()[a] - origin[a]) * invDirection[a];
+            float tFar  = (box.high()[a] - origin[a]) * invDirection[a];
+            if ((tNear != tNear) || (tFar != tFar)) {
+                // NaN: the origin is on a face and the direction is zero
+                // along this axis, so the slab does not limit the ray
+                continue;
+            }
+            if (tNear > tFar) {
+                const float temp = tNear;
+                tNear = tFar;
+                tFar = temp;
+            }
+
+            if (tNear > t0) {
+                t0 = tNear;
+            }
+            if (tFar < t1) {
+                t1 = tFar;
+            }
+            if (t0 > t1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** Visits the nodes that the ray crosses between minTime and maxTime in
+        front to back order. */
+    template<class IntersectCallback>
+    void intersectRay(
+        int                 index,
+        const Ray&          ray,
+        const Vector3&      invDirection,
+        float               minTime,
+        float               maxTime,
+        IntersectCallback&  intersectCallback,
+        float&              distance) const {
+
+        while (minTime <= distance) {
+            const Node& n = node[index];
+
+            const int end = n.firstValue + n.numValues();
+            for (int v = n.firstValue; v < end; ++v) {
+                if (rayHitsBox(bounds[v], ray.origin, invDirection, distance)) {
+                    intersectCallback(ray, value[v], distance);
+                }
+            }
+
+            const Vector3::Axis axis = n.splitAxis();
+            const float origin = ray.origin[axis];
+            const bool lowFirst =
+                (origin < n.splitLocation) ||
+                ((origin == n.splitLocation) && (ray.direction[axis] <= 0));
+
+            const int lowChild = n.hasLowChild() ? (index + 1) : 0;
+            const int nearChild = lowFirst ? lowChild : (int)n.highChild;
+            const int farChild  = lowFirst ? (int)n.highChild : lowChild;
+
+            const float splitTime = (n.splitLocation - origin) * invDirection[axis];
+
+            if ((splitTime > maxTime) || (splitTime <= 0)) {
+                // The ray stays on the near side
+                if (nearChild == 0) {
+                    return;
+                }
+                index = nearChild;
+            } else if (splitTime < minTime) {
+                // The ray is already on the far side
+                if (farChild == 0) {
+                    return;
+                }
+                index = farChild;
+            } else {
+                // Crosses the plane (or is parallel to and on it, where
+                // splitTime is NaN)
+                if (nearChild != 0) {
+                    intersectRay(nearChild, ray, invDirection, minTime,
+                                 (splitTime == splitTime) ? splitTime : maxTime,
+                                 intersectCallback, distance);
+                }
+                if (farChild == 0) {
+                    return;
+                }
+                if (splitTime == splitTime) {
+                    minTime = splitTime;
+                }
+                index = farChild;
+            }
+        }
+    }
+
+    /** Wraps an intersectRay callback to remember the member that last
+        reduced the distance.  Used by intersectRays. */
+    template<class IntersectCallback>
+    class RecordFirstHit {
+    public:
+        IntersectCallback&  callback;
+        const T*            hit;
+
+        RecordFirstHit(IntersectCallback& c) : callback(c), hit(NULL) {}
+
+        inline void operator()(const Ray& ray, const T& value, float& distance) {
+            const float old = distance;
+            callback(ray, value, distance);
+            if (distance < old) {
+                hit = &value;
+            }
+        }
+    };
+
+#ifdef SSE
+    /** Four rays traced together by intersectRays, in structure-of-arrays form */
+    class RayPacket {
+    public:
+        /** Indexed by axis */
+        __m128              origin[3];
+
+        /** Reciprocals of the directions, indexed by axis */
+        __m128              invDirection[3];
+
+        /** For each axis, true if the directions of all rays are negative */
+        bool                negative[3];
+
+        const Ray*          ray[4];
+        float               distance[4];
+        const T*            hit[4];
+    };
+
+    /** Returns a mask with bit i set if ray i of the packet enters the box
+        before distance[i]. */
+    static inline int rayPacketHitsBox(const AABox& box, const RayPacket& p, const __m128& distance) {
+        __m128 t0 = _mm_setzero_ps();
+        __m128 t1 = distance;
+        for (int a = 0; a < 3; ++a) {
+            const __m128 s0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.low()[a]),  p.origin[a]), p.invDirection[a]);
+            const __m128 s1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.high()[a]), p.origin[a]), p.invDirection[a]);
+            // A NaN in either time (the origin on a face and zero direction
+            // along this axis) means that the slab does not limit the ray,
+            // as in rayHitsBox
+            const __m128 ordered = _mm_cmpord_ps(s0, s1);
+            const __m128 tNear = _mm_or_ps(_mm_and_ps(ordered, _mm_min_ps(s0, s1)), _mm_andnot_ps(ordered, _mm_set1_ps(-inf())));
+            const __m128 tFar  = _mm_or_ps(_mm_and_ps(ordered, _mm_max_ps(s0, s1)), _mm_andnot_ps(ordered, _mm_set1_ps(inf())));
+            t0 = _mm_max_ps(tNear, t0);
+            t1 = _mm_min_ps(tFar, t1);
+        }
+        return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+    }
+
+    /** Packet version of intersectRay.  Every ray in the packet must have
+        the same direction signs. */
+    template<class IntersectCallback>
+    void intersectRayPacket(
+        int                 index,
+        RayPacket&          p,
+        __m128              minTime,
+        __m128              maxTime,
+        IntersectCallback&  intersectCallback) const {
+
+        while (true) {
+            __m128 distance = _mm_loadu_ps(p.distance);
+
+            // Rays whose segment in this node is not empty
+            const int active = _mm_movemask_ps(_mm_cmple_ps(minTime, _mm_min_ps(maxTime, distance)));
+            if (active == 0) {
+                return;
+            }
+
+            const Node& n = node[index];
+
+            const int end = n.firstValue + n.numValues();
+            for (int v = n.firstValue; v < end; ++v) {
+                int mask = rayPacketHitsBox(bounds[v], p, distance) & active;
+                if (mask != 0) {
+                    for (int r = 0; mask != 0; ++r, mask >>= 1) {
+                        if (mask & 1) {
+                            const float old = p.distance[r];
+                            intersectCallback(*p.ray[r], value[v], p.distance[r]);
+                            if (p.distance[r] < old) {
+                                p.hit[r] = &value[v];
+                            }
+                        }
+                    }
+                    distance = _mm_loadu_ps(p.distance);
+                }
+            }
+
+            const int axis = n.splitAxis();
+            const __m128 splitTime = 
+                _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.splitLocation), p.origin[axis]), p.invDirection[axis]);
+
+            // Rays travel from the low side to the high side unless their
+            // direction is negative.  A NaN split time (the origin on the
+            // plane and zero direction) gives both children the whole segment.
+            const int lowChild   = n.hasLowChild() ? (index + 1) : 0;
+            const int nearChild  = p.negative[axis] ? (int)n.highChild : lowChild;
+            const int farChild   = p.negative[axis] ? lowChild : (int)n.highChild;
+            const __m128 nearEnd = _mm_min_ps(splitTime, maxTime);
+            const __m128 farBegin = _mm_max_ps(splitTime, minTime);
+
+            const bool visitNear = (nearChild != 0) && 
+                (_mm_movemask_ps(_mm_cmple_ps(minTime, _mm_min_ps(nearEnd, distance))) & active);
+            const bool visitFar = (farChild != 0) && 
+                (_mm_movemask_ps(_mm_cmple_ps(farBegin, _mm_min_ps(maxTime, distance))) & active);
+
+            if (visitNear) {
+                if (visitFar) {
+                    intersectRayPacket(nearChild, p, minTime, nearEnd, intersectCallback);
+                    index   = farChild;
+                    minTime = farBegin;
+                } else {
+                    index   = nearChild;
+                    maxTime = nearEnd;
+                }
+            } else if (visitFar) {
+                index   = farChild;
+                minTime = farBegin;
+            } else {
+                return;
+            }
+        }
+    }
+#endif
+
+public:
+
+    FrozenAABSPTree() {
+        useArrays();
+    }
+
+    explicit FrozenAABSPTree(const AABSPTree<T>& tree) {
+        freeze(tree);
+    }
+
+    /** A copy of a tree loaded in place from a memory mapped file refers to
+        the same file. */
+    FrozenAABSPTree(const FrozenAABSPTree& other) {
+        *this = other;
+    }
+
+    FrozenAABSPTree& operator=(const FrozenAABSPTree& other) {
+        if (this != &other) {
+            nodeArray   = other.nodeArray;
+            boundsArray = other.boundsArray;
+            valueArray  = other.valueArray;
+            if (other.node == other.nodeArray.getCArray()) {
+                useArrays();
+            } else {
+                node        = other.node;
+                bounds      = other.bounds;
+                value       = other.value;
+                m_numNodes  = other.m_numNodes;
+                m_numValues = other.m_numValues;
+            }
+        }
+        return *this;
+    }
+
+    /** Replaces the contents with a copy of tree. */
+    void freeze(const AABSPTree<T>& tree) {
+        clear();
+        if (tree.root != NULL) {
+            flatten(tree.root);
+        }
+        useArrays();
+    }
+
+    /** Replaces the contents of tree with this set, using the same
+        splitting planes. */
+    void thaw(AABSPTree<T>& tree) const {
+        tree.clear();
+        if (m_numNodes > 0) {
+            tree.root = thawNode(0, tree);
+            tree.root->assignSplitBounds(AABox::maxFinite());
+        }
+    }
+
+    void clear() {
+        nodeArray.clear();
+        boundsArray.clear();
+        valueArray.clear();
+        useArrays();
+    }
+
+    int size() const {
+        return m_numValues;
+    }
+
+    int numNodes() const {
+        return m_numNodes;
+    }
+
+    /**
+     Writes the whole tree, including the values and their bounds, so that
+     deserialize() can load it without rebuilding.
+
+     The nodes, bounds, and values are written as raw memory in the byte
+     order of this machine, each starting at a multiple of 16 bytes from
+     the beginning of bo.  T must therefore be a type that can be copied
+     with memcpy and holds no pointers, e.g., Vector3, AABox, or Triangle.
+     */
+    void serialize(BinaryOutput& bo) const {
+        bo.writeString("FrozenAABSPTree");
+        bo.writeInt32(SERIALIZE_VERSION);
+        bo.writeUInt8(System::machineEndian());
+        bo.writeInt32(sizeof(Node));
+        bo.writeInt32(sizeof(AABox));
+        bo.writeInt32(sizeof(T));
+        bo.writeInt32(m_numNodes);
+        bo.writeInt32(m_numValues);
+
+        writeAligned(bo, node,   m_numNodes * sizeof(Node));
+        writeAligned(bo, bounds, m_numValues * sizeof(AABox));
+        writeAligned(bo, value,  m_numValues * sizeof(T));
+    }
+
+    /**
+     Replaces the contents with a tree written by serialize() on a machine
+     with the same byte order and layout of T.
+
+     If bi is memory mapped (see BinaryInput::MAP_RANDOM), the tree is
+     queried directly out of the file and nothing is copied or rebuilt, so
+     loading takes constant time and the operating system pages in only
+     the parts of the tree that queries touch.  In that case bi must not be
+     destroyed until this tree is cleared, replaced, or destroyed.
+     Otherwise the arrays are copied out of bi.
+
+     Throws a std::string and leaves the tree empty if bi is truncated or
+     its nodes refer to children or values outside the tree.
+     */
+    void deserialize(BinaryInput& bi) {
+        clear();
+
+        const std::string magic = bi.readString();
+        alwaysAssertM(magic == "FrozenAABSPTree", "Not a FrozenAABSPTree");
+        const int version = bi.readInt32();
+        alwaysAssertM(version == SERIALIZE_VERSION, "Unsupported FrozenAABSPTree version");
+        alwaysAssertM(bi.readUInt8() == System::machineEndian(),
+                      "FrozenAABSPTree was serialized on a machine with different endianness");
+        const int nodeSize   = bi.readInt32();
+        const int boundsSize = bi.readInt32();
+        const int valueSize  = bi.readInt32();
+        alwaysAssertM((nodeSize == (int)sizeof(Node)) &&
+                      (boundsSize == (int)sizeof(AABox)) &&
+                      (valueSize == (int)sizeof(T)),
+                      "FrozenAABSPTree was serialized with a different value layout");
+        const int numNodes  = bi.readInt32();
+        const int numValues = bi.readInt32();
+
+        const int64 start = bi.getPosition();
+        if ((numNodes < 0) || (numValues < 0) ||
+            (bi.getLength() < alignUp(alignUp(alignUp(start) + (int64)numNodes * sizeof(Node)) +
+                                      (int64)numValues * sizeof(AABox)) +
+                              (int64)numValues * sizeof(T))) {
+            throw format("Truncated FrozenAABSPTree: \"%s\"", bi.getFilename().c_str());
+        }
+
+
+        if (bi.memoryMapped() && (numValues > 0)) {
+            skipPadding(bi);
+            const uint8* n = bi.readBytesInPlace(numNodes * sizeof(Node));
+            skipPadding(bi);
+            const uint8* b = bi.readBytesInPlace(numValues * sizeof(AABox));
+            skipPadding(bi);
+            const uint8* v = bi.readBytesInPlace(numValues * sizeof(T));
+
+            if (isAligned(n) && isAligned(b) && isAligned(v)) {
+                if (! validNodes((const Node*)n, numNodes, numValues)) {
+                    throw format("Corrupt FrozenAABSPTree: \"%s\"", bi.getFilename().c_str());
+                }
+                node        = (const Node*)n;
+                bounds      = (const AABox*)b;
+                value       = (const T*)v;
+                m_numNodes  = numNodes;
+                m_numValues = numValues;
+                return;
+            }
+
+            // The mapping is not aligned the way the file was written
+            bi.setPosition(start);
+        }
+
+        nodeArray.resize(numNodes);
+        boundsArray.resize(numValues);
+        valueArray.resize(numValues);
+        readAligned(bi, nodeArray.getCArray(), numNodes * sizeof(Node));
+        readAligned(bi, boundsArray.getCArray(), numValues * sizeof(AABox));
+        readAligned(bi, valueArray.getCArray(), numValues * sizeof(T));
+        if (! validNodes(nodeArray.getCArray(), numNodes, numValues)) {
+            clear();
+            throw format("Corrupt FrozenAABSPTree: \"%s\"", bi.getFilename().c_str());
+        }
+        useArrays();
+    }
+
+    /** Appends all members of the set. */
+    void getMembers(Array<T>& members) const {
+        const int old = members.size();
+        members.resize(old + m_numValues, DONT_SHRINK_UNDERLYING_ARRAY);
+        for (int v = 0; v < m_numValues; ++v) {
+            members[old + v] = value[v];
+        }
+    }
+
+    /**
+     Appends all members whose bounds intersect the box.
+     */
+    void getIntersectingMembers(const AABox& box, Array<T>& members) const {
+        if (m_numNodes > 0) {
+            getIntersectingMembers(0, box, Sphere(Vector3::zero(), 0), members, false);
+        }
+    }
+
+    /**
+     Appends all members whose bounds intersect the sphere.
+     */
+    void getIntersectingMembers(const Sphere& sphere, Array<T>& members) const {
+        if (m_numNodes > 0) {
+            AABox box;
+            sphere.getBounds(box);
+            getIntersectingMembers(0, box, sphere, members, true);
+        }
+    }
+
+    /**
+     Appends all members inside the set of planes.
+     */
+    void getIntersectingMembers(const Array<Plane>& plane, Array<T>& members) const {
+        if (m_numNodes > 0) {
+            getIntersectingMembers(0, AABox::maxFinite(), plane, members, 0xFFFFFF);
+        }
+    }
+
+    /**
+     Appends all members not culled by the frustum.
+     */
+    void getIntersectingMembers(const GCamera::Frustum& frustum, Array<T>& members) const {
+        Array<Plane> plane;
+        for (int i = 0; i < frustum.faceArray.size(); ++i) {
+            plane.append(frustum.faceArray[i].plane);
+        }
+        getIntersectingMembers(plane, members);
+    }
+
+    /**
+     Finds the first member along the ray.  Members are visited roughly in
+     order along the ray, and only those whose bounds the ray enters
+     before distance are passed to
+
+     <PRE>
+        void intersectCallback(const Ray& ray, const T& value, float& distance);
+     </PRE>
+
+     which must reduce distance to the time at which the ray hits the
+     value, if it hits before distance.  The callback can record the member
+     it hits.
+
+     @param distance On input, the farthest time to consider (usually
+     inf()).  On return, the time of the first hit.
+     */
+    template<class IntersectCallback>
+    void intersectRay(const Ray& ray, IntersectCallback& intersectCallback, float& distance) const {
+        if (m_numNodes == 0) {
+            return;
+        }
+        const Vector3 invDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+        intersectRay(0, ray, invDirection, 0.0f, distance, intersectCallback, distance);
+    }
+
+
+    /**
+     Finds the first member along each ray, calling intersectCallback as
+     described for intersectRay().
+
+     Rays are traced four at a time: each step through the tree and each
+     bounds test handles all four with SSE, and rays drop out of the
+     packet once they have left the node or hit a member closer than it.
+     This is fastest when consecutive rays are coherent, e.g., rays
+     through 2x2 pixel blocks.  A group of four whose direction signs
+     differ on some axis is traced one ray at a time.  Without SSE every
+     ray is traced with intersectRay().
+
+     @param distance Resized to ray.size().  On return, the time of the
+     first hit of each ray, or maxDistance for a miss.
+
+     @param firstHit Resized to ray.size().  On return, the first member
+     each ray hits (the last one for which intersectCallback reduced the
+     distance), or NULL.  The pointers are valid until the tree is changed.
+
+     @param maxDistance Farthest time to consider for every ray.
+     */
+    template<class IntersectCallback>
+    void intersectRays(
+        const Array<Ray>&   ray,
+        IntersectCallback&  intersectCallback,
+        Array<float>&       distance,
+        Array<const T*>&    firstHit,
+        float               maxDistance = inf()) const {
+
+        distance.resize(ray.size(), DONT_SHRINK_UNDERLYING_ARRAY);
+        firstHit.resize(ray.size(), DONT_SHRINK_UNDERLYING_ARRAY);
+
+        for (int i = 0; i < ray.size(); i += 4) {
+            const int count = iMin(4, ray.size() - i);
+
+#           ifdef SSE
+            RayPacket p;
+            // Unused lanes repeat the first ray and start with an empty segment
+            float origin[3][4], invDirection[3][4], minTime[4], maxTime[4];
+            for (int r = 0; r < 4; ++r) {
+                const Ray& R = ray[i + ((r < count) ? r : 0)];
+                p.ray[r]      = &R;
+                p.distance[r] = maxDistance;
+                p.hit[r]      = NULL;
+                for (int a = 0; a < 3; ++a) {
+                    origin[a][r]       = R.origin[a];
+                    invDirection[a][r] = 1.0f / R.direction[a];
+                }
+                minTime[r] = (r < count) ? 0.0f : inf();
+                maxTime[r] = (r < count) ? maxDistance : -inf();
+            }
+
+            bool coherent = true;
+            for (int a = 0; a < 3; ++a) {
+                p.origin[a]       = _mm_loadu_ps(origin[a]);
+                p.invDirection[a] = _mm_loadu_ps(invDirection[a]);
+                const int signs = _mm_movemask_ps(p.invDirection[a]);
+                p.negative[a] = (signs == 0xF);
+                coherent = coherent && ((signs == 0) || (signs == 0xF));
+            }
+
+            if (coherent) {
+                if (m_numNodes > 0) {
+                    intersectRayPacket(0, p, _mm_loadu_ps(minTime), _mm_loadu_ps(maxTime), intersectCallback);
+                }
+                for (int r = 0; r < count; ++r) {
+                    distance[i + r] = p.distance[r];
+                    firstHit[i + r] = p.hit[r];
+                }
+                continue;
+            }
+#           endif
+
+            for (int r = 0; r < count; ++r) {
+                RecordFirstHit<IntersectCallback> record(intersectCallback);
+                distance[i + r] = maxDistance;
+                intersectRay(ray[i + r], record, distance[i + r]);
+                firstHit[i + r] = record.hit;
+            }
+        }
+    }
+};
+
+}
+
+#endif
@@ -27,6 +27,14 @@
 
 #include "G3D/platform.h"
 #include "G3D/Array.h"
+#include "G3D/SmallArray.h"
+#include "G3D/MemoryArena.h"
+#include "G3D/AsyncFileWriter.h"
+#include "G3D/ThreadPool.h"
+#include "G3D/SPSCQueue.h"
+#include "G3D/MPMCQueue.h"
+#include "G3D/Profiler.h"
+#include "G3D/Benchmark.h"
 #include "G3D/Queue.h"
 #include "G3D/Crypto.h"
 #include "G3D/format.h"
@@ -52,6 +60,8 @@
 #include "G3D/g3derror.h"
 #include "G3D/Table.h"
 #include "G3D/Set.h"
+#include "G3D/FlatTable.h"
+#include "G3D/FlatSet.h"
 #include "G3D/BinaryFormat.h"
 #include "G3D/BinaryInput.h"
 #include "G3D/BinaryOutput.h"
@@ -84,6 +94,8 @@
 #include "G3D/GCamera.h"
 #include "G3D/GLight.h"
 #include "G3D/AABSPTree.h"
+#include "G3D/FrozenAABSPTree.h"
+#include "G3D/SweepAndPrune.h"
 #include "G3D/TextOutput.h"
 #include "G3D/MeshBuilder.h"
 #include "G3D/Stopwatch.h"
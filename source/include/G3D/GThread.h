@@ -73,6 +73,9 @@ public:
         TODO: Does this need a timeout? */
     void waitForCompletion();
 
+    /** Gives up the rest of the calling thread's time slice. */
+    static void yield();
+
     /** Returns thread name */
     const std::string& name() {
         return _name;
@@ -108,6 +111,10 @@ public:
     /** Locks the mutex or blocks until available. */
     void lock();
 
+    /** Locks the mutex if it is available and returns true,
+        otherwise returns false immediately without blocking. */
+    bool tryLock();
+
     /** Unlocks the mutex. */
     void unlock();
 };
@@ -138,6 +145,44 @@ public:
 };
 
 
+/**
+    Counting semaphore.  acquire() blocks until the count is positive
+    and then decrements it; release() increments it, waking a waiting
+    thread.  Useful for bounded queues and for waiting on work performed
+    by another thread.
+*/
+class GSemaphore {
+private:
+#   ifdef G3D_WIN32
+    HANDLE                              handle;
+#   else
+    pthread_mutex_t                     mutex;
+    pthread_cond_t                      condition;
+    int                                 count;
+#   endif
+
+    // Not implemented on purpose, don't use
+    GSemaphore(const GSemaphore&);
+    GSemaphore& operator=(const GSemaphore&);
+    bool operator==(const GSemaphore&);
+
+public:
+    /** @param initialCount Must be non-negative */
+    explicit GSemaphore(int initialCount = 0);
+    ~GSemaphore();
+
+    /** Decrements the count, blocking until it is positive. */
+    void acquire();
+
+    /** Decrements the count and returns true if it is positive,
+        otherwise returns false immediately without blocking. */
+    bool tryAcquire();
+
+    /** Increments the count by n. */
+    void release(int n = 1);
+};
+
+
 } // namespace G3D
 
 #endif //G3D_GTHREAD_H
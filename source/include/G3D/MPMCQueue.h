@@ -0,0 +1,189 @@
+/**
+  @file MPMCQueue.h
+
+  Lock-free bounded queue for any number of producer and consumer threads.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_MPMCQUEUE_H
+#define G3D_MPMCQUEUE_H
+
+#include "G3D/platform.h"
+#include "G3D/AtomicInt32.h"
+#include "G3D/GThread.h"
+#include "G3D/System.h"
+#include "G3D/Array.h"
+#include "G3D/g3dmath.h"
+#include "G3D/debug.h"
+
+namespace G3D {
+
+/**
+ Fixed-capacity FIFO that any number of threads may push to and pop from
+ concurrently without locking, e.g., for loader threads handing finished
+ resources to the render thread.  Use G3D::SPSCQueue when there is exactly
+ one producer and one consumer; it is cheaper.
+
+ Each slot carries a sequence number that says whether it is ready to be
+ written or read for the current lap around the ring.  Threads claim a slot
+ by advancing the tail (or head) index with compare-and-set and then access
+ the slot without contending with other threads.  The head and tail indices
+ live on separate cache lines.
+
+ The blocking push() and pop() spin, yielding the processor, until they can
+ proceed.
+
+ <B>BETA API</B>  This is unsupported and may change
+ */
+template<class T>
+class MPMCQueue {
+private:
+
+    enum {PAD = 64};
+
+    class Cell {
+    public:
+        /** Equal to the index that may next be pushed to this cell, or to
+            that index + 1 once the cell holds an element to pop. */
+        AtomicInt32     sequence;
+        T               value;
+    };
+
+    Cell*               cell;
+    uint32              mask;
+
+    uint8               pad0[PAD];
+
+    /** Index of the next element to pop */
+    AtomicInt32         head;
+
+    uint8               pad1[PAD];
+
+    /** Index of the next slot to push to */
+    AtomicInt32         tail;
+
+    uint8               pad2[PAD];
+
+    // Not implemented on purpose, don't use
+    MPMCQueue(const MPMCQueue&);
+    MPMCQueue& operator=(const MPMCQueue&);
+
+public:
+
+    /** @param capacity Rounded up to a power of two, and at least 2 */
+    explicit MPMCQueue(int capacity) : head(0), tail(0) {
+        debugAssert(capacity > 0);
+        const int n = ceilPow2(iMax(capacity, 2));
+        mask = n - 1;
+        cell = new Cell[n];
+        for (int i = 0; i < n; ++i) {
+            cell[i].sequence = i;
+        }
+    }
+
+    ~MPMCQueue() {
+        delete[] cell;
+    }
+
+    inline int capacity() const {
+        return mask + 1;
+    }
+
+    /** Snapshot of the number of elements */
+    inline int size() const {
+        return iMax(0, (int)((uint32)tail.value() - (uint32)head.value()));
+    }
+
+    /** Returns false without blocking if the queue is full. */
+    bool tryPush(const T& e) {
+        uint32 pos = (uint32)tail.value();
+        while (true) {
+            Cell& c = cell[pos & mask];
+            const int32 diff = (int32)((uint32)c.sequence.value() - pos);
+            if (diff == 0) {
+                // The cell is free for this lap; try to claim it
+                const uint32 old = (uint32)tail.compareAndSet(pos, pos + 1);
+                if (old == pos) {
+                    c.value = e;
+                    // Publish; the locked add orders the value before the sequence
+                    c.sequence.add(1);
+                    return true;
+                }
+                pos = old;
+            } else if (diff < 0) {
+                // The cell still holds an element from the previous lap
+                return false;
+            } else {
+                // Another producer claimed this cell
+                pos = (uint32)tail.value();
+            }
+        }
+    }
+
+    /** Blocks while the queue is full. */
+    void push(const T& e) {
+        while (! tryPush(e)) {
+            GThread::yield();
+        }
+    }
+
+    /** Returns false without blocking if the queue is empty. */
+    bool tryPop(T& e) {
+        uint32 pos = (uint32)head.value();
+        while (true) {
+            Cell& c = cell[pos & mask];
+            const int32 diff = (int32)((uint32)c.sequence.value() - (pos + 1));
+            if (diff == 0) {
+                const uint32 old = (uint32)head.compareAndSet(pos, pos + 1);
+                if (old == pos) {
+                    e = c.value;
+                    // Drop the queue's copy, e.g., of a reference-counted pointer
+                    c.value = T();
+                    // Release the cell for the next lap
+                    c.sequence.add(mask);
+                    return true;
+                }
+                pos = old;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = (uint32)head.value();
+            }
+        }
+    }
+
+    /** Blocks while the queue is empty. */
+    void pop(T& e) {
+        while (! tryPop(e)) {
+            GThread::yield();
+        }
+    }
+
+    /** Blocks while the queue is empty. */
+    T pop() {
+        T e;
+        pop(e);
+        return e;
+    }
+
+    /** Appends up to maxCount elements to out without blocking and
+        returns the number appended.  Elements popped concurrently by
+        other consumers may interleave with the batch. */
+    int tryPopBatch(Array<T>& out, int maxCount) {
+        int n = 0;
+        T e;
+        while ((n < maxCount) && tryPop(e)) {
+            out.append(e);
+            ++n;
+        }
+        return n;
+    }
+};
+
+}
+
+#endif
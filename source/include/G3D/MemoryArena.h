@@ -0,0 +1,198 @@
+/**
+  @file MemoryArena.h
+
+  Linear (bump) allocator for short-lived scratch memory.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_MEMORYARENA_H
+#define G3D_MEMORYARENA_H
+
+#include "G3D/platform.h"
+#include "G3D/debug.h"
+#include "G3D/g3dmath.h"
+#include <string>
+
+namespace G3D {
+
+/**
+ Allocates memory by advancing a pointer through large chunks and
+ frees it all at once, either back to a Marker or with reset().
+
+ Use a MemoryArena for temporaries whose lifetime is bounded by a
+ frame or a function call.  Allocation is a few instructions and
+ there is no per-block free, so an arena that has been through one
+ frame performs no heap allocation on later frames.
+
+ G3D::Array and G3D::Table can be backed by an arena; see
+ Array::clearAndSetMemoryArena.  Memory returned by an arena
+ (including the storage of containers backed by it) becomes invalid
+ when the arena is released past it or reset.
+
+ <PRE>
+    MemoryArena arena;
+    ...
+    {
+        MemoryArena::Scope scope(arena);
+        Array<Vector4> temp;
+        temp.clearAndSetMemoryArena(&arena);
+        temp.resize(n);
+        ...
+    } // temp's storage is returned to the arena here
+ </PRE>
+
+ MemoryArena is not threadsafe; use one arena per thread.
+ */
+class MemoryArena {
+private:
+
+    /** Header at the front of each chunk; the usable bytes follow it. */
+    class Chunk {
+    public:
+        Chunk*          next;
+        size_t          size;
+
+        /** Keeps the data that follows the header 16-byte aligned. */
+        size_t          pad[2];
+
+        inline uint8* data() {
+            return reinterpret_cast<uint8*>(this + 1);
+        }
+    };
+
+    /** List of all chunks; chunks after current are empty. */
+    Chunk*              first;
+
+    /** Chunk being allocated from.  NULL before the first allocation
+        after construction, release to an empty marker, or reset.*/
+    Chunk*              current;
+
+    /** Bytes used in current */
+    size_t              offset;
+
+    /** Minimum size of a new chunk */
+    size_t              chunkSize;
+
+    size_t              used;
+    size_t              peak;
+    size_t              lastPeak;
+    size_t              capacity;
+    int                 numChunks;
+
+    /** Slow path of alloc(); moves to (or creates) a chunk that can hold
+        bytes at the given alignment. */
+    void* allocFromNextChunk(size_t bytes, size_t alignment);
+
+    void freeChunks(Chunk* c);
+
+    // Not copyable
+    MemoryArena(const MemoryArena&);
+    MemoryArena& operator=(const MemoryArena&);
+
+public:
+
+    /** Position in the arena returned by mark(). */
+    class Marker {
+    private:
+        friend class MemoryArena;
+        Chunk*          chunk;
+        size_t          offset;
+        size_t          used;
+    };
+
+    /** Marks the arena on construction and releases back to the mark on
+        destruction. Scopes must be destroyed in reverse order of creation. */
+    class Scope {
+    private:
+        MemoryArena&    arena;
+        Marker          marker;
+
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+
+    public:
+        Scope(MemoryArena& a) : arena(a), marker(a.mark()) {}
+
+        ~Scope() {
+            arena.release(marker);
+        }
+    };
+
+    /** @param chunkSize Minimum number of bytes requested from the heap at a
+        time. Larger allocations receive a chunk of their own. No heap
+        allocation occurs until the first alloc(). */
+    MemoryArena(size_t chunkSize = 64 * 1024);
+
+    ~MemoryArena();
+
+    /** Returns bytes of uninitialized memory aligned to alignment, which must be
+        a power of two.  The memory is released by release() or reset(); it
+        is an error to pass it to System::free or System::alignedFree. */
+    inline void* alloc(size_t bytes, size_t alignment = 16) {
+        debugAssertM(isPow2((int)alignment), "Alignment must be a power of two");
+        if (current != NULL) {
+            uint8* base = current->data();
+            size_t p = (((size_t)(base + offset) + alignment - 1) & ~(alignment - 1)) - (size_t)base;
+            if (p + bytes <= current->size) {
+                used  += p + bytes - offset;
+                offset = p + bytes;
+                if (used > peak) {
+                    peak = used;
+                }
+                return base + p;
+            }
+        }
+        return allocFromNextChunk(bytes, alignment);
+    }
+
+    /** The current position.  Pass to release() to free everything
+        allocated after this call. */
+    Marker mark() const {
+        Marker m;
+        m.chunk  = current;
+        m.offset = offset;
+        m.used   = used;
+        return m;
+    }
+
+    /** Frees everything allocated since m was created.  The chunks are kept
+        for reuse. */
+    void release(const Marker& m);
+
+    /** Frees everything. Call once per frame for a frame arena.
+        If the previous interval needed more than one chunk, the chunks are
+        merged into one so that the next interval does not touch the heap.*/
+    void reset();
+
+    /** Bytes currently allocated from the arena, including alignment padding. */
+    inline size_t usedBytes() const {
+        return used;
+    }
+
+    /** Largest value of usedBytes() since the last reset(). */
+    inline size_t peakBytes() const {
+        return peak;
+    }
+
+    /** Value of peakBytes() immediately before the last reset(), i.e., the
+        peak usage during the previous frame for a frame arena. */
+    inline size_t previousPeakBytes() const {
+        return lastPeak;
+    }
+
+    /** Total bytes held from the heap. */
+    inline size_t capacityBytes() const {
+        return capacity;
+    }
+
+    /** Describes the usage, e.g., for display in a debug overlay. */
+    std::string status() const;
+};
+
+}
+
+#endif
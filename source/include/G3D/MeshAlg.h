@@ -14,6 +14,7 @@
 
 #include "G3D/platform.h"
 #include "G3D/Array.h"
+#include "G3D/SmallArray.h"
 #include "G3D/Vector3.h"
 
 namespace G3D {
@@ -54,8 +55,11 @@ public:
          
          Edges may be listed multiple times if they are
          degenerate.
+
+         Stored inline for typical valences so that building
+         adjacency does not allocate per vertex.
          */
-        Array<int>              edgeIndex;
+        SmallArray<int, 8>      edgeIndex;
 
         /**
          Returns true if e or ~e is in the edgeIndex list.
@@ -68,7 +72,7 @@ public:
          Array of faces containing this vertex.  Faces
          may be listed multiple times if they are degenerate.
         */
-        Array<int>              faceIndex;
+        SmallArray<int, 8>      faceIndex;
 
         inline bool inFace(int f) const {
             debugAssert(f >= 0);
@@ -283,19 +287,6 @@ public:
         double&                 maxFaceArea);
 
 private:
-    /**
-     Computes the tangent space basis vectors for
-     a counter-clockwise oriented face.
-
-     @cite Max McGuire
-     */
-    static void computeTangentVectors(
-        const Vector3&  normal,
-        const Vector3   position[3],
-        const Vector2   texCoord[3],
-        Vector3&        tangent, 
-        Vector3&        binormal);
-
     /** Helper for weldAdjacency */
     static void weldBoundaryEdges(
         Array<Face>&       faceArray,
@@ -320,6 +311,8 @@ public:
      perpendicular to each other.  They are guaranteed to
      be perpendicular to the normal.
 
+     Runs in parallel on ThreadPool::common().
+
      @cite Max McGuire
     */
     static void computeTangentSpaceBasis(
@@ -341,7 +334,7 @@ public:
     /**
      Vertex normals are weighted by the area of adjacent faces.
      Nelson Max showed this is superior to uniform weighting for
-     general meshes in jgt.
+     general meshes in jgt.  Runs in parallel on ThreadPool::common().
 
      @param vertexNormalArray Output. Unit length
      @param faceNormalArray Output.   Degenerate faces produce zero magnitude normals. Unit length
@@ -411,8 +404,12 @@ public:
      the mesh.
 
      The welding method runs in roughly linear time in the length of oldVertexArray--
-     a uniform spatial grid is used to achieve nearly constant time vertex collapses
-     for uniformly distributed vertices.
+     a uniform spatial grid with cells of size 2 * <I>radius</I>, hashed into about as many
+     buckets as there are vertices, gives nearly constant time vertex collapses however
+     far apart the vertices are.  The vertices are processed in parallel on
+     ThreadPool::common() and the result is the same as welding them one at a time
+     in order: a vertex is kept if no earlier kept vertex is within <I>radius</I>, and
+     every other vertex maps to the closest kept vertex.
 
      It is sometimes desirable to keep the original vertex ordering but 
      identify the unique vertices.  The following code computes 
@@ -599,8 +596,160 @@ public:
         }
     }
 
+    /**
+     Reorders the triangles of an indexed triangle list so that the GPU's
+     post-transform vertex cache is reused more.  Each triangle keeps its
+     winding.  Runs in time linear in the number of triangles and does not
+     depend on the actual cache size of the hardware, so the result is good
+     for most GPUs.  The order is left alone if it already transforms fewer
+     vertices, as carefully stripped meshes can.  Call optimizeVertexFetch
+     afterwards to also order the vertices by first use.
+
+     @param numVertices  Length of the vertex arrays that index refers to.
+     @param cacheSize    Size of the simulated LRU cache.  32 suits most hardware.
+
+     @cite Tom Forsyth, Linear-Speed Vertex Cache Optimisation, 2006.
+     */
+    static void optimizeVertexCache(
+        Array<int>&         index,
+        int                 numVertices,
+        int                 cacheSize = 32);
+
+    /**
+     Renumbers the vertices of an indexed triangle list in order of first
+     use, so that vertex fetches walk memory forward.  Vertices that no
+     triangle uses are dropped.  Apply the new order to every per-vertex
+     array with reorderVertexArray:
+
+     <PRE>
+        MeshAlg::optimizeVertexCache(index, vertex.size());
+        MeshAlg::optimizeVertexFetch(index, vertex.size(), toOld);
+        MeshAlg::reorderVertexArray(toOld, vertex);
+        MeshAlg::reorderVertexArray(toOld, texCoord);
+     </PRE>
+
+     @param toOld  On return, new vertex ni was old vertex toOld[ni].
+     */
+    static void optimizeVertexFetch(
+        Array<int>&         index,
+        int                 numVertices,
+        Array<int>&         toOld);
+
+    /** Replaces array with array[toOld[0]], array[toOld[1]], ...  See optimizeVertexFetch. */
+    template<class T>
+    static void reorderVertexArray(const Array<int>& toOld, Array<T>& array) {
+        Array<T> old = array;
+        array.resize(toOld.size());
+        for (int i = 0; i < toOld.size(); ++i) {
+            array[i] = old[toOld[i]];
+        }
+    }
+
+    /**
+     Simulates a FIFO post-transform vertex cache of cacheSize entries
+     rendering an indexed triangle list.
+
+     @param acmr Average cache miss ratio: vertices transformed per triangle.
+                 Between 0.5 (ideal for large meshes) and 3.
+     @param atvr Average transform to vertex ratio: vertices transformed per
+                 vertex used.  1 is ideal.
+     */
+    static void computeVertexCacheStatistics(
+        const Array<int>&   index,
+        int                 numVertices,
+        double&             acmr,
+        double&             atvr,
+        int                 cacheSize = 32);
+
+    /**
+     One level of detail of a mesh, produced by simplify and computeLODChain.
+     */
+    class LOD {
+    public:
+        /** Positions, and normals when the input had them */
+        Geometry            geometry;
+
+        /** Empty when the input had no texture coordinates */
+        Array<Vector2>      texCoordArray;
+
+        /** Triangle list, in vertex cache order except for chain[0] of
+            computeLODChain, which is the input unchanged */
+        Array<int>          indexArray;
+
+        /**
+         Distance in object space by which the surface may have moved from
+         the input: the square root of the largest quadric error of any
+         collapse made to reach this level.  0 for the input itself.
+         */
+        float               geometricError;
+
+        LOD() : geometricError(0) {}
+    };
+
+    /**
+     Reduces an indexed triangle mesh to at most targetFaceCount triangles
+     (fewer collapses are made if the topology does not allow more) by
+     repeatedly collapsing the edge whose quadric error is smallest.
+
+     Adjacency comes from computeAdjacency, so colocated vertices with
+     different indices are treated as separate: weld first to simplify
+     across them.  Boundary edges, including texture seams, are held in
+     place by constraint planes.  Collapses that would flip a face or make
+     the mesh non-manifold are rejected.  Normals and texture coordinates
+     are interpolated along each collapsed edge.
+
+     @param geometry    Vertex positions and, optionally, normals.
+     @param texCoord    Empty or one per vertex.
+
+     @cite Garland and Heckbert, Surface Simplification Using Quadric Error Metrics, SIGGRAPH 1997.
+     */
+    static void simplify(
+        const Geometry&         geometry,
+        const Array<Vector2>&   texCoord,
+        const Array<int>&       index,
+        int                     targetFaceCount,
+        LOD&                    lod);
+
+    /**
+     Produces successively simpler levels of detail from a single sequence
+     of edge collapses (see simplify).  chain[0] is a copy of the input, in
+     its own order.  Each later level has at most <I>ratio</I> times the
+     triangles of the one before it.  The chain ends when fewer than
+     minFaceCount would remain or the collapses cannot reach the next
+     level.
+     */
+    static void computeLODChain(
+        const Geometry&         geometry,
+        const Array<Vector2>&   texCoord,
+        const Array<int>&       index,
+        Array<LOD>&             chain,
+        float                   ratio = 0.5f,
+        int                     minFaceCount = 64);
+
 protected:
 
+    /**
+     Stable least-significant-digit radix sort of (key, value) pairs on the
+     low bits of the keys, run in parallel on ThreadPool::common().  Keeps
+     its scratch arrays between calls.  Used by computeAdjacency and
+     computeWeld.
+     */
+    class RadixSort {
+    private:
+        Array<uint64>       tempKey;
+        Array<int>          tempValue;
+        Array<int>          count;
+
+    public:
+        /**
+         Sorts on the low numBits bits of key, moving value with it.  The
+         result is either in key and value or in internal scratch arrays; the
+         sorted arrays are returned in sortedKey and sortedValue.
+         */
+        void sort(Array<uint64>& key, Array<int>& value, int numBits,
+                  const uint64*& sortedKey, const int*& sortedValue);
+    };
+
     /**
      Helper for computeAdjacency.  If a directed edge with index e already
      exists from i0 to i1 then e is returned.  If a directed edge with index e
@@ -0,0 +1,179 @@
+/**
+  @file Profiler.h
+
+  Hierarchical CPU profiler with per-thread scoped zones.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_PROFILER_H
+#define G3D_PROFILER_H
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/G3DGameUnits.h"
+#include <string>
+
+namespace G3D {
+
+namespace _internal {
+    class ProfilerThread;
+}
+
+/**
+ Measures time spent in nested, named zones of code on every thread.
+
+ Mark a zone with G3D_PROFILE_ZONE at the top of a block.  The zone
+ ends when the block exits:
+
+ <PRE>
+    void Sim::onSimulation(RealTime rdt, SimTime sdt, SimTime idt) {
+        G3D_PROFILE_ZONE("Sim::onSimulation");
+        {
+            G3D_PROFILE_ZONE("physics");
+            ...
+        }
+    }
+ </PRE>
+
+ Each thread records the begin and end of its zones with
+ System::getCycleCount into its own lock-free ring buffer, so recording
+ never blocks.  Once per frame, endFrame() (called by GApplet) drains the
+ buffers and builds a tree per thread with the inclusive time, exclusive
+ time, and call count of every zone, keyed by the path of zone names from
+ the root.  Zones still open at the end of a frame are split across the
+ frames.
+
+ Between beginTrace() and endTrace() every zone is also kept and then
+ written as a JSON file that can be loaded by chrome://tracing.
+
+ The profiler is disabled by default.  A disabled zone costs one test of a
+ global flag; define G3D_NO_PROFILER to compile zones out entirely.
+
+ Zone names must be string literals (or otherwise outlive the profiler);
+ only the pointer is recorded.
+
+ <B>BETA API</B>  This is unsupported and may change
+ */
+class Profiler {
+public:
+
+    /** A zone in the tree for one thread and one frame. */
+    class Node {
+    public:
+        const char*     name;
+
+        /** Index of the parent in the same tree, -1 for a root */
+        int             parent;
+
+        /** Number of ancestors */
+        int             depth;
+
+        /** Number of times the zone was entered during the frame.  0 for a zone
+            that was entered in an earlier frame and is still open. */
+        int             callCount;
+
+        /** Time in the zone, including children */
+        RealTime        inclusiveTime;
+
+        /** Time in the zone excluding children */
+        RealTime        exclusiveTime;
+    };
+
+    /** Zones of one thread for one frame, in depth-first order. */
+    class Tree {
+    public:
+        std::string     threadName;
+        Array<Node>     node;
+    };
+
+    /** Totals for a zone name across all threads and positions in the tree. */
+    class Summary {
+    public:
+        const char*     name;
+        int             callCount;
+        RealTime        inclusiveTime;
+        RealTime        exclusiveTime;
+    };
+
+    /** Marks a zone for its lifetime.  Use through G3D_PROFILE_ZONE. */
+    class Zone {
+    private:
+        bool            recorded;
+
+        Zone(const Zone&);
+        Zone& operator=(const Zone&);
+
+    public:
+        inline Zone(const char* name) : recorded(false) {
+            if (m_enabled) {
+                recorded = beginZone(name);
+            }
+        }
+
+        inline ~Zone() {
+            if (recorded) {
+                endZone();
+            }
+        }
+    };
+
+private:
+
+    friend class _internal::ProfilerThread;
+
+    static volatile bool m_enabled;
+
+    /** Returns false if the zone could not be recorded because the thread's
+        buffer is full. */
+    static bool beginZone(const char* name);
+    static void endZone();
+
+public:
+
+    static void setEnabled(bool e);
+
+    static inline bool enabled() {
+        return m_enabled;
+    }
+
+    /** Names the calling thread in trees and traces.  The default is
+        "Thread n". */
+    static void setThreadName(const std::string& name);
+
+    /** Collects the zones recorded by all threads since the previous call.
+        Call once per frame from one thread. */
+    static void endFrame();
+
+    /** Trees for the frame that ended at the last endFrame(), one per
+        thread that recorded zones. */
+    static const Array<Tree>& previousFrame();
+
+    /** Summaries of the previous frame sorted by decreasing exclusive time;
+        at most maxCount are returned. */
+    static void getTopZones(Array<Summary>& out, int maxCount = 10);
+
+    /** Begins keeping every zone for endTrace. */
+    static void beginTrace();
+
+    /** Writes the zones recorded since beginTrace() (and collected by
+        endFrame()) to filename in the Chrome trace event format. */
+    static void endTrace(const std::string& filename);
+};
+
+}
+
+#ifdef G3D_NO_PROFILER
+#   define G3D_PROFILE_ZONE(name)
+#else
+#   define G3D_PROFILE_ZONE_CONCAT2(a, b) a##b
+#   define G3D_PROFILE_ZONE_CONCAT(a, b) G3D_PROFILE_ZONE_CONCAT2(a, b)
+    /** Profiles the rest of the enclosing block under name, which must be a string literal.
+        See G3D::Profiler. */
+#   define G3D_PROFILE_ZONE(name) ::G3D::Profiler::Zone G3D_PROFILE_ZONE_CONCAT(g3dProfileZone, __LINE__)(name)
+#endif
+
+#endif
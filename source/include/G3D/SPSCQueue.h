@@ -0,0 +1,179 @@
+/**
+  @file SPSCQueue.h
+
+  Lock-free bounded queue for one producer thread and one consumer thread.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_SPSCQUEUE_H
+#define G3D_SPSCQUEUE_H
+
+#include "G3D/platform.h"
+#include "G3D/AtomicInt32.h"
+#include "G3D/GThread.h"
+#include "G3D/System.h"
+#include "G3D/Array.h"
+#include "G3D/g3dmath.h"
+#include "G3D/debug.h"
+
+namespace G3D {
+
+/**
+ Fixed-capacity FIFO ring buffer that one thread pushes to and one other
+ thread pops from without locking, e.g., to hand packets from a network
+ thread to the simulation thread.  Use G3D::MPMCQueue when there are several
+ producers or consumers, and G3D::Queue for single-threaded code.
+
+ The head and tail indices live on separate cache lines so that the
+ producer and consumer do not contend for the same line.  Each side also
+ caches the other side's index and rereads it only when the queue appears
+ full (or empty), so in steady state a push or pop touches no shared line
+ except to publish its own index.
+
+ The blocking push() and pop() spin, yielding the processor, until they can
+ proceed; they are intended for threads that have nothing else to do.
+
+ <B>BETA API</B>  This is unsupported and may change
+ */
+template<class T>
+class SPSCQueue {
+private:
+
+    /** Padding between the indices; at least one cache line */
+    enum {PAD = 64};
+
+    /** Slots in the ring, a power of two.  Only those between
+        head and tail hold constructed elements. */
+    T*                  data;
+    uint32              mask;
+
+    uint8               pad0[PAD];
+
+    /** Index of the next element to pop; written only by the consumer */
+    AtomicInt32         head;
+
+    /** Consumer's copy of tail */
+    uint32              cachedTail;
+
+    uint8               pad1[PAD];
+
+    /** Index one past the last element pushed; written only by the producer */
+    AtomicInt32         tail;
+
+    /** Producer's copy of head */
+    uint32              cachedHead;
+
+    uint8               pad2[PAD];
+
+    // Not implemented on purpose, don't use
+    SPSCQueue(const SPSCQueue&);
+    SPSCQueue& operator=(const SPSCQueue&);
+
+public:
+
+    /** @param capacity Rounded up to a power of two */
+    explicit SPSCQueue(int capacity) : head(0), cachedTail(0), tail(0), cachedHead(0) {
+        debugAssert(capacity > 0);
+        const int n = ceilPow2(capacity);
+        mask = n - 1;
+        data = (T*)System::alignedMalloc(sizeof(T) * n, PAD);
+    }
+
+    ~SPSCQueue() {
+        T dummy;
+        while (tryPop(dummy)) {}
+        System::alignedFree(data);
+    }
+
+    inline int capacity() const {
+        return mask + 1;
+    }
+
+    /** Number of elements.  Exact when called from the producer or
+        consumer while the other is idle; otherwise a snapshot. */
+    inline int size() const {
+        return (int)((uint32)tail.value() - (uint32)head.value());
+    }
+
+    /** Producer only.  Returns false without blocking if the queue is full. */
+    inline bool tryPush(const T& e) {
+        const uint32 t = (uint32)tail.value();
+        if (t - cachedHead > mask) {
+            cachedHead = (uint32)head.value();
+            if (t - cachedHead > mask) {
+                return false;
+            }
+        }
+        new (data + (t & mask)) T(e);
+
+        // The locked add orders the element before the new tail
+        tail.add(1);
+        return true;
+    }
+
+    /** Producer only.  Blocks while the queue is full. */
+    inline void push(const T& e) {
+        while (! tryPush(e)) {
+            GThread::yield();
+        }
+    }
+
+    /** Consumer only.  Returns false without blocking if the queue is empty. */
+    inline bool tryPop(T& e) {
+        const uint32 h = (uint32)head.value();
+        if (h == cachedTail) {
+            cachedTail = (uint32)tail.value();
+            if (h == cachedTail) {
+                return false;
+            }
+        }
+        T* slot = data + (h & mask);
+        e = *slot;
+        slot->~T();
+
+        head.add(1);
+        return true;
+    }
+
+    /** Consumer only.  Blocks while the queue is empty. */
+    inline void pop(T& e) {
+        while (! tryPop(e)) {
+            GThread::yield();
+        }
+    }
+
+    /** Consumer only.  Blocks while the queue is empty. */
+    inline T pop() {
+        T e;
+        pop(e);
+        return e;
+    }
+
+    /** Consumer only.  Appends up to maxCount elements to out without
+        blocking and returns the number appended.  The slots are released
+        to the producer all at once. */
+    int tryPopBatch(Array<T>& out, int maxCount) {
+        const uint32 h = (uint32)head.value();
+        cachedTail = (uint32)tail.value();
+        const int n = iMin((int)(cachedTail - h), maxCount);
+
+        for (int i = 0; i < n; ++i) {
+            T* slot = data + ((h + i) & mask);
+            out.append(*slot);
+            slot->~T();
+        }
+
+        if (n > 0) {
+            head.add(n);
+        }
+        return n;
+    }
+};
+
+}
+
+#endif
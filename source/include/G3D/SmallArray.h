@@ -0,0 +1,519 @@
+/**
+  @file SmallArray.h
+
+  Dynamic 1D array with inline storage for the first few elements.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_SMALLARRAY_H
+#define G3D_SMALLARRAY_H
+
+#include "G3D/platform.h"
+#include "G3D/debug.h"
+#include "G3D/System.h"
+#include "G3D/Array.h"
+#include <algorithm>
+
+#ifdef G3D_WIN32
+#   include <new>
+#endif
+
+namespace G3D {
+
+/**
+ Dynamic 1D array that stores up to N elements inside the object
+ itself and only allocates from the heap once it grows beyond that.
+
+ SmallArray has the same interface as G3D::Array.  Use it for
+ arrays that are usually tiny and are created in large numbers or
+ inside inner loops, e.g., per-vertex adjacency lists.  Each
+ SmallArray occupies N * sizeof(T) bytes more than an Array, so keep
+ N small.
+
+ The inline storage is aligned to 8 bytes, not 16; do not use
+ SmallArray for types that require SSE alignment.
+
+ Unlike Array, iterators and references are invalidated by moving
+ (copying) a SmallArray, since the elements live inside the object.
+
+ Do not subclass a SmallArray.
+ */
+template <class T, int N>
+class SmallArray {
+private:
+
+    /** Storage for the first N elements.  The union forces alignment. */
+    union Inline {
+        uint8       byte[N * sizeof(T)];
+        double      d;
+        void*       p;
+    };
+
+    Inline          inlineStorage;
+
+    /** 0...num-1 are initialized elements, num...numAllocated-1 are not.
+        Points at inlineStorage when numAllocated == N. */
+    T*              data;
+
+    int             num;
+    int             numAllocated;
+
+    inline T* inlineData() {
+        return reinterpret_cast<T*>(inlineStorage.byte);
+    }
+
+    inline bool onHeap() const {
+        return numAllocated > N;
+    }
+
+    /**
+     Returns true iff address points to an element of this array.
+     Used by append.
+     */
+    inline bool inArray(const T* address) {
+        return (address >= data) && (address < data + num);
+    }
+
+    /** Only compiled if you use the sort procedure. */
+    static bool __cdecl compareGT(const T& a, const T& b) {
+        return a > b;
+    }
+
+    /**
+     Moves the first oldNum elements to storage for newAllocated
+     elements, which is the inline buffer when newAllocated == N.
+     */
+    void realloc(int oldNum, int newAllocated) {
+        debugAssert(newAllocated >= N);
+        T* oldData = data;
+        const bool oldOnHeap = onHeap();
+
+        if (newAllocated == N) {
+            data = inlineData();
+        } else {
+            data = (T*)System::alignedMalloc(sizeof(T) * newAllocated, 16);
+        }
+        numAllocated = newAllocated;
+
+        debugAssert(oldData != data);
+
+        const int n = iMin(oldNum, numAllocated);
+        for (int i = 0; i < n; ++i) {
+            new (data + i) T(oldData[i]);
+        }
+
+        for (int i = 0; i < oldNum; ++i) {
+            (oldData + i)->~T();
+        }
+
+        if (oldOnHeap) {
+            System::alignedFree(oldData);
+        }
+    }
+
+    void _copy(const T* src, int n) {
+        data = inlineData();
+        num = 0;
+        numAllocated = N;
+        if (n > N) {
+            data = (T*)System::alignedMalloc(sizeof(T) * n, 16);
+            numAllocated = n;
+        }
+        for (int i = 0; i < n; ++i) {
+            new (data + i) T(src[i]);
+        }
+        num = n;
+    }
+
+public:
+
+    typedef T* Iterator;
+    typedef const T* ConstIterator;
+
+    Iterator begin() {
+        return data;
+    }
+
+    ConstIterator begin() const {
+        return data;
+    }
+
+    ConstIterator end() const {
+        return data + num;
+    }
+
+    Iterator end() {
+        return data + num;
+    }
+
+    /**
+     The array returned is only valid until the next append() or resize call,
+     or the SmallArray is copied or deallocated.
+     */
+    T* getCArray() {
+        return data;
+    }
+
+    const T* getCArray() const {
+        return data;
+    }
+
+    /** Creates a zero length array.  No heap allocation occurs. */
+    SmallArray() : data(inlineData()), num(0), numAllocated(N) {
+    }
+
+    SmallArray(int size) : data(inlineData()), num(0), numAllocated(N) {
+        resize(size);
+    }
+
+    SmallArray(const SmallArray& other) {
+        _copy(other.data, other.num);
+    }
+
+    explicit SmallArray(const Array<T>& other) {
+        _copy(other.getCArray(), other.size());
+    }
+
+    /** See the note on Array::~Array regarding pointer types. */
+    ~SmallArray() {
+        for (int i = 0; i < num; ++i) {
+            (data + i)->~T();
+        }
+
+        if (onHeap()) {
+            System::alignedFree(data);
+        }
+        data = NULL;
+        num = 0;
+        numAllocated = 0;
+    }
+
+    SmallArray& operator=(const SmallArray& other) {
+        if (this != &other) {
+            resize(other.num, false);
+            for (int i = 0; i < num; ++i) {
+                data[i] = other.data[i];
+            }
+        }
+        return *this;
+    }
+
+    SmallArray& operator=(const Array<T>& other) {
+        resize(other.size(), false);
+        for (int i = 0; i < num; ++i) {
+            data[i] = other[i];
+        }
+        return *this;
+    }
+
+    /** Copies the elements into an Array. */
+    void getArray(Array<T>& array) const {
+        array.resize(num, false);
+        for (int i = 0; i < num; ++i) {
+            array[i] = data[i];
+        }
+    }
+
+    /**
+     Removes all elements and releases any heap storage.
+     */
+    void clear() {
+        resize(0, true);
+    }
+
+    /** resize(0, false) */
+    void fastClear() {
+        resize(0, false);
+    }
+
+    inline int size() const {
+        return num;
+    }
+
+    inline int length() const {
+        return num;
+    }
+
+    int capacity() const {
+        return numAllocated;
+    }
+
+    /** True if the elements are stored inside the object (no heap storage). */
+    inline bool isInline() const {
+        return ! onHeap();
+    }
+
+    /**
+     Swaps element index with the last element in the array then
+     shrinks the array by one.
+     */
+    void fastRemove(int index) {
+        debugAssert(index >= 0);
+        debugAssert(index < num);
+        data[index] = data[num - 1];
+        resize(num - 1, false);
+    }
+
+    void resize(int n) {
+        resize(n, true);
+    }
+
+    /**
+     When shrinkIfNecessary is true and the new size fits in the inline
+     storage, heap storage is released.
+     */
+    void resize(int n, bool shrinkIfNecessary) {
+        debugAssert(n >= 0);
+        const int oldNum = num;
+
+        // Call the destructors on newly hidden elements if there are any
+        for (int i = n; i < oldNum; ++i) {
+            (data + i)->~T();
+        }
+        num = iMin(n, oldNum);
+
+        if (n > numAllocated) {
+            // Grow geometrically so that repeated append is amortized O(1)
+            realloc(num, iMax(n, numAllocated * 2));
+        } else if (shrinkIfNecessary && onHeap()) {
+            if (n <= N) {
+                realloc(num, N);
+            } else if (n <= numAllocated / 3) {
+                realloc(num, iMax(n * 2, N));
+            }
+        }
+
+        // Do not use parens because we don't want the intializer
+        // invoked for POD types.
+        for (int i = num; i < n; ++i) {
+            new (data + i) T;
+        }
+        num = n;
+    }
+
+    /**
+     Inserts at the specified index and shifts all other elements up by one.
+     */
+    void insert(int n, const T& value) {
+        T tmp = value;
+        resize(num + 1, false);
+        for (int i = num - 1; i > n; --i) {
+            data[i] = data[i - 1];
+        }
+        data[n] = tmp;
+    }
+
+    /**
+     Add an element to the end of the array.  It is safe to append an
+     element that is already in the array.
+     */
+    inline void append(const T& value) {
+        if (num < numAllocated) {
+            new (data + num) T(value);
+            ++num;
+        } else if (inArray(&value)) {
+            T tmp = value;
+            append(tmp);
+        } else {
+            resize(num + 1, false);
+            data[num - 1] = value;
+        }
+    }
+
+    inline void append(const T& v1, const T& v2) {
+        if (inArray(&v1) || inArray(&v2)) {
+            T t1 = v1;
+            T t2 = v2;
+            append(t1, t2);
+        } else if (num + 1 < numAllocated) {
+            new (data + num) T(v1);
+            new (data + num + 1) T(v2);
+            num += 2;
+        } else {
+            resize(num + 2, false);
+            data[num - 2] = v1;
+            data[num - 1] = v2;
+        }
+    }
+
+    inline void append(const T& v1, const T& v2, const T& v3) {
+        if (inArray(&v1) || inArray(&v2) || inArray(&v3)) {
+            T t1 = v1;
+            T t2 = v2;
+            T t3 = v3;
+            append(t1, t2, t3);
+        } else if (num + 2 < numAllocated) {
+            new (data + num) T(v1);
+            new (data + num + 1) T(v2);
+            new (data + num + 2) T(v3);
+            num += 3;
+        } else {
+            resize(num + 3, false);
+            data[num - 3] = v1;
+            data[num - 2] = v2;
+            data[num - 1] = v3;
+        }
+    }
+
+    inline void append(const T& v1, const T& v2, const T& v3, const T& v4) {
+        if (inArray(&v1) || inArray(&v2) || inArray(&v3) || inArray(&v4)) {
+            T t1 = v1;
+            T t2 = v2;
+            T t3 = v3;
+            T t4 = v4;
+            append(t1, t2, t3, t4);
+        } else if (num + 3 < numAllocated) {
+            new (data + num) T(v1);
+            new (data + num + 1) T(v2);
+            new (data + num + 2) T(v3);
+            new (data + num + 3) T(v4);
+            num += 4;
+        } else {
+            resize(num + 4, false);
+            data[num - 4] = v1;
+            data[num - 3] = v2;
+            data[num - 2] = v3;
+            data[num - 1] = v4;
+        }
+    }
+
+    /** Append the elements of array. */
+    void append(const Array<T>& array) {
+        const int oldNum = num;
+        resize(num + array.size(), false);
+        for (int i = 0; i < array.size(); ++i) {
+            data[oldNum + i] = array[i];
+        }
+    }
+
+    /** Pushes a new element onto the end and returns its address. */
+    inline T& next() {
+        resize(num + 1, false);
+        return last();
+    }
+
+    inline void push(const T& value) {
+        append(value);
+    }
+
+    inline void push_back(const T& v) {
+        append(v);
+    }
+
+    inline void pop_back() {
+        popDiscard();
+    }
+
+    /** Removes the last element and returns it. */
+    inline T pop(bool shrinkUnderlyingArrayIfNecessary = false) {
+        debugAssert(num > 0);
+        T temp = data[num - 1];
+        resize(num - 1, shrinkUnderlyingArrayIfNecessary);
+        return temp;
+    }
+
+    inline void popDiscard(bool shrinkUnderlyingArrayIfNecessary = false) {
+        debugAssert(num > 0);
+        resize(num - 1, shrinkUnderlyingArrayIfNecessary);
+    }
+
+    /** Performs bounds checks in debug mode */
+    inline T& operator[](int n) {
+        debugAssert((n >= 0) && (n < num));
+        return data[n];
+    }
+
+    inline const T& operator[](int n) const {
+        debugAssert((n >= 0) && (n < num));
+        return data[n];
+    }
+
+    inline T& front() {
+        return (*this)[0];
+    }
+
+    inline const T& front() const {
+        return (*this)[0];
+    }
+
+    inline T& last() {
+        debugAssert(num > 0);
+        return data[num - 1];
+    }
+
+    inline const T& last() const {
+        debugAssert(num > 0);
+        return data[num - 1];
+    }
+
+    /** Calls delete on all objects[0...size-1] and sets the size to zero. */
+    void deleteAll() {
+        for (int i = 0; i < num; ++i) {
+            delete(data[i]);
+        }
+        resize(0);
+    }
+
+    bool contains(const T& e) const {
+        for (int i = 0; i < num; ++i) {
+            if (data[i] == e) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Returns the index of the first occurance of value or -1 if not found. */
+    int findIndex(const T& value) const {
+        for (int i = 0; i < num; ++i) {
+            if (data[i] == value) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    /** Removes count elements starting at index, preserving order. */
+    void remove(int index, int count = 1) {
+        debugAssert((index >= 0) && (index < num));
+        debugAssert((count > 0) && (index + count <= num));
+        for (int i = index; i < num - count; ++i) {
+            data[i] = data[i + count];
+        }
+        resize(num - count, false);
+    }
+
+    void reverse() {
+        std::reverse(data, data + num);
+    }
+
+    /** See Array::sort */
+    void sort(bool (__cdecl *lessThan)(const T& elem1, const T& elem2)) {
+        std::sort(data, data + num, lessThan);
+    }
+
+    void sort(int direction = SORT_INCREASING) {
+        if (direction == SORT_INCREASING) {
+            std::sort(data, data + num);
+        } else {
+            std::sort(data, data + num, compareGT);
+        }
+    }
+
+    /** Sorts elements beginIndex through and including endIndex. */
+    void sortSubArray(int beginIndex, int endIndex, int direction = SORT_INCREASING) {
+        if (direction == SORT_INCREASING) {
+            std::sort(data + beginIndex, data + endIndex + 1);
+        } else {
+            std::sort(data + beginIndex, data + endIndex + 1, compareGT);
+        }
+    }
+};
+
+} // namespace
+
+#endif
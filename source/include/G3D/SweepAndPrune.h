@@ -0,0 +1,241 @@
+/**
+  @file SweepAndPrune.h
+
+  Incremental broad phase that tracks the overlapping pairs of a set of boxes.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_SWEEPANDPRUNE_H
+#define G3D_SWEEPANDPRUNE_H
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/FlatTable.h"
+#include "G3D/AABox.h"
+#include "G3D/PhysicsFrame.h"
+
+namespace G3D {
+
+/**
+ Finds the pairs of bodies whose axis-aligned bounds overlap, for the
+ broad phase of collision detection.
+
+ Each body is an AABox, given directly or as object space bounds and a
+ PhysicsFrame.  Move bodies with setBounds() and then call step(), which
+ updates the set of overlapping pairs and reports the pairs that began and
+ stopped overlapping since the previous step:
+
+ <PRE>
+    SweepAndPrune broadPhase;
+    for (int i = 0; i < object.size(); ++i) {
+        object[i].body = broadPhase.insert(object[i].bounds, object[i].frame);
+    }
+    ...
+    // Every frame
+    for (int i = 0; i < object.size(); ++i) {
+        broadPhase.setBounds(object[i].body, object[i].bounds, object[i].frame);
+    }
+    broadPhase.step();
+    for (int p = 0; p < broadPhase.addedPairs().size(); ++p) {
+        ...
+    }
+ </PRE>
+
+ For each axis the class keeps the low and high ends of every body
+ in one sorted array.  step() re-sorts the arrays with an insertion sort,
+ which takes time proportional to the number of bodies plus the number of
+ ends that pass each other.  When bodies move a little per step that is
+ close to linear.  Every time the low end of one body passes the high
+ end of another, the pair may have started to overlap and the boxes are
+ tested on all three axes; every time a high end passes a low end, the pair
+ stopped overlapping.  Large batches of new bodies are sorted from scratch
+ instead.
+
+ Boxes that touch overlap.
+
+ <B>BETA API</B>  This is unsupported and may change
+ */
+class SweepAndPrune {
+public:
+
+    /** Two overlapping bodies, identified by the values insert() returned.
+        a < b. */
+    class Pair {
+    public:
+        int             a;
+        int             b;
+
+        Pair() : a(0), b(0) {}
+        Pair(int x, int y) : a(iMin(x, y)), b(iMax(x, y)) {}
+
+        inline bool operator==(const Pair& other) const {
+            return (a == other.a) && (b == other.b);
+        }
+
+        inline bool operator!=(const Pair& other) const {
+            return ! (*this == other);
+        }
+    };
+
+private:
+
+    /** One end of a body on one axis */
+    class Endpoint {
+    public:
+        float           value;
+
+        /** The body in the high bits, and 1 in bit 0 for a high end */
+        uint32          data;
+
+        inline int body() const {
+            return (int)(data >> 1);
+        }
+
+        inline bool isHigh() const {
+            return (data & 1) != 0;
+        }
+
+        /** At equal values low ends sort first, so boxes that touch overlap */
+        inline bool operator<(const Endpoint& other) const {
+            return (value < other.value) ||
+                ((value == other.value) && ((data & 1) < (other.data & 1)));
+        }
+    };
+
+    class Body {
+    public:
+        AABox           bounds;
+
+        /** False once removed */
+        bool            alive;
+    };
+
+    /** If step() has more new bodies than this, it sorts from scratch */
+    enum {MAX_INCREMENTAL_INSERTS = 32};
+
+    Array<Body>         body;
+
+    /** Indices of removed bodies that can be reused */
+    Array<int>          freeBody;
+
+    /** Bodies inserted since the last step */
+    Array<int>          inserted;
+
+    /** Bodies removed since the last step */
+    Array<int>          removed;
+
+    /** Ends of every body except those inserted since the last step, sorted on each axis */
+    Array<Endpoint>     endpoint[3];
+
+    Array<Pair>         m_pairs;
+    Array<Pair>         m_added;
+    Array<Pair>         m_removed;
+
+    /** Maps a pair key to its index in m_pairs */
+    FlatTable<uint64, int> pairIndex;
+
+    /** Number of bodies that are alive */
+    int                 m_size;
+
+    static inline uint64 key(int a, int b) {
+        return ((uint64)(uint32)iMin(a, b) << 32) | (uint64)(uint32)iMax(a, b);
+    }
+
+    inline bool overlaps(int a, int b) const {
+        const AABox& x = body[a].bounds;
+        const AABox& y = body[b].bounds;
+        return
+            (x.low().x <= y.high().x) && (y.low().x <= x.high().x) &&
+            (x.low().y <= y.high().y) && (y.low().y <= x.high().y) &&
+            (x.low().z <= y.high().z) && (y.low().z <= x.high().z);
+    }
+
+    void addPair(int a, int b);
+    void removePair(int a, int b);
+
+    /** Removes m_pairs[i] from m_pairs and pairIndex without reporting it */
+    void removePairAt(int i);
+
+    /** Removes the bodies in removed from the arrays and their pairs */
+    void processRemovals();
+
+    /** Copies the current bounds into the endpoints */
+    void refreshEndpoints();
+
+    void appendEndpoints(int b);
+
+    /** Insertion sort of one axis that updates the pairs as ends pass each other */
+    void sortAxis(int axis);
+
+    /** Sorts every axis from scratch, sweeps the x-axis to find all pairs,
+        and compares them to the previous set */
+    void rebuild();
+
+public:
+
+    SweepAndPrune();
+
+    /** Adds a body and returns its identifier.  Identifiers of removed
+        bodies are reused after step().  Its pairs are found by the next step(). */
+    int insert(const AABox& bounds);
+
+    /** Adds a body with the given object space bounds, transformed by frame. */
+    int insert(const AABox& objectBounds, const PhysicsFrame& frame);
+
+    /** Removes a body.  Its pairs are reported as removed by the next step(). */
+    void remove(int b);
+
+    /** Moves a body.  The pairs change at the next step(). */
+    inline void setBounds(int b, const AABox& bounds) {
+        debugAssert(b >= 0 && b < body.size() && body[b].alive);
+        body[b].bounds = bounds;
+    }
+
+    /** Moves a body to the world space bounds of objectBounds transformed by frame. */
+    void setBounds(int b, const AABox& objectBounds, const PhysicsFrame& frame);
+
+    inline const AABox& bounds(int b) const {
+        return body[b].bounds;
+    }
+
+    /** Number of bodies */
+    inline int size() const {
+        return m_size;
+    }
+
+    /** Updates the pairs for all changes since the last step and fills
+        addedPairs() and removedPairs(). */
+    void step();
+
+    /** Every pair of overlapping bodies as of the last step, in no particular order */
+    inline const Array<Pair>& pairs() const {
+        return m_pairs;
+    }
+
+    /** Pairs that began to overlap during the last step */
+    inline const Array<Pair>& addedPairs() const {
+        return m_added;
+    }
+
+    /** Pairs that stopped overlapping, or one of whose bodies was removed,
+        during the last step */
+    inline const Array<Pair>& removedPairs() const {
+        return m_removed;
+    }
+
+    /** True if the bodies overlapped as of the last step */
+    inline bool overlapping(int a, int b) const {
+        return pairIndex.containsKey(key(a, b));
+    }
+
+    /** Removes all bodies and pairs without reporting them */
+    void clear();
+};
+
+}
+
+#endif
@@ -114,12 +114,18 @@ public:
     static void* alignedMalloc(size_t bytes, size_t alignment);
 
     /**
-     Uses pooled storage to optimize small allocations (1 byte to 5 kilobytes).  
+     Uses pooled storage to optimize small allocations (1 byte to 4 kilobytes).  
      Can be 10x to 100x faster than calling ::malloc or new.
 
+     Each thread keeps its own free lists for small blocks, so
+     allocations on different threads do not contend for a lock.
+     Blocks may be freed on any thread; a block freed on a thread
+     other than the one that allocated it is returned to the
+     allocating thread without locking.
+
      The result must be freed with free.
 
-     Threadsafe on Win32.
+     Threadsafe.
 
      @sa calloc realloc OutOfMemoryCallback free
      */
@@ -156,10 +162,21 @@ public:
     static void* realloc(void* block, size_t bytes);
 
     /** Returns a string describing how well System::malloc is using its internal pooled storage.
-        "heap" memory was slow to allocate; the other data sizes are comparatively fast.*/
+        "heap" memory was slow to allocate; the other data sizes are comparatively fast.
+        Includes one line per thread with its thread-cache hit rate and the number of times
+        it contended with other threads.*/
     static std::string mallocPerformance();
     static void resetMallocPerformanceCounters();
 
+    /**
+     Returns the calling thread's System::malloc cache to the shared pool
+     so that the next thread can reuse it.  GThread calls this when
+     threadMain returns, and exiting threads release their caches
+     automatically on pthreads and on Windows Server 2003 and later.
+     Other threads on older Windows should call it before they exit.
+     */
+    static void releaseMallocThreadCache();
+
     /** 
        Returns a string describing the current usage of the buffer pools used for
        optimizing System::malloc.
@@ -169,7 +186,7 @@ public:
     /**
      Free data allocated with System::malloc.
 
-     Threadsafe on Win32.
+     Threadsafe.
      */
     static void free(void* p);
 
@@ -279,6 +296,10 @@ public:
         Always returns 0 on linux.*/
     static int cpuSpeedMHz();
 
+    /** Number of processor cores (including hyperthreads) available
+        to this process.  Always at least 1. */
+    static int numCores();
+
 private:
     /**
 	 (CKO) Note: Not sure why these are specifically needed
@@ -61,10 +61,10 @@ inline unsigned int hashCode(const G3D::uint64 a) {
 }
 
 inline unsigned int hashCode(const void* a) {
-	// Avoid 64-bit pointer cast problems by turning
-	// the pointer itself into an array of integers.
-	int* intPtr = (int*)(((unsigned char*)&a) + (sizeof(void*) - sizeof(int)));
-	return *intPtr;
+	// Fold the high half of 64-bit pointers into the low half; the high
+	// half alone is the same for most heap pointers.
+	const G3D::uint64 x = (G3D::uint64)(size_t)a;
+	return (unsigned int)(x ^ (x >> 32));
 }
 
 /**
@@ -152,6 +152,17 @@ private:
             System::free(p);
         }
 
+        /** Placement form, used for MemoryArena storage. */
+        inline void* operator new (size_t size, void* p) {
+            (void)size;
+            return p;
+        }
+
+        inline void operator delete (void* p, void* place) {
+            (void)p;
+            (void)place;
+        }
+
 
         Node(Key key, Value value, unsigned int hashCode, Node* next) {
             this->entry.key   = key;
@@ -160,12 +171,6 @@ private:
             this->next        = next;
         }
 
-        /**
-        Clones a whole chain;
-        */
-        Node* clone() {
-           return new Node(this->entry.key, this->entry.value, hashCode, (next == NULL) ? NULL : next->clone());
-        }
     };
 
 
@@ -186,14 +191,59 @@ private:
      */
     int     numBuckets;
 
+    /**
+     If non-NULL, nodes and buckets are allocated from here and never
+     explicitly freed.
+     */
+    MemoryArena* arena;
+
+    inline Node* newNode(const Key& key, const Value& value, unsigned int code, Node* next) {
+        if (arena == NULL) {
+            return new Node(key, value, code, next);
+        } else {
+            return new (arena->alloc(sizeof(Node))) Node(key, value, code, next);
+        }
+    }
+
+    inline void deleteNode(Node* n) {
+        if (arena == NULL) {
+            delete n;
+        } else {
+            n->~Node();
+        }
+    }
+
+    inline Node** newBuckets(int n) {
+        Node** b;
+        if (arena == NULL) {
+            b = (Node**)System::alignedMalloc(sizeof(Node*) * n, 16);
+        } else {
+            b = (Node**)arena->alloc(sizeof(Node*) * n, 16);
+        }
+        System::memset(b, 0, sizeof(Node*) * n);
+        return b;
+    }
+
+    inline void deleteBuckets(Node** b) {
+        if (arena == NULL) {
+            System::alignedFree(b);
+        }
+    }
+
+    /**
+     Clones a whole chain
+     */
+    Node* cloneChain(const Node* n) {
+        return newNode(n->entry.key, n->entry.value, n->hashCode, (n->next == NULL) ? NULL : cloneChain(n->next));
+    }
+
     /**
      Re-hashes for a larger bucket size.
      */
     void resize(int numBuckets) {
 
         Node** oldBucket = bucket;
-        bucket = (Node**)System::alignedMalloc(sizeof(Node*) * numBuckets, 16);
-        System::memset(bucket, 0, sizeof(Node*) * numBuckets);
+        bucket = newBuckets(numBuckets);
 
         for (int b = 0; b < this->numBuckets; b++) {
             Node* node = oldBucket[b];
@@ -210,18 +260,17 @@ private:
             }
         }
 
-        System::alignedFree(oldBucket);
+        deleteBuckets(oldBucket);
         this->numBuckets = numBuckets;
     }
 
     void copyFrom(const Table<Key, Value>& h) {
         this->_size = h._size;
         this->numBuckets = h.numBuckets;
-        this->bucket = (Node**)System::alignedMalloc(sizeof(Node*) * numBuckets, 16);
-        System::memset(this->bucket, 0, sizeof(Node*) * numBuckets);
+        this->bucket = newBuckets(numBuckets);
         for (int b = 0; b < this->numBuckets; b++) {
             if (h.bucket[b] != NULL) {
-                bucket[b] = h.bucket[b]->clone();
+                bucket[b] = cloneChain(h.bucket[b]);
             }
         }
     }
@@ -234,11 +283,11 @@ private:
            Node* node = bucket[b];
            while (node != NULL) {
                 Node* next = node->next;
-                delete node;
+                deleteNode(node);
                 node = next;
            }
         }
-        System::alignedFree(bucket);
+        deleteBuckets(bucket);
         bucket     = NULL;
         numBuckets = 0;
         _size     = 0;
@@ -250,10 +299,21 @@ public:
      Creates an empty hash table.  This causes some heap allocation to occur.
      */
     Table() {
+        arena      = NULL;
         numBuckets = 10;
         _size      = 0;
-        bucket     = (Node**)System::alignedMalloc(sizeof(Node*) * numBuckets, 16);
-        System::memset(bucket, 0, sizeof(Node*) * numBuckets);
+        bucket     = newBuckets(numBuckets);
+    }
+
+    /**
+     Creates an empty hash table whose storage comes from arena.
+     See Array::clearAndSetMemoryArena for the lifetime rules.
+     */
+    explicit Table(MemoryArena* a) {
+        arena      = a;
+        numBuckets = 10;
+        _size      = 0;
+        bucket     = newBuckets(numBuckets);
     }
 
     /**
@@ -266,7 +326,9 @@ public:
         freeMemory();
     }
 
+    /** The copy is heap-backed even if h uses a MemoryArena. */
     Table(const Table<Key, Value>& h) {
+        this->arena = NULL;
         this->copyFrom(h);
     }
 
@@ -454,8 +516,22 @@ public:
          freeMemory();
          numBuckets = 20;
          _size = 0;
-         bucket = (Node**)System::alignedMalloc(sizeof(Node*) * numBuckets, 16);
-         System::memset(bucket, 0, sizeof(Node*) * numBuckets);
+         bucket = newBuckets(numBuckets);
+    }
+
+    /**
+     Removes all elements and allocates all future storage from arena
+     (or from the heap if arena is NULL).
+     */
+    void clearAndSetMemoryArena(MemoryArena* a) {
+         freeMemory();
+         arena = a;
+         clear();
+    }
+
+    /** The arena used for storage, or NULL if heap-backed. */
+    inline MemoryArena* memoryArena() const {
+        return arena;
     }
 
    
@@ -481,7 +557,7 @@ public:
 
         // No bucket, so this must be the first
         if (n == NULL) {
-            bucket[b] = new Node(key, value, code, NULL);
+            bucket[b] = newNode(key, value, code, NULL);
             ++_size;
             return;
         }
@@ -516,7 +592,7 @@ public:
 
         // Not found; insert at the head.
         b = code % numBuckets;
-        bucket[b] = new Node(key, value, code, bucket[b]);
+        bucket[b] = newNode(key, value, code, bucket[b]);
         ++_size;
    }
 
@@ -550,7 +626,7 @@ public:
                   previous->next = n->next;
               }
               // Delete the node
-              delete n;
+              deleteNode(n);
               --_size;
               return;
           }
@@ -14,6 +14,7 @@
 
 #include "G3D/platform.h"
 #include "G3D/Array.h"
+#include "G3D/AsyncFileWriter.h"
 #include <string>
 
 namespace G3D {
@@ -150,6 +151,19 @@ private:
 
     void setOptions(const Options& _opt);
 
+    /** See setAsyncFlushThreshold.  0 when disabled. */
+    int                     asyncFlushThreshold;
+
+    /** True once part of the file has been handed to AsyncFileWriter */
+    bool                    flushedAsync;
+
+    /** Most recent write handed to AsyncFileWriter by this object.*/
+    AsyncWriteRef           pendingWrite;
+
+    /** Hands complete lines to AsyncFileWriter if data exceeds asyncFlushThreshold. 
+        Called from vprintf */
+    void maybeFlushAsync();
+
     /** Converts to the desired newlines.  Called from vprintf */
     void convertNewlines(const std::string& in, std::string& out);
 
@@ -174,6 +188,18 @@ public:
      the method returns immediately and writes the file in the background.*/
     void commit(bool flush = true);
 
+    /** Commit to the filename specified on the constructor on a background
+        thread.  Returns immediately unless the AsyncFileWriter queue is 
+        full; the returned handle reports when the file is ready for reading. */
+    AsyncWriteRef commitAsync();
+
+    /** When more than bytes characters are buffered, the complete lines are
+        handed to AsyncFileWriter and appended to the file, keeping memory
+        bounded for long-running logs.  The flushed text is no longer
+        returned by commitString().  Call commit() or commitAsync() at the
+        end as usual.  Set to 0 (the default) to disable.*/
+    void setAsyncFlushThreshold(int bytes);
+
     /** Commits to this string */
     void commitString(std::string& string);
 
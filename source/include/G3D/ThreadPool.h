@@ -0,0 +1,232 @@
+/**
+  @file ThreadPool.h
+
+  Work-stealing pool of worker threads.
+
+  @maintainer Morgan McGuire, matrix@graphics3d.com
+
+  @created 2026-10-17
+  @edited  2026-10-17
+ */
+
+#ifndef G3D_THREADPOOL_H
+#define G3D_THREADPOOL_H
+
+#include "G3D/platform.h"
+#include "G3D/GThread.h"
+#include "G3D/AtomicInt32.h"
+#include "G3D/Array.h"
+#include "G3D/Queue.h"
+#include "G3D/System.h"
+
+namespace G3D {
+
+namespace _internal {
+    class ThreadPoolWorker;
+}
+
+/**
+ A fixed set of GThread workers that execute ThreadPool::Tasks.
+
+ Each worker keeps its own deque of tasks.  Tasks spawned on a worker are
+ pushed to and popped from the back of its deque, so a worker tends to
+ process the data it just touched.  An idle worker steals from the front of
+ another worker's deque, which takes the oldest (and for recursively split
+ work, largest) task.  Tasks submitted by threads outside the pool go to a
+ shared deque.
+
+ A thread that waits on a TaskGroup executes pending tasks while it waits,
+ so the calling thread contributes to the work and tasks may themselves
+ wait on nested groups without deadlocking.
+
+ Most code should use parallelFor on the common() pool:
+
+ <PRE>
+    class ScaleBody {
+    public:
+        float*  data;
+        float   s;
+        void operator()(int begin, int end) const {
+            for (int i = begin; i < end; ++i) {
+                data[i] *= s;
+            }
+        }
+    };
+    ...
+    ScaleBody body;
+    body.data = array.getCArray();
+    body.s = 2.0f;
+    ThreadPool::common().parallelFor(0, array.size(), 1024, body);
+ </PRE>
+ */
+class ThreadPool {
+public:
+
+    /** A unit of work. */
+    class Task {
+    public:
+        virtual ~Task() {}
+        virtual void run() = 0;
+    };
+
+    /** A set of tasks that can be waited on together. */
+    class TaskGroup {
+    private:
+        friend class ThreadPool;
+
+        ThreadPool&         pool;
+
+        /** Tasks run() but not yet finished */
+        AtomicInt32         pending;
+
+        // Not implemented on purpose, don't use
+        TaskGroup(const TaskGroup&);
+        TaskGroup& operator=(const TaskGroup&);
+
+    public:
+
+        TaskGroup(ThreadPool& p = ThreadPool::common()) : pool(p), pending(0) {}
+
+        /** Waits for the tasks that are still pending. */
+        ~TaskGroup() {
+            wait();
+        }
+
+        /** Schedules task to run on the pool.
+
+            @param deleteWhenDone If true, the pool deletes the task after it
+            runs; otherwise the task must remain valid until wait() returns.*/
+        void run(Task* task, bool deleteWhenDone = false);
+
+        /** Executes pending tasks from the pool until every task
+            in this group has finished. */
+        void wait();
+    };
+
+private:
+
+    friend class _internal::ThreadPoolWorker;
+    friend class TaskGroup;
+
+    class Job {
+    public:
+        Task*           task;
+        TaskGroup*      group;
+        bool            deleteWhenDone;
+    };
+
+    /** Double-ended queue of jobs protected by a lock. */
+    class JobDeque {
+    public:
+        GMutex          lock;
+        Queue<Job>      queue;
+    };
+
+    /** Applies a parallelFor body to a range, splitting off the upper half
+        as a new task until the range is no larger than the grain. */
+    template<class Body>
+    class RangeTask : public Task {
+    public:
+        const Body&     body;
+        int             begin;
+        int             end;
+        int             grain;
+        TaskGroup&      group;
+
+        RangeTask(const Body& b, int i0, int i1, int g, TaskGroup& t) :
+            body(b), begin(i0), end(i1), grain(g), group(t) {}
+
+        virtual void run() {
+            while (end - begin > grain) {
+                const int mid = begin + (end - begin) / 2;
+                group.run(new RangeTask(body, mid, end, grain, group), true);
+                end = mid;
+            }
+            body(begin, end);
+        }
+
+        static void* operator new(size_t size) {
+            return System::malloc(size);
+        }
+
+        static void operator delete(void* p) {
+            System::free(p);
+        }
+    };
+
+    Array<_internal::ThreadPoolWorker*> worker;
+
+    /** One per worker, followed by the deque shared by outside threads. */
+    Array<JobDeque*>    deque;
+
+    /** Released once for each sleeping worker that a push wakes, and once
+        per worker at shutdown.  Workers block on this when they find no work. */
+    GSemaphore          workAvailable;
+
+    /** Workers that found no work and have not yet been woken */
+    AtomicInt32         idleWorkers;
+
+    volatile bool       quit;
+
+    /** Index in deque used by the calling thread. */
+    int currentDequeIndex() const;
+
+    void push(const Job& job);
+
+    /** Takes one worker out of idleWorkers.  Returns false if there were none. */
+    bool claimIdleWorker();
+
+    /** Takes a job from deque[index], or steals one from another deque. */
+    bool findJob(int index, Job& job);
+
+    static void execute(const Job& job);
+
+    // Not implemented on purpose, don't use
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+public:
+
+    /** Starts numWorkers threads.  With zero workers, tasks run on
+        the threads that wait for them. */
+    explicit ThreadPool(int numWorkers);
+
+    /** Waits for the workers to finish their current tasks and then stops
+        them.  Tasks that have not started are discarded. */
+    ~ThreadPool();
+
+    int numWorkers() const {
+        return worker.size();
+    }
+
+    /** Pool shared by the library, with System::numCores() - 1 workers
+        (the thread that waits makes up the last core). */
+    static ThreadPool& common();
+
+    /**
+     Calls body(i0, i1) on disjoint subranges that together cover [begin, end)
+     and returns when all have finished.  Subranges are at most grain
+     elements long unless the whole range is smaller.  Body must provide
+     <CODE>void operator()(int begin, int end) const</CODE> and be safe to
+     call from several threads at once.
+     */
+    template<class Body>
+    void parallelFor(int begin, int end, int grain, const Body& body) {
+        debugAssert(grain > 0);
+        if (end - begin <= grain) {
+            if (end > begin) {
+                body(begin, end);
+            }
+            return;
+        }
+
+        TaskGroup group(*this);
+        RangeTask<Body> root(body, begin, end, grain, group);
+        root.run();
+        group.wait();
+    }
+};
+
+}
+
+#endif
@@ -92,18 +92,25 @@ public:
       originally in the output arrays is cleared.
 
       @param wsLookVector Sort axis; usually the -Z axis of the camera.
+      @param scratch If not NULL, the sort keys are allocated from this arena
+      (e.g., RenderDevice::frameArena()) and released before returning.
+      Otherwise they come from the heap.  Threads that sort at the same time
+      must use different arenas.
      */
     static void sort(
         const Array<PosedModelRef>& inModels, 
         const Vector3&              wsLookVector,
         Array<PosedModelRef>&       opaque,
-        Array<PosedModelRef>&       transparent);
+        Array<PosedModelRef>&       transparent,
+        MemoryArena*                scratch = NULL);
 
-    /** Sorts the array in place along the look vector from front-to-back.*/
+    /** Sorts the array in place along the look vector from front-to-back.
+        See the other sort for scratch. */
     static void sort(
         const Array<PosedModelRef>& inModels, 
         const Vector3&              wsLookVector,
-        Array<PosedModelRef>&       opaque);
+        Array<PosedModelRef>&       opaque,
+        MemoryArena*                scratch = NULL);
 
     /** Object to world space coordinate frame.*/
     virtual void getCoordinateFrame(CoordinateFrame& c) const = 0;
@@ -202,6 +209,20 @@ public:
         return numBoundaryEdges();
     }
 
+    /**
+     Chooses among poses of one object at decreasing levels of detail,
+     finest first (e.g. made from the levels of MeshAlg::computeLODChain).
+     Returns the coarsest level that still has a triangle for every
+     pixelsPerTriangle pixels that the bounding sphere of levels[0] covers
+     on screen (see GCamera::worldToScreenSpaceArea), or levels[0] when
+     the camera is within that sphere's radius of its center plane.
+     */
+    static PosedModelRef selectLOD(
+        const Array<PosedModelRef>& levels,
+        const class GCamera&        camera,
+        const class Rect2D&         viewport,
+        float                       pixelsPerTriangle = 16.0f);
+
     /** 
      Render all terms that are independent of shadowing 
      (e.g., transparency, reflection, ambient illumination, 
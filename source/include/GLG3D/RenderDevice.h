@@ -18,6 +18,7 @@
 
 #include "G3D/platform.h"
 #include "G3D/Array.h"
+#include "G3D/MemoryArena.h"
 #include "G3D/GLight.h"
 #include "G3D/TextOutput.h"
 #include "G3D/MeshAlg.h"
@@ -239,6 +240,9 @@ private:
     /** Number of triangles since last beginFrame() */
     int                         triangleCount;
 
+    /** Scratch memory for the current frame; reset by endFrame() */
+    MemoryArena                 _frameArena;
+
     double                      emwaTriangleCount;
     double                      emwaTriangleRate;
 
@@ -592,6 +596,19 @@ public:
 		return triangleCount;
 	}
 
+    /**
+     Scratch allocator for temporaries that do not outlive the frame,
+     e.g., vertex arrays built while rendering.  Everything allocated from
+     it is released by endFrame(), so allocate inside a MemoryArena::Scope
+     or discard the memory before then.
+
+     frameArena().previousPeakBytes() reports the peak usage of the
+     last complete frame.
+     */
+    inline MemoryArena& frameArena() {
+        return _frameArena;
+    }
+
     /**
      Use ALWAYS_PASS to shut off testing.
      */
@@ -34,53 +34,72 @@ using namespace G3D;
 //#define RUN_SLOW_TESTS
 
 // Forward declarations
-void perfArray();
+void perfArray(Benchmark& benchmark);
 void testArray();
 
 void testMatrix();
 
 void testMatrix3();
-void perfMatrix3();
+void perfMatrix3(Benchmark& benchmark);
 
 void testCollisionDetection();
-void perfCollisionDetection();
+void perfCollisionDetection(Benchmark& benchmark);
 
 void testGChunk();
 
 void testQuat();
 
-void perfAABSPTree();
+void perfAABSPTree(Benchmark& benchmark);
 void testAABSPTree();
 
 void testAABox();
 
 void testReliableConduit(NetworkDevice*);
 
-void perfSystemMemcpy();
+void perfSystemMemcpy(Benchmark& benchmark);
 void testSystemMemcpy();
 void testSystemMemset();
 
+void perfSystemMalloc(Benchmark& benchmark);
+void testSystemMalloc();
+
 void testReferenceCount();
 
 void testRandom();
 
-void perfTextOutput();
+void perfTextOutput(Benchmark& benchmark);
 
 void testMeshAlgTangentSpace();
 
-void perfQueue();
+void perfQueue(Benchmark& benchmark);
 void testQueue();
 
 void testBinaryIO();
 void testHugeBinaryIO();
-void perfBinaryIO();
+void perfBinaryIO(Benchmark& benchmark);
 
 void testTextInput();
+void testTextOutput();
 
 void testTable();
 void testAdjacency();
+void perfAdjacency(Benchmark& benchmark);
+void testMeshAlgWeld();
+void perfMeshAlgWeld(Benchmark& benchmark);
+void testMeshAlgVertexCache();
+void perfMeshAlgVertexCache(Benchmark& benchmark);
+void testMeshAlgSimplify();
+void perfMeshAlgSimplify(Benchmark& benchmark);
+void testMeshAlgNormals();
+void perfMeshAlgNormals(Benchmark& benchmark);
+
+void perfTable(Benchmark& benchmark);
 
-void perfTable();
+void testFlatTable();
+
+void testSmallArray();
+void testMemoryArena();
+void perfSmallArray(Benchmark& benchmark);
 
 void testAtomicInt32();
 
@@ -88,6 +107,16 @@ void testCoordinateFrame();
 
 void testGThread();
 
+void testThreadPool();
+void perfThreadPool(Benchmark& benchmark);
+
+void testProfiler();
+
+void testBenchmark();
+
+void testSweepAndPrune();
+void perfSweepAndPrune(Benchmark& benchmark);
+
 
 void testConvexPolygon2D() {
     printf("ConvexPolygon2D\n");
@@ -273,85 +302,66 @@ public:
 
 
 
-void measureMemsetPerformance() {
-    printf("----------------------------------------------------------\n");
+/** Bytes set per benchmark iteration */
+static const int MEMSET_SIZE = 1024 * 1024;
 
-    uint64 native = 0, g3d = 0;
+static void* memsetBuffer = NULL;
 
-    int n = 1024 * 1024;
-    void* m1 = malloc(n);
+static void nativeMemset() {
+    memset(memsetBuffer, 31, MEMSET_SIZE);
+}
 
-    // First iteration just primes the system
-    for (int i=0; i < 2; ++i) {
-        System::beginCycleCount(native);
-            memset(m1, 31, n);
-        System::endCycleCount(native);
-        System::beginCycleCount(g3d);
-            System::memset(m1, 31, n);
-        System::endCycleCount(g3d);
-    }
-    free(m1);
 
-    printf("System::memset:                     %d cycles/kb\n", (int)(g3d / (n / 1024)));
-    printf("::memset      :                     %d cycles/kb\n", (int)(native / (n / 1024)));
+static void g3dMemset() {
+    System::memset(memsetBuffer, 31, MEMSET_SIZE);
 }
 
 
+/** Cycles per element are cycles per kb */
+void measureMemsetPerformance(Benchmark& benchmark) {
+    if (memsetBuffer == NULL) {
+        memsetBuffer = malloc(MEMSET_SIZE);
+    }
+    benchmark.add("System::memset", g3dMemset,      MEMSET_SIZE / 1024);
+    benchmark.add("::memset",       nativeMemset,   MEMSET_SIZE / 1024);
+}
 
 
+/** Normalizations per benchmark iteration; each performs 3 */
+static const int NORMALIZE_COUNT = 1024 * 1024;
 
-void measureNormalizationPerformance() {
-    printf("----------------------------------------------------------\n");
-    uint64 raw = 0, opt = 0, overhead = 0;
-    int n = 1024 * 1024;
+/** Keeps the compiler from eliding the loops */
+static volatile double normalizeSink = 0;
 
-    double y;
+static void direction() {
     Vector3 x = Vector3(10,-20,3);
-
-    int i, j;
-
-    for (j = 0; j < 2; ++j) {
-        x = Vector3(10,-20,3);
-		y = 0;
-        System::beginCycleCount(overhead);
-        for (i = n - 1; i >= 0; --i) {
-            x.z = i;
-            y += x.z;
-        }
-        System::endCycleCount(overhead);
-    }
-
-    x = Vector3(10,-20,3);
-    y = 0;
-    System::beginCycleCount(raw);
-    for (i = n - 1; i >= 0; --i) {
+    double y = 0;
+    for (int i = NORMALIZE_COUNT - 1; i >= 0; --i) {
         x.z = i;
         y += x.direction().z;
         y += x.direction().z;
         y += x.direction().z;
     }
-    System::endCycleCount(raw);
-    
-    x = Vector3(10,-20,3);
-    y = 0;
-    System::beginCycleCount(opt);
-    for (i = n - 1; i >= 0; --i) {
+    normalizeSink = y;
+}
+
+
+static void fastDirection() {
+    Vector3 x = Vector3(10,-20,3);
+    double y = 0;
+    for (int i = NORMALIZE_COUNT - 1; i >= 0; --i) {
         x.z = i;
         y += x.fastDirection().z;
         y += x.fastDirection().z;
         y += x.fastDirection().z;
     }
-    System::endCycleCount(opt);
-
-    double r = raw;
-    double o = opt;
-    double h = overhead;
-
-    printf("%g %g %g\n", r-h, o-h, h);
+    normalizeSink = y;
+}
 
-    printf("Vector3::direction():               %d cycles\n", (int)((r-h)/(n*3.0)));
-    printf("Vector3::fastDirection():           %d cycles\n", (int)((o-h)/(n*3.0)));
 
+void measureNormalizationPerformance(Benchmark& benchmark) {
+    benchmark.add("Vector3::direction()",       direction,      NORMALIZE_COUNT * 3);
+    benchmark.add("Vector3::fastDirection()",   fastDirection,  NORMALIZE_COUNT * 3);
 }
 
 
@@ -468,9 +478,30 @@ void measureRDPushPopPerformance(RenderDevice* rd) {
 }
 
 
+/**
+ Optional arguments:
+
+ <PRE>
+   -filter <substring>   only run benchmarks whose names contain substring
+   -baseline <file.csv>  compare against an earlier benchmark.csv instead of
+                         benchmark-baseline.csv
+ </PRE>
+
+ Benchmark results are written to benchmark.json and benchmark.csv.  The
+ exit code is nonzero if any benchmark regressed against the baseline.
+ */
 int main(int argc, char* argv[]) {
-    (void)argc;
-    (void)argv;
+    std::string benchmarkFilter;
+    std::string benchmarkBaseline = "benchmark-baseline.csv";
+    for (int i = 1; i < argc - 1; i += 2) {
+        if (strcmp(argv[i], "-filter") == 0) {
+            benchmarkFilter = argv[i + 1];
+        } else if (strcmp(argv[i], "-baseline") == 0) {
+            benchmarkBaseline = argv[i + 1];
+        }
+    }
+
+    int regressions = 0;
 
     RenderDevice* renderDevice = NULL;
 
@@ -490,29 +521,44 @@ int main(int argc, char* argv[]) {
 #    ifndef _DEBUG
         printf("Performance analysis:\n\n");
 
-	perfCollisionDetection();
-
-        perfArray();
-
-        perfTable();
+        {
+            Benchmark benchmark;
+            benchmark.settings().filter = benchmarkFilter;
+
+            perfCollisionDetection(benchmark);
+            perfArray(benchmark);
+            perfTable(benchmark);
+            perfSystemMalloc(benchmark);
+            perfSmallArray(benchmark);
+            perfQueue(benchmark);
+            perfMatrix3(benchmark);
+            perfTextOutput(benchmark);
+            perfSystemMemcpy(benchmark);
+            perfBinaryIO(benchmark);
+            perfAABSPTree(benchmark);
+            perfSweepAndPrune(benchmark);
+            perfAdjacency(benchmark);
+            perfMeshAlgWeld(benchmark);
+            perfMeshAlgVertexCache(benchmark);
+            perfMeshAlgSimplify(benchmark);
+            perfMeshAlgNormals(benchmark);
+            perfThreadPool(benchmark);
+            measureMemsetPerformance(benchmark);
+            measureNormalizationPerformance(benchmark);
+
+            benchmark.run();
+
+            regressions = benchmark.compareToBaseline(benchmarkBaseline);
+            if (regressions >= 0) {
+                printf("\nCompared to %s:\n%s", benchmarkBaseline.c_str(), benchmark.report().c_str());
+                printf("%d regression%s\n", regressions, (regressions == 1) ? "" : "s");
+            }
+            benchmark.writeJSON("benchmark.json");
+            benchmark.writeCSV("benchmark.csv");
+        }
 
         printf("%s\n", System::mallocPerformance().c_str());
 
-        perfQueue();
-
-        perfMatrix3();
-
-        perfTextOutput();
-
-        perfSystemMemcpy();
-
-        perfBinaryIO();
-
-        perfAABSPTree();
-
-        measureMemsetPerformance();
-        measureNormalizationPerformance();
-
 	GWindow::Settings settings;
         settings.width = 800;
         settings.height = 600;
@@ -542,6 +588,12 @@ int main(int argc, char* argv[]) {
 
     testTable();
 
+    testFlatTable();
+
+    testSmallArray();
+
+    testMemoryArena();
+
     testCollisionDetection();    
 
     testCoordinateFrame();
@@ -550,6 +602,8 @@ int main(int argc, char* argv[]) {
 
 	testAABSPTree();
 
+    testSweepAndPrune();
+
 	testQuat();
 
     testReferenceCount();
@@ -558,10 +612,18 @@ int main(int argc, char* argv[]) {
 
     testGThread();
 
+    testThreadPool();
+
+    testProfiler();
+
+    testBenchmark();
+
     testSystemMemset();
 
     testSystemMemcpy();
 
+    testSystemMalloc();
+
     testQueue();
 
 	// Don't run contrib tests until the new 7.00 build system is in place
@@ -585,6 +647,10 @@ int main(int argc, char* argv[]) {
     testAABoxCollision();
     printf("  passed\n");
     testAdjacency();
+    testMeshAlgWeld();
+    testMeshAlgVertexCache();
+    testMeshAlgSimplify();
+    testMeshAlgNormals();
     printf("  passed\n");
     testWildcards();
     printf("  passed\n");
@@ -608,6 +674,8 @@ int main(int argc, char* argv[]) {
 
     testBinaryIO();
 
+    testTextOutput();
+
 #   ifdef RUN_SLOW_TESTS
         testHugeBinaryIO();
         printf("  passed\n");
@@ -629,6 +697,6 @@ int main(int argc, char* argv[]) {
 	    delete networkDevice;
 	}
 
-    return 0;
+    return (regressions > 0) ? 1 : 0;
 }
 
@@ -50,27 +50,657 @@ static void testBoxIntersect() {
 }
 
 
-void perfAABSPTree() {
+/** Random boxes in a few clusters, with some large ones mixed in */
+static void makeClusteredBoxes(Array<AABox>& array, int n) {
+    Vector3 cluster[4];
+    for (int c = 0; c < 4; ++c) {
+        cluster[c] = Vector3::random() * 8;
+    }
 
-    Array<AABox>                array;
-    AABSPTree<AABox>            tree;
-    
-    const int NUM_POINTS = 100000;
-    
-    for (int i = 0; i < NUM_POINTS; ++i) {
-        Vector3 pt = Vector3(uniformRandom(-10, 10), uniformRandom(-10, 10), uniformRandom(-10, 10));
-        AABox box(pt, pt + Vector3(.1f, .1f, .1f));
-        array.append(box);
-        tree.insert(box);
+    for (int i = 0; i < n; ++i) {
+        const Vector3 pt = cluster[i % 4] + Vector3::random() * uniformRandom(0, 2);
+        const float size = ((i % 50) == 0) ? uniformRandom(1, 4) : uniformRandom(0.01f, 0.2f);
+        array.append(AABox(pt, pt + Vector3(size, size * 0.5f, size)));
     }
+}
 
-    tree.balance();
 
-    uint64 bspcount = 0, arraycount = 0, boxcount = 0;
+static void testSAH() {
+    Array<AABox> array;
+    makeClusteredBoxes(array, 5000);
+
+    AABSPTree<AABox> tree;
+    tree.insert(array);
+    tree.balanceSAH();
+
+    debugAssert(tree.size() == array.size());
+    for (int i = 0; i < array.size(); ++i) {
+        debugAssert(tree.contains(array[i]));
+    }
+
+    // Box queries agree with brute force
+    for (int q = 0; q < 20; ++q) {
+        const Vector3 c = Vector3::random() * 8;
+        const AABox box(c - Vector3(1, 1, 1), c + Vector3(1, 2, 1));
+
+        Array<AABox> hits;
+        tree.getIntersectingMembers(box, hits);
+
+        int expected = 0;
+        for (int i = 0; i < array.size(); ++i) {
+            if (array[i].intersects(box)) {
+                ++expected;
+            }
+        }
+        debugAssert(hits.size() == expected);
+    }
+
+    // Plane queries agree with brute force
+    Array<Plane> plane;
+    plane.append(Plane(Vector3(-1, 0, 0), Vector3(3, 1, 1)));
+    plane.append(Plane(Vector3(1, 0, 0), Vector3(-3, 1, 1)));
+    plane.append(Plane(Vector3(0, 1, 0), Vector3(1, -2, 1)));
+    {
+        Array<AABox> hits;
+        tree.getIntersectingMembers(plane, hits);
+
+        int expected = 0;
+        for (int i = 0; i < array.size(); ++i) {
+            if (! array[i].culledBy(plane)) {
+                ++expected;
+            }
+        }
+        debugAssert(hits.size() == expected);
+    }
+
+    // Removal after an SAH build
+    for (int i = 0; i < array.size(); i += 2) {
+        tree.remove(array[i]);
+    }
+    debugAssert(tree.size() == array.size() / 2);
+    {
+        Array<AABox> all;
+        tree.getMembers(all);
+        debugAssert(all.size() == array.size() / 2);
+    }
+
+    // Coincident points cannot be split
+    AABSPTree<Vector3> pointTree;
+    for (int i = 0; i < 100; ++i) {
+        pointTree.insert(Vector3(1, 2, float(i % 2)));
+    }
+    pointTree.balanceSAH(1);
+    Array<Vector3> hits;
+    pointTree.getIntersectingMembers(AABox(Vector3(0, 0, 0.5f), Vector3(2, 3, 2)), hits);
+    debugAssert(hits.size() == 1);
+
+    // Collinear points have bounds with no area but can still be split
+    AABSPTree<Vector3> lineTree;
+    for (int i = 0; i < 1000; ++i) {
+        lineTree.insert(Vector3(float(i), 5, -3));
+    }
+    lineTree.balanceSAH();
+    int valuesTested = 0;
+    const AABox query(Vector3(499.5f, 4, -4), Vector3(500.5f, 6, -2));
+    debugAssert(lineTree.debugCountBoxQueryVisits(query, valuesTested) > 1);
+    debugAssert(valuesTested < 50);
+    hits.fastClear();
+    lineTree.getIntersectingMembers(query, hits);
+    debugAssert((hits.size() == 1) && (hits[0].x == 500));
+}
+
+
+/** Moves each box by its velocity, bouncing off the walls of [-10, 10]^3 */
+static void moveBoxes(Array<AABox>& box, Array<Vector3>& velocity) {
+    for (int i = 0; i < box.size(); ++i) {
+        Vector3 lo = box[i].low() + velocity[i];
+        for (int a = 0; a < 3; ++a) {
+            if ((lo[a] < -10) || (lo[a] > 10)) {
+                velocity[i][a] = -velocity[i][a];
+                lo[a] += 2 * velocity[i][a];
+            }
+        }
+        box[i] = AABox(lo, lo + box[i].high() - box[i].low());
+    }
+}
+
+
+static void testRefit() {
+    // The tree holds pointers so that members keep their identity as they move
+    Array<AABox> box;
+    Array<Vector3> velocity;
+    makeClusteredBoxes(box, 2000);
+    for (int i = 0; i < box.size(); ++i) {
+        velocity.append(Vector3::random() * 0.5f);
+    }
+
+    Array<AABox*> member;
+    for (int i = 0; i < box.size(); ++i) {
+        member.append(&box[i]);
+    }
+
+    AABSPTree<AABox*> tree;
+    tree.insert(member);
+    tree.balanceSAH();
+    tree.refit();
+
+    for (int frame = 0; frame < 20; ++frame) {
+        moveBoxes(box, velocity);
+        tree.update(member);
+        tree.refit();
+
+        debugAssert(tree.size() == member.size());
+
+        const Vector3 c = Vector3::random() * 8;
+        const AABox query(c - Vector3(2, 2, 2), c + Vector3(2, 2, 2));
+        Array<AABox*> hits;
+        tree.getIntersectingMembers(query, hits);
 
-    // Run twice to get cache issues out of the way
-    for (int it = 0; it < 2; ++it) {
+        int expected = 0;
+        for (int i = 0; i < box.size(); ++i) {
+            if (box[i].intersects(query)) {
+                ++expected;
+            }
+        }
+        debugAssert(hits.size() == expected);
+
+        // The same region as planes facing inward
         Array<Plane> plane;
+        for (int a = 0; a < 3; ++a) {
+            Vector3 n = Vector3::zero();
+            n[a] = 1;
+            plane.append(Plane(n, query.low()), Plane(-n, query.high()));
+        }
+        hits.fastClear();
+        tree.getIntersectingMembers(plane, hits);
+        expected = 0;
+        for (int i = 0; i < box.size(); ++i) {
+            if (! box[i].culledBy(plane)) {
+                ++expected;
+            }
+        }
+        debugAssert(hits.size() == expected);
+    }
+
+    // A query that misses every member stops at the root, wherever the
+    // splitting planes are
+    {
+        int valuesTested = 0;
+        const AABox empty(Vector3(50, 50, 50), Vector3(51, 51, 51));
+        for (int i = 0; i < box.size(); ++i) {
+            debugAssert(! box[i].intersects(empty));
+        }
+        debugAssert(tree.debugCountBoxQueryVisits(empty, valuesTested) == 1);
+    }
+
+    // Removing everything empties the tree, which can then be refilled
+    for (int i = 0; i < member.size(); ++i) {
+        tree.remove(member[i]);
+    }
+    tree.refit();
+    debugAssert(tree.size() == 0);
+    tree.update(member);
+    tree.refit();
+    debugAssert(tree.size() == member.size());
+}
+
+
+/** Records the first box hit by a ray.  The intersection callback for
+    FrozenAABSPTree::intersectRay. */
+class FirstHit {
+public:
+    const AABox*    hit;
+
+    FirstHit() : hit(NULL) {}
+
+    void operator()(const Ray& ray, const AABox& box, float& distance) {
+        const float t = ray.intersectionTime(box);
+        if (t < distance) {
+            distance = t;
+            hit = &box;
+        }
+    }
+};
+
+
+/** First hit with the iterator, following the example in AABSPTree::beginRayIntersection */
+static float firstHitTime(const AABSPTree<AABox>& tree, const Ray& ray) {
+    typedef AABSPTree<AABox>::RayIntersectionIterator IT;
+    const IT end = tree.endRayIntersection();
+
+    float firstTime = inf();
+    for (IT obj = tree.beginRayIntersection(ray); obj != end; ++obj) {
+        const float t = ray.intersectionTime(*obj);
+        if (t < firstTime) {
+            firstTime = t;
+            obj.markBreakNode();
+        }
+    }
+    return firstTime;
+}
+
+
+/** size x size rays from a pinhole camera looking down the z axis at the
+    [-10, 10]^3 volume, with each group of four covering a 2x2 pixel block */
+static void makePrimaryRays(Array<Ray>& ray, int size) {
+    const Vector3 eye(0, 0, -30);
+    for (int y = 0; y < size; y += 2) {
+        for (int x = 0; x < size; x += 2) {
+            for (int i = 0; i < 4; ++i) {
+                const float u = ((x + (i & 1)) / (float)size - 0.5f) * 0.6f;
+                const float v = ((y + (i >> 1)) / (float)size - 0.5f) * 0.6f;
+                ray.append(Ray::fromOriginAndDirection(eye, Vector3(u, v, 1).direction()));
+            }
+        }
+    }
+}
+
+
+static void testRayPacket(const FrozenAABSPTree<AABox>& frozen) {
+    // Coherent packets, then packets whose directions differ in sign,
+    // and a partial packet at the end
+    Array<Ray> ray;
+    makePrimaryRays(ray, 8);
+    for (int i = 0; i < 30; ++i) {
+        ray.append(Ray::fromOriginAndDirection(Vector3::random() * 12, Vector3::random()));
+    }
+    ray.append(Ray::fromOriginAndDirection(Vector3(0, 0, -20), Vector3::unitZ()));
+
+    FirstHit callback;
+    Array<float> distance;
+    Array<const AABox*> firstHit;
+    frozen.intersectRays(ray, callback, distance, firstHit);
+    debugAssert(distance.size() == ray.size());
+
+    int hits = 0;
+    for (int i = 0; i < ray.size(); ++i) {
+        FirstHit expected;
+        float t = inf();
+        frozen.intersectRay(ray[i], expected, t);
+        debugAssert(distance[i] == t);
+        debugAssert(firstHit[i] == expected.hit);
+        if (firstHit[i] != NULL) {
+            ++hits;
+        }
+    }
+    debugAssert(hits > 0);
+
+    // Limited distance
+    frozen.intersectRays(ray, callback, distance, firstHit, 1.0f);
+    for (int i = 0; i < ray.size(); ++i) {
+        debugAssert(distance[i] <= 1.0f);
+        debugAssert((firstHit[i] == NULL) == (distance[i] == 1.0f));
+    }
+
+    // Rays that miss everything, as a coherent packet and one ray at a time,
+    // return maxDistance
+    Array<Ray> away;
+    for (int i = 0; i < 4; ++i) {
+        away.append(Ray::fromOriginAndDirection(Vector3(i * 0.1f, 0, -200), -Vector3::unitZ()));
+    }
+    away.append(Ray::fromOriginAndDirection(Vector3(200, 0, 0), Vector3::unitX()));
+    away.append(Ray::fromOriginAndDirection(Vector3(-200, 0, 0), -Vector3::unitX()));
+    for (int m = 0; m < 2; ++m) {
+        const float maxDistance = (m == 0) ? inf() : 50.0f;
+        frozen.intersectRays(away, callback, distance, firstHit, maxDistance);
+        for (int i = 0; i < away.size(); ++i) {
+            debugAssert(firstHit[i] == NULL);
+            debugAssert(distance[i] == maxDistance);
+        }
+    }
+}
+
+
+/** Records the nearest box reached by rays along +z */
+class FirstHitAlongZ {
+public:
+    void operator()(const Ray& ray, const AABox& box, float& distance) {
+        const float t = max(box.low().z - ray.origin.z, 0.0f);
+        if (t < distance) {
+            distance = t;
+        }
+    }
+};
+
+
+/** Rays parallel to the faces of grid-aligned boxes, starting in the planes of those faces */
+static void testRayPacketOnFaces() {
+    Array<AABox> array;
+    for (int x = 0; x < 4; ++x) {
+        for (int y = 0; y < 4; ++y) {
+            const Vector3 low((float)x, (float)y, (float)(x + y));
+            array.append(AABox(low, low + Vector3(1, 1, 1)));
+        }
+    }
+
+    AABSPTree<AABox> tree;
+    tree.insert(array);
+    tree.balanceSAH();
+    FrozenAABSPTree<AABox> frozen(tree);
+
+    Array<Ray> ray;
+    for (int x = 0; x <= 4; ++x) {
+        for (int y = 0; y < 4; ++y) {
+            ray.append(Ray::fromOriginAndDirection(Vector3((float)x, y + 0.5f, -5), Vector3::unitZ()));
+            if (x < 4) {
+                ray.append(Ray::fromOriginAndDirection(Vector3(x + 0.5f, (float)y, -5), Vector3::unitZ()));
+            }
+        }
+    }
+
+    FirstHitAlongZ callback;
+    Array<float> distance;
+    Array<const AABox*> firstHit;
+    frozen.intersectRays(ray, callback, distance, firstHit);
+    for (int i = 0; i < ray.size(); ++i) {
+        float t = inf();
+        frozen.intersectRay(ray[i], callback, t);
+        debugAssert(distance[i] == t);
+        // Every ray lies on a face of some box
+        debugAssert(t < inf());
+    }
+}
+
+
+static void testFrozen() {
+    Array<AABox> array;
+    makeClusteredBoxes(array, 3000);
+
+    AABSPTree<AABox> tree;
+    tree.insert(array);
+    tree.balanceSAH();
+
+    FrozenAABSPTree<AABox> frozen(tree);
+    debugAssert(frozen.size() == tree.size());
+
+    for (int q = 0; q < 20; ++q) {
+        const Vector3 c = Vector3::random() * 8;
+
+        // Box
+        const AABox box(c - Vector3(1, 1, 1), c + Vector3(1, 2, 1));
+        Array<AABox> a, b;
+        tree.getIntersectingMembers(box, a);
+        frozen.getIntersectingMembers(box, b);
+        debugAssert(a.size() == b.size());
+
+        // Sphere
+        const Sphere sphere(c, 1.5);
+        a.fastClear();
+        b.fastClear();
+        tree.getIntersectingMembers(sphere, a);
+        frozen.getIntersectingMembers(sphere, b);
+        debugAssert(a.size() == b.size());
+
+        // Ray, against brute force
+        const Ray ray = Ray::fromOriginAndDirection(Vector3::random() * 12, Vector3::random());
+        float expected = inf();
+        for (int i = 0; i < array.size(); ++i) {
+            expected = min(expected, ray.intersectionTime(array[i]));
+        }
+
+        FirstHit hit;
+        float distance = inf();
+        frozen.intersectRay(ray, hit, distance);
+        debugAssert(distance == expected);
+        debugAssert((hit.hit != NULL) == (expected < inf()));
+    }
+
+    // Planes
+    Array<Plane> plane;
+    plane.append(Plane(Vector3(-1, 0, 0), Vector3(3, 1, 1)));
+    plane.append(Plane(Vector3(1, 0, 0), Vector3(-3, 1, 1)));
+    plane.append(Plane(Vector3(0, 1, 0), Vector3(1, -2, 1)));
+    {
+        Array<AABox> a, b;
+        tree.getIntersectingMembers(plane, a);
+        frozen.getIntersectingMembers(plane, b);
+        debugAssert(a.size() == b.size());
+    }
+
+    testRayPacket(frozen);
+    testRayPacketOnFaces();
+
+    // Back to a tree with the same members and planes
+    AABSPTree<AABox> thawed;
+    thawed.insert(AABox(Vector3(100, 100, 100), Vector3(101, 101, 101)));
+    frozen.thaw(thawed);
+    debugAssert(thawed.size() == array.size());
+    for (int i = 0; i < array.size(); ++i) {
+        debugAssert(thawed.contains(array[i]));
+    }
+    {
+        const AABox box(Vector3(-2, -2, -2), Vector3(2, 2, 2));
+        Array<AABox> a, b;
+        tree.getIntersectingMembers(box, a);
+        thawed.getIntersectingMembers(box, b);
+        debugAssert(a.size() == b.size());
+    }
+    thawed.remove(array[0]);
+    debugAssert(! thawed.contains(array[0]));
+
+    // Empty
+    AABSPTree<AABox> empty;
+    frozen.freeze(empty);
+    debugAssert(frozen.size() == 0);
+    Array<AABox> none;
+    frozen.getIntersectingMembers(AABox(Vector3(-1, -1, -1), Vector3(1, 1, 1)), none);
+    debugAssert(none.size() == 0);
+}
+
+
+/** Checks that two frozen trees return the same members for box, plane, and ray queries */
+static void checkSameQueries(const FrozenAABSPTree<AABox>& a, const FrozenAABSPTree<AABox>& b) {
+    debugAssert(a.size() == b.size());
+    debugAssert(a.numNodes() == b.numNodes());
+
+    Array<AABox> x, y;
+    a.getMembers(x);
+    b.getMembers(y);
+    debugAssert(x.size() == y.size());
+    for (int i = 0; i < x.size(); ++i) {
+        debugAssert(x[i] == y[i]);
+    }
+
+    for (int q = 0; q < 20; ++q) {
+        const Vector3 c = Vector3::random() * 8;
+        const AABox box(c - Vector3(1, 1, 1), c + Vector3(1, 2, 1));
+        x.fastClear();
+        y.fastClear();
+        a.getIntersectingMembers(box, x);
+        b.getIntersectingMembers(box, y);
+        debugAssert(x.size() == y.size());
+
+        const Ray ray = Ray::fromOriginAndDirection(Vector3::random() * 12, Vector3::random());
+        FirstHit hit;
+        float s = inf(), t = inf();
+        a.intersectRay(ray, hit, s);
+        b.intersectRay(ray, hit, t);
+        debugAssert(s == t);
+    }
+
+    Array<Plane> plane;
+    plane.append(Plane(Vector3(-1, 0, 0), Vector3(3, 1, 1)));
+    plane.append(Plane(Vector3(0, 1, 0), Vector3(1, -2, 1)));
+    x.fastClear();
+    y.fastClear();
+    a.getIntersectingMembers(plane, x);
+    b.getIntersectingMembers(plane, y);
+    debugAssert(x.size() == y.size());
+}
+
+
+/** Loads the first length bytes of data with the uint32 at offset (if not -1)
+    replaced by x, and returns true if deserialize threw and left the tree empty. */
+static bool loadFails(const Array<uint8>& data, int length, int offset, uint32 x) {
+    Array<uint8> copy(data);
+    if (offset >= 0) {
+        System::memcpy(copy.getCArray() + offset, &x, sizeof(x));
+    }
+
+    FrozenAABSPTree<AABox> loaded;
+    try {
+        BinaryInput in(copy.getCArray(), length, G3D_LITTLE_ENDIAN);
+        loaded.deserialize(in);
+    } catch (const std::string&) {
+        return loaded.size() == 0;
+    }
+    return false;
+}
+
+
+static void testFrozenSerialize() {
+    Array<AABox> array;
+    makeClusteredBoxes(array, 3000);
+
+    AABSPTree<AABox> tree;
+    tree.insert(array);
+    tree.balanceSAH();
+    const FrozenAABSPTree<AABox> frozen(tree);
+
+    {
+        BinaryOutput b("test-frozen.dat", G3D_LITTLE_ENDIAN);
+        frozen.serialize(b);
+        b.commit();
+    }
+
+    // Copied out of a buffer
+    {
+        BinaryInput b("test-frozen.dat", G3D_LITTLE_ENDIAN);
+        FrozenAABSPTree<AABox> loaded;
+        loaded.deserialize(b);
+        debugAssert(b.getPosition() == b.getLength());
+        checkSameQueries(frozen, loaded);
+    }
+
+    // In place in a memory mapped file, and a copy of it
+    {
+        BinaryInput b("test-frozen.dat", G3D_LITTLE_ENDIAN, false, BinaryInput::MAP_RANDOM);
+        FrozenAABSPTree<AABox> loaded;
+        loaded.deserialize(b);
+        checkSameQueries(frozen, loaded);
+
+        FrozenAABSPTree<AABox> copy;
+        copy = loaded;
+        checkSameQueries(frozen, copy);
+
+        AABSPTree<AABox> thawed;
+        loaded.thaw(thawed);
+        debugAssert(thawed.size() == array.size());
+        debugAssert(thawed.contains(array[7]));
+    }
+
+    // After other data, in memory
+    {
+        BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+        b.writeInt8(3);
+        frozen.serialize(b);
+        b.writeInt32(1234);
+
+        BinaryInput in(b.getCArray(), b.length(), G3D_LITTLE_ENDIAN);
+        debugAssert(in.readInt8() == 3);
+        FrozenAABSPTree<AABox> loaded;
+        loaded.deserialize(in);
+        debugAssert(in.readInt32() == 1234);
+        checkSameQueries(frozen, loaded);
+    }
+
+    // Empty
+    {
+        BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+        FrozenAABSPTree<AABox>().serialize(b);
+        BinaryInput in(b.getCArray(), b.length(), G3D_LITTLE_ENDIAN);
+        FrozenAABSPTree<AABox> loaded(frozen);
+        loaded.deserialize(in);
+        debugAssert(loaded.size() == 0);
+        Array<AABox> none;
+        loaded.getIntersectingMembers(AABox(Vector3(-1, -1, -1), Vector3(1, 1, 1)), none);
+        debugAssert(none.size() == 0);
+    }
+
+    // Truncated or corrupt
+    {
+        BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+        frozen.serialize(b);
+        Array<uint8> good;
+        good.resize(b.length());
+        System::memcpy(good.getCArray(), b.getCArray(), b.length());
+
+        // The nodes start at the first multiple of 16 after the header:
+        // "FrozenAABSPTree\0", version, endian, three sizes, and two counts
+        const int firstNode = iCeil((16 + 4 + 1 + 5 * 4) / 16.0) * 16;
+        const int nodeSize = 16;
+        const int last = frozen.numNodes() - 1;
+
+        debugAssert(! loadFails(good, good.size(), -1, 0));
+        debugAssert(loadFails(good, good.size() - 1, -1, 0));
+        debugAssert(loadFails(good, firstNode, -1, 0));
+
+        // highChild of the root past the end, and pointing back at itself
+        debugAssert(loadFails(good, good.size(), firstNode + 4, frozen.numNodes()));
+        debugAssert(loadFails(good, good.size(), firstNode + 4, 0x7FFFFFFF));
+        debugAssert(loadFails(good, good.size(), firstNode + nodeSize + 4, 1));
+
+        // firstValue of the last node past the values
+        debugAssert(loadFails(good, good.size(), firstNode + last * nodeSize + 8, frozen.size()));
+
+        // A low child on the last node, and too many values on it
+        debugAssert(loadFails(good, good.size(), firstNode + last * nodeSize + 12, 4));
+        debugAssert(loadFails(good, good.size(), firstNode + last * nodeSize + 12, 0xFFFFFFF8));
+    }
+
+    remove("test-frozen.dat");
+}
+
+
+/** 100k small boxes in a tree and in an array, queried with a 
+    frustum-like set of planes, a box, or rays, or the time to balance the tree */
+class AABSPTreeCase : public Benchmark::Case {
+public:
+    enum {NUM_POINTS = 100000, NUM_RAYS = 1000, PRIMARY_RAY_SIZE = 64, NUM_PRIMARY_RAYS = PRIMARY_RAY_SIZE * PRIMARY_RAY_SIZE};
+
+    /** RAY finds the first hit of NUM_RAYS random rays.  PRIMARY_RAY and
+        RAY_PACKET (which only applies to FROZEN) find the first hits of
+        coherent rays from a pinhole camera. */
+    enum Query {PLANES, BOX, ARRAY_PLANES, BUILD, RAY, PRIMARY_RAY, RAY_PACKET};
+
+    /** FROZEN is a FrozenAABSPTree of the SAH tree */
+    enum Structure {MEDIAN, SAH, FROZEN};
+
+    Query                   query;
+    Structure               structure;
+    Array<AABox>            array;
+    AABSPTree<AABox>        tree;
+    FrozenAABSPTree<AABox>  frozen;
+    Array<Plane>            plane;
+    AABox                   box;
+    Array<Ray>              ray;
+    Array<AABox>            point;
+    float                   totalTime;
+    Array<float>            distance;
+    Array<const AABox*>     firstHit;
+
+    AABSPTreeCase(Query q, Structure s = MEDIAN) : query(q), structure(s), box(Vector3(1, 1, 1), Vector3(3,3,3)) {}
+
+    virtual void setUp() {
+        for (int i = 0; i < NUM_POINTS; ++i) {
+            Vector3 pt = Vector3(uniformRandom(-10, 10), uniformRandom(-10, 10), uniformRandom(-10, 10));
+            AABox box(pt, pt + Vector3(.1f, .1f, .1f));
+            array.append(box);
+        }
+
+        if ((query != ARRAY_PLANES) && (query != BUILD)) {
+            tree.insert(array);
+            if (structure == MEDIAN) {
+                tree.balance();
+            } else {
+                tree.balanceSAH();
+            }
+            if (structure == FROZEN) {
+                frozen.freeze(tree);
+                tree.clear();
+            }
+        }
+
         plane.append(Plane(Vector3(-1, 0, 0), Vector3(3, 1, 1)));
         plane.append(Plane(Vector3(1, 0, 0), Vector3(1, 1, 1)));
         plane.append(Plane(Vector3(0, 0, -1), Vector3(1, 1, 3)));
@@ -78,37 +708,647 @@ void perfAABSPTree() {
         plane.append(Plane(Vector3(0,-1, 0), Vector3(1, 3, 1)));
         plane.append(Plane(Vector3(0, 1, 0), Vector3(1, -3, 1)));
 
-        AABox box(Vector3(1, 1, 1), Vector3(3,3,3));
+        if (query == RAY) {
+            for (int i = 0; i < NUM_RAYS; ++i) {
+                ray.append(Ray::fromOriginAndDirection(Vector3::random() * 12, Vector3::random()));
+            }
+        } else {
+            makePrimaryRays(ray, PRIMARY_RAY_SIZE);
+        }
+    }
+
+    virtual void beforeIteration() {
+        if (query == BUILD) {
+            tree.clear();
+            tree.insert(array);
+        }
+    }
+
+    virtual void run() {
+        point.fastClear();
+        switch (query) {
+        case PLANES:
+            if (structure == FROZEN) {
+                frozen.getIntersectingMembers(plane, point);
+            } else {
+                tree.getIntersectingMembers(plane, point);
+            }
+            break;
 
-        Array<AABox> point;
+        case BOX:
+            if (structure == FROZEN) {
+                frozen.getIntersectingMembers(box, point);
+            } else {
+                tree.getIntersectingMembers(box, point);
+            }
+            break;
 
-        System::beginCycleCount(bspcount);
-        tree.getIntersectingMembers(plane, point);
-        System::endCycleCount(bspcount);
+        case ARRAY_PLANES:
+            for (int i = 0; i < array.size(); ++i) {
+                if (! array[i].culledBy(plane)) {
+                    point.append(array[i]);
+                }
+            }
+            break;
 
+        case BUILD:
+            if (structure == MEDIAN) {
+                tree.balance();
+            } else {
+                tree.balanceSAH();
+            }
+            break;
+
+        case RAY:
+        case PRIMARY_RAY:
+            totalTime = 0;
+            for (int r = 0; r < ray.size(); ++r) {
+                float t = inf();
+                if (structure == FROZEN) {
+                    FirstHit hit;
+                    frozen.intersectRay(ray[r], hit, t);
+                } else {
+                    t = firstHitTime(tree, ray[r]);
+                }
+                if (t < inf()) {
+                    totalTime += t;
+                }
+            }
+            break;
+
+        case RAY_PACKET:
+            {
+                FirstHit hit;
+                frozen.intersectRays(ray, hit, distance, firstHit);
+            }
+            break;
+        }
+    }
+
+    virtual void tearDown() {
+        array.clear();
+        tree.clear();
+        frozen.clear();
+        distance.clear();
+        firstHit.clear();
+        plane.clear();
+        ray.clear();
         point.clear();
+    }
+};
+
+
+/** Average nodes visited and member bounds tested per box and per ray query */
+static void measureQueryCost(const AABSPTree<AABox>& tree, double& boxNodes, double& boxValues, double& rayValues) {
+    enum {NUM_QUERIES = 200};
 
-        System::beginCycleCount(boxcount);
-        tree.getIntersectingMembers(box, point);
-        System::endCycleCount(boxcount);
+    int nodes = 0, values = 0;
+    for (int q = 0; q < NUM_QUERIES; ++q) {
+        const Vector3 c = Vector3::random() * 8;
+        nodes += tree.debugCountBoxQueryVisits(AABox(c, c + Vector3(1, 1, 1)), values);
+    }
+    boxNodes  = nodes  / (double)NUM_QUERIES;
+    boxValues = values / (double)NUM_QUERIES;
+
+    int tests = 0;
+    for (int q = 0; q < NUM_QUERIES; ++q) {
+        const Ray ray = Ray::fromOriginAndDirection(Vector3::random() * 12, Vector3::random());
+        AABSPTree<AABox>::RayIntersectionIterator it = tree.beginRayIntersection(ray);
+        const AABSPTree<AABox>::RayIntersectionIterator end = tree.endRayIntersection();
+        while (it != end) {
+            ++it;
+        }
+        tests += it.debugCounter;
+    }
+    rayValues = tests / (double)NUM_QUERIES;
+}
+
+
+/** Prints the query cost of the median/mean and SAH trees for uniform and clustered boxes */
+static void compareQueryCost() {
+    for (int d = 0; d < 2; ++d) {
+        Array<AABox> array;
+        if (d == 0) {
+            for (int i = 0; i < AABSPTreeCase::NUM_POINTS; ++i) {
+                Vector3 pt = Vector3(uniformRandom(-10, 10), uniformRandom(-10, 10), uniformRandom(-10, 10));
+                array.append(AABox(pt, pt + Vector3(.1f, .1f, .1f)));
+            }
+        } else {
+            makeClusteredBoxes(array, AABSPTreeCase::NUM_POINTS);
+        }
+
+        for (int h = 0; h < 2; ++h) {
+            AABSPTree<AABox> tree;
+            tree.insert(array);
+            if (h == 0) {
+                tree.balance();
+            } else {
+                tree.balanceSAH();
+            }
+
+            double boxNodes, boxValues, rayValues;
+            measureQueryCost(tree, boxNodes, boxValues, rayValues);
+            printf("AABSPTree %-9s %-6s box query: %7.1f nodes %8.1f tests   ray query: %8.1f tests\n",
+                   (d == 0) ? "uniform" : "clustered", (h == 0) ? "median" : "SAH",
+                   boxNodes, boxValues, rayValues);
+        }
+    }
+}
 
+
+/** Distance to the center of a box, which is never less than the distance to the box */
+class CenterDistance {
+public:
+    float operator()(const Vector3& point, const AABox& box) const {
+        return (box.center() - point).length();
+    }
+};
+
+
+/** Sorted distances from point to the k closest boxes by brute force */
+template<class Distance>
+static void bruteForceNearest(const Array<AABox>& array, const Vector3& point, int k, Distance& distance, Array<float>& out) {
+    out.fastClear();
+    for (int i = 0; i < array.size(); ++i) {
+        out.append(distance(point, array[i]));
+    }
+    out.sort();
+    out.resize(iMin(k, out.size()));
+}
+
+
+static void testNearest() {
+    Array<AABox> array;
+    makeClusteredBoxes(array, 3000);
+
+    AABSPTree<AABox> tree;
+    tree.insert(array);
+    tree.balanceSAH();
+
+    AABSPTree<AABox>::BoundsDistance boundsDistance;
+    CenterDistance centerDistance;
+
+    Array<Vector3> point;
+    for (int q = 0; q < 50; ++q) {
+        point.append(Vector3::random() * uniformRandom(0, 15));
+    }
+
+    const int k[] = {1, 7, 40};
+    for (int K = 0; K < 3; ++K) {
+        for (int q = 0; q < point.size(); ++q) {
+            Array<float> expected;
+            Array<AABox> found;
+
+            bruteForceNearest(array, point[q], k[K], centerDistance, expected);
+            tree.getNearestMembers(point[q], k[K], found, centerDistance);
+            debugAssert(found.size() == k[K]);
+            for (int i = 0; i < found.size(); ++i) {
+                debugAssert(centerDistance(point[q], found[i]) == expected[i]);
+            }
+
+            found.fastClear();
+            bruteForceNearest(array, point[q], k[K], boundsDistance, expected);
+            tree.getNearestMembers(point[q], k[K], found);
+            debugAssert(found.size() == k[K]);
+            for (int i = 0; i < found.size(); ++i) {
+                debugAssert(boundsDistance(point[q], found[i]) == expected[i]);
+            }
+        }
+
+        // The batch agrees with single queries
+        Array<AABox> members;
+        Array<int> offset;
+        tree.getNearestMembers(point, k[K], members, offset, centerDistance, 3.0f);
+        debugAssert(offset.size() == point.size() + 1);
+        for (int q = 0; q < point.size(); ++q) {
+            Array<AABox> found;
+            tree.getNearestMembers(point[q], k[K], found, centerDistance, 3.0f);
+            debugAssert(offset[q + 1] - offset[q] == found.size());
+            for (int i = 0; i < found.size(); ++i) {
+                debugAssert(members[offset[q] + i] == found[i]);
+                debugAssert(centerDistance(point[q], found[i]) <= 3.0f);
+            }
+        }
+    }
+
+    // Closest member within a radius
+    for (int q = 0; q < point.size(); ++q) {
+        Array<float> expected;
+        bruteForceNearest(array, point[q], 1, centerDistance, expected);
+
+        AABox nearest;
+        debugAssert(tree.getNearestMember(point[q], nearest, centerDistance));
+        debugAssert(centerDistance(point[q], nearest) == expected[0]);
+
+        const bool inRadius = tree.getNearestMember(point[q], nearest, centerDistance, 1.0f);
+        debugAssert(inRadius == (expected[0] <= 1.0f));
+    }
+
+    AABSPTree<AABox> empty;
+    Array<AABox> none;
+    empty.getNearestMembers(Vector3::zero(), 5, none);
+    debugAssert(none.size() == 0);
+}
+
+
+static void testBatchIntersection() {
+    Array<AABox> array;
+    makeClusteredBoxes(array, 3000);
+
+    AABSPTree<AABox> tree;
+    tree.insert(array);
+    tree.balanceSAH();
+
+    Array<AABox> box;
+    Array<Sphere> sphere;
+    for (int q = 0; q < 300; ++q) {
+        const Vector3 c = Vector3::random() * 8;
+        box.append(AABox(c, c + Vector3(1, 2, 1) * uniformRandom(0, 2)));
+        sphere.append(Sphere(c, uniformRandom(0, 2)));
+    }
+
+    AABSPTree<AABox>::IntersectionBatch batch;
+    for (int pass = 0; pass < 3; ++pass) {
+        // The second pass reuses the batch with fewer queries
+        const int n = (pass == 1) ? 17 : box.size();
+        Array<AABox> b;
+        Array<Sphere> sp;
+        for (int q = 0; q < n; ++q) {
+            b.append(box[q]);
+            sp.append(sphere[q]);
+        }
+
+        tree.getIntersectingMembers(b, batch);
+        debugAssert(batch.numQueries() == n);
+        for (int q = 0; q < n; ++q) {
+            Array<AABox> expected;
+            tree.getIntersectingMembers(box[q], expected);
+            debugAssert(batch.count(q) == expected.size());
+            for (int i = 0; i < expected.size(); ++i) {
+                debugAssert(batch.members[batch.offset[q] + i] == expected[i]);
+            }
+        }
+        debugAssert(batch.members.size() == batch.offset[n]);
+
+        // The third pass runs on a pool of its own
+        ThreadPool pool(2);
+        tree.getIntersectingMembers(sp, batch, (pass == 2) ? &pool : NULL);
+        debugAssert(batch.numQueries() == n);
+        for (int q = 0; q < n; ++q) {
+            Array<AABox> expected;
+            tree.getIntersectingMembers(sphere[q], expected);
+            debugAssert(batch.count(q) == expected.size());
+            for (int i = 0; i < expected.size(); ++i) {
+                debugAssert(batch.members[batch.offset[q] + i] == expected[i]);
+            }
+        }
+    }
+
+    // No queries
+    tree.getIntersectingMembers(Array<AABox>(), batch);
+    debugAssert(batch.numQueries() == 0);
+    debugAssert(batch.members.size() == 0);
+
+    // Empty tree
+    AABSPTree<AABox> empty;
+    empty.getIntersectingMembers(box, batch);
+    debugAssert(batch.numQueries() == box.size());
+    debugAssert(batch.members.size() == 0);
+}
+
+
+/** Every one of 10k entities finds the entities within 3 units, the
+    interest management query of a game server */
+class InterestCase : public Benchmark::Case {
+public:
+    enum {NUM_ENTITIES = 10000};
+
+    /** LOOP calls the single-sphere getIntersectingMembers once per entity */
+    enum Method {LOOP, BATCH};
+
+    Method                  method;
+
+    /** Threads that run a BATCH, counting the one that waits; 0 for
+        ThreadPool::common() */
+    int                     numThreads;
+    ThreadPool*             pool;
+    AABSPTree<AABox>        tree;
+    Array<Sphere>           sphere;
+    AABSPTree<AABox>::IntersectionBatch batch;
+    int                     total;
+
+    InterestCase(Method m, int numThreads = 0) : method(m), numThreads(numThreads), pool(NULL) {}
+
+    virtual void setUp() {
+        if (numThreads > 0) {
+            pool = new ThreadPool(numThreads - 1);
+        }
+        Array<AABox> array;
+        for (int i = 0; i < NUM_ENTITIES; ++i) {
+            const Vector3 pt = Vector3(uniformRandom(-40, 40), uniformRandom(-40, 40), uniformRandom(-5, 5));
+            array.append(AABox(pt, pt + Vector3(.5f, .5f, 1.5f)));
+            sphere.append(Sphere(pt, 3));
+        }
+        tree.insert(array);
+        tree.balanceSAH();
+    }
+
+    virtual void run() {
+        total = 0;
+        switch (method) {
+        case LOOP:
+            for (int i = 0; i < sphere.size(); ++i) {
+                Array<AABox> found;
+                tree.getIntersectingMembers(sphere[i], found);
+                total += found.size();
+            }
+            break;
+
+        case BATCH:
+            tree.getIntersectingMembers(sphere, batch, pool);
+            total = batch.members.size();
+            break;
+        }
+    }
+
+    virtual void tearDown() {
+        tree.clear();
+        sphere.clear();
+        batch.clear();
+        delete pool;
+        pool = NULL;
+    }
+};
+
+
+/** k nearest neighbors of 1000 points among 100k boxes */
+class NearestCase : public Benchmark::Case {
+public:
+    enum {NUM_POINTS = 100000, NUM_QUERIES = 1000, K = 8};
+
+    /** EXPANDING_SPHERE doubles the radius of a sphere query until it holds k members */
+    enum Method {EXPANDING_SPHERE, BEST_FIRST, BATCH};
+
+    Method                  method;
+    AABSPTree<AABox>        tree;
+    Array<Vector3>          point;
+    Array<AABox>            members;
+    Array<int>              offset;
+
+    NearestCase(Method m) : method(m) {}
+
+    virtual void setUp() {
+        Array<AABox> array;
+        for (int i = 0; i < NUM_POINTS; ++i) {
+            Vector3 pt = Vector3(uniformRandom(-10, 10), uniformRandom(-10, 10), uniformRandom(-10, 10));
+            array.append(AABox(pt, pt + Vector3(.1f, .1f, .1f)));
+        }
+        tree.insert(array);
+        tree.balanceSAH();
+
+        for (int i = 0; i < NUM_QUERIES; ++i) {
+            point.append(Vector3(uniformRandom(-10, 10), uniformRandom(-10, 10), uniformRandom(-10, 10)));
+        }
+    }
+
+    virtual void run() {
+        members.fastClear();
+        switch (method) {
+        case EXPANDING_SPHERE:
+            for (int i = 0; i < point.size(); ++i) {
+                float radius = 0.25f;
+                Array<AABox> found;
+                do {
+                    found.fastClear();
+                    tree.getIntersectingMembers(Sphere(point[i], radius), found);
+                    radius *= 2;
+                } while (found.size() < K);
+                members.append(found[0]);
+            }
+            break;
+
+        case BEST_FIRST:
+            for (int i = 0; i < point.size(); ++i) {
+                tree.getNearestMembers(point[i], K, members);
+            }
+            break;
+
+        case BATCH:
+            tree.getNearestMembers(point, K, members, offset);
+            break;
+        }
+    }
+
+    virtual void tearDown() {
+        tree.clear();
         point.clear();
+        members.clear();
+        offset.clear();
+    }
+};
 
-        System::beginCycleCount(arraycount);
-        for (int i = 0; i < array.size(); ++i) {
-            if (! array[i].culledBy(plane)) {
-                point.append(array[i]);
+
+/** Boxes that start uniformly distributed and drift into four clusters,
+    kept up to date with update() and, depending on the mode, refit() or
+    balanceSAH() every frame.  One iteration is one frame. */
+class MovingAABSPTreeCase : public Benchmark::Case {
+public:
+    enum {NUM_BOXES = 10000};
+    enum Mode {UPDATE, REFIT, REBALANCE};
+
+    Mode                    mode;
+    Array<AABox>            box;
+    Array<AABox*>           member;
+    AABSPTree<AABox*>       tree;
+    Vector3                 cluster[4];
+
+    /** Where each box is headed */
+    Array<Vector3>          target;
+
+    MovingAABSPTreeCase(Mode m) : mode(m) {}
+
+    virtual void setUp() {
+        box.resize(NUM_BOXES);
+        member.resize(NUM_BOXES);
+        for (int i = 0; i < NUM_BOXES; ++i) {
+            const Vector3 pt(uniformRandom(-10, 10), uniformRandom(-10, 10), uniformRandom(-10, 10));
+            box[i] = AABox(pt, pt + Vector3(.2f, .2f, .2f));
+            member[i] = &box[i];
+        }
+        for (int c = 0; c < 4; ++c) {
+            cluster[c] = Vector3::random() * 6;
+        }
+        target.resize(NUM_BOXES);
+        for (int i = 0; i < NUM_BOXES; ++i) {
+            target[i] = cluster[i % 4] + Vector3::random() * uniformRandom(0, 3);
+        }
+        tree.insert(member);
+        tree.balanceSAH();
+    }
+
+    virtual void run() {
+        for (int i = 0; i < box.size(); ++i) {
+            const Vector3 lo = box[i].low();
+            const Vector3 pt = lo + (target[i] - lo) * 0.02f + Vector3::random() * 0.05f;
+            box[i] = AABox(pt, pt + Vector3(.2f, .2f, .2f));
+        }
+        tree.update(member);
+        switch (mode) {
+        case UPDATE:
+            break;
+
+        case REFIT:
+            tree.refit();
+            break;
+
+        case REBALANCE:
+            tree.balanceSAH();
+            break;
+        }
+    }
+
+    virtual void tearDown() {
+        tree.clear();
+        box.clear();
+        member.clear();
+        target.clear();
+    }
+};
+
+
+/** Time to get a queryable tree of 100k triangles: building it from scratch,
+    or loading a FrozenAABSPTree written by serialize() */
+class LoadAABSPTreeCase : public Benchmark::Case {
+public:
+    enum {NUM_TRIANGLES = 100000};
+
+    /** MAP loads the tree in place from a memory mapped file */
+    enum Mode {BALANCE, BALANCE_SAH, LOAD, MAP};
+
+    Mode                    mode;
+    Array<Triangle>         triangle;
+    AABSPTree<Triangle>     tree;
+    FrozenAABSPTree<Triangle> frozen;
+    Array<Triangle>         member;
+
+    LoadAABSPTreeCase(Mode m) : mode(m) {}
+
+    virtual void setUp() {
+        for (int i = 0; i < NUM_TRIANGLES; ++i) {
+            const Vector3 v = Vector3(uniformRandom(-10, 10), uniformRandom(-10, 10), uniformRandom(-10, 10));
+            triangle.append(Triangle(v, v + Vector3::random() * 0.2f, v + Vector3::random() * 0.2f));
+        }
+
+        if ((mode == LOAD) || (mode == MAP)) {
+            tree.insert(triangle);
+            tree.balanceSAH();
+            frozen.freeze(tree);
+            tree.clear();
+            BinaryOutput b("test-load.dat", G3D_LITTLE_ENDIAN);
+            frozen.serialize(b);
+            b.commit();
+            frozen.clear();
+        }
+    }
+
+    virtual void run() {
+        switch (mode) {
+        case BALANCE:
+        case BALANCE_SAH:
+            tree.clear();
+            tree.insert(triangle);
+            if (mode == BALANCE) {
+                tree.balance();
+            } else {
+                tree.balanceSAH();
             }
+            break;
+
+        case LOAD:
+        case MAP:
+            {
+                BinaryInput b("test-load.dat", G3D_LITTLE_ENDIAN, false,
+                              (mode == MAP) ? BinaryInput::MAP_RANDOM : BinaryInput::NO_MEMORY_MAP);
+                frozen.deserialize(b);
+
+                // A first query, which pages in part of a mapped file
+                member.fastClear();
+                frozen.getIntersectingMembers(AABox(Vector3(0, 0, 0), Vector3(1, 1, 1)), member);
+                frozen.clear();
+            }
+            break;
         }
-        System::endCycleCount(arraycount);
     }
 
-    printf("AABSPTree<AABox>::getIntersectingMembers(plane) %g Mcycles\n"
-           "AABSPTree<AABox>::getIntersectingMembers(box)   %g Mcycles\n"
-           "Culled by on Array<AABox>                       %g Mcycles\n\n", 
-           bspcount / 1e6, 
-           boxcount / 1e6,
-           arraycount / 1e6);
+    virtual void tearDown() {
+        triangle.clear();
+        tree.clear();
+        frozen.clear();
+        member.clear();
+        remove("test-load.dat");
+    }
+};
+
+
+/** Prints the query cost of moving trees after 200 frames of each kind of maintenance.
+    The queries are near the clusters. */
+static void compareMovingQueryCost() {
+    const char* name[] = {"update", "refit", "balanceSAH"};
+    for (int m = 0; m < 3; ++m) {
+        MovingAABSPTreeCase c((MovingAABSPTreeCase::Mode)m);
+        c.setUp();
+        for (int frame = 0; frame < 200; ++frame) {
+            c.run();
+        }
+
+        int nodes = 0, values = 0;
+        for (int q = 0; q < 200; ++q) {
+            const Vector3 p = c.cluster[q % 4] + Vector3::random() * uniformRandom(0, 3) - Vector3(0.5f, 0.5f, 0.5f);
+            nodes += c.tree.debugCountBoxQueryVisits(AABox(p, p + Vector3(1, 1, 1)), values);
+        }
+        printf("AABSPTree moving %-10s box query: %7.1f nodes %8.1f tests\n",
+               name[m], nodes / 200.0, values / 200.0);
+        c.tearDown();
+    }
+}
+
+
+void perfAABSPTree(Benchmark& benchmark) {
+    compareQueryCost();
+    compareMovingQueryCost();
+
+    benchmark.add("AABSPTree<AABox>::getIntersectingMembers(plane)",  new AABSPTreeCase(AABSPTreeCase::PLANES));
+    benchmark.add("AABSPTree<AABox>::getIntersectingMembers(box)",    new AABSPTreeCase(AABSPTreeCase::BOX));
+    benchmark.add("AABSPTree<AABox>::getIntersectingMembers(plane) (SAH)",  new AABSPTreeCase(AABSPTreeCase::PLANES, AABSPTreeCase::SAH));
+    benchmark.add("AABSPTree<AABox>::getIntersectingMembers(box) (SAH)",    new AABSPTreeCase(AABSPTreeCase::BOX, AABSPTreeCase::SAH));
+    benchmark.add("FrozenAABSPTree<AABox>::getIntersectingMembers(plane)", new AABSPTreeCase(AABSPTreeCase::PLANES, AABSPTreeCase::FROZEN));
+    benchmark.add("FrozenAABSPTree<AABox>::getIntersectingMembers(box)", new AABSPTreeCase(AABSPTreeCase::BOX, AABSPTreeCase::FROZEN));
+    benchmark.add("AABSPTree<AABox>::beginRayIntersection (first hit)", new AABSPTreeCase(AABSPTreeCase::RAY), AABSPTreeCase::NUM_RAYS);
+    benchmark.add("AABSPTree<AABox>::beginRayIntersection (first hit SAH)", new AABSPTreeCase(AABSPTreeCase::RAY, AABSPTreeCase::SAH), AABSPTreeCase::NUM_RAYS);
+    benchmark.add("FrozenAABSPTree<AABox>::intersectRay", new AABSPTreeCase(AABSPTreeCase::RAY, AABSPTreeCase::FROZEN), AABSPTreeCase::NUM_RAYS);
+    benchmark.add("AABSPTree<AABox>::beginRayIntersection (primary SAH)", new AABSPTreeCase(AABSPTreeCase::PRIMARY_RAY, AABSPTreeCase::SAH), AABSPTreeCase::NUM_PRIMARY_RAYS);
+    benchmark.add("FrozenAABSPTree<AABox>::intersectRay (primary)", new AABSPTreeCase(AABSPTreeCase::PRIMARY_RAY, AABSPTreeCase::FROZEN), AABSPTreeCase::NUM_PRIMARY_RAYS);
+    benchmark.add("FrozenAABSPTree<AABox>::intersectRays (primary)", new AABSPTreeCase(AABSPTreeCase::RAY_PACKET, AABSPTreeCase::FROZEN), AABSPTreeCase::NUM_PRIMARY_RAYS);
+    benchmark.add("Array<AABox> culledBy(plane)",                     new AABSPTreeCase(AABSPTreeCase::ARRAY_PLANES), AABSPTreeCase::NUM_POINTS);
+    benchmark.add("AABSPTree<AABox>::balance",                        new AABSPTreeCase(AABSPTreeCase::BUILD), AABSPTreeCase::NUM_POINTS);
+    benchmark.add("AABSPTree<AABox>::balanceSAH",                     new AABSPTreeCase(AABSPTreeCase::BUILD, AABSPTreeCase::SAH), AABSPTreeCase::NUM_POINTS);
+    benchmark.add("AABSPTree<Triangle>::insert+balance",              new LoadAABSPTreeCase(LoadAABSPTreeCase::BALANCE), LoadAABSPTreeCase::NUM_TRIANGLES);
+    benchmark.add("AABSPTree<Triangle>::insert+balanceSAH",           new LoadAABSPTreeCase(LoadAABSPTreeCase::BALANCE_SAH), LoadAABSPTreeCase::NUM_TRIANGLES);
+    benchmark.add("FrozenAABSPTree<Triangle>::deserialize",           new LoadAABSPTreeCase(LoadAABSPTreeCase::LOAD), LoadAABSPTreeCase::NUM_TRIANGLES);
+    benchmark.add("FrozenAABSPTree<Triangle>::deserialize (mapped)",  new LoadAABSPTreeCase(LoadAABSPTreeCase::MAP), LoadAABSPTreeCase::NUM_TRIANGLES);
+    benchmark.add("AABSPTree<AABox>::getIntersectingMembers(sphere) (interest loop)",  new InterestCase(InterestCase::LOOP), InterestCase::NUM_ENTITIES);
+    benchmark.add("AABSPTree<AABox>::getIntersectingMembers(sphere) (interest batch)", new InterestCase(InterestCase::BATCH), InterestCase::NUM_ENTITIES);
+    // Scaling with the number of threads; only meaningful with that many cores
+    for (int n = 1; n <= 8; n *= 2) {
+        benchmark.add(format("AABSPTree<AABox>::getIntersectingMembers(sphere) (interest batch %d thread%s)", n, (n == 1) ? "" : "s"),
+                      new InterestCase(InterestCase::BATCH, n), InterestCase::NUM_ENTITIES);
+    }
+    benchmark.add("AABSPTree<AABox> 8 nearest (expanding sphere)",   new NearestCase(NearestCase::EXPANDING_SPHERE), NearestCase::NUM_QUERIES);
+    benchmark.add("AABSPTree<AABox>::getNearestMembers (8)",          new NearestCase(NearestCase::BEST_FIRST), NearestCase::NUM_QUERIES);
+    benchmark.add("AABSPTree<AABox>::getNearestMembers (8 batch)",    new NearestCase(NearestCase::BATCH), NearestCase::NUM_QUERIES);
+    benchmark.add("AABSPTree<AABox*>::update (moving)",                new MovingAABSPTreeCase(MovingAABSPTreeCase::UPDATE), MovingAABSPTreeCase::NUM_BOXES);
+    benchmark.add("AABSPTree<AABox*>::update+refit (moving)",          new MovingAABSPTreeCase(MovingAABSPTreeCase::REFIT), MovingAABSPTreeCase::NUM_BOXES);
+    benchmark.add("AABSPTree<AABox*>::update+balanceSAH (moving)",     new MovingAABSPTreeCase(MovingAABSPTreeCase::REBALANCE), MovingAABSPTreeCase::NUM_BOXES);
 }
 
 
@@ -117,6 +1357,12 @@ void testAABSPTree() {
 
 	testBoxIntersect();
 	testSerialize();
+	testSAH();
+	testFrozen();
+	testFrozenSerialize();
+	testRefit();
+	testNearest();
+	testBatchIntersection();
 
 	printf("passed\n");
 }
@@ -1,6 +1,6 @@
 #include "G3D/G3DAll.h"
 
-void perfArray();
+void perfArray(Benchmark& benchmark);
 void testArray();
 
 class Big {
@@ -75,374 +75,215 @@ static void testSort() {
 }
 
 
-void perfArray() {
-    printf("Array Performance:\n");
+// Note:
+//
+// std::vector calls the copy constructor for new elements and always calls the
+// constructor even when it doesn't exist (e.g., for int).  This makes its alloc
+// time much worse than other methods, but gives it a slight boost on the first
+// memory access because everything is in cache.  The large array cases work on
+// huge arrays to amortize that effect down.
 
-    // Note:
-    //
-    // std::vector calls the copy constructor for new elements and always calls the
-    // constructor even when it doesn't exist (e.g., for int).  This makes its alloc
-    // time much worse than other methods, but gives it a slight boost on the first
-    // memory access because everything is in cache.  These tests work on huge arrays
-    // to amortize that effect down.
-
-
-    {
-        // Measure time for short array allocation
-        uint64 vectorAllocBig = 0,  vectorAllocSmall = 0;
-        uint64 arrayAllocBig = 0,   arrayAllocSmall = 0;
-
-        const int M = 3000;
+/** Constructs and destroys many 4-element arrays */
+template<class A>
+class ShortArrayCase : public Benchmark::Case {
+public:
+    enum {COUNT = 3000};
 
-        // Run many times to filter out startup behavior
-        for (int j = 0; j < 3; ++j) {
-            System::beginCycleCount(vectorAllocBig);
-            for (int i = 0; i < M; ++i) {
-                std::vector<Big> v(4);                
-            }
-            System::endCycleCount(vectorAllocBig);
+    virtual void run() {
+        for (int i = 0; i < COUNT; ++i) {
+            A v(4);
+        }
+    }
+};
 
-            System::beginCycleCount(vectorAllocSmall);
-            for (int i = 0; i < M; ++i) {
-                std::vector<int> v(4);
-            }
-            System::endCycleCount(vectorAllocSmall);
 
-            System::beginCycleCount(arrayAllocBig);
-            for (int i = 0; i < M; ++i) {
-                Array<Big> v(4);                
-            }
-            System::endCycleCount(arrayAllocBig);
+/** Grows an array one element at a time */
+template<class T>
+class ResizeCase : public Benchmark::Case {
+public:
+    enum {COUNT = 10000};
 
-            System::beginCycleCount(arrayAllocSmall);
-            for (int i = 0; i < M; ++i) {
-                Array<int> v(4);
-            }
-            System::endCycleCount(arrayAllocSmall);
+    virtual void run() {
+        Array<T> array;
+        for (int i = 1; i <= COUNT; ++i) {
+            array.resize(i, false);
         }
-
-        printf(" Array cycles/alloc for short arrays\n\n");
-        printf("                           Big class           int      outcome\n");
-        bool G3Dwin = 
-            (arrayAllocBig * 1.1 <= vectorAllocBig) &&
-            (arrayAllocSmall * 1.1 <= vectorAllocSmall);
-
-        printf("  G3D::Array               %9.02f     %9.02f     %s\n", 
-               (double)arrayAllocBig/M, (double)arrayAllocSmall/M,
-               G3Dwin ? " ok " : "FAIL");
-        printf("  std::vector              %9.02f     %9.02f\n", 
-               (double)vectorAllocBig/M, (double)vectorAllocSmall/M);
-        printf("\n\n");
     }
+};
 
-    ////////////////////////////////////////////////////
-    // Measure time for array resize
-    uint64 vectorResizeBig = 0,  vectorResizeSmall = 0;
-    uint64 arrayResizeBig = 0,   arrayResizeSmall = 0;
-    uint64 mallocResizeBig = 0,  mallocResizeSmall = 0;
-
-    const int M = 10000;
-
-    //  Low and high bounds for resize tests
-    const int L = 1;
-    const int H = M + L;
-
-    // Run many times to filter out startup behavior
-    for (int j = 0; j < 3; ++j) {
-        System::beginCycleCount(vectorResizeBig);
-        {
-            std::vector<Big> array;
-            for (int i = L; i < H; ++i) {
-                array.resize(i);
-            }
-        }
-        System::endCycleCount(vectorResizeBig);   
-
-        System::beginCycleCount(vectorResizeSmall);
-        {
-            std::vector<int> array;
-            for (int i = L; i < H; ++i) {
-                array.resize(i);
-            }
-        }
-        System::endCycleCount(vectorResizeSmall);   
 
-        System::beginCycleCount(arrayResizeSmall);
-        {
-            Array<int> array;
-            for (int i = L; i < H; ++i) {
-                array.resize(i, false);
-            }
+template<class T>
+class VectorResizeCase : public Benchmark::Case {
+public:
+    virtual void run() {
+        std::vector<T> array;
+        for (int i = 1; i <= ResizeCase<T>::COUNT; ++i) {
+            array.resize(i);
         }
-        System::endCycleCount(arrayResizeSmall); 
+    }
+};
 
-        System::beginCycleCount(arrayResizeBig);
-        {
-            Array<Big> array;
-            for (int i = L; i < H; ++i) {
-                array.resize(i, false);
-            }
-        }
-        System::endCycleCount(arrayResizeBig);   
-    
-        System::beginCycleCount(mallocResizeBig);
-        {
-            Big* array = NULL;
-            for (int i = L; i < H; ++i) {
-                array = (Big*)realloc(array, sizeof(Big) * i);
-            }
-            free(array);
-        }
-        System::endCycleCount(mallocResizeBig);   
 
-        System::beginCycleCount(mallocResizeSmall);
-        {
-            int* array = NULL;
-            for (int i = L; i < H; ++i) {
-                array = (int*)realloc(array, sizeof(int) * i);
-            }
-            free(array);
+/** Does not call constructors or destructors */
+template<class T>
+class ReallocResizeCase : public Benchmark::Case {
+public:
+    virtual void run() {
+        T* array = NULL;
+        for (int i = 1; i <= ResizeCase<T>::COUNT; ++i) {
+            array = (T*)realloc(array, sizeof(T) * i);
         }
-        System::endCycleCount(mallocResizeSmall);   
+        free(array);
     }
+};
 
 
-    {
-        printf(" Array cycles/resize (%d resizes)\n\n", M);
-        printf("                           Big class           int     outcome\n");
-        bool G3Dwin = 
-            (arrayResizeBig <= vectorResizeBig * 1.2) &&
-            (arrayResizeSmall * 1.1 <= vectorResizeSmall);
-
-        printf("  G3D::Array               %9.02f     %9.02f     %s\n", 
-               (double)arrayResizeBig/M, (double)arrayResizeSmall/M,
-               G3Dwin ? " ok " : "FAIL");
-        printf("  std::vector              %9.02f     %9.02f\n", (double)vectorResizeBig/M, (double)vectorResizeSmall/M);
-        printf("  realloc(*)               %9.02f     %9.02f\n", (double)mallocResizeBig/M, (double)mallocResizeSmall/M);
-        printf("    * does not call constructor or destructor!\n\n");
-    }
+enum Allocator {G3D_ARRAY, STD_VECTOR, NEW_DELETE, MALLOC_FREE, ALIGNED_MALLOC};
 
+static int& element(int& x) {
+    return x;
+}
 
-    // Measure times for various operations on large arrays of small elements
-    uint64 newAllocInt = 0,     newFreeInt = 0,     newAccessInt = 0;
-    uint64 arrayAllocInt = 0,   arrayFreeInt = 0,   arrayAccessInt = 0;
-    uint64 vectorAllocInt = 0,  vectorFreeInt = 0,  vectorAccessInt = 0;
-    uint64 mallocAllocInt = 0,  mallocFreeInt = 0,  mallocAccessInt = 0;
-    uint64 sysmallocAllocInt = 0,  sysmallocFreeInt = 0,  sysmallocAccessInt = 0;
-
-    // The code that generates memory accesses
-#define LOOPS\
-            for (int k = 0; k < 3; ++k) {\
-                int i;\
-		        for (i = 0; i < size; ++i) {\
-                    array[i] = i;\
-                }\
-                for (i = 0; i < size; ++i) {\
-                    ++array[i];\
-                }\
-                for (i = 0; i < size; ++i) {\
-                    ++array[i];\
-                }\
-                for (i = 0; i < size; ++i) {\
-                    ++array[i];\
-                }\
-                for (i = 0; i < size; ++i) {\
-                    ++array[i];\
-                }\
-            }
+static int& element(Big& x) {
+    return x.x;
+}
 
-    // 10 million
-    int size = 10000000;
-
-    // Run many times to filter out startup behavior
-    for (int j = 0; j < 3; ++j) {
-        System::beginCycleCount(mallocAllocInt);
-        {
-            int* array = (int*)malloc(sizeof(int) * size);
-            System::endCycleCount(mallocAllocInt);
-            System::beginCycleCount(mallocAccessInt);
-            LOOPS;
-            System::endCycleCount(mallocAccessInt);
-            System::beginCycleCount(mallocFreeInt);
-            free(array);
-        }
-        System::endCycleCount(mallocFreeInt);    
-
-        System::beginCycleCount(sysmallocAllocInt);
-        {
-            int* array = (int*)System::alignedMalloc(sizeof(int) * size, 4096);
-            System::endCycleCount(sysmallocAllocInt);
-            System::beginCycleCount(sysmallocAccessInt);
-            LOOPS;
-            System::endCycleCount(sysmallocAccessInt);
-            System::beginCycleCount(sysmallocFreeInt);
-            System::alignedFree(array);
-        }
-        System::endCycleCount(sysmallocFreeInt);   
-
-        System::beginCycleCount(arrayAllocInt);
-        {
-            Array<int> array(size);
-            System::endCycleCount(arrayAllocInt);
-            System::beginCycleCount(arrayAccessInt);
-            LOOPS;
-            System::endCycleCount(arrayAccessInt);
-            System::beginCycleCount(arrayFreeInt);
-        }
-        System::endCycleCount(arrayFreeInt);
-
-        {
-            System::beginCycleCount(newAllocInt);
-            int* array = new int[size];
-            System::endCycleCount(newAllocInt);
-            System::beginCycleCount(newAccessInt);
-            LOOPS;
-            System::endCycleCount(newAccessInt);
-
-            System::beginCycleCount(newFreeInt);
-            delete[] array;
-        }
-        System::endCycleCount(newFreeInt);
-
-        System::beginCycleCount(vectorAllocInt);
-        {
-            std::vector<int> array(size);
-            System::endCycleCount(vectorAllocInt);
-            System::beginCycleCount(vectorAccessInt);
-            LOOPS;
-            System::endCycleCount(vectorAccessInt);
-            System::beginCycleCount(vectorFreeInt);
+/** Allocates and frees, or accesses, a large array with one of several allocators */
+template<class T>
+class LargeArrayCase : public Benchmark::Case {
+public:
+    /** Number of memory ops per element that run() performs when accessing
+        (3 loops * (5 writes + 4 reads)) */
+    enum {OPS = 9 * 3};
+
+    Allocator           allocator;
+    int                 size;
+    bool                access;
+
+    Array<T>*           array;
+    std::vector<T>*     vector;
+    T*                  data;
+
+    LargeArrayCase(Allocator a, int s, bool x) : allocator(a), size(s), access(x),
+        array(NULL), vector(NULL), data(NULL) {}
+
+    void allocate() {
+        switch (allocator) {
+        case G3D_ARRAY:
+            array = new Array<T>(size);
+            data = array->getCArray();
+            break;
+        case STD_VECTOR:
+            vector = new std::vector<T>(size);
+            data = &(*vector)[0];
+            break;
+        case NEW_DELETE:
+            data = new T[size];
+            break;
+        case MALLOC_FREE:
+            data = (T*)malloc(sizeof(T) * size);
+            break;
+        case ALIGNED_MALLOC:
+            data = (T*)System::alignedMalloc(sizeof(T) * size, 4096);
+            break;
         }
-        System::endCycleCount(vectorFreeInt);
     }
 
-#undef LOOPS
-
-    {
-        // Number of memory ops per element that LOOPS performed
-        float N = 9*3;
-
-        printf(" Int array cycles/elt\n");
-        printf("                             Alloc    Access   Free\n");
-        printf("  G3D::Array                 %5.02f    %5.02f   %5.02f\n", (arrayAllocInt / (float)size),   (arrayAccessInt / (float)(N * size)),   (arrayFreeInt / (float)size));
-        printf("  std::vector                %5.02f    %5.02f   %5.02f\n", (vectorAllocInt / (float)size),  (vectorAccessInt / (float)(N * size)),  (vectorFreeInt / (float)size));
-        printf("  new/delete                 %5.02f    %5.02f   %5.02f\n", (newAllocInt / (float)size),     (newAccessInt / (float)(N * size)),     (newFreeInt / (float)size));
-        printf("  malloc/free                %5.02f    %5.02f   %5.02f\n", (mallocAllocInt / (float)size),  (mallocAccessInt / (float)(N * size)),  (mallocFreeInt / (float)size));
-        printf("  System::alignedMalloc      %5.02f    %5.02f   %5.02f\n", (sysmallocAllocInt / (float)size),  (sysmallocAccessInt / (float)(N * size)),  (sysmallocFreeInt / (float)size));
-        printf("\n");
+    void release() {
+        switch (allocator) {
+        case G3D_ARRAY:
+            delete array;
+            break;
+        case STD_VECTOR:
+            delete vector;
+            break;
+        case NEW_DELETE:
+            delete[] data;
+            break;
+        case MALLOC_FREE:
+            free(data);
+            break;
+        case ALIGNED_MALLOC:
+            System::alignedFree(data);
+            break;
+        }
+        array = NULL;
+        vector = NULL;
+        data = NULL;
     }
 
-    ///////////////////////////////////////////////////////
-    // The code that generates memory accesses
-#   define LOOPS\
-            for (int k = 0; k < 3; ++k) {\
-                int i;\
-		        for (i = 0; i < size; ++i) {\
-                    array[i].x = i;\
-                }\
-                for (i = 0; i < size; ++i) {\
-                    ++array[i].x;\
-                }\
-                for (i = 0; i < size; ++i) {\
-                    ++array[i].x;\
-                }\
-                for (i = 0; i < size; ++i) {\
-                    ++array[i].x;\
-                }\
-                for (i = 0; i < size; ++i) {\
-                    ++array[i].x;\
-                }\
-            }
-    // 1 million
-    size = 1000000;
-
-    // Measure times for various operations on large arrays of small elements
-    uint64 newAllocBig = 0,     newFreeBig = 0,     newAccessBig = 0;
-    uint64 arrayAllocBig = 0,   arrayFreeBig = 0,   arrayAccessBig = 0;
-    uint64 vectorAllocBig = 0,  vectorFreeBig = 0,  vectorAccessBig = 0;
-    uint64 mallocAllocBig = 0,  mallocFreeBig = 0,  mallocAccessBig = 0;
-    uint64 sysmallocAllocBig = 0,  sysmallocFreeBig = 0,  sysmallocAccessBig = 0;
-    // Run many times to filter out startup behavior
-    for (int j = 0; j < 3; ++j) {
-        System::beginCycleCount(mallocAllocBig);
-        {
-            Big* array = (Big*)malloc(sizeof(Big) * size);
-            System::endCycleCount(mallocAllocBig);
-            System::beginCycleCount(mallocAccessBig);
-            LOOPS;
-            System::endCycleCount(mallocAccessBig);
-            System::beginCycleCount(mallocFreeBig);
-            free(array);
-        }
-        System::endCycleCount(mallocFreeBig);    
-
-        System::beginCycleCount(sysmallocAllocBig);
-        {
-            Big* array = (Big*)System::alignedMalloc(sizeof(Big) * size, 4096);
-            System::endCycleCount(sysmallocAllocBig);
-            System::beginCycleCount(sysmallocAccessBig);
-            LOOPS;
-            System::endCycleCount(sysmallocAccessBig);
-            System::beginCycleCount(sysmallocFreeBig);
-            System::alignedFree(array);
+    virtual void setUp() {
+        if (access) {
+            allocate();
         }
-        System::endCycleCount(sysmallocFreeBig);   
-
-        System::beginCycleCount(arrayAllocBig);
-        {
-            Array<Big> array(size);
-            System::endCycleCount(arrayAllocBig);
-            System::beginCycleCount(arrayAccessBig);
-            LOOPS;
-            System::endCycleCount(arrayAccessBig);
-            System::beginCycleCount(arrayFreeBig);
+    }
+
+    virtual void run() {
+        if (! access) {
+            allocate();
+            release();
+            return;
         }
-        System::endCycleCount(arrayFreeBig);
-
-        {
-            System::beginCycleCount(newAllocBig);
-            Big* array = new Big[size];
-            System::endCycleCount(newAllocBig);
-            System::beginCycleCount(newAccessBig);
-            LOOPS;
-            System::endCycleCount(newAccessBig);
-
-            System::beginCycleCount(newFreeBig);
-            delete[] array;
+
+        for (int k = 0; k < 3; ++k) {
+            int i;
+            for (i = 0; i < size; ++i) {
+                element(data[i]) = i;
+            }
+            for (i = 0; i < size; ++i) {
+                ++element(data[i]);
+            }
+            for (i = 0; i < size; ++i) {
+                ++element(data[i]);
+            }
+            for (i = 0; i < size; ++i) {
+                ++element(data[i]);
+            }
+            for (i = 0; i < size; ++i) {
+                ++element(data[i]);
+            }
         }
-        System::endCycleCount(newFreeBig);
-
-        System::beginCycleCount(vectorAllocBig);
-        {
-            std::vector<Big> array(size);
-            System::endCycleCount(vectorAllocBig);
-            System::beginCycleCount(vectorAccessBig);
-            LOOPS;
-            System::endCycleCount(vectorAccessBig);
-            System::beginCycleCount(vectorFreeBig);
+    }
+
+    virtual void tearDown() {
+        if (access) {
+            release();
         }
-        System::endCycleCount(vectorFreeBig);
     }
+};
 
-#   undef LOOPS
 
+template<class T>
+static void addLargeArrayCases(Benchmark& benchmark, const char* type, int size) {
+    static const char* name[] = {"Array", "std::vector", "new[]", "malloc(*)", "System::alignedMalloc(*)"};
 
-    {
-        // Number of memory ops per element that LOOPS performed (3 loops * (5 writes + 4 reads))
-        float N = 9*3;
-
-        printf(" Big class array cycles/elt\n");
-        printf("                             Alloc    Access   Free\n");
-        printf("  G3D::Array               %7.02f    %5.02f   %5.02f\n", (arrayAllocBig / (float)size),   (arrayAccessBig / (float)(N * size)),   (arrayFreeBig / (float)size));
-        printf("  std::vector              %7.02f    %5.02f   %5.02f\n", (vectorAllocBig / (float)size),  (vectorAccessBig / (float)(N * size)),  (vectorFreeBig / (float)size));
-        printf("  new/delete               %7.02f    %5.02f   %5.02f\n", (newAllocBig / (float)size),     (newAccessBig / (float)(N * size)),     (newFreeBig / (float)size));
-        printf("  malloc/free(*)           %7.02f    %5.02f   %5.02f\n", (mallocAllocBig / (float)size),  (mallocAccessBig / (float)(N * size)),  (mallocFreeBig / (float)size));
-        printf("  System::alignedMalloc(*) %7.02f    %5.02f   %5.02f\n", (sysmallocAllocBig / (float)size),  (sysmallocAccessBig / (float)(N * size)),  (sysmallocFreeBig / (float)size));
-        printf("    * does not call constructor or destructor!\n\n");
+    for (int a = 0; a < 5; ++a) {
+        benchmark.add(format("%s<%s> alloc+free (%d)", name[a], type, size), 
+                      new LargeArrayCase<T>((Allocator)a, size, false), size);
+        benchmark.add(format("%s<%s> access (%d)", name[a], type, size), 
+                      new LargeArrayCase<T>((Allocator)a, size, true), size * LargeArrayCase<T>::OPS);
     }
+}
 
 
-    printf("\n");
+/** (*) does not call constructor or destructor! */
+void perfArray(Benchmark& benchmark) {
+    const int S = ShortArrayCase<Array<int> >::COUNT;
+    benchmark.add("Array<Big>(4)",          new ShortArrayCase<Array<Big> >(),          S);
+    benchmark.add("Array<int>(4)",          new ShortArrayCase<Array<int> >(),          S);
+    benchmark.add("std::vector<Big>(4)",    new ShortArrayCase<std::vector<Big> >(),    S);
+    benchmark.add("std::vector<int>(4)",    new ShortArrayCase<std::vector<int> >(),    S);
+
+    const int R = ResizeCase<int>::COUNT;
+    benchmark.add("Array<Big>::resize",         new ResizeCase<Big>(),          R);
+    benchmark.add("Array<int>::resize",         new ResizeCase<int>(),          R);
+    benchmark.add("std::vector<Big>::resize",   new VectorResizeCase<Big>(),    R);
+    benchmark.add("std::vector<int>::resize",   new VectorResizeCase<int>(),    R);
+    benchmark.add("realloc<Big>(*)",            new ReallocResizeCase<Big>(),   R);
+    benchmark.add("realloc<int>(*)",            new ReallocResizeCase<int>(),   R);
+
+    addLargeArrayCases<int>(benchmark, "int", 10000000);
+    addLargeArrayCases<Big>(benchmark, "Big", 1000000);
 }
 
 
@@ -0,0 +1,117 @@
+#include "G3D/G3DAll.h"
+
+/** Sleeps for a fixed time so that the statistics are predictable */
+class SleepCase : public Benchmark::Case {
+public:
+    RealTime    duration;
+    int         setUpCount;
+    int         beforeCount;
+    int         runCount;
+    int         tearDownCount;
+
+    SleepCase(RealTime d) : duration(d), setUpCount(0), beforeCount(0), runCount(0), tearDownCount(0) {}
+
+    virtual void setUp() {
+        ++setUpCount;
+    }
+
+    virtual void beforeIteration() {
+        ++beforeCount;
+    }
+
+    virtual void run() {
+        ++runCount;
+        System::sleep(duration);
+    }
+
+    virtual void tearDown() {
+        ++tearDownCount;
+    }
+};
+
+
+static int functionCount = 0;
+
+static void countFunction() {
+    ++functionCount;
+}
+
+
+void testBenchmark() {
+    printf("G3D::Benchmark ");
+
+    Benchmark::Settings settings;
+    settings.warmupIterations = 2;
+    settings.minIterations = 5;
+    settings.maxIterations = 20;
+    settings.minTime = 0;
+    settings.verbose = false;
+
+    SleepCase* fast = new SleepCase(0.001);
+    SleepCase* slow = new SleepCase(0.01);
+
+    Benchmark benchmark(settings);
+    benchmark.add("fast", fast, 10);
+    benchmark.add("slow", slow);
+    benchmark.add("function", countFunction);
+    debugAssert(benchmark.numCases() == 3);
+
+    benchmark.run();
+    const Array<Benchmark::Result>& result = benchmark.results();
+    debugAssert(result.size() == 3);
+
+    // Call protocol
+    debugAssert(fast->setUpCount == 1);
+    debugAssert(fast->tearDownCount == 1);
+    debugAssert(fast->runCount == 7);
+    debugAssert(fast->beforeCount == 7);
+    debugAssert(functionCount == 7);
+
+    // Statistics
+    for (int i = 0; i < result.size(); ++i) {
+        const Benchmark::Result& r = result[i];
+        debugAssert(r.iterations == 5);
+        debugAssert(r.min <= r.median);
+        debugAssert(r.median <= r.p95);
+        debugAssert(r.stddev >= 0);
+        debugAssert(! r.hasBaseline);
+    }
+    debugAssert(result[0].name == "fast");
+    debugAssert(result[0].elementsPerIteration == 10);
+    debugAssert(result[0].median >= 0.0009);
+    debugAssert(result[1].median > result[0].median);
+    debugAssert(result[1].cyclesPerElement > result[0].cyclesPerElement);
+
+    // Baseline comparison
+    benchmark.writeCSV("benchmark-test.csv");
+    debugAssert(benchmark.compareToBaseline("benchmark-test.csv") == 0);
+    debugAssert(benchmark.results()[1].hasBaseline);
+    debugAssert(fuzzyEq(benchmark.results()[1].baselineMedian, result[1].median));
+
+    // A baseline that is much faster than this run
+    writeStringToFile(
+        "name,iterations,elements,median,p95,mean,stddev,min,cyclesPerElement\n"
+        "slow,5,1,0.0001,0.0001,0.0001,0,0.0001,1\n"
+        "missing,5,1,0.0001,0.0001,0.0001,0,0.0001,1\n",
+        "benchmark-test.csv");
+    debugAssert(benchmark.compareToBaseline("benchmark-test.csv") == 1);
+    debugAssert(benchmark.results()[1].regressed);
+    debugAssert(! benchmark.results()[0].regressed);
+    debugAssert(benchmark.report().find("REGRESSED") != std::string::npos);
+
+    debugAssert(benchmark.compareToBaseline("no-such-file.csv") == -1);
+
+    benchmark.writeJSON("benchmark-test.json");
+    std::string json = readFileAsString("benchmark-test.json");
+    debugAssert(beginsWith(json, "{\"results\":["));
+    debugAssert(json.find("\"name\":\"slow\"") != std::string::npos);
+    debugAssert(json.find("\"regressed\":true") != std::string::npos);
+
+    // Filter
+    benchmark.settings().filter = "fas";
+    benchmark.run();
+    debugAssert(benchmark.results().size() == 1);
+    debugAssert(benchmark.results()[0].name == "fast");
+
+    printf("passed\n");
+}
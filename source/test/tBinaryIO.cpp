@@ -162,43 +162,224 @@ static void testCompression() {
 }
 
 
-static void measureSerializerPerformance() {
-    Array<uint8> x(1024);
-    RealTime t0 = System::time();
-    Matrix4 M(Matrix4::identity());
-    
-    for (int i = 0; i < 100; ++i) {
-        BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
-        b.writeInt32(1);
-        b.writeInt32(2);
-        b.writeInt32(8);
-        M.serialize(b);
-        b.commit(x.getCArray());
-    }
-    RealTime reallocTime = (System::time() - t0) / 100.0;
-    printf("BinaryOutput time with re-allocation: %gs\n", reallocTime);
-
-    BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
-    t0 = System::time();    
-    for (int i = 0; i < 100; ++i) {
-        b.writeInt32(1);
-        b.writeInt32(2);
-        b.writeInt32(8);
-        M.serialize(b);
-        b.commit(x.getCArray());
-        b.reset();
-    }
-    RealTime resetTime = (System::time() - t0) / 100.0;
-    printf("BinaryOutput time with BinaryOutput::reset: %gs\n\n", resetTime);
-    
+static void testMemoryMap() {
+    printf("BinaryInput Memory Map\n");
+    {
+        BinaryOutput f("out.t", G3D_LITTLE_ENDIAN);
+        for (int i = 0; i < 1000; ++i) {
+            f.writeInt32(i);
+        }
+        f.writeString("end");
+        f.commit();
+    }
+
+    {
+        BinaryInput g("out.t", G3D_LITTLE_ENDIAN, false, BinaryInput::MAP_SEQUENTIAL);
+        debugAssert(g.memoryMapped());
+        debugAssert(g.getLength() == 4004);
+        debugAssert(g.readInt32() == 0);
+
+        // Zero-copy reads point into the file
+        const uint8* p = g.readBytesInPlace(8);
+        debugAssert(p == g.getCArray() + 4);
+        debugAssert(*(const int32*)p == 1);
+
+        g.setPosition(4 * 999);
+        debugAssert(g.readInt32() == 999);
+        debugAssert(g.readString() == "end");
+    }
+
+    {
+        BinaryOutput f("out.t", G3D_LITTLE_ENDIAN);
+        for (int i = 0; i < 1000; ++i) {
+            f.writeInt32(i);
+        }
+        f.compress();
+        f.commit();
+    }
+
+    {
+        // Compressed files are decompressed out of the mapping
+        BinaryInput g("out.t", G3D_LITTLE_ENDIAN, true, BinaryInput::MAP_RANDOM);
+        debugAssert(! g.memoryMapped());
+        debugAssert(g.getLength() == 4000);
+        g.setPosition(4 * 500);
+        debugAssert(g.readInt32() == 500);
+    }
+}
+
+
+/** Serializes a small record, creating a BinaryOutput each time or reusing one */
+class SerializerCase : public Benchmark::Case {
+public:
+    enum {COUNT = 1000};
+
+    bool            reset;
+    Array<uint8>    x;
+    Matrix4         M;
+
+    SerializerCase(bool r) : reset(r), x(1024), M(Matrix4::identity()) {}
+
+    virtual void run() {
+        if (reset) {
+            BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+            for (int i = 0; i < COUNT; ++i) {
+                b.writeInt32(1);
+                b.writeInt32(2);
+                b.writeInt32(8);
+                M.serialize(b);
+                b.commit(x.getCArray());
+                b.reset();
+            }
+        } else {
+            for (int i = 0; i < COUNT; ++i) {
+                BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+                b.writeInt32(1);
+                b.writeInt32(2);
+                b.writeInt32(8);
+                M.serialize(b);
+                b.commit(x.getCArray());
+            }
+        }
+    }
+};
+
+
+static void testBlockCompression() {
+    printf("BinaryInput & BinaryOutput Block Compression\n");
+
+    const int N = 100000;
+    {
+        BinaryOutput f("out.t", G3D_BIG_ENDIAN);
+        f.enableBlockCompression(1000);
+        for (int i = 0; i < N; ++i) {
+            f.writeInt32(i);
+        }
+        // Seek backwards within the buffered blocks
+        f.setPosition(f.position() - 4);
+        f.writeInt32(-1);
+        f.writeString("end");
+        f.commit();
+    }
+
+    // The compressed file is much smaller than the data
+    debugAssert(fileLength("out.t") < N * 2);
+
+    for (int m = 0; m < 2; ++m) {
+        BinaryInput g("out.t", G3D_BIG_ENDIAN, true, 
+                      (m == 0) ? BinaryInput::NO_MEMORY_MAP : BinaryInput::MAP_RANDOM);
+        debugAssert(g.getLength() == N * 4 + 4);
+
+        // Sequential
+        for (int i = 0; i < N - 1; ++i) {
+            int32 x = g.readInt32();
+            debugAssert(x == i); (void)x;
+        }
+        debugAssert(g.readInt32() == -1);
+        debugAssert(g.readString() == "end");
+
+        // Random access
+        for (int i = 0; i < 100; ++i) {
+            int j = (i * 7919) % (N - 1);
+            g.setPosition(j * 4);
+            debugAssert(g.readInt32() == j);
+        }
+
+        // A read spanning many blocks
+        Array<int32> all;
+        g.setPosition(40);
+        g.readInt32(all, N - 20);
+        for (int i = 0; i < all.size(); ++i) {
+            debugAssert(all[i] == i + 10);
+        }
+    }
+
+    {
+        // From memory
+        BinaryInput file("out.t", G3D_BIG_ENDIAN);
+        BinaryInput g(file.getCArray(), file.getLength(), G3D_BIG_ENDIAN, true);
+        debugAssert(g.getLength() == N * 4 + 4);
+        g.setPosition(4 * 1234);
+        debugAssert(g.readInt32() == 1234);
+        debugAssert(g.getCArray() != NULL);
+    }
+
+#   ifdef G3D_LINUX
+    {
+        // A full disk is reported, not written as a corrupt file
+        bool threw = false;
+        try {
+            BinaryOutput f("/dev/full", G3D_BIG_ENDIAN);
+            f.enableBlockCompression(1000);
+            for (int i = 0; i < N; ++i) {
+                f.writeInt32(i);
+            }
+            f.commit();
+        } catch (const std::string&) {
+            threw = true;
+        }
+        debugAssert(threw);
+    }
+#   endif
+}
+
+
+static void testAsyncCommit() {
+    printf("BinaryOutput Asynchronous Commit\n");
+
+    const int N = 50000;
+    AsyncWriteRef w;
+    {
+        BinaryOutput f("out.t", G3D_LITTLE_ENDIAN);
+        f.setAsyncFlushThreshold(4096);
+        for (int i = 0; i < N; ++i) {
+            f.writeInt32(i);
+        }
+        debugAssert(f.length() == N * 4);
+        w = f.commitAsync();
+        // f may be destroyed before the write completes
+    }
+
+    w->wait();
+    debugAssert(w->completed());
+    debugAssert(w->ok());
+
+    BinaryInput g("out.t", G3D_LITTLE_ENDIAN);
+    debugAssert(g.getLength() == N * 4);
+    for (int i = 0; i < N; ++i) {
+        int32 x = g.readInt32();
+        debugAssert(x == i); (void)x;
+    }
+
+    // Synchronous commit after incremental flushes; more pending
+    // writes than the queue holds
+    AsyncFileWriter::setMaxPending(2);
+    {
+        BinaryOutput f("out.t", G3D_LITTLE_ENDIAN);
+        f.setAsyncFlushThreshold(1000);
+        for (int i = 0; i < N; ++i) {
+            f.writeInt32(-i);
+        }
+        f.commit();
+    }
+    AsyncFileWriter::setMaxPending(4);
+
+    BinaryInput h("out.t", G3D_LITTLE_ENDIAN);
+    debugAssert(h.getLength() == N * 4);
+    h.setPosition((N - 1) * 4);
+    debugAssert(h.readInt32() == -(N - 1));
 }
 
 
-void perfBinaryIO() {
-    measureSerializerPerformance();
+void perfBinaryIO(Benchmark& benchmark) {
+    benchmark.add("BinaryOutput (re-allocation)",       new SerializerCase(false),  SerializerCase::COUNT);
+    benchmark.add("BinaryOutput (BinaryOutput::reset)", new SerializerCase(true),   SerializerCase::COUNT);
 }
 
 void testBinaryIO() {
     testBitSerialization();
     testCompression();
+    testMemoryMap();
+    testBlockCompression();
+    testAsyncCommit();
 }
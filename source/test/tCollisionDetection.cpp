@@ -1,127 +1,254 @@
 #include "G3D/G3DAll.h"
 
-static void measureTriangleCollisionPerformance() {
-    printf("----------------------------------------------------------\n");
-    {
-    uint64 raw, opt;
+/** Number of queries per benchmark iteration */
+static const int COLLISION_COUNT = 100000;
+
+/** Keeps the compiler from eliding the queries */
+static volatile float collisionSink = 0;
 
+static void sphereTriangleVertices() {
     Vector3 v0(0, 0, 0);
     Vector3 v1(0, 0, -1);
     Vector3 v2(-1, 0, 0);
     Sphere sphere(Vector3(.5,1,-.5), 1);
     Vector3 vel(0, -1, 0);
     Vector3 location, normal;
-    Triangle triangle(v0, v1, v2);
-    int n = 1024;
-    int i;
+    for (int i = 0; i < COLLISION_COUNT; ++i) {
+        collisionSink = CollisionDetection::collisionTimeForMovingSphereFixedTriangle(sphere, vel, Triangle(v0, v1, v2), location, normal);
+    }
+}
 
-    System::beginCycleCount(raw);
-    for (i = 0; i < n; ++i) {
-        double t = CollisionDetection::collisionTimeForMovingSphereFixedTriangle(sphere, vel, Triangle(v0, v1, v2), location, normal);
-        (void)t;
+
+static void sphereTriangle() {
+    Sphere sphere(Vector3(.5,1,-.5), 1);
+    Vector3 vel(0, -1, 0);
+    Vector3 location, normal;
+    Triangle triangle(Vector3(0, 0, 0), Vector3(0, 0, -1), Vector3(-1, 0, 0));
+    for (int i = 0; i < COLLISION_COUNT; ++i) {
+        collisionSink = CollisionDetection::collisionTimeForMovingSphereFixedTriangle(sphere, vel, triangle, location, normal);
     }
-    System::endCycleCount(raw);
+}
 
-    System::beginCycleCount(opt);
-    for (i = 0; i < n; ++i) {
-        double t = CollisionDetection::collisionTimeForMovingSphereFixedTriangle(sphere, vel, triangle, location, normal);
-        (void)t;
+
+static void rayTriangleMiss() {
+    Triangle triangle(Vector3(0, 0, 0), Vector3(0, 0, -1), Vector3(-1, 0, 0));
+    Ray ray = Ray::fromOriginAndDirection(Vector3(3.0f, -1.0f, -0.25f), Vector3(0, -1, 0));
+    for (int i = 0; i < COLLISION_COUNT; ++i) {
+        collisionSink = ray.intersectionTime(triangle);
     }
-    System::endCycleCount(opt);
+}
 
-    printf("Sphere-Triangle collision detection on 3 vertices: %d cycles\n", (int)(raw / n));
-    printf("Sphere-Triangle collision detection on Triangle:   %d cycles\n", (int)(opt / n));
+
+static void pointTriangleMiss() {
+    Triangle triangle(Vector3(0, 0, 0), Vector3(0, 0, -1), Vector3(-1, 0, 0));
+    Vector3 start(3.0f, -1.0f, -0.25f);
+    Vector3 vel(0, -1, 0);
+    Vector3 location, normal;
+    for (int i = 0; i < COLLISION_COUNT; ++i) {
+        collisionSink = CollisionDetection::collisionTimeForMovingPointFixedTriangle(
+            start, vel, triangle, location, normal);
     }
-    {
-        uint64 raw = 0, CD = 0;
+}
 
-        Vector3 v0(0, 0, 0);
-        Vector3 v1(0, 0, -1);
-        Vector3 v2(-1, 0, 0);
-        Sphere sphere(Vector3(0.5f, 1.0f, -0.5f), 1);
-        Vector3 vel(0, -1, 0);
-        Vector3 location, normal;
-        Triangle triangle(v0, v1, v2);
-		Vector3 start(3.0f, -1.0f, -0.25f);
-        int n = 1024;
-        int i;
-        Ray ray = Ray::fromOriginAndDirection(start, vel);
-
-        System::beginCycleCount(raw);
-        for (i = 0; i < n; ++i) {
-            double t = ray.intersectionTime(triangle);
-            (void)t;
-        }
-        System::endCycleCount(raw);
-        System::beginCycleCount(CD);
-        for (i = 0; i < n; ++i) {
-            double t = CollisionDetection::collisionTimeForMovingPointFixedTriangle(
-                start, vel, triangle, location, normal);
-            (void)t;
+
+static void rayTriangleHit() {
+    Triangle triangle(Vector3(0, 0, 0), Vector3(0, 0, -1), Vector3(-1, 0, 0));
+    Ray ray = Ray::fromOriginAndDirection(Vector3(-0.15f, 1.0f, -0.15f), Vector3(0, -1, 0));
+    for (int i = 0; i < COLLISION_COUNT; ++i) {
+        collisionSink = ray.intersectionTime(triangle);
+    }
+}
+
+
+static void pointBox() {
+    Box box = AABox(Vector3(-1, -1, -1), Vector3(1,2,3));
+    Vector3 location, normal;
+    for (int i = 0; i < COLLISION_COUNT; ++i) {
+        collisionSink = CollisionDetection::collisionTimeForMovingPointFixedBox(
+            Vector3(0,10,0), Vector3(0,-1,0), box, location, normal);
+    }
+}
+
+
+static void pointAABox() {
+    AABox aabox(Vector3(-1, -1, -1), Vector3(1,2,3));
+    Vector3 location;
+    for (int i = 0; i < COLLISION_COUNT; ++i) {
+        collisionSink = CollisionDetection::collisionTimeForMovingPointFixedAABox(
+            Vector3(0,10,0), Vector3(0,-1,0), aabox, location);
+    }
+}
+
+
+/** Random triangles around the origin, some of them slivers */
+static void randomTriangles(int n, Array<Triangle>& out) {
+    out.fastClear();
+    for (int i = 0; i < n; ++i) {
+        const Vector3 center = Vector3::random() * uniformRandom(0, 10);
+        const Vector3 v0 = center + Vector3::random() * uniformRandom(0.1f, 2);
+        const Vector3 v1 = center + Vector3::random() * uniformRandom(0.1f, 2);
+        Vector3 v2 = center + Vector3::random() * uniformRandom(0.1f, 2);
+        if (i % 17 == 1) {
+            v2 = v0 + (v1 - v0) * 0.5f + Vector3::random() * 0.001f;
         }
-        System::endCycleCount(CD);
-        printf("ray.intersectionTime(triangle) (Miss):                %d cycles\n", (int)(raw / n));
-        printf("collisionTimeForMovingPointFixedTriangle (Miss):      %d cycles\n", (int)(CD / n));
+        out.append(Triangle(v0, v1, v2));
     }
-    {
-        uint64 raw = 0;
+}
 
-        Vector3 v0(0, 0, 0);
-        Vector3 v1(0, 0, -1);
-        Vector3 v2(-1, 0, 0);
-        Vector3 vel(0, -1, 0);
-        Vector3 location, normal;
-		Vector3 start(-0.15f, 1.0f, -0.15f);
-        Triangle triangle(v0, v1, v2);
-        int n = 1024;
-        int i;
-        Ray ray = Ray::fromOriginAndDirection(start, vel);
-
-        System::beginCycleCount(raw);
-        for (i = 0; i < n; ++i) {
-            double t = ray.intersectionTime(triangle);
-            (void)t;
+
+/** The batch point query must return exactly what the scalar loop does */
+static void checkPointTriangles(
+    const Vector3&                              start,
+    const Vector3&                              velocity,
+    const Array<Triangle>&                      triangle,
+    const CollisionDetection::PackedTriangles&  packed) {
+
+    float expected = inf();
+    int expectedIndex = -1;
+    for (int i = 0; i < triangle.size(); ++i) {
+        const float t = CollisionDetection::collisionTimeForMovingPointFixedTriangle(start, velocity, triangle[i]);
+        if (t < expected) {
+            expected = t;
+            expectedIndex = i;
         }
-        System::endCycleCount(raw);
+    }
 
-        printf("Hit:\n");
-        printf("ray.intersectionTime(triangle) (Hit):                 %d cycles\n", (int)(raw / n));
+    int index;
+    Vector3 location, normal;
+    const float t = CollisionDetection::collisionTimeForMovingPointFixedTriangles(start, velocity, packed, index, location, normal);
+    debugAssert(t == expected);
+    debugAssert(index == expectedIndex);
+    if (index != -1) {
+        Vector3 expectedLocation, expectedNormal;
+        CollisionDetection::collisionTimeForMovingPointFixedTriangle(start, velocity, triangle[index], expectedLocation, expectedNormal);
+        debugAssert(location == expectedLocation);
+        debugAssert(normal == expectedNormal);
     }
 }
- 
-
-static void measureAABoxCollisionPerformance() {
-    printf("----------------------------------------------------------\n");
 
-    uint64 raw, opt;
 
-    AABox aabox(Vector3(-1, -1, -1), Vector3(1,2,3));
-    Box   box = aabox;
+/** The batch sphere query must return exactly what the scalar loop does */
+static void checkSphereTriangles(
+    const Sphere&                               sphere,
+    const Vector3&                              velocity,
+    const Array<Triangle>&                      triangle,
+    const CollisionDetection::PackedTriangles&  packed) {
+
+    float expected = inf();
+    int expectedIndex = -1;
+    Vector3 ignore;
+    for (int i = 0; i < triangle.size(); ++i) {
+        const float t = CollisionDetection::collisionTimeForMovingSphereFixedTriangle(sphere, velocity, triangle[i], ignore);
+        if (t < expected) {
+            expected = t;
+            expectedIndex = i;
+        }
+    }
 
-    Vector3 pt1(0,10,0);
-    Vector3 vel1(0,-1,0);
+    int index;
     Vector3 location, normal;
-    int n = 1024;
-    int i;
+    const float t = CollisionDetection::collisionTimeForMovingSphereFixedTriangles(sphere, velocity, packed, index, location, normal);
+    debugAssert(t == expected);
+    debugAssert(index == expectedIndex);
+    if (index != -1) {
+        Vector3 expectedLocation, expectedNormal;
+        CollisionDetection::collisionTimeForMovingSphereFixedTriangle(sphere, velocity, triangle[index], expectedLocation, expectedNormal);
+        debugAssert(location == expectedLocation);
+        debugAssert(normal == expectedNormal);
+    }
+}
 
-    System::beginCycleCount(raw);
-    for (i = 0; i < n; ++i) {
-        double t = CollisionDetection::collisionTimeForMovingPointFixedBox(
-            pt1, vel1, box, location, normal);
-        (void)t;
+
+/** Every batch query must agree with the earliest of the scalar queries */
+static void testBatchTriangles() {
+    Array<Triangle> triangle;
+    for (int trial = 0; trial < 200; ++trial) {
+        // Also sizes that are not a multiple of four, and the empty set
+        randomTriangles(trial % 23, triangle);
+        const CollisionDetection::PackedTriangles packed(triangle);
+        debugAssert(packed.size() == triangle.size());
+
+        for (int q = 0; q < 20; ++q) {
+            const Vector3 start = Vector3::random() * uniformRandom(0, 15);
+            // Aim most queries into the soup
+            const Vector3 velocity = ((q % 4 == 0) ? Vector3::random() : (Vector3::random() * 3 - start).direction()) *
+                uniformRandom(0.5f, 4);
+            const Sphere sphere(start, (q % 5 == 0) ? 0.0f : uniformRandom(0.05f, 1.5f));
+
+            checkPointTriangles(start, velocity, triangle, packed);
+            checkSphereTriangles(sphere, velocity, triangle, packed);
+        }
     }
-    System::endCycleCount(raw);
 
-    System::beginCycleCount(opt);
-    for (i = 0; i < n; ++i) {
-        double t = CollisionDetection::collisionTimeForMovingPointFixedAABox(
-            pt1, vel1, aabox, location);
-        (void)t;
+    // Near ties and grazing hits: a grid of triangles that share edges, with
+    // copies a rounding error above and below, queried along the shared edges
+    // and vertices and with spheres that just touch them
+    {
+        triangle.fastClear();
+        for (int z = 0; z < 4; ++z) {
+            for (int x = 0; x < 4; ++x) {
+                for (int layer = -1; layer <= 1; ++layer) {
+                    const float y = layer * 1e-6f;
+                    const Vector3 v00(x, y, z), v10(x + 1.0f, y, z), v01(x, y, z + 1.0f), v11(x + 1.0f, y, z + 1.0f);
+                    triangle.append(Triangle(v00, v01, v11));
+                    triangle.append(Triangle(v00, v11, v10));
+                }
+            }
+        }
+        // Interleave the layers across the groups of four
+        for (int i = 0; i < triangle.size(); i += 3) {
+            const int j = iRandom(0, triangle.size() - 1);
+            const Triangle temp = triangle[i];
+            triangle[i] = triangle[j];
+            triangle[j] = temp;
+        }
+        const CollisionDetection::PackedTriangles packed(triangle);
+
+        for (int q = 0; q < 2000; ++q) {
+            // Start over an edge or vertex of the grid, nudged by about a rounding error
+            Vector3 target(iRandom(0, 4), 0, uniformRandom(0, 4));
+            if (q % 3 == 0) {
+                target.z = iRandom(0, 4);
+            } else if (q % 3 == 1) {
+                // Diagonal edge
+                target.x = iRandom(0, 3) + (target.z - floor(target.z));
+            }
+            target += Vector3(uniformRandom(-1, 1), 0, uniformRandom(-1, 1)) * 1e-6f;
+
+            const Vector3 velocity = (q % 2 == 0) ? Vector3(0, -1, 0) : Vector3(uniformRandom(-.3f, .3f), -1, uniformRandom(-.3f, .3f));
+            checkPointTriangles(target - velocity * 2, velocity, triangle, packed);
+
+            // Spheres that come down onto the grid, or slide along it just
+            // touching
+            const float radius = uniformRandom(0.1f, 1);
+            checkSphereTriangles(Sphere(target - velocity * 2 + Vector3(0, radius, 0), radius), velocity, triangle, packed);
+            checkSphereTriangles(Sphere(Vector3(-2, radius * (1 + uniformRandom(-1e-5f, 1e-5f)), target.z), radius),
+                                 Vector3(1, uniformRandom(-1e-5f, 1e-5f), uniformRandom(-.5f, .5f)), triangle, packed);
+        }
     }
-    System::endCycleCount(opt);
 
-    printf("Ray-Box:   %d cycles\n", (int)(raw / n));
-    printf("Ray-AABox: %d cycles\n", (int)(opt / n));
+    // Ties go to the lowest index
+    {
+        Array<Triangle> same;
+        for (int i = 0; i < 6; ++i) {
+            same.append(Triangle(Vector3(0, 0, 0), Vector3(0, 0, -1), Vector3(-1, 0, 0)));
+        }
+        same[0] = Triangle(Vector3(5, 0, 0), Vector3(5, 0, -1), Vector3(4, 0, 0));
+        const CollisionDetection::PackedTriangles packed(same);
+
+        int index;
+        Vector3 location;
+        float t = CollisionDetection::collisionTimeForMovingSphereFixedTriangles(
+            Sphere(Vector3(-.25f, 2, -.25f), 1), Vector3(0, -1, 0), packed, index, location);
+        debugAssert(index == 1);
+        debugAssert(t == 1);
+        debugAssert(location.fuzzyEq(Vector3(-.25f, 0, -.25f)));
+
+        t = CollisionDetection::collisionTimeForMovingPointFixedTriangles(
+            Vector3(-.25f, 2, -.25f), Vector3(0, -1, 0), packed, index);
+        debugAssert(index == 1);
+        debugAssert(t == 2);
+    }
 }
 
 
@@ -234,11 +361,74 @@ void testCollisionDetection() {
         debugAssert(t == 0.5);
     }
 
+    testBatchTriangles();
+
     printf("passed\n");
 }
 
 
-void perfCollisionDetection() {
-	measureTriangleCollisionPerformance();
-	measureAABoxCollisionPerformance();
+/** A swept sphere against a few hundred nearby triangles, e.g., a character
+    against the level geometry around it */
+class SphereTriangleSoupCase : public Benchmark::Case {
+public:
+    enum {NUM_TRIANGLES = 256, NUM_QUERIES = 1000};
+
+    bool                                    batch;
+    Array<Triangle>                         triangle;
+    CollisionDetection::PackedTriangles     packed;
+    Array<Sphere>                           sphere;
+    Array<Vector3>                          velocity;
+
+    SphereTriangleSoupCase(bool b) : batch(b) {}
+
+    virtual void setUp() {
+        randomTriangles(NUM_TRIANGLES, triangle);
+        packed.set(triangle);
+        for (int q = 0; q < NUM_QUERIES; ++q) {
+            const Vector3 start = Vector3::random() * 12;
+            sphere.append(Sphere(start, 0.5f));
+            velocity.append((Vector3::random() * 3 - start).direction() * 2);
+        }
+    }
+
+    virtual void run() {
+        Vector3 location, normal;
+        for (int q = 0; q < NUM_QUERIES; ++q) {
+            if (batch) {
+                int index;
+                collisionSink = CollisionDetection::collisionTimeForMovingSphereFixedTriangles(
+                    sphere[q], velocity[q], packed, index, location, normal);
+            } else {
+                float best = inf();
+                for (int i = 0; i < triangle.size(); ++i) {
+                    best = min(best, CollisionDetection::collisionTimeForMovingSphereFixedTriangle(
+                        sphere[q], velocity[q], triangle[i], location, normal));
+                }
+                collisionSink = best;
+            }
+        }
+    }
+
+    virtual void tearDown() {
+        triangle.clear();
+        packed.clear();
+        sphere.clear();
+        velocity.clear();
+    }
+};
+
+
+void perfCollisionDetection(Benchmark& benchmark) {
+    const int N = COLLISION_COUNT;
+    benchmark.add("CollisionDetection::sphere-triangle (3 vertices)",   sphereTriangleVertices, N);
+    benchmark.add("CollisionDetection::sphere-triangle (Triangle)",     sphereTriangle,         N);
+    benchmark.add("Ray::intersectionTime(Triangle) (miss)",             rayTriangleMiss,        N);
+    benchmark.add("CollisionDetection::point-triangle (miss)",          pointTriangleMiss,      N);
+    benchmark.add("Ray::intersectionTime(Triangle) (hit)",              rayTriangleHit,         N);
+    benchmark.add("CollisionDetection::point-Box",                      pointBox,               N);
+    benchmark.add("CollisionDetection::point-AABox",                    pointAABox,             N);
+
+    const int S = SphereTriangleSoupCase::NUM_TRIANGLES * SphereTriangleSoupCase::NUM_QUERIES;
+    benchmark.add("CollisionDetection::sphere-triangle soup (loop)",    new SphereTriangleSoupCase(false), S);
+    benchmark.add("CollisionDetection::sphere-triangle soup (batch)",   new SphereTriangleSoupCase(true),  S);
 }
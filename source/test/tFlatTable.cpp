@@ -0,0 +1,155 @@
+#include "G3D/G3DAll.h"
+
+class FlatTableKey {
+public:
+    int value;
+
+    FlatTableKey() : value(0) {}
+    FlatTableKey(int v) : value(v) {}
+
+    inline bool operator==(const FlatTableKey& other) const {
+        return value == other.value;
+    }
+};
+
+/** Deliberately terrible hash; every key collides */
+unsigned int hashCode(const FlatTableKey& key) {
+    (void)key;
+    return 7;
+}
+
+
+void testFlatTable() {
+    printf("G3D::FlatTable  ");
+
+    // Basic get/set
+    {
+        FlatTable<int, int> table;
+        debugAssert(table.size() == 0);
+        debugAssert(! table.containsKey(0));
+
+        table.set(10, 20);
+        table.set(3, 1);
+        table.set(1, 4);
+
+        debugAssert(table.size() == 3);
+        debugAssert(table[10] == 20);
+        debugAssert(table[3] == 1);
+        debugAssert(table[1] == 4);
+        debugAssert(table.containsKey(10));
+        debugAssert(! table.containsKey(0));
+
+        table.set(3, 7);
+        debugAssert(table.size() == 3);
+        debugAssert(table[3] == 7);
+
+        int val;
+        debugAssert(table.get(1, val) && (val == 4));
+        debugAssert(! table.get(2, val));
+    }
+
+    // Growth, removal, and agreement with Table
+    {
+        FlatTable<int, int> flat;
+        Table<int, int> table;
+
+        for (int i = 0; i < 5000; ++i) {
+            flat.set(i * 3, i);
+            table.set(i * 3, i);
+        }
+        for (int i = 0; i < 5000; i += 2) {
+            flat.remove(i * 3);
+            table.remove(i * 3);
+        }
+        // Reinsert over deleted slots
+        for (int i = 0; i < 1000; ++i) {
+            flat.set(i * 7, -i);
+            table.set(i * 7, -i);
+        }
+
+        debugAssert(flat.size() == table.size());
+        debugAssert(flat.debugGetLoad() <= 0.875);
+        for (int i = 0; i < 20000; ++i) {
+            int a = 0, b = 0;
+            bool inFlat = flat.get(i, a);
+            bool inTable = table.get(i, b);
+            debugAssert(inFlat == inTable);
+            debugAssert(a == b);
+        }
+
+        // Iteration visits every entry once
+        int count = 0;
+        FlatTable<int, int>::Iterator end = flat.end();
+        for (FlatTable<int, int>::Iterator it = flat.begin(); it != end; ++it) {
+            debugAssert(table[it->key] == it->value);
+            ++count;
+        }
+        debugAssert(count == flat.size());
+
+        Array<int> keys;
+        flat.getKeys(keys);
+        debugAssert(keys.size() == flat.size());
+
+        // Copy
+        FlatTable<int, int> copy = flat;
+        debugAssert(copy.size() == flat.size());
+        for (int i = 0; i < keys.size(); ++i) {
+            debugAssert(copy[keys[i]] == flat[keys[i]]);
+        }
+
+        flat.clear();
+        debugAssert(flat.size() == 0);
+        debugAssert(! flat.containsKey(3));
+        debugAssert(copy.size() == keys.size());
+    }
+
+    // Non-POD keys and values
+    {
+        FlatTable<std::string, std::string> table;
+        for (int i = 0; i < 200; ++i) {
+            table.set(format("%d", i), format("v%d", i));
+        }
+        for (int i = 0; i < 200; i += 3) {
+            table.remove(format("%d", i));
+        }
+        for (int i = 0; i < 200; ++i) {
+            debugAssert(table.containsKey(format("%d", i)) == ((i % 3) != 0));
+        }
+        debugAssert(table["5"] == "v5");
+    }
+
+    // Collisions
+    {
+        FlatTable<FlatTableKey, int> table;
+        for (int i = 0; i < 100; ++i) {
+            table.set(FlatTableKey(i), i);
+        }
+        for (int i = 0; i < 100; ++i) {
+            debugAssert(table[FlatTableKey(i)] == i);
+        }
+        for (int i = 0; i < 100; i += 2) {
+            table.remove(FlatTableKey(i));
+        }
+        for (int i = 0; i < 100; ++i) {
+            debugAssert(table.containsKey(FlatTableKey(i)) == ((i & 1) == 1));
+        }
+    }
+
+    // Set
+    {
+        FlatSet<int> set;
+        set.reserve(100);
+        int n = set.size();
+        debugAssert(n == 0);
+        for (int i = 0; i < 100; ++i) {
+            set.insert(i % 10);
+        }
+        debugAssert(set.size() == 10);
+        debugAssert(set.contains(9));
+        set.remove(9);
+        debugAssert(! set.contains(9));
+        debugAssert(set.getMembers().size() == 9);
+    }
+
+    printf("passed\n");
+}
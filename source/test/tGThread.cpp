@@ -45,6 +45,18 @@ void testGThread() {
         debugAssert(tGThread.value() == 2);
     }
 
+    {
+        GSemaphore s(2);
+        debugAssert(s.tryAcquire());
+        s.acquire();
+        debugAssert(! s.tryAcquire());
+        s.release(3);
+        s.acquire();
+        s.acquire();
+        debugAssert(s.tryAcquire());
+        debugAssert(! s.tryAcquire());
+    }
+
     printf("passed\n");
 }
 
@@ -58,92 +58,69 @@ void testMatrix3() {
 }
 
 
-void perfMatrix3() {
-    printf("Matrix3:\n");
-    uint64 raw, opt, overhead, naive;
-
-    // 0.5 million operations
-    int n = 1024 * 1024 / 2;
-
-    // Use two copies to avoid nice cache behavior
-    Matrix3 A = Matrix3::fromAxisAngle(Vector3(1, 2, 1), 1.2f);
-    Matrix3 B = Matrix3::fromAxisAngle(Vector3(0, 1, -1), .2f);
-    Matrix3 C = Matrix3::zero();
-
-    Matrix3 D = Matrix3::fromAxisAngle(Vector3(1, 2, 1), 1.2f);
-    Matrix3 E = Matrix3::fromAxisAngle(Vector3(0, 1, -1), .2f);
-    Matrix3 F = Matrix3::zero();
-
-    int i;
-    System::beginCycleCount(overhead);
-    for (i = n - 1; i >= 0; --i) {
-    }
-    System::endCycleCount(overhead);
-
-    System::beginCycleCount(raw);
-    for (i = n - 1; i >= 0; --i) {
+/** Number of operations per benchmark iteration; each performs 3 */
+static const int MATRIX3_COUNT = 1024 * 1024 / 8;
+
+// Use two sets of matrices to avoid nice cache behavior
+static Matrix3 A = Matrix3::fromAxisAngle(Vector3(1, 2, 1), 1.2f);
+static Matrix3 B = Matrix3::fromAxisAngle(Vector3(0, 1, -1), .2f);
+static Matrix3 C = Matrix3::zero();
+static Matrix3 D = Matrix3::fromAxisAngle(Vector3(1, 2, 1), 1.2f);
+static Matrix3 E = Matrix3::fromAxisAngle(Vector3(0, 1, -1), .2f);
+static Matrix3 F = Matrix3::zero();
+
+static void transposeReturn() {
+    for (int i = MATRIX3_COUNT - 1; i >= 0; --i) {
         C = A.transpose();
         F = D.transpose();
         C = B.transpose();
     }
-    System::endCycleCount(raw);
+}
 
-    System::beginCycleCount(opt);
-    for (i = n - 1; i >= 0; --i) {
+
+static void transposeOutput() {
+    for (int i = MATRIX3_COUNT - 1; i >= 0; --i) {
         Matrix3::transpose(A, C);
         Matrix3::transpose(D, F);
         Matrix3::transpose(B, C);
     }
-    System::endCycleCount(opt);
-
-    raw -= overhead;
-    opt -= overhead;
-
-    printf(" Transpose Performance                       outcome\n");
-    printf("     transpose(A, C): %g cycles/mul       %s\n\n", 
-        (double)opt / (3*n), (opt/(3*n) < 400) ? " ok " : "FAIL");
-    printf("   C = A.transpose(): %g cycles/mul       %s\n", 
-        (double)raw / (3*n), (raw/(3*n) < 150) ? " ok " : "FAIL");
-    printf("\n");
-    /////////////////////////////////
+}
 
 
-    printf(" Matrix-Matrix Multiplication\n");
-    System::beginCycleCount(raw);
-    for (i = n - 1; i >= 0; --i) {
+static void mulOperator() {
+    for (int i = MATRIX3_COUNT - 1; i >= 0; --i) {
         C = A * B;
         F = D * E;
         C = A * D;
     }
-    System::endCycleCount(raw);
+}
 
-    System::beginCycleCount(opt);
-    for (i = n - 1; i >= 0; --i) {
+
+static void mulOutput() {
+    for (int i = MATRIX3_COUNT - 1; i >= 0; --i) {
         Matrix3::mul(A, B, C);
         Matrix3::mul(D, E, F);
         Matrix3::mul(A, D, C);
     }
-    System::endCycleCount(opt);
+}
 
-    
-    {
-        float A[3][3], B[3][3], C[3][3], D[3][3], E[3][3], F[3][3];
 
-        System::beginCycleCount(naive);
-        for (i = n - 1; i >= 0; --i) {
-            mul(A, B, C);
-            mul(D, E, F);
-            mul(A, D, C);
-        }
-        System::endCycleCount(naive);
+static void mulNaive() {
+    static float A[3][3], B[3][3], C[3][3], D[3][3], E[3][3], F[3][3];
+    for (int i = MATRIX3_COUNT - 1; i >= 0; --i) {
+        mul(A, B, C);
+        mul(D, E, F);
+        mul(A, D, C);
     }
+}
 
-    raw -= overhead;
-    opt -= overhead;
-    
-    printf("  mul(A, B, C)          %g cycles/mul     %s\n", (double)opt / (3*n), (opt/(3*n) < 250) ? " ok " : "FAIL");
-    printf("     C = A * B          %g cycles/mul     %s\n", (double)raw / (3*n), (raw/(3*n) < 500) ? " ok " : "FAIL");
-    printf("  naive for-loops       %g cycles/mul\n", (double)naive / (3*n));
 
-    printf("\n\n");
+void perfMatrix3(Benchmark& benchmark) {
+    const int N = MATRIX3_COUNT * 3;
+    benchmark.add("Matrix3::transpose (output)",    transposeOutput,    N);
+    benchmark.add("Matrix3::transpose (return)",    transposeReturn,    N);
+    benchmark.add("Matrix3::mul (output)",          mulOutput,          N);
+    benchmark.add("Matrix3::operator*",             mulOperator,        N);
+    benchmark.add("float[3][3] naive mul",          mulNaive,           N);
 }
+
@@ -0,0 +1,88 @@
+#include "G3D/G3DAll.h"
+
+void testMemoryArena() {
+    printf("G3D::MemoryArena  ");
+
+    // Alignment, markers, and chunk reuse
+    {
+        MemoryArena arena(1024);
+        debugAssert(arena.capacityBytes() == 0);
+
+        uint8* a = (uint8*)arena.alloc(3, 1);
+        uint8* b = (uint8*)arena.alloc(8, 16);
+        debugAssert(((size_t)b & 15) == 0);
+        debugAssert(b > a);
+        System::memset(b, 1, 8);
+
+        MemoryArena::Marker m = arena.mark();
+        size_t used = arena.usedBytes();
+
+        // Spill into a second chunk, including one larger than the chunk size
+        for (int i = 0; i < 20; ++i) {
+            void* p = arena.alloc(200, 8);
+            debugAssert(((size_t)p & 7) == 0);
+            System::memset(p, i, 200);
+        }
+        void* big = arena.alloc(5000);
+        System::memset(big, 0, 5000);
+        debugAssert(arena.usedBytes() > 9000);
+
+        arena.release(m);
+        debugAssert(arena.usedBytes() == used);
+        debugAssert(b[7] == 1);
+
+        // The memory after the marker is handed out again
+        uint8* c = (uint8*)arena.alloc(8, 16);
+        debugAssert(c == b + 16);
+        (void)c;
+
+        size_t peak = arena.peakBytes();
+        arena.reset();
+        debugAssert(arena.usedBytes() == 0);
+        debugAssert(arena.peakBytes() == 0);
+        debugAssert(arena.previousPeakBytes() == peak);
+
+        // After a reset everything fits in a single chunk
+        size_t capacity = arena.capacityBytes();
+        for (int i = 0; i < 20; ++i) {
+            arena.alloc(200, 8);
+        }
+        arena.alloc(5000);
+        debugAssert(arena.capacityBytes() == capacity);
+    }
+
+    // Containers backed by an arena
+    {
+        MemoryArena arena;
+        for (int frame = 0; frame < 3; ++frame) {
+            MemoryArena::Scope scope(arena);
+
+            Array<int> array;
+            array.clearAndSetMemoryArena(&arena);
+            for (int i = 0; i < 1000; ++i) {
+                array.append(i);
+            }
+            debugAssert(array.memoryArena() == &arena);
+            debugAssert(array[999] == 999);
+
+            Array<int> copy = array;
+            debugAssert(copy.memoryArena() == NULL);
+            debugAssert(copy[500] == 500);
+
+            Table<int, std::string> table(&arena);
+            for (int i = 0; i < 100; ++i) {
+                table.set(i, format("%d", i));
+            }
+            table.remove(50);
+            debugAssert(table.size() == 99);
+            debugAssert(table[7] == "7");
+
+            Table<int, std::string> tableCopy = table;
+            debugAssert(tableCopy.memoryArena() == NULL);
+            debugAssert(tableCopy[99] == "99");
+        }
+        debugAssert(arena.usedBytes() == 0);
+    }
+
+    printf("passed\n");
+}
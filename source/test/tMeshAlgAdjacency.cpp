@@ -1,5 +1,145 @@
 #include "G3D/G3DAll.h"
 
+/**
+ Checks computeAdjacency against counts made independently: between each
+ pair of vertices there are as many interior edges as the smaller of the
+ number of half-edges in each direction, and the rest are boundary edges.
+ */
+static void checkAdjacency(
+    const Array<int>&                   index,
+    const Array<MeshAlg::Face>&         faceArray,
+    const Array<MeshAlg::Edge>&         edgeArray,
+    const Array<MeshAlg::Vertex>&       vertexArray) {
+
+    MeshAlg::debugCheckConsistency(faceArray, edgeArray, vertexArray);
+    debugAssert(faceArray.size() * 3 == index.size());
+
+    // Half-edge counts, lower vertex index first: forward and backward
+    Table<uint64, Vector2int16> count;
+    for (int h = 0; h < index.size(); ++h) {
+        const int i0 = index[h];
+        const int i1 = index[(h % 3 == 2) ? (h - 2) : (h + 1)];
+        const uint64 k = ((uint64)iMin(i0, i1) << 32) | iMax(i0, i1);
+        if (! count.containsKey(k)) {
+            count.set(k, Vector2int16(0, 0));
+        }
+        if (i0 <= i1) {
+            ++count[k].x;
+        } else {
+            ++count[k].y;
+        }
+    }
+
+    int interior = 0, numBoundary = 0;
+    Table<uint64, Vector2int16>::Iterator it = count.begin();
+    for (; it != count.end(); ++it) {
+        interior    += iMin(it->value.x, it->value.y);
+        numBoundary += iAbs(it->value.x - it->value.y);
+    }
+    debugAssert(edgeArray.size() == interior + numBoundary);
+    debugAssert(MeshAlg::countBoundaryEdges(edgeArray) == numBoundary);
+
+    // Boundary edges are last
+    for (int e = 0; e < edgeArray.size(); ++e) {
+        debugAssert(edgeArray[e].boundary() == (e >= interior));
+    }
+
+    // Face edges run from vertex j to vertex j + 1
+    for (int f = 0; f < faceArray.size(); ++f) {
+        const MeshAlg::Face& face = faceArray[f];
+        for (int j = 0; j < 3; ++j) {
+            const int e = face.edgeIndex[j];
+            const MeshAlg::Edge& edge = edgeArray[(e >= 0) ? e : ~e];
+            const int from = (e >= 0) ? edge.vertexIndex[0] : edge.vertexIndex[1];
+            const int to   = (e >= 0) ? edge.vertexIndex[1] : edge.vertexIndex[0];
+            debugAssert(from == face.vertexIndex[j]);
+            debugAssert(to == face.vertexIndex[(j + 1) % 3]);
+        }
+    }
+
+    // Each vertex lists its faces in order, once per corner
+    Array<int> corners;
+    corners.resize(vertexArray.size());
+    for (int v = 0; v < corners.size(); ++v) {
+        corners[v] = 0;
+    }
+    for (int i = 0; i < index.size(); ++i) {
+        ++corners[index[i]];
+    }
+    for (int v = 0; v < vertexArray.size(); ++v) {
+        const MeshAlg::Vertex& vertex = vertexArray[v];
+        debugAssert(vertex.faceIndex.size() == corners[v]);
+        for (int i = 1; i < vertex.faceIndex.size(); ++i) {
+            debugAssert(vertex.faceIndex[i - 1] <= vertex.faceIndex[i]);
+        }
+    }
+}
+
+
+static void makeGrid(int n, Array<Vector3>& vertex, Array<int>& index);
+
+/** Two grids with shared, doubled, non-manifold, and degenerate faces */
+static void makeMessyMesh(int n, Array<Vector3>& vertex, Array<int>& index);
+
+
+/** Computes adjacency for several meshes at once */
+class AdjacencyBody {
+public:
+    const Array<Vector3>*       vertex;
+    const Array<int>*           index;
+    Array<MeshAlg::Face>*       face;
+    Array<MeshAlg::Edge>*       edge;
+    Array<MeshAlg::Vertex>*     vertexArray;
+
+    void operator()(int begin, int end) const {
+        for (int i = begin; i < end; ++i) {
+            MeshAlg::computeAdjacency(vertex[i], index[i], face[i], edge[i], vertexArray[i]);
+        }
+    }
+};
+
+
+static void testLargeAdjacency() {
+    enum {N = 4};
+    Array<Vector3>          vertex[N];
+    Array<int>              index[N];
+    Array<MeshAlg::Face>    face[N];
+    Array<MeshAlg::Edge>    edge[N];
+    Array<MeshAlg::Vertex>  vertexArray[N];
+
+    // Meshes of several chunks, computed concurrently
+    static const int size[N] = {3, 40, 130, 210};
+    for (int i = 0; i < N; ++i) {
+        makeMessyMesh(size[i], vertex[i], index[i]);
+    }
+
+    AdjacencyBody body;
+    body.vertex      = vertex;
+    body.index       = index;
+    body.face        = face;
+    body.edge        = edge;
+    body.vertexArray = vertexArray;
+    ThreadPool::common().parallelFor(0, N, 1, body);
+
+    for (int i = 0; i < N; ++i) {
+        checkAdjacency(index[i], face[i], edge[i], vertexArray[i]);
+    }
+
+    // The same results serially
+    Array<MeshAlg::Face>    f;
+    Array<MeshAlg::Edge>    e;
+    Array<MeshAlg::Vertex>  v;
+    MeshAlg::computeAdjacency(vertex[N - 1], index[N - 1], f, e, v);
+    debugAssert(e.size() == edge[N - 1].size());
+    for (int i = 0; i < e.size(); ++i) {
+        debugAssert(e[i].vertexIndex[0] == edge[N - 1][i].vertexIndex[0]);
+        debugAssert(e[i].vertexIndex[1] == edge[N - 1][i].vertexIndex[1]);
+        debugAssert(e[i].faceIndex[0] == edge[N - 1][i].faceIndex[0]);
+        debugAssert(e[i].faceIndex[1] == edge[N - 1][i].faceIndex[1]);
+    }
+}
+
+
 void testAdjacency() {
     printf("MeshAlg::computeAdjacency\n");
 
@@ -301,5 +441,104 @@ void testAdjacency() {
         debugAssert(edgeArray[4].boundary());
 
     }
-    
+
+    testLargeAdjacency();
+}
+
+
+/** An n x n grid of vertices, two triangles per cell */
+static void makeGrid(int n, Array<Vector3>& vertex, Array<int>& index) {
+    vertex.fastClear();
+    index.fastClear();
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            vertex.append(Vector3(x, y, sin(x * 0.1f) * cos(y * 0.1f)));
+        }
+    }
+    for (int y = 0; y < n - 1; ++y) {
+        for (int x = 0; x < n - 1; ++x) {
+            const int v = x + y * n;
+            index.append(v, v + 1, v + n + 1);
+            index.append(v, v + n + 1, v + n);
+        }
+    }
+}
+
+
+static void makeMessyMesh(int n, Array<Vector3>& vertex, Array<int>& index) {
+    makeGrid(n, vertex, index);
+
+    // A second grid that shares the first one's vertices along its middle
+    // row, with the opposite winding
+    const int base = vertex.size();
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            vertex.append(Vector3(x, y, 1));
+        }
+    }
+    const int middle = (n / 2) * n;
+    for (int y = 0; y < n - 1; ++y) {
+        for (int x = 0; x < n - 1; ++x) {
+            int v = base + x + y * n;
+            int w = v + n;
+            if (y == n / 2) {
+                v = middle + x;
+            } else if (y + 1 == n / 2) {
+                w = middle + x;
+            }
+            index.append(v, w + 1, v + 1);
+            index.append(v, w, w + 1);
+        }
+    }
+
+    // Doubled faces, faces whose edges meet more than two others, and
+    // degenerate faces
+    const int numFaces = index.size() / 3;
+    for (int i = 0; i < numFaces; i += 7) {
+        const int f = iRandom(0, numFaces - 1);
+        index.append(index[f * 3], index[f * 3 + 1], index[f * 3 + 2]);
+        if (i % 3 == 0) {
+            index.append(index[f * 3 + 1], index[f * 3], iRandom(0, vertex.size() - 1));
+        }
+        if (i % 5 == 0) {
+            index.append(index[f * 3], index[f * 3 + 1], index[f * 3]);
+        }
+    }
+}
+
+
+/** computeAdjacency on grids of increasing size */
+class AdjacencyCase : public Benchmark::Case {
+public:
+    int                         n;
+    Array<Vector3>              vertex;
+    Array<int>                  index;
+    Array<MeshAlg::Face>        faceArray;
+    Array<MeshAlg::Edge>        edgeArray;
+    Array<MeshAlg::Vertex>      vertexArray;
+
+    AdjacencyCase(int n) : n(n) {}
+
+    virtual void setUp() {
+        makeGrid(n, vertex, index);
+    }
+
+    virtual void run() {
+        MeshAlg::computeAdjacency(vertex, index, faceArray, edgeArray, vertexArray);
+    }
+
+    virtual void tearDown() {
+        vertex.clear();
+        index.clear();
+        faceArray.clear();
+        edgeArray.clear();
+        vertexArray.clear();
+    }
+};
+
+
+void perfAdjacency(Benchmark& benchmark) {
+    benchmark.add("MeshAlg::computeAdjacency (20k faces)",  new AdjacencyCase(101),  2 * 100 * 100);
+    benchmark.add("MeshAlg::computeAdjacency (200k faces)", new AdjacencyCase(317),  2 * 316 * 316);
+    benchmark.add("MeshAlg::computeAdjacency (2M faces)",   new AdjacencyCase(1001), 2 * 1000 * 1000);
 }
@@ -0,0 +1,222 @@
+#include "G3D/G3DAll.h"
+
+/** Wavy n x n grid with its texture coordinates; every 7th triangle is degenerate if degenerate is true */
+static void makeWavyGrid(int n, bool degenerate, Array<Vector3>& vertex, Array<Vector2>& texCoord, Array<int>& index) {
+    vertex.fastClear();
+    texCoord.fastClear();
+    index.fastClear();
+
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            const float s = (float)x / (n - 1);
+            const float t = (float)y / (n - 1);
+            vertex.append(Vector3(s * 10, t * 10, sin(s * 17.0f) * cos(t * 11.0f)));
+            texCoord.append(Vector2(s, 1 - t));
+        }
+    }
+
+    for (int y = 0; y < n - 1; ++y) {
+        for (int x = 0; x < n - 1; ++x) {
+            const int v = y * n + x;
+            index.append(v, v + 1, v + n + 1);
+            if (degenerate && (index.size() % 7 == 0)) {
+                index.append(v, v, v + n);
+            } else {
+                index.append(v, v + n + 1, v + n);
+            }
+        }
+    }
+}
+
+
+/** The per-vertex sum of face normals, one vertex at a time */
+static void referenceNormals(
+    const Array<Vector3>&           vertex,
+    const Array<MeshAlg::Face>&     face,
+    const Array<MeshAlg::Vertex>&   adjacency,
+    Array<Vector3>&                 vertexNormal,
+    Array<Vector3>&                 faceNormal) {
+
+    faceNormal.resize(face.size());
+    for (int f = 0; f < face.size(); ++f) {
+        const int* i = face[f].vertexIndex;
+        faceNormal[f] = (vertex[i[1]] - vertex[i[0]]).cross(vertex[i[2]] - vertex[i[0]]);
+    }
+
+    vertexNormal.resize(vertex.size());
+    for (int v = 0; v < vertex.size(); ++v) {
+        Vector3 sum = Vector3::zero();
+        for (int k = 0; k < adjacency[v].faceIndex.size(); ++k) {
+            sum += faceNormal[adjacency[v].faceIndex[k]];
+        }
+        vertexNormal[v] = sum.directionOrZero();
+    }
+
+    for (int f = 0; f < face.size(); ++f) {
+        faceNormal[f] = faceNormal[f].directionOrZero();
+    }
+}
+
+
+static bool allFuzzyEq(const Array<Vector3>& a, const Array<Vector3>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (int i = 0; i < a.size(); ++i) {
+        if (! (a[i] - b[i]).isZero() && ((a[i] - b[i]).length() > 1e-4f)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void testMeshAlgNormals() {
+    printf("MeshAlg::computeNormals ");
+
+    // Sizes that leave every remainder of the four-wide kernels
+    for (int n = 2; n < 40; n += 5) {
+        Array<Vector3> vertex;
+        Array<Vector2> texCoord;
+        Array<int> index;
+        makeWavyGrid(n, n > 10, vertex, texCoord, index);
+
+        Array<MeshAlg::Face>    face;
+        Array<MeshAlg::Edge>    edge;
+        Array<MeshAlg::Vertex>  adjacency;
+        MeshAlg::computeAdjacency(vertex, index, face, edge, adjacency);
+
+        Array<Vector3> vertexNormal, faceNormal, expectedVertexNormal, expectedFaceNormal;
+        MeshAlg::computeNormals(vertex, face, adjacency, vertexNormal, faceNormal);
+        referenceNormals(vertex, face, adjacency, expectedVertexNormal, expectedFaceNormal);
+        debugAssert(allFuzzyEq(vertexNormal, expectedVertexNormal));
+        debugAssert(allFuzzyEq(faceNormal, expectedFaceNormal));
+
+        for (int f = 0; f < face.size(); ++f) {
+            const int* i = face[f].vertexIndex;
+            if ((i[0] == i[1]) || (i[0] == i[2]) || (i[1] == i[2])) {
+                debugAssert(faceNormal[f].isZero());
+            } else {
+                debugAssert(faceNormal[f].isUnit());
+            }
+        }
+
+        Array<Vector3> unnormalized;
+        MeshAlg::computeFaceNormals(vertex, face, unnormalized, false);
+        debugAssert(unnormalized.size() == face.size());
+        for (int f = 0; f < face.size(); ++f) {
+            const int* i = face[f].vertexIndex;
+            debugAssert(unnormalized[f] == (vertex[i[1]] - vertex[i[0]]).cross(vertex[i[2]] - vertex[i[0]]));
+            debugAssert(faceNormal[f].fuzzyEq(unnormalized[f].directionOrZero()));
+        }
+
+        // Each tangent is perpendicular to its normal and follows s across this grid
+        Array<Vector3> tangent, binormal;
+        MeshAlg::computeTangentSpaceBasis(vertex, texCoord, vertexNormal, face, tangent, binormal);
+        debugAssert((tangent.size() == vertex.size()) && (binormal.size() == vertex.size()));
+        for (int v = 0; v < vertex.size(); ++v) {
+            debugAssert(tangent[v].isUnit() && binormal[v].isUnit());
+            debugAssert(fuzzyEq(tangent[v].dot(vertexNormal[v]), 0));
+            debugAssert(fuzzyEq(binormal[v].dot(vertexNormal[v]), 0));
+            debugAssert(tangent[v].x > 0);
+            debugAssert(binormal[v].y > 0);
+        }
+    }
+
+    {
+        // Flat quads give the exact frame
+        Array<Vector3> vertex;
+        Array<Vector2> texCoord;
+        Array<int> index;
+        for (int q = 0; q < 5; ++q) {
+            vertex.append(Vector3(q * 4 - 2.0f, -2, 0), Vector3(q * 4 + 2.0f, -2, 0));
+            vertex.append(Vector3(q * 4 + 2.0f,  2, 0), Vector3(q * 4 - 2.0f,  2, 0));
+            texCoord.append(Vector2(0, 1), Vector2(1, 1), Vector2(1, 0), Vector2(0, 0));
+            index.append(4 * q, 4 * q + 1, 4 * q + 2);
+            index.append(4 * q, 4 * q + 2, 4 * q + 3);
+        }
+
+        MeshAlg::Geometry geometry;
+        geometry.vertexArray = vertex;
+        MeshAlg::computeNormals(geometry, index);
+
+        Array<MeshAlg::Face>    face;
+        Array<MeshAlg::Edge>    edge;
+        Array<MeshAlg::Vertex>  adjacency;
+        MeshAlg::computeAdjacency(vertex, index, face, edge, adjacency);
+
+        Array<Vector3> tangent, binormal;
+        MeshAlg::computeTangentSpaceBasis(vertex, texCoord, geometry.normalArray, face, tangent, binormal);
+        for (int v = 0; v < vertex.size(); ++v) {
+            debugAssert(geometry.normalArray[v].fuzzyEq(Vector3::unitZ()));
+            debugAssert(tangent[v].fuzzyEq(Vector3::unitX()));
+            debugAssert(binormal[v].fuzzyEq(Vector3::unitY()));
+        }
+    }
+
+    printf("passed\n");
+}
+
+
+/** The normal and tangent space methods on a wavy grid */
+class NormalsCase : public Benchmark::Case {
+public:
+    enum Method {NORMALS, FACE_NORMALS, TANGENT_SPACE};
+
+    Method                  method;
+    int                     n;
+    Array<Vector3>          vertex;
+    Array<Vector2>          texCoord;
+    Array<MeshAlg::Face>    face;
+    Array<MeshAlg::Vertex>  adjacency;
+    Array<Vector3>          vertexNormal;
+    Array<Vector3>          faceNormal;
+    Array<Vector3>          tangent;
+    Array<Vector3>          binormal;
+
+    NormalsCase(Method method, int n) : method(method), n(n) {}
+
+    virtual void setUp() {
+        Array<int> index;
+        Array<MeshAlg::Edge> edge;
+        makeWavyGrid(n, false, vertex, texCoord, index);
+        MeshAlg::computeAdjacency(vertex, index, face, edge, adjacency);
+        MeshAlg::computeNormals(vertex, face, adjacency, vertexNormal, faceNormal);
+    }
+
+    virtual void run() {
+        switch (method) {
+        case NORMALS:
+            MeshAlg::computeNormals(vertex, face, adjacency, vertexNormal, faceNormal);
+            break;
+
+        case FACE_NORMALS:
+            MeshAlg::computeFaceNormals(vertex, face, faceNormal);
+            break;
+
+        case TANGENT_SPACE:
+            MeshAlg::computeTangentSpaceBasis(vertex, texCoord, vertexNormal, face, tangent, binormal);
+            break;
+        }
+    }
+
+    virtual void tearDown() {
+        vertex.clear();
+        texCoord.clear();
+        face.clear();
+        adjacency.clear();
+        vertexNormal.clear();
+        faceNormal.clear();
+        tangent.clear();
+        binormal.clear();
+    }
+};
+
+
+void perfMeshAlgNormals(Benchmark& benchmark) {
+    const int n = 512;
+    const int numFaces = 2 * (n - 1) * (n - 1);
+    benchmark.add("MeshAlg::computeNormals (500k faces)",           new NormalsCase(NormalsCase::NORMALS, n),       numFaces);
+    benchmark.add("MeshAlg::computeFaceNormals (500k faces)",       new NormalsCase(NormalsCase::FACE_NORMALS, n),  numFaces);
+    benchmark.add("MeshAlg::computeTangentSpaceBasis (500k faces)", new NormalsCase(NormalsCase::TANGENT_SPACE, n), numFaces);
+}
@@ -0,0 +1,226 @@
+#include "G3D/G3DAll.h"
+
+static const float TORUS_R = 1.0f;
+static const float TORUS_r = 0.3f;
+
+/** Closed torus of 2 * n * m triangles with normals and texture coordinates */
+static void makeTorus(int n, int m, MeshAlg::Geometry& geometry, Array<Vector2>& texCoord, Array<int>& index) {
+    geometry.clear();
+    texCoord.clear();
+    index.clear();
+
+    for (int i = 0; i < n; ++i) {
+        const float a = (float)twoPi() * i / n;
+        const Vector3 ring(cos(a), sin(a), 0);
+        for (int j = 0; j < m; ++j) {
+            const float b = (float)twoPi() * j / m;
+            const Vector3 normal = ring * cos(b) + Vector3::unitZ() * sin(b);
+            geometry.vertexArray.append(ring * TORUS_R + normal * TORUS_r);
+            geometry.normalArray.append(normal);
+            texCoord.append(Vector2((float)i / n, (float)j / m));
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < m; ++j) {
+            const int v00 = i * m + j;
+            const int v10 = ((i + 1) % n) * m + j;
+            const int v01 = i * m + (j + 1) % m;
+            const int v11 = ((i + 1) % n) * m + (j + 1) % m;
+            index.append(v00, v10, v11);
+            index.append(v00, v11, v01);
+        }
+    }
+}
+
+
+/** Distance from v to the surface of the torus */
+static float torusDistance(const Vector3& v) {
+    const Vector3 ring = Vector3(v.x, v.y, 0).directionOrZero() * TORUS_R;
+    return fabs((v - ring).length() - TORUS_r);
+}
+
+
+/** Checks that lod is a closed, valid mesh with at most maxFaces faces */
+static void checkClosedLOD(const MeshAlg::LOD& lod, int maxFaces) {
+    const int numVertices = lod.geometry.vertexArray.size();
+    debugAssert(lod.indexArray.size() % 3 == 0);
+    debugAssert(lod.indexArray.size() / 3 <= maxFaces);
+    debugAssert(lod.indexArray.size() > 0);
+    debugAssert(lod.geometry.normalArray.size() == numVertices);
+    debugAssert(lod.texCoordArray.size() == numVertices);
+
+    for (int i = 0; i < lod.indexArray.size(); ++i) {
+        debugAssert((lod.indexArray[i] >= 0) && (lod.indexArray[i] < numVertices));
+    }
+
+    Array<MeshAlg::Face>    faceArray;
+    Array<MeshAlg::Edge>    edgeArray;
+    Array<MeshAlg::Vertex>  vertexArray;
+    MeshAlg::computeAdjacency(lod.geometry.vertexArray, lod.indexArray, faceArray, edgeArray, vertexArray);
+    debugAssert(MeshAlg::countBoundaryEdges(edgeArray) == 0);
+    // A closed genus-one surface
+    debugAssert(numVertices - edgeArray.size() + faceArray.size() == 0);
+
+    for (int v = 0; v < numVertices; ++v) {
+        debugAssert(fuzzyEq(lod.geometry.normalArray[v].length(), 1.0f));
+        debugAssert(lod.texCoordArray[v].x >= 0 && lod.texCoordArray[v].x <= 1);
+        debugAssert(lod.texCoordArray[v].y >= 0 && lod.texCoordArray[v].y <= 1);
+    }
+}
+
+
+void testMeshAlgSimplify() {
+    printf("MeshAlg::simplify ");
+
+    {
+        MeshAlg::Geometry geometry;
+        Array<Vector2> texCoord;
+        Array<int> index;
+        makeTorus(40, 20, geometry, texCoord, index);
+
+        MeshAlg::LOD lod;
+        MeshAlg::simplify(geometry, texCoord, index, 400, lod);
+        checkClosedLOD(lod, 400);
+        debugAssert(lod.indexArray.size() / 3 > 300);
+        debugAssert(lod.geometricError > 0);
+
+        for (int v = 0; v < lod.geometry.vertexArray.size(); ++v) {
+            debugAssert(torusDistance(lod.geometry.vertexArray[v]) < 0.05f);
+            debugAssert(torusDistance(lod.geometry.vertexArray[v]) <= lod.geometricError + 0.01f);
+        }
+
+        // Asking for more faces than there are changes nothing but the order
+        MeshAlg::simplify(geometry, texCoord, index, index.size(), lod);
+        debugAssert(lod.indexArray.size() == index.size());
+        debugAssert(lod.geometry.vertexArray.size() == geometry.vertexArray.size());
+        debugAssert(lod.geometricError == 0);
+    }
+
+    {
+        // A flat grid keeps its plane and its outline
+        const int n = 30;
+        MeshAlg::Geometry geometry;
+        Array<Vector2> texCoord;
+        Array<int> index;
+        for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+                geometry.vertexArray.append(Vector3((float)x / (n - 1), (float)y / (n - 1), 0));
+            }
+        }
+        for (int y = 0; y < n - 1; ++y) {
+            for (int x = 0; x < n - 1; ++x) {
+                const int v = y * n + x;
+                index.append(v, v + 1, v + n + 1);
+                index.append(v, v + n + 1, v + n);
+            }
+        }
+
+        MeshAlg::LOD lod;
+        MeshAlg::simplify(geometry, texCoord, index, 20, lod);
+        debugAssert(lod.indexArray.size() / 3 <= 20);
+        debugAssert(lod.geometry.normalArray.size() == 0);
+        debugAssert(lod.texCoordArray.size() == 0);
+
+        Array<Vector3>& v = lod.geometry.vertexArray;
+        Vector3 lo = v[0], hi = v[0];
+        float area = 0;
+        for (int i = 0; i < v.size(); ++i) {
+            debugAssert(fuzzyEq(v[i].z, 0));
+            lo = lo.min(v[i]);
+            hi = hi.max(v[i]);
+        }
+        for (int i = 0; i < lod.indexArray.size(); i += 3) {
+            const Vector3 normal = (v[lod.indexArray[i + 1]] - v[lod.indexArray[i]]).cross(v[lod.indexArray[i + 2]] - v[lod.indexArray[i]]);
+            // No face flipped over
+            debugAssert(normal.z >= 0);
+            area += normal.z * 0.5f;
+        }
+        debugAssert(lo.fuzzyEq(Vector3::zero()) && hi.fuzzyEq(Vector3(1, 1, 0)));
+        debugAssert(fuzzyEq(area, 1.0f));
+    }
+
+    {
+        MeshAlg::Geometry geometry;
+        Array<Vector2> texCoord;
+        Array<int> index;
+        makeTorus(64, 32, geometry, texCoord, index);
+
+        Array<MeshAlg::LOD> chain;
+        MeshAlg::computeLODChain(geometry, texCoord, index, chain, 0.5f, 100);
+        debugAssert(chain.size() >= 5);
+        debugAssert(chain[0].indexArray.size() == index.size());
+        debugAssert(chain[0].geometricError == 0);
+        for (int i = 1; i < chain.size(); ++i) {
+            checkClosedLOD(chain[i], chain[i - 1].indexArray.size() / 6);
+            debugAssert(chain[i].indexArray.size() / 3 >= 100);
+            debugAssert(chain[i].geometricError >= chain[i - 1].geometricError);
+        }
+    }
+
+    {
+        // Small closed pieces that cannot be simplified stop the chain
+        // before a level would miss the ratio
+        MeshAlg::Geometry geometry;
+        Array<Vector2> texCoord;
+        Array<int> index;
+        makeTorus(32, 16, geometry, texCoord, index);
+        for (int t = 0; t < 200; ++t) {
+            const int v = geometry.vertexArray.size();
+            const Vector3 center(t * 3.0f + 5, 0, 0);
+            const Vector3 corner[4] = {Vector3(1, 1, 1), Vector3(1, -1, -1), Vector3(-1, 1, -1), Vector3(-1, -1, 1)};
+            for (int c = 0; c < 4; ++c) {
+                geometry.vertexArray.append(center + corner[c] * 0.1f);
+                geometry.normalArray.append(corner[c].direction());
+                texCoord.append(Vector2(0, 0));
+            }
+            index.append(v, v + 1, v + 2);
+            index.append(v, v + 3, v + 1);
+            index.append(v, v + 2, v + 3);
+            index.append(v + 1, v + 3, v + 2);
+        }
+
+        Array<MeshAlg::LOD> chain;
+        MeshAlg::computeLODChain(geometry, texCoord, index, chain, 0.5f, 16);
+        debugAssert(chain.size() >= 2);
+        for (int i = 1; i < chain.size(); ++i) {
+            debugAssert(chain[i].indexArray.size() / 3 <= chain[i - 1].indexArray.size() / 6);
+        }
+    }
+
+    printf("passed\n");
+}
+
+
+/** simplify on a torus */
+class SimplifyCase : public Benchmark::Case {
+public:
+    int                     n;
+    MeshAlg::Geometry       geometry;
+    Array<Vector2>          texCoord;
+    Array<int>              index;
+    Array<MeshAlg::LOD>     chain;
+
+    SimplifyCase(int n) : n(n) {}
+
+    virtual void setUp() {
+        makeTorus(2 * n, n, geometry, texCoord, index);
+    }
+
+    virtual void run() {
+        MeshAlg::computeLODChain(geometry, texCoord, index, chain);
+    }
+
+    virtual void tearDown() {
+        geometry.clear();
+        texCoord.clear();
+        index.clear();
+        chain.clear();
+    }
+};
+
+
+void perfMeshAlgSimplify(Benchmark& benchmark) {
+    benchmark.add("MeshAlg::computeLODChain (20k faces)",  new SimplifyCase(71),  4 * 71 * 71);
+    benchmark.add("MeshAlg::computeLODChain (200k faces)", new SimplifyCase(224), 4 * 224 * 224);
+}
@@ -0,0 +1,270 @@
+#include "G3D/G3DAll.h"
+
+/** Triangulated n x n vertex grid with its triangles in random order */
+static void makeShuffledGrid(int n, Array<int>& index) {
+    Array<int> order;
+    for (int t = 0; t < 2 * (n - 1) * (n - 1); ++t) {
+        order.append(t);
+    }
+    order.randomize();
+
+    index.fastClear();
+    for (int i = 0; i < order.size(); ++i) {
+        const int cell = order[i] / 2;
+        const int v = (cell / (n - 1)) * n + (cell % (n - 1));
+        if ((order[i] & 1) == 0) {
+            index.append(v, v + n, v + 1);
+        } else {
+            index.append(v + 1, v + n, v + n + 1);
+        }
+    }
+}
+
+
+/** Triangle (a, b, c) rotated to start at its smallest index, preserving the winding */
+class WoundTriangle {
+public:
+    int v[3];
+
+    WoundTriangle(const int* t) {
+        const int s = (t[0] < t[1]) ? ((t[0] < t[2]) ? 0 : 2) : ((t[1] < t[2]) ? 1 : 2);
+        for (int j = 0; j < 3; ++j) {
+            v[j] = t[(s + j) % 3];
+        }
+    }
+
+    bool operator<(const WoundTriangle& other) const {
+        for (int j = 0; j < 3; ++j) {
+            if (v[j] != other.v[j]) {
+                return v[j] < other.v[j];
+            }
+        }
+        return false;
+    }
+
+    bool operator==(const WoundTriangle& other) const {
+        return (v[0] == other.v[0]) && (v[1] == other.v[1]) && (v[2] == other.v[2]);
+    }
+};
+
+
+/** True if a and b hold the same triangles with the same windings, in any order */
+static bool sameTriangles(const Array<int>& a, const Array<int>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    std::vector<WoundTriangle> ta, tb;
+    for (int i = 0; i < a.size(); i += 3) {
+        ta.push_back(WoundTriangle(a.getCArray() + i));
+        tb.push_back(WoundTriangle(b.getCArray() + i));
+    }
+    std::sort(ta.begin(), ta.end());
+    std::sort(tb.begin(), tb.end());
+    return ta == tb;
+}
+
+
+void testMeshAlgVertexCache() {
+    printf("MeshAlg::optimizeVertexCache ");
+
+    {
+        double acmr, atvr;
+        Array<int> index;
+
+        index.append(0, 1, 2);
+        MeshAlg::computeVertexCacheStatistics(index, 3, acmr, atvr);
+        debugAssert(acmr == 3.0);
+        debugAssert(atvr == 1.0);
+
+        index.append(2, 1, 3);
+        MeshAlg::computeVertexCacheStatistics(index, 4, acmr, atvr, 3);
+        debugAssert(acmr == 2.0);
+        debugAssert(atvr == 1.0);
+
+        // A FIFO cache does not move 0 to the front when it is reused, so 3 pushes it out
+        index.fastClear();
+        index.append(0, 1, 2);
+        index.append(0, 3, 2);
+        index.append(3, 2, 0);
+        MeshAlg::computeVertexCacheStatistics(index, 4, acmr, atvr, 3);
+        debugAssert(fuzzyEq(acmr, 5.0 / 3.0));
+        debugAssert(atvr == 1.25);
+    }
+
+    {
+        const int n = 101;
+        Array<int> index;
+        makeShuffledGrid(n, index);
+        const Array<int> original = index;
+
+        double beforeACMR, beforeATVR, afterACMR, afterATVR;
+        MeshAlg::computeVertexCacheStatistics(index, n * n, beforeACMR, beforeATVR);
+        MeshAlg::optimizeVertexCache(index, n * n);
+        MeshAlg::computeVertexCacheStatistics(index, n * n, afterACMR, afterATVR);
+
+        debugAssert(sameTriangles(index, original));
+        debugAssert(beforeACMR > 2.0);
+        debugAssert(afterACMR < 0.75);
+        debugAssert(afterATVR < 1.5);
+
+        // Never makes a good order worse
+        const Array<int> once = index;
+        MeshAlg::optimizeVertexCache(index, n * n);
+        MeshAlg::computeVertexCacheStatistics(index, n * n, beforeACMR, beforeATVR);
+        debugAssert(beforeACMR <= afterACMR);
+        debugAssert((beforeACMR < afterACMR) ||
+                    (memcmp(index.getCArray(), once.getCArray(), sizeof(int) * index.size()) == 0));
+
+        // Fetch order: vertices numbered by first use, every triangle unchanged
+        Array<Vector3> vertex;
+        for (int v = 0; v < n * n; ++v) {
+            vertex.append(Vector3((float)(v % n), (float)(v / n), 0));
+        }
+        const Array<Vector3> originalVertex = vertex;
+        const Array<int> cached = index;
+
+        Array<int> toOld;
+        MeshAlg::optimizeVertexFetch(index, vertex.size(), toOld);
+        MeshAlg::reorderVertexArray(toOld, vertex);
+
+        debugAssert(toOld.size() == n * n);
+        int next = 0;
+        for (int i = 0; i < index.size(); ++i) {
+            debugAssert(index[i] <= next);
+            next = iMax(next, index[i] + 1);
+            debugAssert(vertex[index[i]] == originalVertex[cached[i]]);
+        }
+
+        MeshAlg::computeVertexCacheStatistics(index, vertex.size(), beforeACMR, beforeATVR);
+        debugAssert(beforeACMR == afterACMR);
+    }
+
+    {
+        // Degenerate triangles and unused vertices
+        Array<int> index;
+        index.append(0, 0, 1);
+        index.append(1, 2, 2);
+        index.append(5, 5, 5);
+        index.append(2, 1, 5);
+        const Array<int> original = index;
+
+        MeshAlg::optimizeVertexCache(index, 7);
+        debugAssert(sameTriangles(index, original));
+
+        Array<int> toOld;
+        MeshAlg::optimizeVertexFetch(index, 7, toOld);
+        debugAssert(toOld.size() == 4);
+        debugAssert(! toOld.contains(3) && ! toOld.contains(4) && ! toOld.contains(6));
+    }
+
+    {
+        Array<int> index, toOld;
+        MeshAlg::optimizeVertexCache(index, 0);
+        MeshAlg::optimizeVertexFetch(index, 0, toOld);
+        debugAssert(index.size() == 0);
+        debugAssert(toOld.size() == 0);
+    }
+
+    printf("passed\n");
+}
+
+
+/** Reads the vertices and triangles of an IFS file.  Returns false if there is no such file. */
+static bool loadIFS(const std::string& filename, Array<Vector3>& vertex, Array<int>& index) {
+    if (! fileExists(filename)) {
+        return false;
+    }
+
+    BinaryInput b(filename, G3D_LITTLE_ENDIAN);
+    b.readString32();
+    b.readFloat32();
+    b.readString32();
+    while (b.hasMore()) {
+        const std::string field = b.readString32();
+        const int num = b.readUInt32();
+        if (field == "VERTICES") {
+            vertex.resize(num);
+            for (int v = 0; v < num; ++v) {
+                vertex[v].deserialize(b);
+            }
+        } else if (field == "TRIANGLES") {
+            index.resize(num * 3);
+            for (int i = 0; i < num * 3; ++i) {
+                index[i] = b.readUInt32();
+            }
+        } else {
+            // Texture coordinates
+            b.skip(num * 2 * sizeof(float32));
+        }
+    }
+    return true;
+}
+
+
+/** optimizeVertexCache on a mesh from disk or a shuffled grid */
+class VertexCacheCase : public Benchmark::Case {
+public:
+    std::string         filename;
+    int                 n;
+    int                 numVertices;
+    Array<int>          original;
+    Array<int>          index;
+
+    VertexCacheCase(const std::string& filename) : filename(filename), n(0) {}
+    VertexCacheCase(int n) : n(n) {}
+
+    virtual void setUp() {
+        if (n > 0) {
+            makeShuffledGrid(n, original);
+            numVertices = n * n;
+        } else {
+            Array<Vector3> vertex;
+            loadIFS(filename, vertex, original);
+            numVertices = vertex.size();
+        }
+    }
+
+    virtual void run() {
+        index = original;
+        MeshAlg::optimizeVertexCache(index, numVertices);
+    }
+
+    virtual void tearDown() {
+        original.clear();
+        index.clear();
+    }
+};
+
+
+void perfMeshAlgVertexCache(Benchmark& benchmark) {
+    static const char* filename[] = {
+        "../gfxmeter/data-files/bunny.ifs",
+        "../data/ifs/cow.ifs",
+        "../data/ifs/teapot.ifs",
+        "../data/ifs/knot.ifs",
+        "../data/ifs/p51-mustang.ifs",
+        "../data/ifs/ah64-body.ifs"};
+
+    for (int f = 0; f < 6; ++f) {
+        Array<Vector3> vertex;
+        Array<int> index, toOld;
+        if (! loadIFS(filename[f], vertex, index)) {
+            continue;
+        }
+
+        double acmr[2], atvr[2];
+        MeshAlg::computeVertexCacheStatistics(index, vertex.size(), acmr[0], atvr[0]);
+        MeshAlg::optimizeVertexCache(index, vertex.size());
+        MeshAlg::optimizeVertexFetch(index, vertex.size(), toOld);
+        MeshAlg::computeVertexCacheStatistics(index, toOld.size(), acmr[1], atvr[1]);
+
+        printf("Vertex cache %-18s %6d tris   ACMR %5.3f -> %5.3f   ATVR %5.3f -> %5.3f\n",
+               filenameBaseExt(filename[f]).c_str(), index.size() / 3, acmr[0], acmr[1], atvr[0], atvr[1]);
+    }
+
+    if (fileExists(filename[0])) {
+        benchmark.add("MeshAlg::optimizeVertexCache (bunny)", new VertexCacheCase(filename[0]), 69451);
+    }
+    benchmark.add("MeshAlg::optimizeVertexCache (200k faces)", new VertexCacheCase(317), 2 * 316 * 316);
+}
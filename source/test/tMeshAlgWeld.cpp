@@ -0,0 +1,165 @@
+#include "G3D/G3DAll.h"
+
+/**
+ Triangle soup of an n x n grid on [0, 1]^2: every interior grid vertex
+ appears six times, moved by up to jitter.  If outlier, one extra vertex far
+ away stretches the bounds, as a stray point in a scan does.
+ */
+static void makeSoup(int n, float jitter, bool outlier, Array<Vector3>& vertex) {
+    vertex.fastClear();
+    const float s = 1.0f / (n - 1);
+    for (int y = 0; y < n - 1; ++y) {
+        for (int x = 0; x < n - 1; ++x) {
+            static const int corner[6][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1}};
+            for (int c = 0; c < 6; ++c) {
+                vertex.append(Vector3((x + corner[c][0]) * s, (y + corner[c][1]) * s, 0) +
+                              Vector3::random() * uniformRandom(0, jitter));
+            }
+        }
+    }
+    if (outlier) {
+        vertex.append(Vector3(1e4f, 1e4f, 1e4f));
+    }
+}
+
+
+/**
+ Welds one vertex at a time: a vertex is kept if no kept vertex is within
+ radius, and every vertex maps to the closest kept one.
+ */
+static void bruteForceWeld(const Array<Vector3>& vertex, double radius, Array<int>& toNew, Array<int>& kept) {
+    kept.fastClear();
+    for (int i = 0; i < vertex.size(); ++i) {
+        bool near = false;
+        for (int k = 0; (k < kept.size()) && ! near; ++k) {
+            near = ((double)(vertex[kept[k]] - vertex[i]).squaredMagnitude() <= radius * radius);
+        }
+        if (! near) {
+            kept.append(i);
+        }
+    }
+
+    toNew.resize(vertex.size());
+    for (int i = 0; i < vertex.size(); ++i) {
+        float best = inf();
+        for (int k = 0; k < kept.size(); ++k) {
+            const float d = (vertex[kept[k]] - vertex[i]).squaredMagnitude();
+            if (d < best) {
+                best = d;
+                toNew[i] = k;
+            }
+        }
+    }
+}
+
+
+static void checkWeld(const Array<Vector3>& vertex, double radius) {
+    Array<Vector3> welded;
+    Array<int> toNew, toOld;
+    MeshAlg::computeWeld(vertex, welded, toNew, toOld, radius);
+
+    Array<int> expectedToNew, kept;
+    bruteForceWeld(vertex, radius, expectedToNew, kept);
+
+    debugAssert(welded.size() == kept.size());
+    debugAssert(toOld.size() == welded.size());
+    debugAssert(toNew.size() == vertex.size());
+    for (int ni = 0; ni < kept.size(); ++ni) {
+        debugAssert(welded[ni] == vertex[kept[ni]]);
+        debugAssert(toNew[toOld[ni]] == ni);
+    }
+    for (int oi = 0; oi < vertex.size(); ++oi) {
+        debugAssert(toNew[oi] == expectedToNew[oi]);
+        debugAssert((double)(welded[toNew[oi]] - vertex[oi]).squaredMagnitude() <= radius * radius);
+    }
+}
+
+
+void testMeshAlgWeld() {
+    printf("MeshAlg::computeWeld ");
+
+    {
+        // Clusters of points whose neighborhoods overlap, so that the
+        // order of the vertices matters
+        Array<Vector3> vertex;
+        for (int c = 0; c < 200; ++c) {
+            const Vector3 center = Vector3::random() * uniformRandom(0, 3);
+            for (int i = 0; i < 10; ++i) {
+                vertex.append(center + Vector3::random() * uniformRandom(0, 0.15f));
+            }
+        }
+        vertex.randomize();
+
+        checkWeld(vertex, 0.1);
+        checkWeld(vertex, 0.01);
+        checkWeld(vertex, 0.5);
+    }
+
+    {
+        // Long chain of vertices, each within the radius of the next
+        Array<Vector3> vertex;
+        for (int i = 0; i < 500; ++i) {
+            vertex.append(Vector3(i * 0.9f, 0, 0));
+        }
+        checkWeld(vertex, 1.0);
+        vertex.reverse();
+        checkWeld(vertex, 1.0);
+    }
+
+    {
+        // Far-flung vertices, colocated vertices, and radius zero
+        Array<Vector3> vertex;
+        makeSoup(8, 0, true, vertex);
+        vertex.append(Vector3(-1e20f, 5, 0));
+        vertex.append(Vector3(1e20f, 5, 0));
+        checkWeld(vertex, 1e-5);
+        checkWeld(vertex, 0);
+    }
+
+    {
+        Array<Vector3> vertex, welded;
+        Array<int> toNew, toOld;
+        MeshAlg::computeWeld(vertex, welded, toNew, toOld);
+        debugAssert(welded.size() == 0);
+        debugAssert(toNew.size() == 0);
+        debugAssert(toOld.size() == 0);
+    }
+
+    printf("passed\n");
+}
+
+
+/** computeWeld on triangle soups */
+class WeldCase : public Benchmark::Case {
+public:
+    int                 n;
+    bool                outlier;
+    Array<Vector3>      vertex;
+    Array<Vector3>      welded;
+    Array<int>          toNew;
+    Array<int>          toOld;
+
+    WeldCase(int n, bool outlier) : n(n), outlier(outlier) {}
+
+    virtual void setUp() {
+        makeSoup(n, 1e-6f, outlier, vertex);
+    }
+
+    virtual void run() {
+        MeshAlg::computeWeld(vertex, welded, toNew, toOld, 1e-5);
+    }
+
+    virtual void tearDown() {
+        vertex.clear();
+        welded.clear();
+        toNew.clear();
+        toOld.clear();
+    }
+};
+
+
+void perfMeshAlgWeld(Benchmark& benchmark) {
+    benchmark.add("MeshAlg::computeWeld (100k soup)",             new WeldCase(130, false),  6 * 129 * 129);
+    benchmark.add("MeshAlg::computeWeld (100k soup with outlier)", new WeldCase(130, true),  6 * 129 * 129 + 1);
+    benchmark.add("MeshAlg::computeWeld (1M soup)",               new WeldCase(410, false),  6 * 409 * 409);
+}
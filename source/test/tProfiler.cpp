@@ -0,0 +1,187 @@
+#include "G3D/G3DAll.h"
+#include <string.h>
+
+static void spin(int n) {
+    volatile int x = 0;
+    for (int i = 0; i < n; ++i) {
+        x += i;
+    }
+}
+
+static void nested(int depth) {
+    G3D_PROFILE_ZONE("nested");
+    spin(1000);
+    if (depth > 0) {
+        nested(depth - 1);
+    }
+}
+
+static const Profiler::Tree* findTree(const std::string& threadName) {
+    const Array<Profiler::Tree>& frame = Profiler::previousFrame();
+    for (int i = 0; i < frame.size(); ++i) {
+        if (frame[i].threadName == threadName) {
+            return &frame[i];
+        }
+    }
+    return NULL;
+}
+
+static int findNode(const Profiler::Tree* tree, const char* name, int depth) {
+    for (int i = 0; i < tree->node.size(); ++i) {
+        if ((strcmp(tree->node[i].name, name) == 0) && (tree->node[i].depth == depth)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+class ProfiledThread : public GThread {
+public:
+    ProfiledThread() : GThread("ProfiledThread") {}
+protected:
+    virtual void threadMain() {
+        Profiler::setThreadName("worker");
+        for (int i = 0; i < 5; ++i) {
+            G3D_PROFILE_ZONE("work");
+            spin(1000);
+        }
+    }
+};
+
+void testProfiler() {
+    printf("G3D::Profiler ");
+
+    Profiler::setThreadName("main");
+
+    {
+        // Disabled zones record nothing
+        Profiler::setEnabled(false);
+        Profiler::endFrame();
+        {
+            G3D_PROFILE_ZONE("disabled");
+        }
+        Profiler::endFrame();
+        debugAssert(findTree("main") == NULL);
+    }
+
+    Profiler::setEnabled(true);
+
+    {
+        // Nesting and call counts
+        {
+            G3D_PROFILE_ZONE("outer");
+            for (int i = 0; i < 3; ++i) {
+                G3D_PROFILE_ZONE("inner");
+                spin(10000);
+            }
+            nested(2);
+        }
+        Profiler::endFrame();
+
+        const Profiler::Tree* tree = findTree("main");
+        debugAssert(tree != NULL);
+        debugAssert(tree->node.size() == 5);
+
+        const int outer = findNode(tree, "outer", 0);
+        const int inner = findNode(tree, "inner", 1);
+        debugAssert(outer == 0);
+        debugAssert(inner == 1);
+        debugAssert(tree->node[outer].callCount == 1);
+        debugAssert(tree->node[inner].callCount == 3);
+        debugAssert(tree->node[inner].parent == outer);
+        debugAssert(findNode(tree, "nested", 3) == 4);
+        debugAssert(tree->node[4].parent == 3);
+
+        for (int i = 0; i < tree->node.size(); ++i) {
+            debugAssert(tree->node[i].inclusiveTime >= tree->node[i].exclusiveTime);
+            debugAssert(tree->node[i].exclusiveTime >= 0);
+        }
+        debugAssert(tree->node[outer].inclusiveTime >= tree->node[inner].inclusiveTime);
+
+        Array<Profiler::Summary> top;
+        Profiler::getTopZones(top);
+        debugAssert(top.size() == 3);
+        for (int i = 1; i < top.size(); ++i) {
+            debugAssert(top[i - 1].exclusiveTime >= top[i].exclusiveTime);
+        }
+    }
+
+    {
+        // A zone open across the end of a frame appears in both frames
+        {
+            G3D_PROFILE_ZONE("long");
+            spin(1000);
+            Profiler::endFrame();
+            debugAssert(findTree("main")->node[0].callCount == 1);
+            spin(1000);
+        }
+        Profiler::endFrame();
+        const Profiler::Tree* tree = findTree("main");
+        debugAssert(tree->node.size() == 1);
+        debugAssert(strcmp(tree->node[0].name, "long") == 0);
+        debugAssert(tree->node[0].callCount == 0);
+
+        Profiler::endFrame();
+        debugAssert(findTree("main") == NULL);
+    }
+
+    {
+        // Other threads
+        Profiler::beginTrace();
+        ProfiledThread t;
+        t.start();
+        t.waitForCompletion();
+        {
+            G3D_PROFILE_ZONE("main");
+        }
+        {
+            G3D_PROFILE_ZONE("C:\\path\t\"quoted\"");
+        }
+        Profiler::endFrame();
+
+        const Profiler::Tree* tree = findTree("worker");
+        debugAssert(tree != NULL);
+        debugAssert(tree->node.size() == 1);
+        debugAssert(tree->node[0].callCount == 5);
+
+        Profiler::setThreadName("main \"thread\"");
+        Profiler::endTrace("profiler-trace.json");
+        Profiler::setThreadName("main");
+        std::string s = readFileAsString("profiler-trace.json");
+        debugAssert(beginsWith(s, "{\"traceEvents\":["));
+        debugAssert(s.find("\"name\":\"worker\"") != std::string::npos);
+        debugAssert(s.find("\"name\":\"work\",\"ph\":\"X\"") != std::string::npos);
+
+        // Names are escaped
+        debugAssert(s.find("\"name\":\"main \\\"thread\\\"\"") != std::string::npos);
+        debugAssert(s.find("\"name\":\"C:\\\\path\\u0009\\\"quoted\\\"\"") != std::string::npos);
+    }
+
+    {
+        // Overflowing the buffer drops whole zones, never just their ends
+        {
+            G3D_PROFILE_ZONE("overflow");
+            for (int i = 0; i < 10000; ++i) {
+                G3D_PROFILE_ZONE("many");
+            }
+        }
+        Profiler::endFrame();
+        const Profiler::Tree* tree = findTree("main");
+        debugAssert(tree->node.size() == 2);
+        debugAssert(tree->node[0].callCount == 1);
+        debugAssert(tree->node[1].callCount > 0);
+        debugAssert(tree->node[1].callCount < 10000);
+
+        // The buffer works again after the frame
+        {
+            G3D_PROFILE_ZONE("after");
+        }
+        Profiler::endFrame();
+        debugAssert(findTree("main")->node[0].callCount == 1);
+    }
+
+    Profiler::setEnabled(false);
+    Profiler::endFrame();
+
+    printf("passed\n");
+}
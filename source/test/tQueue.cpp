@@ -33,202 +33,242 @@ public:
 };
 
 
-void perfQueue() {
-    printf("Queue Performance:\n");
+/** G3D::Queue protected by a GMutex, for comparison with the lock-free queues */
+class LockedQueue {
+public:
+    GMutex          lock;
+    Queue<int>      queue;
+    int             maxSize;
+
+    LockedQueue(int m) : maxSize(m) {}
+
+    void push(int x) {
+        while (true) {
+            lock.lock();
+            if (queue.size() < maxSize) {
+                queue.pushBack(x);
+                lock.unlock();
+                return;
+            }
+            lock.unlock();
+            GThread::yield();
+        }
+    }
 
-    uint64 g3dStreamSmall = 0, g3dEnquequeFSmall = 0, g3dEnquequeBSmall = 0;
-    uint64 stdStreamSmall = 0, stdEnquequeFSmall = 0, stdEnquequeBSmall = 0;
+    int pop() {
+        while (true) {
+            lock.lock();
+            if (queue.size() > 0) {
+                int x = queue.popFront();
+                lock.unlock();
+                return x;
+            }
+            lock.unlock();
+            GThread::yield();
+        }
+    }
+};
 
-    uint64 g3dStreamLarge = 0, g3dEnquequeFLarge = 0, g3dEnquequeBLarge = 0;
-    uint64 stdStreamLarge = 0, stdEnquequeFLarge = 0, stdEnquequeBLarge = 0;
 
-    int iterations = 1000000;
-    int enqueuesize = 10000;
- 
-    // Number of elements in the queue at the beginning for streaming tests
-    int qsize = 1000;
-    {
-        Queue<int>      g3dQ;
-        std::deque<int> stdQ;
+/** Pushes first, first + 1, ..., first + count - 1 onto Q */
+template<class Q>
+class QueueProducer : public GThread {
+public:
+    Q&      queue;
+    int     first;
+    int     count;
 
+    QueueProducer(Q& q, int f, int c) : GThread("QueueProducer"), queue(q), first(f), count(c) {}
 
-        for (int i = 0; i < qsize; ++i) {
-            g3dQ.pushBack(i);
-            stdQ.push_back(i);
+protected:
+    virtual void threadMain() {
+        for (int i = 0; i < count; ++i) {
+            queue.push(first + i);
         }
+    }
+};
 
-        // Run many times to filter out startup behavior
-        for (int j = 0; j < 3; ++j) {
 
-            System::beginCycleCount(g3dStreamSmall);
-            {
-                for (int i = 0; i < iterations; ++i) {
-                    g3dQ.pushBack(g3dQ.popFront());
-                }
-            }
-            System::endCycleCount(g3dStreamSmall);   
-
-            System::beginCycleCount(stdStreamSmall);
-            {
-                for (int i = 0; i < iterations; ++i) {
-                    int v = stdQ[0];
-                    stdQ.pop_front();
-                    stdQ.push_back(v);
-                }
+/** Pops count elements from Q and sums them.  Checks that the elements from
+    each producer arrive in order. */
+template<class Q>
+class QueueConsumer : public GThread {
+public:
+    Q&      queue;
+    int     count;
+    int     producerSize;
+    int64   sum;
+    bool    ordered;
+
+    QueueConsumer(Q& q, int c, int p) : GThread("QueueConsumer"), queue(q), count(c), 
+        producerSize(p), sum(0), ordered(true) {}
+
+protected:
+    virtual void threadMain() {
+        Array<int> last;
+        for (int i = 0; i < count; ++i) {
+            int x = queue.pop();
+            int p = x / producerSize;
+            if (p >= last.size()) {
+                last.resize(p + 1);
+                last[p] = -1;
             }
-            System::endCycleCount(stdStreamSmall);   
+            ordered = ordered && (x > last[p]);
+            last[p] = x;
+            sum += x;
         }
     }
-    {
-        Queue<int>      g3dQ;
-        System::beginCycleCount(g3dEnquequeFSmall);
-        {
-            for (int i = 0; i < enqueuesize; ++i) {
-                g3dQ.pushFront(i);
-            }
-        }
-        System::endCycleCount(g3dEnquequeFSmall);   
+};
 
-        std::deque<int> stdQ;
-        System::beginCycleCount(stdEnquequeFSmall);
-        {
-            for (int i = 0; i < enqueuesize; ++i) {
-                stdQ.push_front(i);
-            }
-        }
-        System::endCycleCount(stdEnquequeFSmall);   
+
+/** Runs numProducers and numConsumers threads that pass n elements
+    through queue and returns the elapsed time. Checks the result. */
+template<class Q>
+static RealTime runQueueThreads(Q& queue, int numProducers, int numConsumers, int n) {
+    const int perProducer = n / numProducers;
+    const int perConsumer = n / numConsumers;
+    debugAssert(perProducer * numProducers == n);
+    debugAssert(perConsumer * numConsumers == n);
+
+    Array<QueueProducer<Q>*> producer;
+    Array<QueueConsumer<Q>*> consumer;
+    for (int i = 0; i < numProducers; ++i) {
+        producer.append(new QueueProducer<Q>(queue, i * perProducer, perProducer));
     }
-    {
-        Queue<int>      g3dQ;
-        System::beginCycleCount(g3dEnquequeBSmall);
-        {
-            for (int i = 0; i < enqueuesize; ++i) {
-                g3dQ.pushBack(i);
-            }
+    for (int i = 0; i < numConsumers; ++i) {
+        consumer.append(new QueueConsumer<Q>(queue, perConsumer, perProducer));
+    }
+
+    RealTime t0 = System::time();
+    for (int i = 0; i < numConsumers; ++i) {
+        consumer[i]->start();
+    }
+    for (int i = 0; i < numProducers; ++i) {
+        producer[i]->start();
+    }
+    for (int i = 0; i < numProducers; ++i) {
+        producer[i]->waitForCompletion();
+    }
+    for (int i = 0; i < numConsumers; ++i) {
+        consumer[i]->waitForCompletion();
+    }
+    RealTime t = System::time() - t0;
+
+    int64 sum = 0;
+    for (int i = 0; i < numConsumers; ++i) {
+        debugAssert(consumer[i]->ordered);
+        sum += consumer[i]->sum;
+    }
+    debugAssert(sum == (int64)n * (n - 1) / 2); (void)sum;
+
+    producer.deleteAll();
+    consumer.deleteAll();
+    return t;
+}
+
+
+// Adapters so that the same benchmark cases run on G3D::Queue and std::deque
+template<class T> static void pushBack(Queue<T>& q, const T& v)       { q.pushBack(v); }
+template<class T> static void pushBack(std::deque<T>& q, const T& v)  { q.push_back(v); }
+template<class T> static void pushFront(Queue<T>& q, const T& v)      { q.pushFront(v); }
+template<class T> static void pushFront(std::deque<T>& q, const T& v) { q.push_front(v); }
+template<class T> static T popFront(Queue<T>& q)                      { return q.popFront(); }
+template<class T> static T popFront(std::deque<T>& q) {
+    T v = q.front();
+    q.pop_front();
+    return v;
+}
+
+
+/** Cycles elements from the front to the back of a queue of constant size */
+template<class Q, class T>
+class QueueStreamCase : public Benchmark::Case {
+public:
+    enum {SIZE = 1000, ITERATIONS = 100000};
+
+    Q       q;
+
+    virtual void setUp() {
+        for (int i = 0; i < SIZE; ++i) {
+            pushBack(q, T());
         }
-        System::endCycleCount(g3dEnquequeBSmall);   
+    }
 
-        std::deque<int> stdQ;
-        System::beginCycleCount(stdEnquequeBSmall);
-        {
-            for (int i = 0; i < enqueuesize; ++i) {
-                stdQ.push_back(i);
-            }
+    virtual void run() {
+        for (int i = 0; i < ITERATIONS; ++i) {
+            pushBack(q, popFront(q));
         }
-        System::endCycleCount(stdEnquequeBSmall);   
     }
+};
 
-    /////////////////////////////////
-    {
-        Queue<BigE>      g3dQ;
-        std::deque<BigE> stdQ;
 
+/** Pushes elements onto an initially empty queue */
+template<class Q, class T>
+class QueuePileUpCase : public Benchmark::Case {
+public:
+    enum {SIZE = 10000};
 
-        for (int i = 0; i < qsize; ++i) {
-            BigE v;
-            g3dQ.pushBack(v);
-            stdQ.push_back(v);
-        }
+    bool    front;
 
-        // Run many times to filter out startup behavior
-        for (int j = 0; j < 3; ++j) {
-            BigE v = stdQ[0];
+    QueuePileUpCase(bool f) : front(f) {}
 
-            System::beginCycleCount(g3dStreamLarge);
-            {
-                for (int i = 0; i < iterations; ++i) {
-                    g3dQ.popFront();
-                    g3dQ.pushBack(v);
-                }
+    virtual void run() {
+        Q q;
+        T v;
+        if (front) {
+            for (int i = 0; i < SIZE; ++i) {
+                pushFront(q, v);
             }
-            System::endCycleCount(g3dStreamLarge);   
-
-            System::beginCycleCount(stdStreamLarge);
-            {
-                for (int i = 0; i < iterations; ++i) {
-                    stdQ.pop_front();
-                    stdQ.push_back(v);
-                }
+        } else {
+            for (int i = 0; i < SIZE; ++i) {
+                pushBack(q, v);
             }
-            System::endCycleCount(stdStreamLarge);   
         }
     }
-    {
-        Queue<BigE>      g3dQ;
-        System::beginCycleCount(g3dEnquequeFLarge);
-        {
-            BigE v;
-            for (int i = 0; i < enqueuesize; ++i) {
-                g3dQ.pushFront(v);
-            }
-        }
-        System::endCycleCount(g3dEnquequeFLarge);   
-
-        std::deque<BigE> stdQ;
-        System::beginCycleCount(stdEnquequeFLarge);
-        {
-            BigE v;
-            for (int i = 0; i < enqueuesize; ++i) {
-                stdQ.push_front(v);
-            }
-        }
-        System::endCycleCount(stdEnquequeFLarge);   
+};
+
+
+/** Passes elements from producer to consumer threads */
+template<class Q>
+class ConcurrentQueueCase : public Benchmark::Case {
+public:
+    enum {COUNT = 1 << 18};
+
+    int     numProducers;
+    int     numConsumers;
+
+    ConcurrentQueueCase(int p, int c) : numProducers(p), numConsumers(c) {}
+
+    virtual void run() {
+        Q q(1024);
+        runQueueThreads(q, numProducers, numConsumers, COUNT);
     }
-    {
-        Queue<BigE>      g3dQ;
-        System::beginCycleCount(g3dEnquequeBLarge);
-        BigE v;
-        for (int i = 0; i < enqueuesize; ++i) {
-            g3dQ.pushBack(v);
-        }
-        System::endCycleCount(g3dEnquequeBLarge);   
-
-        std::deque<BigE> stdQ;
-        System::beginCycleCount(stdEnquequeBLarge);
-        {
-            BigE v;
-            for (int i = 0; i < enqueuesize; ++i) {
-                stdQ.push_back(v);
-            }
-        }
-        System::endCycleCount(stdEnquequeBLarge);   
-    }
-
-
-    printf(" Pile-up push front cycles per elt (max queue size = %d)\n", enqueuesize);
-    printf("  G3D::Queue<int>             %5.02f\n",  g3dEnquequeFSmall / 
-(float)enqueuesize);
-    printf("  std::deque<int>             %5.02f\n",  stdEnquequeFSmall / 
-(float)enqueuesize);
-    printf("  G3D::Queue<BigE>            %5.02f\n",  g3dEnquequeFLarge / 
-(float)enqueuesize);
-    printf("  std::deque<BigE>            %5.02f\n",  stdEnquequeFLarge / 
-(float)enqueuesize);
-    printf("\n");
-
-    printf(" Pile-up push back cycles per elt (max queue size = %d)\n", enqueuesize);
-    printf("  G3D::Queue<int>             %5.02f\n",  g3dEnquequeBSmall / 
-(float)enqueuesize);
-    printf("  std::deque<int>             %5.02f\n",  stdEnquequeBSmall / 
-(float)enqueuesize);
-    printf("  G3D::Queue<BigE>            %5.02f\n",  g3dEnquequeBLarge / 
-(float)enqueuesize);
-    printf("  std::deque<BigE>            %5.02f\n",  stdEnquequeBLarge / 
-(float)enqueuesize);
-    printf("\n");
-
-    printf(" Streaming cycles per iteration (queue size = %d)\n", qsize);
-    printf("  G3D::Queue<int>             %5.02f\n",  g3dStreamSmall / 
-(float)iterations);
-    printf("  std::deque<int>             %5.02f\n",  stdStreamSmall / 
-(float)iterations);
-    printf("  G3D::Queue<BigE>            %5.02f\n",  g3dStreamLarge / 
-(float)iterations);
-    printf("  std::deque<BigE>            %5.02f\n",  stdStreamLarge / 
-(float)iterations);
-
-
-    printf("\n\n");
+};
+
+
+void perfQueue(Benchmark& benchmark) {
+    const int S = QueueStreamCase<Queue<int>, int>::ITERATIONS;
+    benchmark.add("Queue<int>::stream",         new QueueStreamCase<Queue<int>, int>(),             S);
+    benchmark.add("std::deque<int>::stream",    new QueueStreamCase<std::deque<int>, int>(),        S);
+    benchmark.add("Queue<BigE>::stream",        new QueueStreamCase<Queue<BigE>, BigE>(),           S);
+    benchmark.add("std::deque<BigE>::stream",   new QueueStreamCase<std::deque<BigE>, BigE>(),      S);
+
+    const int N = QueuePileUpCase<Queue<int>, int>::SIZE;
+    benchmark.add("Queue<int>::pushFront",          new QueuePileUpCase<Queue<int>, int>(true),         N);
+    benchmark.add("std::deque<int>::push_front",    new QueuePileUpCase<std::deque<int>, int>(true),    N);
+    benchmark.add("Queue<BigE>::pushFront",         new QueuePileUpCase<Queue<BigE>, BigE>(true),       N);
+    benchmark.add("std::deque<BigE>::push_front",   new QueuePileUpCase<std::deque<BigE>, BigE>(true),  N);
+    benchmark.add("Queue<int>::pushBack",           new QueuePileUpCase<Queue<int>, int>(false),        N);
+    benchmark.add("std::deque<int>::push_back",     new QueuePileUpCase<std::deque<int>, int>(false),   N);
+    benchmark.add("Queue<BigE>::pushBack",          new QueuePileUpCase<Queue<BigE>, BigE>(false),      N);
+    benchmark.add("std::deque<BigE>::push_back",    new QueuePileUpCase<std::deque<BigE>, BigE>(false), N);
+
+    const int C = ConcurrentQueueCase<LockedQueue>::COUNT;
+    benchmark.add("LockedQueue (1 producer 1 consumer)",    new ConcurrentQueueCase<LockedQueue>(1, 1),     C);
+    benchmark.add("SPSCQueue (1 producer 1 consumer)",      new ConcurrentQueueCase<SPSCQueue<int> >(1, 1), C);
+    benchmark.add("MPMCQueue (1 producer 1 consumer)",      new ConcurrentQueueCase<MPMCQueue<int> >(1, 1), C);
+    benchmark.add("LockedQueue (4 producers 4 consumers)",  new ConcurrentQueueCase<LockedQueue>(4, 4),     C);
+    benchmark.add("MPMCQueue (4 producers 4 consumers)",    new ConcurrentQueueCase<MPMCQueue<int> >(4, 4), C);
 }
 
 
@@ -268,6 +308,68 @@ static void testCopy() {
 }
 
 
+static void testSPSCQueue() {
+    SPSCQueue<int> q(5);
+    debugAssert(q.capacity() == 8);
+
+    int x;
+    debugAssert(! q.tryPop(x));
+    for (int i = 0; i < 8; ++i) {
+        debugAssert(q.tryPush(i));
+    }
+    debugAssert(! q.tryPush(8));
+    debugAssert(q.size() == 8);
+
+    debugAssert(q.pop() == 0);
+    debugAssert(q.tryPush(8));
+
+    Array<int> batch;
+    debugAssert(q.tryPopBatch(batch, 3) == 3);
+    debugAssert(batch[0] == 1 && batch[2] == 3);
+    debugAssert(q.tryPopBatch(batch, 100) == 5);
+    debugAssert(batch.last() == 8);
+    debugAssert(q.size() == 0);
+
+    // Wrap around many times across two threads
+    SPSCQueue<int> r(16);
+    runQueueThreads(r, 1, 1, 100000);
+
+    // Elements left in the queue are destroyed
+    {
+        SPSCQueue<std::string> s(4);
+        s.push("a");
+        s.push("b");
+        debugAssert(s.pop() == "a");
+    }
+}
+
+
+static void testMPMCQueue() {
+    MPMCQueue<int> q(4);
+    debugAssert(q.capacity() == 4);
+
+    int x;
+    debugAssert(! q.tryPop(x));
+    for (int i = 0; i < 4; ++i) {
+        debugAssert(q.tryPush(i));
+    }
+    debugAssert(! q.tryPush(4));
+
+    debugAssert(q.tryPop(x) && (x == 0));
+    debugAssert(q.tryPush(4));
+
+    Array<int> batch;
+    debugAssert(q.tryPopBatch(batch, 10) == 4);
+    debugAssert(batch[0] == 1 && batch[3] == 4);
+    debugAssert(q.size() == 0);
+
+    // Contended stress test; small capacity forces both full and empty waits
+    MPMCQueue<int> r(8);
+    runQueueThreads(r, 3, 2, 60000);
+    runQueueThreads(r, 1, 4, 60000);
+}
+
+
 void testQueue() {
     printf("Queue ");
 
@@ -361,6 +463,10 @@ void testQueue() {
         Queue<int> r(q);
         _check(r);
     }
+
+
+    testSPSCQueue();
+    testMPMCQueue();
     
     printf("succeeded\n");
 }
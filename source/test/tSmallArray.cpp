@@ -0,0 +1,155 @@
+#include "G3D/G3DAll.h"
+
+/** Counts live instances to check construction/destruction balance. */
+class SmallArrayCounted {
+public:
+    static int  live;
+    int         value;
+
+    SmallArrayCounted() : value(0) { ++live; }
+    SmallArrayCounted(int v) : value(v) { ++live; }
+    SmallArrayCounted(const SmallArrayCounted& c) : value(c.value) { ++live; }
+    ~SmallArrayCounted() { --live; }
+
+    bool operator==(const SmallArrayCounted& c) const {
+        return value == c.value;
+    }
+};
+
+int SmallArrayCounted::live = 0;
+
+
+void testSmallArray() {
+    printf("G3D::SmallArray  ");
+
+    // Inline storage and spilling to the heap
+    {
+        SmallArray<int, 4> a;
+        debugAssert(a.size() == 0);
+        debugAssert(a.isInline());
+
+        a.append(3, 1, 2);
+        debugAssert(a.isInline());
+        a.append(0);
+        debugAssert(a.isInline());
+        debugAssert(a.size() == 4);
+
+        a.append(7);
+        debugAssert(! a.isInline());
+        debugAssert(a.size() == 5);
+        debugAssert(a[0] == 3);
+        debugAssert(a[4] == 7);
+
+        // Appending an element of the array while it grows
+        for (int i = 0; i < 100; ++i) {
+            a.append(a[0]);
+        }
+        debugAssert(a.size() == 105);
+        debugAssert(a.last() == 3);
+
+        a.resize(5);
+        a.sort();
+        debugAssert(a[0] == 0 && a[1] == 1 && a[2] == 2 && a[3] == 3 && a[4] == 7);
+        a.sort(SORT_DECREASING);
+        debugAssert(a[0] == 7 && a[4] == 0);
+
+        a.fastRemove(0);
+        debugAssert(a.size() == 4);
+        debugAssert(a[0] == 0);
+        debugAssert(! a.contains(7));
+        debugAssert(a.findIndex(2) == 2);
+
+        a.remove(1);
+        debugAssert(a.size() == 3);
+        debugAssert(a[0] == 0 && a[1] == 2 && a[2] == 1);
+
+        // Shrinking back below N releases the heap storage
+        a.resize(2);
+        debugAssert(a.isInline());
+        debugAssert(a[0] == 0 && a[1] == 2);
+
+        a.insert(1, 9);
+        debugAssert(a[1] == 9 && a[2] == 2);
+        debugAssert(a.pop() == 2);
+
+        a.clear();
+        debugAssert(a.size() == 0);
+        debugAssert(a.isInline());
+    }
+
+    // Copy, assignment, and conversion to and from Array
+    {
+        SmallArray<int, 2> a;
+        for (int i = 0; i < 10; ++i) {
+            a.append(i);
+        }
+        SmallArray<int, 2> b = a;
+        SmallArray<int, 2> c;
+        c.append(5);
+        c = b;
+        debugAssert(c.size() == 10);
+        for (int i = 0; i < 10; ++i) {
+            debugAssert(b[i] == i);
+            debugAssert(c[i] == i);
+        }
+
+        Array<int> x;
+        c.getArray(x);
+        debugAssert(x.size() == 10);
+        debugAssert(x[9] == 9);
+
+        x.resize(1);
+        c = x;
+        debugAssert(c.size() == 1);
+        debugAssert(c[0] == 0);
+    }
+
+    // Non-POD elements are constructed and destroyed exactly once
+    {
+        {
+            SmallArray<SmallArrayCounted, 3> a;
+            for (int i = 0; i < 20; ++i) {
+                a.append(SmallArrayCounted(i));
+            }
+            debugAssert(SmallArrayCounted::live == 20);
+            SmallArray<SmallArrayCounted, 3> b = a;
+            debugAssert(SmallArrayCounted::live == 40);
+            b.resize(2);
+            debugAssert(SmallArrayCounted::live == 22);
+            a = b;
+            debugAssert(SmallArrayCounted::live == 4);
+            debugAssert(a[1].value == 1);
+        }
+        debugAssert(SmallArrayCounted::live == 0);
+    }
+
+    printf("passed\n");
+}
+
+
+/** Number of lists built per benchmark iteration */
+static const int SMALL_ARRAY_COUNT = 100000;
+
+/** Keeps the compiler from eliding the loops */
+static volatile int smallArraySink = 0;
+
+/** Builds and destroys 6-element lists */
+template<class A>
+static void buildSmallLists() {
+    int total = 0;
+    for (int i = 0; i < SMALL_ARRAY_COUNT; ++i) {
+        A a;
+        for (int j = 0; j < 6; ++j) {
+            a.append(i + j);
+        }
+        total += a[5];
+    }
+    smallArraySink = total;
+}
+
+
+void perfSmallArray(Benchmark& benchmark) {
+    benchmark.add("Array<int> 6 appends",           buildSmallLists<Array<int> >,           SMALL_ARRAY_COUNT);
+    benchmark.add("SmallArray<int 8> 6 appends",    buildSmallLists<SmallArray<int, 8> >,   SMALL_ARRAY_COUNT);
+}
+
@@ -0,0 +1,317 @@
+#include "G3D/G3DAll.h"
+
+static inline uint64 pairKey(int a, int b) {
+    return ((uint64)iMin(a, b) << 32) | (uint64)iMax(a, b);
+}
+
+
+/** Closed-interval overlap, the same test SweepAndPrune uses */
+static bool touches(const AABox& x, const AABox& y) {
+    for (int a = 0; a < 3; ++a) {
+        if ((x.low()[a] > y.high()[a]) || (y.low()[a] > x.high()[a])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/** Sorted keys of all overlapping pairs of live bodies */
+static void bruteForcePairs(const Array<AABox>& bounds, const Array<bool>& alive, Array<uint64>& out) {
+    out.fastClear();
+    for (int i = 0; i < bounds.size(); ++i) {
+        if (! alive[i]) {
+            continue;
+        }
+        for (int j = i + 1; j < bounds.size(); ++j) {
+            if (alive[j] && touches(bounds[i], bounds[j])) {
+                out.append(pairKey(i, j));
+            }
+        }
+    }
+    out.sort();
+}
+
+
+static void sortedKeys(const Array<SweepAndPrune::Pair>& pair, Array<uint64>& out) {
+    out.fastClear();
+    for (int i = 0; i < pair.size(); ++i) {
+        debugAssert(pair[i].a < pair[i].b);
+        out.append(pairKey(pair[i].a, pair[i].b));
+    }
+    out.sort();
+}
+
+
+/** Elements of sorted array x that are not in sorted array y */
+static void difference(const Array<uint64>& x, const Array<uint64>& y, Array<uint64>& out) {
+    out.fastClear();
+    int j = 0;
+    for (int i = 0; i < x.size(); ++i) {
+        while ((j < y.size()) && (y[j] < x[i])) {
+            ++j;
+        }
+        if ((j == y.size()) || (y[j] != x[i])) {
+            out.append(x[i]);
+        }
+    }
+}
+
+
+static bool sameKeys(const Array<uint64>& x, const Array<uint64>& y) {
+    if (x.size() != y.size()) {
+        return false;
+    }
+    for (int i = 0; i < x.size(); ++i) {
+        if (x[i] != y[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static AABox randomBox(float worldSize) {
+    const Vector3 p(uniformRandom(0, worldSize), uniformRandom(0, worldSize), uniformRandom(0, worldSize));
+    return AABox(p, p + Vector3(uniformRandom(0.5f, 2), uniformRandom(0.5f, 2), uniformRandom(0.5f, 2)));
+}
+
+
+/** Bodies move, appear, and disappear; after every step the pairs and the
+    deltas must match brute force */
+static void testSweepAndPruneMoving() {
+    SweepAndPrune sap;
+
+    // Indexed by body identifier
+    Array<AABox>    bounds;
+    Array<bool>     alive;
+    Array<Vector3>  velocity;
+
+    Array<uint64> previous, current, actual, expected;
+
+    for (int step = 0; step < 40; ++step) {
+        // A large batch (sorted from scratch) at first, then a few at a time
+        const int numInserts = (step == 0) ? 300 : ((step == 20) ? 100 : (step % 3));
+        for (int i = 0; i < numInserts; ++i) {
+            const AABox box = randomBox(15);
+            const int b = sap.insert(box);
+            if (b >= bounds.size()) {
+                bounds.resize(b + 1);
+                alive.resize(b + 1);
+                velocity.resize(b + 1);
+            }
+            bounds[b]   = box;
+            alive[b]    = true;
+            velocity[b] = Vector3::random() * 0.3f;
+        }
+
+        if (step % 4 == 3) {
+            for (int r = 0; r < 5; ++r) {
+                const int b = iRandom(0, bounds.size() - 1);
+                if (alive[b]) {
+                    sap.remove(b);
+                    alive[b] = false;
+                }
+            }
+        }
+
+        for (int b = 0; b < bounds.size(); ++b) {
+            if (alive[b]) {
+                bounds[b] = AABox(bounds[b].low() + velocity[b], bounds[b].high() + velocity[b]);
+                sap.setBounds(b, bounds[b]);
+            }
+        }
+
+        sap.step();
+
+        bruteForcePairs(bounds, alive, current);
+        sortedKeys(sap.pairs(), actual);
+        debugAssert(sameKeys(actual, current));
+
+        sortedKeys(sap.addedPairs(), actual);
+        difference(current, previous, expected);
+        debugAssert(sameKeys(actual, expected));
+
+        sortedKeys(sap.removedPairs(), actual);
+        difference(previous, current, expected);
+        debugAssert(sameKeys(actual, expected));
+
+        for (int i = 0; i < sap.pairs().size(); ++i) {
+            debugAssert(sap.overlapping(sap.pairs()[i].b, sap.pairs()[i].a));
+        }
+
+        previous = current;
+    }
+
+    int n = 0;
+    for (int b = 0; b < alive.size(); ++b) {
+        n += alive[b] ? 1 : 0;
+    }
+    debugAssert(sap.size() == n);
+}
+
+
+void testSweepAndPrune() {
+    printf("SweepAndPrune ");
+
+    // Touching boxes overlap; separated ones don't
+    {
+        SweepAndPrune sap;
+        const int a = sap.insert(AABox(Vector3(0, 0, 0), Vector3(1, 1, 1)));
+        const int b = sap.insert(AABox(Vector3(1, 0, 0), Vector3(2, 1, 1)));
+        const int c = sap.insert(AABox(Vector3(3, 0, 0), Vector3(4, 1, 1)));
+        sap.step();
+        debugAssert(sap.pairs().size() == 1);
+        debugAssert(sap.addedPairs().size() == 1);
+        debugAssert(sap.overlapping(a, b));
+        debugAssert(! sap.overlapping(b, c));
+
+        // Slide c onto b, and a away from b
+        sap.setBounds(c, AABox(Vector3(1.5f, 0.5f, 0.5f), Vector3(2.5f, 1.5f, 1.5f)));
+        sap.setBounds(a, AABox(Vector3(-2, 0, 0), Vector3(-1, 1, 1)));
+        sap.step();
+        debugAssert(sap.pairs().size() == 1);
+        debugAssert(sap.overlapping(b, c));
+        debugAssert(sap.addedPairs().size() == 1);
+        debugAssert(sap.addedPairs()[0] == SweepAndPrune::Pair(c, b));
+        debugAssert(sap.removedPairs().size() == 1);
+        debugAssert(sap.removedPairs()[0] == SweepAndPrune::Pair(a, b));
+
+        // Nothing moved
+        sap.step();
+        debugAssert(sap.addedPairs().size() == 0);
+        debugAssert(sap.removedPairs().size() == 0);
+
+        // Removing a body removes its pairs
+        sap.remove(c);
+        sap.step();
+        debugAssert(sap.pairs().size() == 0);
+        debugAssert(sap.removedPairs().size() == 1);
+        debugAssert(sap.size() == 2);
+
+        sap.clear();
+        debugAssert(sap.size() == 0);
+        sap.step();
+        debugAssert(sap.pairs().size() == 0);
+    }
+
+    // Bodies given by a frame
+    {
+        SweepAndPrune sap;
+        const AABox objectBounds(Vector3(-1, -1, -1), Vector3(1, 1, 1));
+        PhysicsFrame frame;
+        frame.translation = Vector3(10, 0, 0);
+        frame.rotation = Quat::fromAxisAngleRotation(Vector3::unitZ(), toRadians(45));
+        const int a = sap.insert(objectBounds, frame);
+
+        AABox expected;
+        frame.toCoordinateFrame().toWorldSpace(objectBounds).getBounds(expected);
+        debugAssert(sap.bounds(a).low().fuzzyEq(expected.low()));
+        debugAssert(sap.bounds(a).high().fuzzyEq(expected.high()));
+
+        // The rotated box reaches sqrt(2) from its center along x
+        const int b = sap.insert(AABox(Vector3(11.3f, -0.1f, -0.1f), Vector3(12, 0.1f, 0.1f)));
+        sap.step();
+        debugAssert(sap.overlapping(a, b));
+
+        frame.rotation = Quat();
+        sap.setBounds(a, objectBounds, frame);
+        sap.step();
+        debugAssert(! sap.overlapping(a, b));
+    }
+
+    testSweepAndPruneMoving();
+
+    printf("passed\n");
+}
+
+
+/** 10k boxes drifting through a world, the overlapping pairs found each frame */
+class SweepAndPruneCase : public Benchmark::Case {
+public:
+    enum {NUM_BODIES = 10000};
+
+    /** BRUTE_FORCE tests every pair; AABSPTREE rebuilds a tree and queries
+        it with every box */
+    enum Method {SWEEP_AND_PRUNE, BRUTE_FORCE, AABSPTREE};
+
+    Method                  method;
+    SweepAndPrune           sap;
+    Array<AABox>            bounds;
+    Array<Vector3>          velocity;
+    Array<int>              body;
+    AABSPTree<AABox>        tree;
+    Array<AABox>            member;
+    int                     numPairs;
+
+    SweepAndPruneCase(Method m) : method(m) {}
+
+    virtual void setUp() {
+        for (int i = 0; i < NUM_BODIES; ++i) {
+            bounds.append(randomBox(100));
+            velocity.append(Vector3::random() * 0.05f);
+            if (method == SWEEP_AND_PRUNE) {
+                body.append(sap.insert(bounds[i]));
+            }
+        }
+        sap.step();
+    }
+
+    virtual void beforeIteration() {
+        for (int i = 0; i < bounds.size(); ++i) {
+            bounds[i] = AABox(bounds[i].low() + velocity[i], bounds[i].high() + velocity[i]);
+        }
+    }
+
+    virtual void run() {
+        numPairs = 0;
+        switch (method) {
+        case SWEEP_AND_PRUNE:
+            for (int i = 0; i < bounds.size(); ++i) {
+                sap.setBounds(body[i], bounds[i]);
+            }
+            sap.step();
+            numPairs = sap.pairs().size();
+            break;
+
+        case BRUTE_FORCE:
+            for (int i = 0; i < bounds.size(); ++i) {
+                for (int j = i + 1; j < bounds.size(); ++j) {
+                    if (bounds[i].intersects(bounds[j])) {
+                        ++numPairs;
+                    }
+                }
+            }
+            break;
+
+        case AABSPTREE:
+            tree.clear();
+            tree.insert(bounds);
+            tree.balance();
+            for (int i = 0; i < bounds.size(); ++i) {
+                member.fastClear();
+                tree.getIntersectingMembers(bounds[i], member);
+                numPairs += member.size() - 1;
+            }
+            numPairs /= 2;
+            break;
+        }
+    }
+
+    virtual void tearDown() {
+        sap.clear();
+        bounds.clear();
+        velocity.clear();
+        body.clear();
+        tree.clear();
+        member.clear();
+    }
+};
+
+
+void perfSweepAndPrune(Benchmark& benchmark) {
+    benchmark.add("SweepAndPrune::step (moving)",           new SweepAndPruneCase(SweepAndPruneCase::SWEEP_AND_PRUNE), SweepAndPruneCase::NUM_BODIES);
+    benchmark.add("AABox::intersects all pairs (moving)",   new SweepAndPruneCase(SweepAndPruneCase::BRUTE_FORCE), SweepAndPruneCase::NUM_BODIES);
+    benchmark.add("AABSPTree<AABox> rebuild+query (moving)", new SweepAndPruneCase(SweepAndPruneCase::AABSPTREE), SweepAndPruneCase::NUM_BODIES);
+}
+
@@ -0,0 +1,200 @@
+#include "G3D/G3DAll.h"
+
+/** Allocates and frees a sliding window of blocks of random sizes. */
+class MallocThread : public GThread {
+public:
+    enum {WINDOW = 256};
+
+    bool            useSystem;
+    int             iterations;
+    size_t          maxSize;
+
+    /** Blocks left allocated at the end of the run for another thread to free. */
+    void*           block[WINDOW];
+
+    MallocThread(bool s, int n, size_t m) : GThread("MallocThread"),
+        useSystem(s), iterations(n), maxSize(m) {
+        for (int i = 0; i < WINDOW; ++i) {
+            block[i] = NULL;
+        }
+    }
+
+protected:
+
+    virtual void threadMain() {
+        // Simple LCG so that every thread sees the same sequence
+        // without sharing state.
+        uint32 seed = 1;
+        for (int i = 0; i < iterations; ++i) {
+            seed = seed * 1664525 + 1013904223;
+            const int slot = (seed >> 8) % WINDOW;
+            const size_t bytes = 1 + (seed >> 16) % maxSize;
+
+            if (useSystem) {
+                System::free(block[slot]);
+                block[slot] = System::malloc(bytes);
+            } else {
+                ::free(block[slot]);
+                block[slot] = ::malloc(bytes);
+            }
+            // Touch the memory
+            *(uint8*)block[slot] = (uint8)i;
+        }
+    }
+};
+
+
+/** Frees blocks that were allocated on other threads. */
+class FreeThread : public GThread {
+public:
+    MallocThread*   source;
+
+    FreeThread(MallocThread* s) : GThread("FreeThread"), source(s) {}
+
+protected:
+    virtual void threadMain() {
+        for (int i = 0; i < MallocThread::WINDOW; ++i) {
+            System::free(source->block[i]);
+            source->block[i] = NULL;
+        }
+    }
+};
+
+
+void testSystemMalloc() {
+    printf("System::malloc ");
+
+    // Single thread
+    {
+        Array<void*> p;
+        for (int i = 0; i < 10000; ++i) {
+            size_t bytes = (i * 37) % 6000;
+            p.append(System::malloc(bytes));
+            System::memset(p.last(), i & 0xFF, bytes);
+        }
+
+        // Grow a block through several size classes and into the heap
+        uint8* x = (uint8*)System::malloc(10);
+        for (int i = 0; i < 10; ++i) {
+            x[i] = i;
+        }
+        for (int size = 20; size < 10000; size *= 2) {
+            x = (uint8*)System::realloc(x, size);
+            for (int i = 0; i < 10; ++i) {
+                debugAssert(x[i] == i);
+            }
+        }
+        System::free(x);
+
+        for (int i = 0; i < p.size(); ++i) {
+            size_t bytes = (i * 37) % 6000;
+            if (bytes > 0) {
+                debugAssert(((uint8*)p[i])[bytes - 1] == (i & 0xFF));
+            }
+            System::free(p[i]);
+        }
+    }
+
+    // Blocks allocated on one thread and freed on another
+    {
+        const int N = 4;
+        MallocThread* producer[N];
+        FreeThread* consumer[N];
+        for (int t = 0; t < N; ++t) {
+            producer[t] = new MallocThread(true, 20000, 2000);
+            producer[t]->start();
+        }
+
+        for (int t = 0; t < N; ++t) {
+            producer[t]->waitForCompletion();
+            consumer[t] = new FreeThread(producer[t]);
+            consumer[t]->start();
+        }
+
+        for (int t = 0; t < N; ++t) {
+            consumer[t]->waitForCompletion();
+            for (int i = 0; i < MallocThread::WINDOW; ++i) {
+                debugAssert(producer[t]->block[i] == NULL);
+            }
+            delete consumer[t];
+            delete producer[t];
+        }
+
+        // The producers have exited; their caches must be reusable
+        // and the remotely freed blocks recoverable.
+        MallocThread again(true, 20000, 2000);
+        again.start();
+        again.waitForCompletion();
+        FreeThread cleanup(&again);
+        cleanup.start();
+        cleanup.waitForCompletion();
+    }
+
+    // Threads that start and exit one after another reuse the same cache
+    {
+        int active, before, after;
+        sscanf(System::mallocStatus().c_str(), "thread caches: %d/%d", &active, &before);
+        for (int t = 0; t < 50; ++t) {
+            MallocThread thread(true, 1000, 200);
+            thread.start();
+            thread.waitForCompletion();
+            FreeThread cleanup(&thread);
+            cleanup.start();
+            cleanup.waitForCompletion();
+        }
+        sscanf(System::mallocStatus().c_str(), "thread caches: %d/%d", &active, &after);
+        debugAssert(after <= before + 1);
+    }
+
+    printf("passed\n");
+}
+
+
+/** Runs MallocThreads in parallel and frees what they leave behind */
+class MallocCase : public Benchmark::Case {
+public:
+    enum {ITERATIONS = 200000};
+
+    bool    useSystem;
+    int     numThreads;
+
+    MallocCase(bool s, int n) : useSystem(s), numThreads(n) {}
+
+    virtual void run() {
+        Array<MallocThread*> thread;
+        for (int i = 0; i < numThreads; ++i) {
+            thread.append(new MallocThread(useSystem, ITERATIONS, 1024));
+        }
+
+        for (int i = 0; i < numThreads; ++i) {
+            thread[i]->start();
+        }
+        for (int i = 0; i < numThreads; ++i) {
+            thread[i]->waitForCompletion();
+        }
+
+        for (int i = 0; i < numThreads; ++i) {
+            for (int j = 0; j < MallocThread::WINDOW; ++j) {
+                if (useSystem) {
+                    System::free(thread[i]->block[j]);
+                } else {
+                    ::free(thread[i]->block[j]);
+                }
+            }
+            delete thread[i];
+        }
+    }
+};
+
+
+/** Wall-clock time per malloc + free pair on each thread.  With perfect 
+    scaling on enough cores this stays constant as the thread count grows. */
+void perfSystemMalloc(Benchmark& benchmark) {
+    for (int numThreads = 1; numThreads <= 8; numThreads *= 2) {
+        benchmark.add(format("::malloc (%d threads)", numThreads),
+                      new MallocCase(false, numThreads), MallocCase::ITERATIONS);
+        benchmark.add(format("System::malloc (%d threads)", numThreads),
+                      new MallocCase(true, numThreads), MallocCase::ITERATIONS);
+    }
+}
+
@@ -2,79 +2,55 @@
 
 
 
-void perfSystemMemcpy() {
-    printf("----------------------------------------------------------\n");
-
-    // Number of memory sizes to test
-    static const int M = 8;
-
-    //  Repeats per memory size
-    static const int trials = 200;
-
-    size_t size[M];
-    for (int i = 0; i < M; ++i) {
-		size[i] = 1024 * (size_t)::pow((float)(i + 1), 4);
+/** Copies between two aligned buffers, repeated to about 4 MB per iteration */
+class MemcpyCase : public Benchmark::Case {
+public:
+    bool    useSystem;
+    int     size;
+    int     repeats;
+    void*   src;
+    void*   dst;
+
+    MemcpyCase(bool s, int n) : useSystem(s), size(n), repeats(iMax(1, (4 << 20) / n)),
+        src(NULL), dst(NULL) {}
+
+    virtual void setUp() {
+        src = System::alignedMalloc(size, 1024*4);
+        dst = System::alignedMalloc(size, 1024*4);
+        System::memset(src, 1, size);
     }
 
-    printf("System::memcpy Performance:\n");
-    printf("  Measured in cycles/kb at various copy sizes\n\n");
-    uint64 native[M], g3d[M];
-
-    for (int m = 0; m < M; ++m) {
-        int n = size[m];
-        void* m1 = System::alignedMalloc(n, 1024*4);
-        void* m2 = System::alignedMalloc(n, 1024*4);
-
-        // First iteration just primes the system
-        ::memcpy(m1, m2, n);
-        System::beginCycleCount(native[m]);
-            for (int j = 0; j < trials; ++j) {
-                ::memcpy(m1, m2, n);
+    virtual void run() {
+        if (useSystem) {
+            for (int j = 0; j < repeats; ++j) {
+                System::memcpy(dst, src, size);
             }
-        System::endCycleCount(native[m]);
-
-        System::memcpy(m1, m2, n);
-        System::beginCycleCount(g3d[m]);
-            for (int j = 0; j < trials; ++j) {
-                System::memcpy(m1, m2, n);
+        } else {
+            for (int j = 0; j < repeats; ++j) {
+                ::memcpy(dst, src, size);
             }
-        System::endCycleCount(g3d[m]);
-
-        System::alignedFree(m1);
-        System::alignedFree(m2);
+        }
     }
 
-
-    printf("         Size       ");
-    for (int i = 0; i < M; ++i) {
-        printf("%6dk", (int)size[i] / 1024);
+    virtual void tearDown() {
+        System::alignedFree(src);
+        System::alignedFree(dst);
     }
-    printf("\n");
+};
 
-    printf("    ::memcpy        ");
-    for (int m = 0; m < M; ++m) {
-        double k = trials * (double)size[m] / 1024;
-        printf(" %6d", (int)(native[m] / k));
-    }
-    printf("\n");
 
-    printf("    System::memcpy* ");
-    for (int m = 0; m < M; ++m) {
-        double k = trials * (double)size[m] / 1024;
-        printf(" %6d", (int)(g3d[m] / k));
-    }
-    printf("\n");
-    
-
-    if (System::hasSSE2() && System::hasMMX()) {
-        printf("      * MMX on this machine\n");
-    } else if (System::hasSSE() && System::hasMMX()) {
-        printf("      * MMX on this machine\n");
-    } else {
-        printf("      * memcpy on this machine\n");
-    }
-    printf("\n");
+/** Cycles per element are cycles per kb.  System::memcpy uses MMX when available. */
+void perfSystemMemcpy(Benchmark& benchmark) {
+    // Number of memory sizes to test
+    static const int M = 8;
 
+    for (int i = 0; i < M; ++i) {
+        const int size = 1024 * (int)::pow((float)(i + 1), 4);
+        MemcpyCase* native = new MemcpyCase(false, size);
+        benchmark.add(format("::memcpy (%dk)", size / 1024), native, native->repeats * size / 1024);
+        MemcpyCase* g3d = new MemcpyCase(true, size);
+        benchmark.add(format("System::memcpy (%dk)", size / 1024), g3d, g3d->repeats * size / 1024);
+    }
 }
 
 
@@ -166,172 +166,160 @@ void testTable() {
         debugAssert(table.debugGetNumBuckets() == 10);
     }
 
-    printf("passed\n");
-}
+    // Heap pointers differ mostly in their low bits, which the hash must
+    // keep on 64-bit machines
+    {
+        Array<int*> p;
+        Table<int*, int> table;
+        Set<void*> set;
+        for (int i = 0; i < 1000; ++i) {
+            p.append(new int(i));
+            table.set(p[i], i);
+            set.insert(p[i]);
+        }
 
+        debugAssert(table.size() == 1000);
+        debugAssert(set.size() == 1000);
+        for (int i = 0; i < p.size(); ++i) {
+            debugAssert(table[p[i]] == i);
+            debugAssert(set.contains(p[i]));
+        }
+        debugAssert(table.debugGetDeepestBucketSize() < 10);
 
-template<class K, class V>
-void perfTest(const char* description, const K* keys, const V* vals, int M) {
-    uint64 tableSet = 0, tableGet = 0, tableRemove = 0;
-    uint64 mapSet = 0, mapGet = 0, mapRemove = 0;
-#   ifdef HAS_HASH_MAP
-    uint64 hashMapSet = 0, hashMapGet = 0, hashMapRemove = 0;
-#   endif
+        for (int i = 0; i < p.size(); ++i) {
+            set.remove(p[i]);
+            delete p[i];
+        }
+        debugAssert(set.size() == 0);
+    }
 
-    uint64 overhead = 0;
+    printf("passed\n");
+}
 
-    // Run many times to filter out startup behavior
-    for (int j = 0; j < 3; ++j) {
 
-        // There's a little overhead just for the loop and reading 
-        // the values from the arrays.  Take this into account when
-        // counting cycles.
-        System::beginCycleCount(overhead);
-        {K k; V v;
-        for (int i = 0; i < M; ++i) {
-            k = keys[i];
-            v = vals[i];
-        }
-        System::endCycleCount(overhead);
-        }
+// Adapters so that the same benchmark cases run on every table type
+template<class K, class V> static void set(Table<K, V>& t, const K& k, const V& v)     { t.set(k, v); }
+template<class K, class V> static void set(FlatTable<K, V>& t, const K& k, const V& v) { t.set(k, v); }
+template<class K, class V> static void set(std::map<K, V>& t, const K& k, const V& v)  { t[k] = v; }
+template<class K, class V> static void remove(Table<K, V>& t, const K& k)              { t.remove(k); }
+template<class K, class V> static void remove(FlatTable<K, V>& t, const K& k)          { t.remove(k); }
+template<class K, class V> static void remove(std::map<K, V>& t, const K& k)           { t.erase(k); }
+#ifdef HAS_HASH_MAP
+template<class K, class V> static void set(hash_map<K, V>& t, const K& k, const V& v)  { t[k] = v; }
+template<class K, class V> static void remove(hash_map<K, V>& t, const K& k)           { t.erase(k); }
+#endif
 
-        {Table<K, V> t;
-        System::beginCycleCount(tableSet);
-        for (int i = 0; i < M; ++i) {
-            t.set(keys[i], vals[i]);
-        }
-        System::endCycleCount(tableSet);
-        
-        System::beginCycleCount(tableGet);
-        for (int i = 0; i < M; ++i) {
-            t[keys[i]];
-        }
-        System::endCycleCount(tableGet);
 
-        System::beginCycleCount(tableRemove);
-        for (int i = 0; i < M; ++i) {
-            t.remove(keys[i]);
-        }
-        System::endCycleCount(tableRemove);
-        }
+/** Inserts, fetches, or removes every key */
+template<class T, class K, class V>
+class TableCase : public Benchmark::Case {
+public:
+    enum Op {SET, GET, REMOVE};
 
-        /////////////////////////////////
+    Op              op;
+    const Array<K>& keys;
+    const Array<V>& vals;
+    T*              table;
 
-        {std::map<K, V> t;
-        System::beginCycleCount(mapSet);
-        for (int i = 0; i < M; ++i) {
-            t[keys[i]] = vals[i];
-        }
-        System::endCycleCount(mapSet);
-        
-        System::beginCycleCount(mapGet);
-        for (int i = 0; i < M; ++i) {
-            t[keys[i]];
-        }
-        System::endCycleCount(mapGet);
+    TableCase(Op o, const Array<K>& k, const Array<V>& v) : op(o), keys(k), vals(v), table(NULL) {}
 
-        System::beginCycleCount(mapRemove);
-        for (int i = 0; i < M; ++i) {
-            t.erase(keys[i]);
-        }
-        System::endCycleCount(mapRemove);
+    void fill() {
+        for (int i = 0; i < keys.size(); ++i) {
+            set(*table, keys[i], vals[i]);
         }
+    }
 
-        /////////////////////////////////
-
-#       ifdef HAS_HASH_MAP
-        {hash_map<K, V> t;
-        System::beginCycleCount(hashMapSet);
-        for (int i = 0; i < M; ++i) {
-            t[keys[i]] = vals[i];
+    virtual void beforeIteration() {
+        if ((op == GET) && (table != NULL)) {
+            return;
         }
-        System::endCycleCount(hashMapSet);
-        
-        System::beginCycleCount(hashMapGet);
-        for (int i = 0; i < M; ++i) {
-            t[keys[i]];
+        delete table;
+        table = new T();
+        if (op != SET) {
+            fill();
         }
-        System::endCycleCount(hashMapGet);
+    }
 
-        System::beginCycleCount(hashMapRemove);
-        for (int i = 0; i < M; ++i) {
-            t.erase(keys[i]);
-        }
-        System::endCycleCount(hashMapRemove);
+    virtual void run() {
+        switch (op) {
+        case SET:
+            fill();
+            break;
+
+        case GET:
+            for (int i = 0; i < keys.size(); ++i) {
+                (*table)[keys[i]];
+            }
+            break;
+
+        case REMOVE:
+            for (int i = 0; i < keys.size(); ++i) {
+                remove(*table, keys[i]);
+            }
+            break;
         }
-#       endif
     }
 
-    tableSet -= overhead;
-    if (tableGet < overhead) {
-        tableGet = 0;
-    } else {
-        tableGet -= overhead;
+    virtual void tearDown() {
+        delete table;
+        table = NULL;
     }
-    tableRemove -= overhead;
-
-    mapSet -= overhead;
-    mapGet -= overhead;
-    mapRemove -= overhead;
-
-    float N = M;
-    printf("%s\n", description);
-    bool G3Dwin = 
-        (tableSet <= mapSet) &&
-        (tableGet <= mapGet) &&
-        (tableRemove <= mapRemove);
-    printf("Table         %9.1f  %9.1f  %9.1f   %s\n", 
-           (float)tableSet / N, (float)tableGet / N, (float)tableRemove / N,
-           G3Dwin ? " ok " : "FAIL"); 
+};
+
+
+template<class T, class K, class V>
+static void addTableCases(Benchmark& benchmark, const std::string& name, const std::string& suffix,
+                          const Array<K>& keys, const Array<V>& vals) {
+    typedef TableCase<T, K, V> C;
+    benchmark.add(name + "::set" + suffix,      new C(C::SET, keys, vals),      keys.size());
+    benchmark.add(name + "::get" + suffix,      new C(C::GET, keys, vals),      keys.size());
+    benchmark.add(name + "::remove" + suffix,   new C(C::REMOVE, keys, vals),   keys.size());
+}
+
+
+template<class K, class V>
+static void perfTest(Benchmark& benchmark, const std::string& types, const Array<K>& keys, const Array<V>& vals,
+                     const std::string& suffix = "") {
+    addTableCases<Table<K, V>, K, V>(benchmark, "Table<" + types + ">", suffix, keys, vals);
+    addTableCases<FlatTable<K, V>, K, V>(benchmark, "FlatTable<" + types + ">", suffix, keys, vals);
 #   ifdef HAS_HASH_MAP
-    printf("hash_map      %9.1f  %9.1f  %9.1f\n", (float)hashMapSet / N, (float)hashMapGet / N, (float)hashMapRemove / N); 
+    addTableCases<hash_map<K, V>, K, V>(benchmark, "hash_map<" + types + ">", suffix, keys, vals);
 #   endif
-    printf("std::map      %9.1f  %9.1f  %9.1f\n", (float)mapSet / N, (float)mapGet / N, (float)mapRemove / N); 
-    printf("\n");
+    addTableCases<std::map<K, V>, K, V>(benchmark, "std::map<" + types + ">", suffix, keys, vals);
 }
 
 
-void perfTable() {
-    printf("                insert       fetch     remove    outcome\n");
+void perfTable(Benchmark& benchmark) {
+    // The cases refer to the keys and values until the benchmark is destroyed
+    static Array<int> intKey, intVal, bigKey, bigVal;
+    static Array<std::string> stringKey, stringVal;
 
     const int M = 300;
-    {
-        int keys[M];
-        int vals[M];
-        for (int i = 0; i < M; ++i) {
-            keys[i] = i * 2;
-            vals[i] = i;
-        }
-        perfTest<int, int>("int,int", keys, vals, M);
+    intKey.resize(M);
+    intVal.resize(M);
+    stringKey.resize(M);
+    stringVal.resize(M);
+    for (int i = 0; i < M; ++i) {
+        intKey[i] = i * 2;
+        intVal[i] = i;
+        stringKey[i] = format("%d", i * 2);
+        stringVal[i] = format("%d", i);
     }
 
-    {
-        std::string keys[M];
-        int vals[M];
-        for (int i = 0; i < M; ++i) {
-            keys[i] = format("%d", i * 2);
-            vals[i] = i;
-        }
-        perfTest<std::string, int>("string, int", keys, vals, M);
-    }
-
-    {
-        int keys[M];
-        std::string vals[M];
-        for (int i = 0; i < M; ++i) {
-            keys[i] = i * 2;
-            vals[i] = format("%d", i);
-        }
-        perfTest<int, std::string>("int, string", keys, vals, M);
-    }
+    perfTest<int, int>(benchmark, "int int", intKey, intVal);
+    perfTest<std::string, int>(benchmark, "string int", stringKey, intVal);
+    perfTest<int, std::string>(benchmark, "int string", intKey, stringVal);
+    perfTest<std::string, std::string>(benchmark, "string string", stringKey, stringVal);
 
     {
-        std::string keys[M];
-        std::string vals[M];
-        for (int i = 0; i < M; ++i) {
-            keys[i] = format("%d", i * 2);
-            vals[i] = format("%d", i);
+        // Large enough that the tables do not fit in cache
+        const int L = 200000;
+        bigKey.resize(L);
+        bigVal.resize(L);
+        for (int i = 0; i < L; ++i) {
+            bigKey[i] = (i * 7919) % L;
+            bigVal[i] = i;
         }
-        perfTest<std::string, std::string>("string, string", keys, vals, M);
+        perfTest<int, int>(benchmark, "int int", bigKey, bigVal, " (200k)");
     }
 }
@@ -1,45 +1,85 @@
 #include "G3D/G3DAll.h"
 
-void perfTextOutput() {
-    printf("TextOutput\n");
+void testTextOutput() {
+    printf("G3D::TextOutput  ");
 
-    // printf
+    // Asynchronous commit with incremental flushing
     {
-        TextOutput t;
-        char buf[2048];
-
-        uint64 tt, tf, tp;
-        const int N = 5000;
-
-        System::beginCycleCount(tp);
-        for (int i = 0; i < N; ++i){
-            sprintf(buf, "%d, %d, %d\n", i, i + 1, i + 2);
+        TextOutput t("out.txt");
+        t.setAsyncFlushThreshold(100);
+        for (int i = 0; i < 1000; ++i) {
+            t.printf("%d\n", i);
         }
-        System::endCycleCount(tp);
+        t.printf("end");
+        AsyncWriteRef w = t.commitAsync();
+        w->wait();
+        debugAssert(w->ok());
 
-        std::string s;
-        System::beginCycleCount(tf);
-        for (int i = 0; i < N; ++i){
-            s = format("%d, %d, %d\n", i, i + 1, i + 2);
+        TextInput ti("out.txt");
+        for (int i = 0; i < 1000; ++i) {
+            debugAssert(ti.readNumber() == i);
         }
-        System::endCycleCount(tf);
+        debugAssert(ti.readSymbol() == "end");
+    }
 
-        System::beginCycleCount(tt);
-        for (int i = 0; i < N; ++i){
-            t.printf("%d, %d, %d\n", i, i + 1, i + 2);
-        }
-        System::endCycleCount(tt);
-        t.commitString(s);
-
-        int k = 3;
-        printf(" Cycles to print int32\n");
-        printf("   sprintf                    %g\n", (double)tp / (k * N));
-        printf("   format                     %g\n", (double)tf / (k * N));
-        printf("   TextOutput::printf         %g\n", (double)tt / (k * N));
-        printf("\n");
+    // Synchronous commit after incremental flushing
+    {
+        TextOutput t("out.txt");
+        t.setAsyncFlushThreshold(10);
+        t.writeSymbols("a", "b", "c");
+        t.writeNewline();
+        t.writeNumber(42);
+        t.writeNewline();
+        t.writeString("x y z");
+        t.commit();
+
+        TextInput ti("out.txt");
+        debugAssert(ti.readSymbol() == "a");
+        debugAssert(ti.readSymbol() == "b");
+        debugAssert(ti.readSymbol() == "c");
+        debugAssert(ti.readNumber() == 42);
+        debugAssert(ti.readString() == "x y z");
+    }
+
+    printf("passed\n");
+}
+
+
+/** Lines printed per benchmark iteration; each line has 3 ints */
+static const int PRINT_COUNT = 5000;
+
+static void printSprintf() {
+    char buf[2048];
+    for (int i = 0; i < PRINT_COUNT; ++i){
+        sprintf(buf, "%d, %d, %d\n", i, i + 1, i + 2);
     }
-    printf("\n\n");
-//    while(true);
+}
+
+
+static void printFormat() {
+    std::string s;
+    for (int i = 0; i < PRINT_COUNT; ++i){
+        s = format("%d, %d, %d\n", i, i + 1, i + 2);
+    }
+}
+
+
+static void printTextOutput() {
+    TextOutput t;
+    for (int i = 0; i < PRINT_COUNT; ++i){
+        t.printf("%d, %d, %d\n", i, i + 1, i + 2);
+    }
+    std::string s;
+    t.commitString(s);
+}
+
+
+/** Cycles per element are cycles to print one int32 */
+void perfTextOutput(Benchmark& benchmark) {
+    const int N = PRINT_COUNT * 3;
+    benchmark.add("sprintf",                printSprintf,       N);
+    benchmark.add("format",                 printFormat,        N);
+    benchmark.add("TextOutput::printf",     printTextOutput,    N);
 }
 
 
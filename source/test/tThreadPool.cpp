@@ -0,0 +1,192 @@
+#include "G3D/G3DAll.h"
+
+/** Marks every element it visits */
+class ThreadPoolCountBody {
+public:
+    AtomicInt32*    visits;
+    AtomicInt32*    calls;
+
+    void operator()(int begin, int end) const {
+        calls->increment();
+        for (int i = begin; i < end; ++i) {
+            visits[i].increment();
+        }
+    }
+};
+
+
+/** Runs a nested parallelFor from inside a pool task */
+class ThreadPoolNestedBody {
+public:
+    ThreadPool*     pool;
+    AtomicInt32*    visits;
+    int             inner;
+
+    void operator()(int begin, int end) const {
+        for (int i = begin; i < end; ++i) {
+            AtomicInt32 calls(0);
+            ThreadPoolCountBody body;
+            body.visits = visits + i * inner;
+            body.calls = &calls;
+            pool->parallelFor(0, inner, 7, body);
+        }
+    }
+};
+
+
+class ThreadPoolAddTask : public ThreadPool::Task {
+public:
+    AtomicInt32*    sum;
+    int             value;
+
+    virtual void run() {
+        sum->add(value);
+    }
+};
+
+
+static void checkVisits(AtomicInt32* visits, int n) {
+    for (int i = 0; i < n; ++i) {
+        debugAssert(visits[i].value() == 1);
+        visits[i] = 0;
+    }
+}
+
+
+void testThreadPool() {
+    printf("G3D::ThreadPool  ");
+
+    const int N = 10000;
+    AtomicInt32* visits = new AtomicInt32[N];
+    for (int i = 0; i < N; ++i) {
+        visits[i] = 0;
+    }
+
+    for (int numWorkers = 0; numWorkers <= 4; numWorkers += 2) {
+        ThreadPool pool(numWorkers);
+        debugAssert(pool.numWorkers() == numWorkers);
+
+        // Each element is visited exactly once, in ranges no longer than the grain
+        for (int grain = 1; grain <= N * 2; grain *= 13) {
+            AtomicInt32 calls(0);
+            ThreadPoolCountBody body;
+            body.visits = visits;
+            body.calls = &calls;
+            pool.parallelFor(0, N, grain, body);
+            checkVisits(visits, N);
+            debugAssert(calls.value() >= N / grain);
+        }
+
+        // Empty range
+        {
+            AtomicInt32 calls(0);
+            ThreadPoolCountBody body;
+            body.visits = visits;
+            body.calls = &calls;
+            pool.parallelFor(5, 5, 10, body);
+            debugAssert(calls.value() == 0);
+        }
+
+        // Nested parallelism must not deadlock
+        {
+            ThreadPoolNestedBody body;
+            body.pool = &pool;
+            body.visits = visits;
+            body.inner = 100;
+            pool.parallelFor(0, N / 100, 3, body);
+            checkVisits(visits, N);
+        }
+
+        // Task groups, stressed by many small tasks
+        for (int trial = 0; trial < 20; ++trial) {
+            AtomicInt32 sum(0);
+            Array<ThreadPoolAddTask> task;
+            task.resize(500);
+            {
+                ThreadPool::TaskGroup group(pool);
+                for (int i = 0; i < task.size(); ++i) {
+                    task[i].sum = &sum;
+                    task[i].value = i;
+                    group.run(&task[i]);
+                }
+                group.wait();
+                debugAssert(sum.value() == 500 * 499 / 2);
+
+                // Reuse after wait
+                ThreadPoolAddTask* extra = new ThreadPoolAddTask();
+                extra->sum = &sum;
+                extra->value = 1;
+                group.run(extra, true);
+                // Destructor waits
+            }
+            debugAssert(sum.value() == 500 * 499 / 2 + 1);
+        }
+    }
+
+    delete[] visits;
+
+    printf("passed\n");
+}
+
+
+/** Compute-bound loop body for the scaling benchmark */
+class ThreadPoolWorkBody {
+public:
+    float*          out;
+
+    void operator()(int begin, int end) const {
+        for (int i = begin; i < end; ++i) {
+            float x = (float)i;
+            for (int j = 0; j < 50; ++j) {
+                x = sqrt(x * x + 1.0f);
+            }
+            out[i] = x;
+        }
+    }
+};
+
+
+/** Applies ThreadPoolWorkBody to 1M elements, serially or on a pool of n threads
+    including the caller */
+class ThreadPoolCase : public Benchmark::Case {
+public:
+    enum {N = 1000000};
+
+    /** 0 for serial */
+    int                 numThreads;
+    ThreadPool*         pool;
+    Array<float>        out;
+    ThreadPoolWorkBody  body;
+
+    ThreadPoolCase(int n) : numThreads(n), pool(NULL) {}
+
+    virtual void setUp() {
+        out.resize(N);
+        body.out = out.getCArray();
+        if (numThreads > 0) {
+            pool = new ThreadPool(numThreads - 1);
+        }
+    }
+
+    virtual void run() {
+        if (pool == NULL) {
+            body(0, N);
+        } else {
+            pool->parallelFor(0, N, 1000, body);
+        }
+    }
+
+    virtual void tearDown() {
+        delete pool;
+        pool = NULL;
+        out.clear();
+    }
+};
+
+
+void perfThreadPool(Benchmark& benchmark) {
+    benchmark.add("ThreadPoolWorkBody (serial)", new ThreadPoolCase(0), ThreadPoolCase::N);
+    for (int n = 1; n <= iMax(4, System::numCores()); n *= 2) {
+        benchmark.add(format("ThreadPool::parallelFor (%d threads)", n), new ThreadPoolCase(n), ThreadPoolCase::N);
+    }
+}
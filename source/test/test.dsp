@@ -107,6 +107,10 @@ SOURCE=.\tAtomicInt32.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\tBenchmark.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\tBinaryIO.cpp
 # End Source File
 # Begin Source File
@@ -115,6 +119,10 @@ SOURCE=.\tCollisionDetection.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\tFlatTable.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\tGChunk.cpp
 # End Source File
 # Begin Source File
@@ -131,14 +139,38 @@ SOURCE=.\tMatrix3.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\tMemoryArena.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\tMeshAlgAdjacency.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\tMeshAlgNormals.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\tMeshAlgSimplify.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\tMeshAlgTangentSpace.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\tMeshAlgVertexCache.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\tMeshAlgWeld.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\tProfiler.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\tQuat.cpp
 # End Source File
 # Begin Source File
@@ -159,6 +191,18 @@ SOURCE=.\tReliableConduit.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\tSmallArray.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\tSweepAndPrune.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\tSystemMalloc.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\tSystemMemcpy.cpp
 # End Source File
 # Begin Source File
@@ -177,6 +221,10 @@ SOURCE=.\tTextInput.cpp
 
 SOURCE=.\tTextOutput.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=.\tThreadPool.cpp
+# End Source File
 # End Group
 # Begin Group "Header Files"
 